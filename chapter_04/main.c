@@ -8,6 +8,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 /* Window dimensions */
 #define WINDOW_WIDTH  800
@@ -22,7 +24,7 @@ static struct {
     float color_r;
     float color_g;
     float color_b;
-    int last_time;
+    float fps_time;
     int frame_count;
     float fps;
     bool fullscreen;
@@ -34,12 +36,14 @@ static struct {
     .color_r = 1.0f,
     .color_g = 0.5f,
     .color_b = 0.0f,
-    .last_time = 0,
+    .fps_time = 0.0f,
     .frame_count = 0,
     .fps = 0.0f,
     .fullscreen = false
 };
 
+static frame_clock_t frame_clock;
+
 /*
  * init_gl - Initialize OpenGL state
  */
@@ -94,15 +98,15 @@ void display(void) {
  * idle - GLUT idle callback
  */
 void idle(void) {
-    int current_time = glutGet(GLUT_ELAPSED_TIME);
-    float delta = (current_time - app_state.last_time) / 1000.0f;
+    float delta = (float)frame_clock_tick(&frame_clock);
     
     /* Update FPS counter every second */
-    if (current_time - app_state.last_time >= 1000) {
-        app_state.fps = app_state.frame_count / delta;
+    app_state.fps_time += delta;
+    if (app_state.fps_time >= 1.0f) {
+        app_state.fps = app_state.frame_count / app_state.fps_time;
         printf("FPS: %.1f\n", app_state.fps);
         app_state.frame_count = 0;
-        app_state.last_time = current_time;
+        app_state.fps_time = 0.0f;
     }
     
     /* Animate rotation */
@@ -148,6 +152,7 @@ void reshape(int width, int height) {
 void keyboard(unsigned char key, int x, int y) {
     (void)x;
     (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27:  /* ESC */
@@ -197,6 +202,7 @@ void keyboard(unsigned char key, int x, int y) {
 void special(int key, int x, int y) {
     (void)x;
     (void)y;
+    frame_pacer_wake();
     
     const float move_speed = 0.05f;
     
@@ -235,6 +241,7 @@ void special(int key, int x, int y) {
  * mouse - GLUT mouse button callback
  */
 void mouse(int button, int state, int x, int y) {
+    frame_pacer_wake();
     if (state == GLUT_DOWN) {
         switch (button) {
             case GLUT_LEFT_BUTTON:
@@ -263,6 +270,7 @@ void mouse(int button, int state, int x, int y) {
  * motion - GLUT mouse motion callback (button held)
  */
 void motion(int x, int y) {
+    frame_pacer_wake();
     /* Convert window coordinates to OpenGL coordinates */
     int width = glutGet(GLUT_WINDOW_WIDTH);
     int height = glutGet(GLUT_WINDOW_HEIGHT);
@@ -312,7 +320,8 @@ int main(int argc, char** argv) {
     
     /* Register callbacks */
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1); /* The cube turns by itself, even in on-demand mode */
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(special);
@@ -321,7 +330,7 @@ int main(int argc, char** argv) {
     glutPassiveMotionFunc(passive_motion);
     
     /* Initialize timing */
-    app_state.last_time = glutGet(GLUT_ELAPSED_TIME);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
     
     /* Enter main loop */
     glutMainLoop();
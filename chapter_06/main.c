@@ -10,15 +10,32 @@
 #include <stdlib.h>
 #include <math.h>
 #include "camera.h"
+#include "frame_pacer.h"
+#include "mat4.h"
+#include "thread_pool.h"
+#include "timing.h"
 
 #define WINDOW_WIDTH  1000
 #define WINDOW_HEIGHT 700
+#define GRID_MIN 1
+#define GRID_MAX 25   /* 15625 cubes */
 
 static int demo_mode = 0;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static camera_t camera;
 static int use_perspective = 1;
 
+/* Cube grid: model matrices are computed on worker threads, then the
+ * draw loop only has to hand each one to glMultMatrixf */
+static int grid_size = 5;
+static float* grid_matrices = NULL;
+static int grid_capacity = 0;
+static thread_pool_t* grid_pool = NULL;
+static double grid_prep_ms = 0.0;
+static int grid_prep_frames = 0;
+static double grid_report_time = 0.0;
+
 void draw_cube(float size) {
     float h = size / 2;
     
@@ -136,32 +153,64 @@ void demo_hierarchy(void) {
     glPopMatrix();
 }
 
-void demo_cubes_grid(void) {
-    int grid = 5;
-    float spacing = 2.0f;
+/* Worker task: model matrices for grid cells [begin, end) */
+static void grid_transform_range(void* ctx, int begin, int end) {
+    int grid = grid_size;
+    float spacing = 10.0f / grid;     /* Keep the grid the same overall size */
     float offset = (grid - 1) * spacing / 2.0f;
+    (void)ctx;
+
+    for (int n = begin; n < end; n++) {
+        int i = n / (grid * grid);
+        int j = (n / grid) % grid;
+        int k = n % grid;
+        float phase = (i + j + k) * 0.3f;
+
+        mat4_translate_rotate_scale(&grid_matrices[(size_t)n * 16],
+                                    i * spacing - offset, j * spacing - offset,
+                                    k * spacing - offset,
+                                    rotation + phase * 50, 1.0f, 1.0f, 0.0f,
+                                    spacing / 2.0f);
+    }
+}
+
+void demo_cubes_grid(void) {
+    int grid = grid_size;
+    int count = grid * grid * grid;
+
+    if (count > grid_capacity) {
+        float* data = realloc(grid_matrices, (size_t)count * 16 * sizeof(float));
+        if (!data) return;
+        grid_matrices = data;
+        grid_capacity = count;
+    }
+
+    /* Transform stage: finished before the first GL call of the grid */
+    uint64_t start = timing_now_ns();
+    thread_pool_parallel_for(grid_pool, count, 256, grid_transform_range, NULL);
+    grid_prep_ms += (timing_now_ns() - start) / 1e6;
+    grid_prep_frames++;
     
-    for (int i = 0; i < grid; i++) {
-        for (int j = 0; j < grid; j++) {
-            for (int k = 0; k < grid; k++) {
-                glPushMatrix();
-                    float x = i * spacing - offset;
-                    float y = j * spacing - offset;
-                    float z = k * spacing - offset;
-                    glTranslatef(x, y, z);
-                    
-                    float phase = (i + j + k) * 0.3f;
-                    glRotatef(rotation + phase * 50, 1.0f, 1.0f, 0.0f);
-                    
-                    float r = (float)i / grid;
-                    float g = (float)j / grid;
-                    float b = (float)k / grid;
-                    glColor3f(r, g, b);
-                    
-                    glutWireCube(0.5);
-                glPopMatrix();
-            }
-        }
+    for (int n = 0; n < count; n++) {
+        int i = n / (grid * grid);
+        int j = (n / grid) % grid;
+        int k = n % grid;
+
+        glPushMatrix();
+            glMultMatrixf(&grid_matrices[(size_t)n * 16]);
+            glColor3f((float)i / grid, (float)j / grid, (float)k / grid);
+            glutWireCube(0.5);
+        glPopMatrix();
+    }
+
+    double now = timing_seconds();
+    if (now - grid_report_time >= 1.0) {
+        printf("Grid %d^3 (%d cubes): transforms %.3f ms/frame on %d thread(s)\n",
+               grid, count, grid_prep_ms / grid_prep_frames,
+               thread_pool_size(grid_pool));
+        grid_prep_ms = 0.0;
+        grid_prep_frames = 0;
+        grid_report_time = now;
     }
 }
 
@@ -254,7 +303,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -265,9 +315,13 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
-        case 27: case 'q': case 'Q': exit(0); break;
+        case 27: case 'q': case 'Q':
+            thread_pool_destroy(grid_pool);
+            exit(0);
+            break;
         case '0': case '1': case '2': case '3': case '4':
             demo_mode = key - '0';
             printf("Demo mode: %d\n", demo_mode);
@@ -279,11 +333,20 @@ void keyboard(unsigned char key, int x, int y) {
             break;
         case 'w': case 'W': camera.distance -= 1.0f; break;
         case 's': case 'S': camera.distance += 1.0f; break;
+        case '+': case '=':
+            if (grid_size < GRID_MAX) grid_size++;
+            printf("Grid: %d cubes\n", grid_size * grid_size * grid_size);
+            break;
+        case '-': case '_':
+            if (grid_size > GRID_MIN) grid_size--;
+            printf("Grid: %d cubes\n", grid_size * grid_size * grid_size);
+            break;
     }
 }
 
 void special(int key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     switch (key) {
         case GLUT_KEY_LEFT: camera.angle_h -= 5.0f; break;
         case GLUT_KEY_RIGHT: camera.angle_h += 5.0f; break;
@@ -305,6 +368,7 @@ int main(int argc, char** argv) {
     printf("  0-4: Switch demo\n");
     printf("  P: Toggle perspective/orthographic\n");
     printf("  W/S: Zoom in/out\n");
+    printf("  +/-: Grow/shrink the cube grid (demo 2)\n");
     printf("  Arrows: Rotate camera\n");
     printf("  ESC/Q: Quit\n\n");
     
@@ -314,9 +378,12 @@ int main(int argc, char** argv) {
     glutCreateWindow("Chapter 6: Coordinate Systems & Matrix Stacks");
     
     init_gl();
+    grid_pool = thread_pool_create(0);
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(special);
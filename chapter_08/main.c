@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include "materials.h"
+#include "frame_pacer.h"
+#include "timing.h"
 
 #define WINDOW_WIDTH  1000
 #define WINDOW_HEIGHT 700
@@ -15,6 +17,7 @@
 static int material_preset = 0;
 static int lighting_enabled = 1;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static float light_angle = 0.0f;
 
 void setup_lighting(void) {
@@ -91,7 +94,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -106,6 +110,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27: case 'q': case 'Q': exit(0); break;
@@ -125,6 +130,7 @@ void keyboard(unsigned char key, int x, int y) {
 
 void special(int key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     switch (key) {
         case GLUT_KEY_LEFT: light_angle -= 5.0f; break;
         case GLUT_KEY_RIGHT: light_angle += 5.0f; break;
@@ -154,7 +160,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(special);
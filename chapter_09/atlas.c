@@ -0,0 +1,247 @@
+/*
+ * atlas.c - Many small images packed into a few large textures
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+
+void atlas_init(atlas_t* atlas, int page_size, int padding, int channels) {
+    int p = 1;
+
+    while (p < padding) p *= 2;
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->page_size = page_size;
+    atlas->padding = p;
+    atlas->channels = channels;
+}
+
+static int new_page(atlas_t* atlas) {
+    int n = atlas->page_count + 1;
+    unsigned char** pages = realloc(atlas->pages, n * sizeof(*pages));
+    if (pages) atlas->pages = pages;
+    atlas_skyline_t** skylines = realloc(atlas->skylines, n * sizeof(*skylines));
+    if (skylines) atlas->skylines = skylines;
+    int* skyline_count = realloc(atlas->skyline_count, n * sizeof(int));
+    if (skyline_count) atlas->skyline_count = skyline_count;
+    GLuint* textures = realloc(atlas->textures, n * sizeof(GLuint));
+    if (textures) atlas->textures = textures;
+    if (!pages || !skylines || !skyline_count || !textures) return -1;
+
+    size_t size = atlas->page_size;
+    unsigned char* pixels = calloc(size * size, atlas->channels);
+    /* Every segment is at least 'padding' wide */
+    atlas_skyline_t* skyline = malloc((size / atlas->padding + 1) * sizeof(atlas_skyline_t));
+    if (!pixels || !skyline) {
+        free(pixels);
+        free(skyline);
+        return -1;
+    }
+    skyline[0].x = skyline[0].y = 0;
+    skyline[0].width = atlas->page_size;
+    atlas->pages[n - 1] = pixels;
+    atlas->skylines[n - 1] = skyline;
+    atlas->skyline_count[n - 1] = 1;
+    atlas->textures[n - 1] = 0;
+    atlas->page_count = n;
+    return n - 1;
+}
+
+/* Height a w x h cell would sit at if its left edge is at segment i, or -1 */
+static int skyline_fit(const atlas_skyline_t* sky, int count, int i, int w, int h, int size) {
+    int y = 0, left = w;
+
+    if (sky[i].x + w > size) return -1;
+    for (int j = i; left > 0 && j < count; j++) {
+        if (sky[j].y > y) y = sky[j].y;
+        left -= sky[j].width;
+    }
+    return y + h <= size ? y : -1;
+}
+
+/* Raise the skyline under a cell placed at segment i */
+static void skyline_place(atlas_skyline_t* sky, int* count, int i, int y, int w, int h) {
+    int n = *count;
+    int right = sky[i].x + w;
+
+    /* The cell's top becomes a new segment in front of segment i */
+    memmove(sky + i + 1, sky + i, (n - i) * sizeof(*sky));
+    sky[i].y = y + h;
+    sky[i].width = w;
+    n++;
+
+    /* Cut away what the cell now covers */
+    for (int j = i + 1; j < n && sky[j].x < right;) {
+        int cut = right - sky[j].x;
+        if (cut >= sky[j].width) {
+            memmove(sky + j, sky + j + 1, (n - j - 1) * sizeof(*sky));
+            n--;
+        } else {
+            sky[j].x += cut;
+            sky[j].width -= cut;
+            break;
+        }
+    }
+
+    /* Merge neighbours at the same height */
+    for (int j = 0; j + 1 < n;) {
+        if (sky[j].y == sky[j + 1].y) {
+            sky[j].width += sky[j + 1].width;
+            memmove(sky + j + 1, sky + j + 2, (n - j - 2) * sizeof(*sky));
+            n--;
+        } else {
+            j++;
+        }
+    }
+    *count = n;
+}
+
+/* Copy an image into its cell, repeating its edge texels into the padding */
+static void copy_padded(const atlas_t* atlas, int page, int cell_x, int cell_y,
+                        const atlas_image_t* image) {
+    int c = atlas->channels, p = atlas->padding, w = image->width, h = image->height;
+    size_t stride = (size_t)atlas->page_size * c;
+
+    for (int y = -p; y < h + p; y++) {
+        int sy = y < 0 ? 0 : y >= h ? h - 1 : y;
+        const unsigned char* src = image->pixels + (size_t)sy * image->stride;
+        unsigned char* dst = atlas->pages[page] + (size_t)(cell_y + p + y) * stride +
+                             (size_t)cell_x * c;
+
+        for (int x = 0; x < p; x++) memcpy(dst + x * c, src, c);
+        memcpy(dst + p * c, src, (size_t)w * c);
+        for (int x = 0; x < p; x++) memcpy(dst + (p + w + x) * c, src + (w - 1) * c, c);
+    }
+}
+
+int atlas_add(atlas_t* atlas, const atlas_image_t* image, atlas_rect_t* rect) {
+    int p = atlas->padding, size = atlas->page_size;
+    /* Cells are whole multiples of the padding, so they start on multiples too */
+    int w = (image->width + 2 * p + p - 1) / p * p;
+    int h = (image->height + 2 * p + p - 1) / p * p;
+    int page = -1, best_i = -1, best_y = 0, best_top = size + 1;
+
+    rect->page = -1;
+    if (w > size || h > size) return -1;
+
+    /* Bottom-left: the lowest top edge, on the first page with room */
+    for (int pg = 0; pg < atlas->page_count && page < 0; pg++) {
+        const atlas_skyline_t* sky = atlas->skylines[pg];
+        for (int i = 0; i < atlas->skyline_count[pg]; i++) {
+            int y = skyline_fit(sky, atlas->skyline_count[pg], i, w, h, size);
+            if (y >= 0 && y + h < best_top) {
+                best_top = y + h;
+                best_y = y;
+                best_i = i;
+                page = pg;
+            }
+        }
+    }
+    if (page < 0) {
+        if ((page = new_page(atlas)) < 0) return -1;
+        best_i = 0;
+        best_y = 0;
+    }
+
+    int x = atlas->skylines[page][best_i].x;
+    skyline_place(atlas->skylines[page], &atlas->skyline_count[page], best_i, best_y, w, h);
+    copy_padded(atlas, page, x, best_y, image);
+
+    rect->page = page;
+    rect->x = x + p;
+    rect->y = best_y + p;
+    rect->width = image->width;
+    rect->height = image->height;
+    rect->u0 = (float)rect->x / size;
+    rect->v0 = (float)rect->y / size;
+    rect->u1 = (float)(rect->x + rect->width) / size;
+    rect->v1 = (float)(rect->y + rect->height) / size;
+    atlas->texels_used += (size_t)image->width * image->height;
+    return 0;
+}
+
+typedef struct {
+    int index, width, height;
+} pack_order_t;
+
+static int taller_first(const void* a, const void* b) {
+    const pack_order_t* pa = a;
+    const pack_order_t* pb = b;
+    if (pa->height != pb->height) return pb->height - pa->height;
+    if (pa->width != pb->width) return pb->width - pa->width;
+    return pa->index - pb->index;
+}
+
+int atlas_pack(atlas_t* atlas, const atlas_image_t* images, int count, atlas_rect_t* rects) {
+    pack_order_t* order = malloc(count * sizeof(pack_order_t));
+    int placed = 0;
+
+    for (int i = 0; i < count; i++) rects[i].page = -1;
+    if (!order) return 0;
+    for (int i = 0; i < count; i++) {
+        order[i].index = i;
+        order[i].width = images[i].width;
+        order[i].height = images[i].height;
+    }
+    qsort(order, count, sizeof(pack_order_t), taller_first);
+    for (int i = 0; i < count; i++) {
+        int k = order[i].index;
+        if (atlas_add(atlas, &images[k], &rects[k]) == 0) placed++;
+    }
+    free(order);
+    return placed;
+}
+
+int atlas_upload(atlas_t* atlas, const mipmap_options_t* opts) {
+    size_t stride = (size_t)atlas->page_size * atlas->channels;
+    GLint bound;
+
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    for (int i = 0; i < atlas->page_count; i++) {
+        mipmap_chain_t chain;
+
+        if (mipmap_build(&chain, atlas->pages[i], atlas->page_size, atlas->page_size, stride,
+                         atlas->channels, opts) != 0) {
+            glBindTexture(GL_TEXTURE_2D, (GLuint)bound);
+            return -1;
+        }
+        if (!atlas->textures[i]) glGenTextures(1, &atlas->textures[i]);
+        glBindTexture(GL_TEXTURE_2D, atlas->textures[i]);
+        mipmap_upload(&chain);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        mipmap_free(&chain);
+    }
+    glBindTexture(GL_TEXTURE_2D, (GLuint)bound);
+    return 0;
+}
+
+void atlas_remap_texcoords(const atlas_rect_t* rect, float* texcoords, int count) {
+    float du = rect->u1 - rect->u0, dv = rect->v1 - rect->v0;
+
+    for (int i = 0; i < count; i++) {
+        texcoords[i * 2] = rect->u0 + texcoords[i * 2] * du;
+        texcoords[i * 2 + 1] = rect->v0 + texcoords[i * 2 + 1] * dv;
+    }
+}
+
+float atlas_fill(const atlas_t* atlas) {
+    if (atlas->page_count == 0) return 0.0f;
+    return (float)atlas->texels_used /
+           ((float)atlas->page_count * atlas->page_size * atlas->page_size);
+}
+
+void atlas_free(atlas_t* atlas) {
+    for (int i = 0; i < atlas->page_count; i++) {
+        if (atlas->textures[i]) glDeleteTextures(1, &atlas->textures[i]);
+        free(atlas->pages[i]);
+        free(atlas->skylines[i]);
+    }
+    free(atlas->pages);
+    free(atlas->skylines);
+    free(atlas->skyline_count);
+    free(atlas->textures);
+    memset(atlas, 0, sizeof(*atlas));
+}
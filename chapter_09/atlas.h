@@ -0,0 +1,110 @@
+/*
+ * atlas.h - Many small images packed into a few large textures
+ *
+ * Binding a texture is a state change, and drawing 1,000 objects with
+ * 1,000 textures means 1,000 binds and 1,000 separate batches. Packed into
+ * an atlas, objects that share a page share a bind, and their vertex
+ * arrays can be drawn in one call once their texture coordinates point
+ * at the right part of the page:
+ *
+ *   atlas_t atlas;
+ *   atlas_init(&atlas, 2048, 4, 4);
+ *   atlas_pack(&atlas, images, count, rects);     (rects[i] says where)
+ *   atlas_upload(&atlas, &opts);
+ *   atlas_remap_texcoords(&rects[i], texcoords, vertex_count);
+ *   glBindTexture(GL_TEXTURE_2D, atlas.textures[rects[i].page]);
+ *
+ * Images are placed with the skyline bottom-left rule, tallest first.
+ * Each sits in a cell with 'padding' texels of its own edge repeated
+ * around it. Cells start on multiples of 'padding', so a mipmap level
+ * averages texels from one cell only down to level log2(padding); with
+ * padding 4, levels 0 to 2 never bleed a neighbour in.
+ *
+ * Texture coordinates outside 0..1 would reach into other images, so
+ * GL_REPEAT wrapping is lost: tile by splitting geometry instead.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <GL/glut.h>
+#include <stddef.h>
+#include "mipmap.h"
+
+typedef struct {
+    const unsigned char* pixels;
+    int width, height;
+    size_t stride;               /* Bytes between rows */
+} atlas_image_t;
+
+typedef struct {
+    int page;
+    int x, y, width, height;     /* The image's texels within the page */
+    float u0, v0, u1, v1;        /* The same, as texture coordinates */
+} atlas_rect_t;
+
+typedef struct {
+    int x, y, width;
+} atlas_skyline_t;
+
+typedef struct {
+    int page_size;
+    int padding;                 /* A power of two */
+    int channels;
+    int page_count;
+    unsigned char** pages;       /* page_size rows of page_size * channels bytes */
+    atlas_skyline_t** skylines;  /* Per page: the top edge of the space used */
+    int* skyline_count;
+    GLuint* textures;            /* After atlas_upload */
+    size_t texels_used;          /* Image texels, without padding */
+} atlas_t;
+
+/*
+ * atlas_init - Set up an empty atlas
+ *
+ * @page_size: Side of each page, a power of two
+ * @padding: Texels of edge kept around each image, rounded up to a power of two
+ * @channels: 1 to 4, for every image
+ */
+void atlas_init(atlas_t* atlas, int page_size, int padding, int channels);
+
+/*
+ * atlas_add - Place one image and copy it in, starting a page if need be
+ *
+ * Returns 0, or -1 if it cannot fit in a page or memory ran out.
+ */
+int atlas_add(atlas_t* atlas, const atlas_image_t* image, atlas_rect_t* rect);
+
+/*
+ * atlas_pack - Add images tallest first, which packs far tighter
+ *
+ * @rects: One per image, in the same order as 'images'
+ *
+ * Returns how many images were placed; rects for the rest have page -1.
+ */
+int atlas_pack(atlas_t* atlas, const atlas_image_t* images, int count, atlas_rect_t* rects);
+
+/*
+ * atlas_upload - Build each page's mipmaps and upload it as a texture
+ *
+ * Pages keep their pixels, so more images can be added and the atlas
+ * uploaded again. Returns 0, or -1 if memory ran out.
+ */
+int atlas_upload(atlas_t* atlas, const mipmap_options_t* opts);
+
+/*
+ * atlas_remap_texcoords - Move s,t pairs from 0..1 into an image's rect
+ *
+ * @texcoords: 'count' pairs, as for glTexCoordPointer(2, GL_FLOAT, 0, ...),
+ *             rewritten in place
+ */
+void atlas_remap_texcoords(const atlas_rect_t* rect, float* texcoords, int count);
+
+/*
+ * atlas_fill - Fraction of the pages' area holding image texels
+ */
+float atlas_fill(const atlas_t* atlas);
+
+void atlas_free(atlas_t* atlas);
+
+#endif /* ATLAS_H */
@@ -0,0 +1,200 @@
+/*
+ * dynamic_texture.c - Textures redrawn on the CPU, uploaded a rectangle at a time
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "dynamic_texture.h"
+
+#define CALL_TEXELS 1024         /* What a glTexSubImage2D call costs, in texels sent */
+
+static const GLenum formats[] = {0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA};
+
+int dynamic_texture_init(dynamic_texture_t* dt, int width, int height, int channels,
+                         const mipmap_options_t* opts) {
+    size_t total = 0;
+    GLint bound;
+
+    memset(dt, 0, sizeof(*dt));
+    if (width < 1 || height < 1 || (width & (width - 1)) || (height & (height - 1)) ||
+        channels < 1 || channels > 4 || (opts && opts->filter != MIPMAP_BOX)) {
+        return -1;
+    }
+    if (opts) dt->opts = *opts;
+    else mipmap_options_defaults(&dt->opts);
+
+    /* Levels in one block, laid out as mipmap_build would */
+    mipmap_chain_t* chain = &dt->chain;
+    chain->channels = channels;
+    for (int w = width, h = height;; w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1) {
+        int i = chain->levels++;
+        chain->width[i] = w;
+        chain->height[i] = h;
+        chain->stride[i] = ((size_t)w * channels + 3) & ~(size_t)3;
+        total += chain->stride[i] * h;
+        if (!opts || (w == 1 && h == 1)) break;
+    }
+    if (!(chain->pixels = calloc(total, 1))) return -1;
+    total = 0;
+    for (int i = 0; i < chain->levels; i++) {
+        chain->level[i] = chain->pixels + total;
+        total += chain->stride[i] * chain->height[i];
+    }
+
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    glGenTextures(1, &dt->texture);
+    glBindTexture(GL_TEXTURE_2D, dt->texture);
+    mipmap_upload(chain);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, opts ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, (GLuint)bound);
+    return 0;
+}
+
+static size_t area(const dynamic_rect_t* r) {
+    return (size_t)r->width * r->height;
+}
+
+static dynamic_rect_t merged(const dynamic_rect_t* a, const dynamic_rect_t* b) {
+    dynamic_rect_t u;
+    int x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+    int y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+
+    u.x = a->x < b->x ? a->x : b->x;
+    u.y = a->y < b->y ? a->y : b->y;
+    u.width = x1 - u.x;
+    u.height = y1 - u.y;
+    return u;
+}
+
+void dynamic_texture_mark(dynamic_texture_t* dt, int x, int y, int width, int height) {
+    dynamic_rect_t r;
+    int x1 = x + width, y1 = y + height;
+
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > dt->chain.width[0]) x1 = dt->chain.width[0];
+    if (y1 > dt->chain.height[0]) y1 = dt->chain.height[0];
+    if (x1 <= x || y1 <= y) return;
+    r.x = x;
+    r.y = y;
+    r.width = x1 - x;
+    r.height = y1 - y;
+
+    /* Fold in every rectangle the union would not grow: overlapping or touching */
+    for (int i = 0; i < dt->dirty_count;) {
+        dynamic_rect_t u = merged(&r, &dt->dirty[i]);
+        if (area(&u) <= area(&r) + area(&dt->dirty[i])) {
+            r = u;
+            dt->dirty[i] = dt->dirty[--dt->dirty_count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    /* Full: join the one whose union with r wastes least (every union grows now) */
+    if (dt->dirty_count == DYNAMIC_TEXTURE_MAX_RECTS) {
+        size_t best_waste = (size_t)-1;
+        int best = 0;
+        for (int i = 0; i < dt->dirty_count; i++) {
+            dynamic_rect_t u = merged(&r, &dt->dirty[i]);
+            size_t waste = area(&u) - area(&r) - area(&dt->dirty[i]);
+            if (waste < best_waste) {
+                best_waste = waste;
+                best = i;
+            }
+        }
+        dt->dirty[best] = merged(&r, &dt->dirty[best]);
+        return;
+    }
+    dt->dirty[dt->dirty_count++] = r;
+}
+
+/* The rectangle of 'level' built from 'r' on the level above, which it
+ * replaces. -1, with 'r' unchanged, if the filter ran out of memory */
+static int rebuild_region(dynamic_texture_t* dt, int level, dynamic_rect_t* r) {
+    const mipmap_chain_t* chain = &dt->chain;
+    int c = chain->channels;
+    int src_w = chain->width[level - 1], src_h = chain->height[level - 1];
+    int x0 = r->x / 2, y0 = r->y / 2;
+    int x1 = (r->x + r->width + 1) / 2, y1 = (r->y + r->height + 1) / 2;
+
+    if (x1 > chain->width[level]) x1 = chain->width[level];
+    if (y1 > chain->height[level]) y1 = chain->height[level];
+
+    /* Source texels 2x and 2x + 1, or the single column or row of a 1-wide level */
+    int sx = src_w > 1 ? 2 * x0 : 0, sy = src_h > 1 ? 2 * y0 : 0;
+    int sw = src_w > 1 ? 2 * (x1 - x0) : 1, sh = src_h > 1 ? 2 * (y1 - y0) : 1;
+    if (mipmap_resample(chain->level[level - 1] + (size_t)sy * chain->stride[level - 1] +
+                            (size_t)sx * c,
+                        sw, sh, chain->stride[level - 1],
+                        chain->level[level] + (size_t)y0 * chain->stride[level] + (size_t)x0 * c,
+                        x1 - x0, y1 - y0, chain->stride[level], c, &dt->opts) != 0) {
+        return -1;
+    }
+    r->x = x0;
+    r->y = y0;
+    r->width = x1 - x0;
+    r->height = y1 - y0;
+    return 0;
+}
+
+/* Straight from the copy: the row length and skips pick out the rectangle */
+static void upload_rect(const mipmap_chain_t* chain, int level, const dynamic_rect_t* r) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, chain->width[level]);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, r->x);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, r->y);
+    glTexSubImage2D(GL_TEXTURE_2D, level, r->x, r->y, r->width, r->height,
+                    formats[chain->channels], GL_UNSIGNED_BYTE, chain->level[level]);
+}
+
+size_t dynamic_texture_update(dynamic_texture_t* dt) {
+    const mipmap_chain_t* chain = &dt->chain;
+    size_t bytes = 0;
+    GLint bound;
+
+    if (dt->dirty_count == 0) return 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    glBindTexture(GL_TEXTURE_2D, dt->texture);
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    /* Level by level, as each level's rectangles are built from the one
+     * above. A level that cannot be rebuilt is not sent, nor are the ones
+     * below it: they keep their old texels */
+    for (int level = 0; level < chain->levels; level++) {
+        size_t texels = 0, level_texels = (size_t)chain->width[level] * chain->height[level];
+        int rebuilt = 1;
+
+        for (int i = 0; i < dt->dirty_count && rebuilt; i++) {
+            if (level > 0 && rebuild_region(dt, level, &dt->dirty[i]) != 0) rebuilt = 0;
+            texels += area(&dt->dirty[i]);
+        }
+        if (!rebuilt) break;
+        /* Half the level dirty, or so many small rectangles that the calls
+         * cost more than the texels: send the level whole */
+        if (2 * texels + (size_t)dt->dirty_count * CALL_TEXELS >= level_texels) {
+            dynamic_rect_t all = {0, 0, chain->width[level], chain->height[level]};
+            upload_rect(chain, level, &all);
+            bytes += level_texels * chain->channels;
+            dt->calls++;
+        } else {
+            for (int i = 0; i < dt->dirty_count; i++) upload_rect(chain, level, &dt->dirty[i]);
+            bytes += texels * chain->channels;
+            dt->calls += dt->dirty_count;
+        }
+    }
+
+    glPopClientAttrib();
+    glBindTexture(GL_TEXTURE_2D, (GLuint)bound);
+    dt->dirty_count = 0;
+    dt->bytes_uploaded += bytes;
+    return bytes;
+}
+
+void dynamic_texture_free(dynamic_texture_t* dt) {
+    if (dt->texture) glDeleteTextures(1, &dt->texture);
+    mipmap_free(&dt->chain);
+    memset(dt, 0, sizeof(*dt));
+}
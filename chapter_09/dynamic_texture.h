@@ -0,0 +1,86 @@
+/*
+ * dynamic_texture.h - Textures redrawn on the CPU, uploaded a rectangle at a time
+ *
+ * A texture whose pixels change every frame (a plot, a minimap, a video
+ * frame with a small moving part) does not need all of them sent again.
+ * The texture keeps a CPU copy; drawing code changes the copy, marks what
+ * it touched, and the update sends only those rectangles with
+ * glTexSubImage2D:
+ *
+ *   dynamic_texture_t plot;
+ *   dynamic_texture_init(&plot, 512, 256, 4, &opts);   (NULL: no mipmaps)
+ *
+ *   Every frame:
+ *   unsigned char* row = plot.chain.level[0] + y * plot.chain.stride[0];
+ *   ...change some texels...
+ *   dynamic_texture_mark(&plot, x, y, width, height);
+ *   dynamic_texture_update(&plot);
+ *   glBindTexture(GL_TEXTURE_2D, plot.texture);
+ *
+ * Marks that overlap or touch are merged. Past DYNAMIC_TEXTURE_MAX_RECTS,
+ * each new mark joins the one it wastes least space with. A level whose
+ * marks cover half of it, or that would take many calls for a few texels
+ * each (the small levels, mostly), is sent whole in one call.
+ *
+ * With mipmaps, each dirty rectangle is rebuilt only where it reaches into
+ * the smaller levels: a 2x2 box average of the rectangle above, widened to
+ * even texels, so the result matches mipmap_build on the whole image. The
+ * Kaiser filter reaches 12 texels across and is not offered here; gamma
+ * correction is.
+ */
+
+#ifndef DYNAMIC_TEXTURE_H
+#define DYNAMIC_TEXTURE_H
+
+#include <GL/glut.h>
+#include <stddef.h>
+#include "mipmap.h"
+
+#define DYNAMIC_TEXTURE_MAX_RECTS 256
+
+typedef struct {
+    int x, y, width, height;
+} dynamic_rect_t;
+
+typedef struct {
+    GLuint texture;
+    mipmap_chain_t chain;        /* The CPU copy; draw into level[0] */
+    mipmap_options_t opts;
+    dynamic_rect_t dirty[DYNAMIC_TEXTURE_MAX_RECTS];
+    int dirty_count;
+    size_t bytes_uploaded;       /* Since init, every level */
+    int calls;                   /* glTexSubImage2D calls since init */
+} dynamic_texture_t;
+
+/*
+ * dynamic_texture_init - Create the texture, all zero
+ *
+ * @width, @height: Powers of two
+ * @channels: 1 to 4
+ * @opts: Mipmap filter, or NULL for level 0 only (GL_LINEAR minification)
+ *
+ * Call with the GL context current. Returns 0, or -1 for a bad size, a
+ * Kaiser filter, or no memory.
+ */
+int dynamic_texture_init(dynamic_texture_t* dt, int width, int height, int channels,
+                         const mipmap_options_t* opts);
+
+/*
+ * dynamic_texture_mark - Note that level 0 texels in a rectangle changed
+ *
+ * Clipped to the texture. Nothing is sent until dynamic_texture_update.
+ */
+void dynamic_texture_mark(dynamic_texture_t* dt, int x, int y, int width, int height);
+
+/*
+ * dynamic_texture_update - Rebuild the marked parts of the smaller levels
+ * and upload every marked rectangle
+ *
+ * Restores the texture binding. Returns the bytes sent. If the filter runs
+ * out of memory, the levels from the one it failed on down are left stale.
+ */
+size_t dynamic_texture_update(dynamic_texture_t* dt);
+
+void dynamic_texture_free(dynamic_texture_t* dt);
+
+#endif /* DYNAMIC_TEXTURE_H */
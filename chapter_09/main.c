@@ -1,14 +1,25 @@
 /*
  * Chapter 9: Textures
  * 
- * Demonstrates texture loading and mapping with procedurally generated textures.
+ * Demonstrates texture loading and mapping, from an image file (TGA, PPM or
+ * BMP) given on the command line or a generated pattern: a checkerboard,
+ * noise or a gradient.
  */
 
 #include <GL/glut.h>
 #include <GL/glu.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "dynamic_texture.h"
+#include "frame_pacer.h"
+#include "mipmap.h"
+#include "procedural.h"
+#include "tex_bench.h"
+#include "texture_loader.h"
+#include "texture_streamer.h"
+#include "timing.h"
 
 #define TEX_SIZE 256
 
@@ -16,67 +27,230 @@ static GLuint texture_id;
 static int filter_mode = 0;
 static int wrap_mode = 0;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static float tex_scroll = 0.0f;
+static const char* image_path = NULL;   /* Texture file, or NULL for a pattern */
 
-/* Generate checkerboard texture */
-void generate_checkerboard(unsigned char* data, int size) {
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            int c = (((i & 16) == 0) ^ ((j & 16) == 0)) * 255;
-            int idx = (i * size + j) * 3;
-            data[idx + 0] = c;
-            data[idx + 1] = c;
-            data[idx + 2] = c;
-        }
+/* An image file is loaded in the background; the placeholder is drawn until then */
+static texture_streamer_t* streamer = NULL;
+static int image_handle = -1;
+static int pending_handle = -1;         /* Being loaded to replace image_handle */
+static double load_start, start_time;
+static int first_frame = 1;
+
+/* The pattern's level 0, kept so its mipmaps can be rebuilt with other filters */
+static unsigned char* tex_pixels = NULL;
+static int tex_width, tex_height, tex_channels;
+static size_t tex_stride;
+static mipmap_options_t mip_opts;
+
+/* V: live data plotted a column per frame into a dynamic texture */
+#define PLOT_WIDTH 256
+#define PLOT_HEIGHT 128
+static dynamic_texture_t plot;
+static int show_plot = 0;
+static int plot_column = 0;
+static float plot_walk = 0.0f;
+
+/* P: the built-in texture's patterns, all tiling, generated at start-up */
+static const char* pattern_names[] = {"checkerboard", "value noise fBm", "Perlin noise fBm",
+                                      "simplex noise fBm", "gradient"};
+static int pattern = 0;
+
+void pattern_options(int which, procedural_options_t* opts) {
+    static const unsigned char colors[][2][4] = {
+        {{0, 0, 0, 255}, {255, 255, 255, 255}},
+        {{20, 30, 90, 255}, {230, 235, 255, 255}},
+        {{60, 120, 220, 255}, {255, 255, 255, 255}},
+        {{70, 45, 20, 255}, {225, 200, 140, 255}},
+        {{200, 30, 30, 255}, {255, 220, 60, 255}},
+    };
+
+    procedural_options_defaults(opts);
+    opts->kind = which == 0 ? PROCEDURAL_CHECKER : which == 1 ? PROCEDURAL_VALUE :
+                 which == 2 ? PROCEDURAL_PERLIN : which == 3 ? PROCEDURAL_SIMPLEX :
+                 PROCEDURAL_GRADIENT;
+    opts->period_x = opts->period_y = which == 0 ? TEX_SIZE / 16 : which == 4 ? 1 : 4;
+    opts->octaves = 5;
+    memcpy(opts->colors, colors[which], sizeof(opts->colors));
+}
+
+/* The current pattern into tex_pixels */
+void generate_pattern(void) {
+    procedural_options_t opts;
+    double start = timing_seconds();
+
+    pattern_options(pattern, &opts);
+    procedural_generate(NULL, &opts, tex_pixels, tex_width, tex_height, tex_stride, tex_channels);
+    printf("Pattern: %s, generated in %.2f ms\n", pattern_names[pattern],
+           (timing_seconds() - start) * 1000.0);
+}
+
+/* (Re)build the mipmap chain with the current filter and upload it */
+void build_mipmaps(void) {
+    mipmap_chain_t chain;
+    double start = timing_seconds();
+
+    if (mipmap_build(&chain, tex_pixels, tex_width, tex_height, tex_stride,
+                     tex_channels, &mip_opts) != 0) {
+        fprintf(stderr, "Out of memory building mipmaps\n");
+        return;
     }
+    double built = timing_seconds();
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    mipmap_upload(&chain);
+    printf("Mipmaps: %d levels from %dx%d, %s filter%s, built in %.1f ms, uploaded in %.1f ms\n",
+           chain.levels, chain.width[0], chain.height[0],
+           mip_opts.filter == MIPMAP_KAISER ? "Kaiser" : "box",
+           mip_opts.gamma_correct ? ", gamma-correct" : "",
+           (built - start) * 1000.0, (timing_seconds() - built) * 1000.0);
+    mipmap_free(&chain);
+}
+
+/* $XDG_CACHE_HOME/opengl-1-tutorial, else ~/.cache/..., else in /tmp */
+void default_cache_dir(char* buf, size_t size) {
+    const char* base = getenv("XDG_CACHE_HOME");
+
+    if (base && base[0]) snprintf(buf, size, "%s/opengl-1-tutorial", base);
+    else if ((base = getenv("HOME")) != NULL) snprintf(buf, size, "%s/.cache/opengl-1-tutorial", base);
+    else snprintf(buf, size, "/tmp/opengl-1-tutorial");
 }
 
 void load_texture(void) {
-    unsigned char* tex_data = malloc(TEX_SIZE * TEX_SIZE * 3);
-    generate_checkerboard(tex_data, TEX_SIZE);
+    tex_width = tex_height = TEX_SIZE;
+    tex_channels = 3;
+    tex_stride = TEX_SIZE * 3;
+    tex_pixels = malloc(TEX_SIZE * TEX_SIZE * 3);
+    generate_pattern();
     
     glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    mipmap_options_defaults(&mip_opts);
+    mipmap_options_from_gl(&mip_opts);
+    build_mipmaps();
     
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    
-    gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGB, TEX_SIZE, TEX_SIZE,
-                      GL_RGB, GL_UNSIGNED_BYTE, tex_data);
-    
-    free(tex_data);
+    if (image_path) {
+        streamer = texture_streamer_create(0);
+        if (streamer) {
+            char dir[1024];
+            default_cache_dir(dir, sizeof(dir));
+            texture_streamer_set_cache(streamer, dir);
+            load_start = timing_seconds();
+            pending_handle = texture_streamer_load(streamer, image_path, &mip_opts);
+        }
+    }
     
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 }
 
-void update_texture_params(void) {
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    
-    /* Filtering */
-    switch (filter_mode) {
-        case 0:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            printf("Filter: NEAREST\n");
-            break;
-        case 1:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            printf("Filter: LINEAR\n");
-            break;
-        case 2:
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            printf("Filter: LINEAR_MIPMAP_LINEAR\n");
-            break;
+/* The streamed image (or its placeholder) if there is one, else the pattern */
+GLuint current_texture(void) {
+    return streamer ? texture_streamer_texture(streamer, image_handle) : texture_id;
+}
+
+/* G and K: the pattern is rebuilt here; a file is reloaded in the background */
+void rebuild_mipmaps(void) {
+    if (!streamer) {
+        build_mipmaps();
+        return;
     }
-    
-    /* Wrapping */
+    if (pending_handle >= 0) texture_streamer_release(streamer, pending_handle);
+    load_start = timing_seconds();
+    pending_handle = texture_streamer_load(streamer, image_path, &mip_opts);
+}
+
+/* Parameters belong to each texture object, so a newly streamed one needs them too */
+void apply_texture_params(GLuint texture) {
+    static const GLenum min_filters[] = {GL_NEAREST, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR};
+    static const GLenum mag_filters[] = {GL_NEAREST, GL_LINEAR, GL_LINEAR};
     GLenum wrap = (wrap_mode == 0) ? GL_REPEAT : GL_CLAMP;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filters[filter_mode]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filters[filter_mode]);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+}
+
+void update_texture_params(void) {
+    static const char* filter_names[] = {"NEAREST", "LINEAR", "LINEAR_MIPMAP_LINEAR"};
+
+    apply_texture_params(current_texture());
+    if (plot.texture) apply_texture_params(plot.texture);
+    printf("Filter: %s\n", filter_names[filter_mode]);
     printf("Wrap: %s\n", (wrap_mode == 0) ? "REPEAT" : "CLAMP");
 }
 
+/* Upload what the workers have finished, and swap in a finished load */
+void stream_textures(void) {
+    if (!streamer) return;
+    texture_streamer_update(streamer, UPLOAD_BUDGET_MS);
+    if (pending_handle < 0) return;
+
+    texture_state_t state = texture_streamer_state(streamer, pending_handle);
+    if (state == TEXTURE_READY) {
+        texture_streamer_release(streamer, image_handle);
+        image_handle = pending_handle;
+        apply_texture_params(current_texture());
+        printf("Loaded %s in the background in %.1f ms\n", image_path,
+               (timing_seconds() - load_start) * 1000.0);
+    } else if (state == TEXTURE_FAILED) {
+        texture_streamer_release(streamer, pending_handle);
+    } else {
+        return;
+    }
+    pending_handle = -1;
+}
+
+/* Plot the next column of three signals, with a bright cursor after it.
+ * Only those two columns are sent, not the whole texture. */
+void update_plot(void) {
+    unsigned char* pixels = plot.chain.level[0];
+    size_t stride = plot.chain.stride[0];
+    int cursor = (plot_column + 1) % PLOT_WIDTH;
+    double t = timing_seconds();
+    float values[3];
+
+    plot_walk += ((float)rand() / RAND_MAX - 0.5f) * 0.1f;
+    plot_walk *= 0.98f;
+    values[0] = (float)sin(t * 2.0);
+    values[1] = (float)(0.6 * sin(t * 5.3) * sin(t * 0.7));
+    values[2] = plot_walk;
+
+    for (int y = 0; y < PLOT_HEIGHT; y++) {
+        unsigned char* p = pixels + y * stride + plot_column * 4;
+        unsigned char* c = pixels + y * stride + cursor * 4;
+        unsigned char grid = y % 32 == 0 ? 70 : 20;
+        p[0] = p[1] = grid; p[2] = grid + 10; p[3] = 255;
+        c[0] = c[1] = c[2] = 200; c[3] = 255;
+    }
+    for (int i = 0; i < 3; i++) {
+        int y = (int)((values[i] * 0.45f + 0.5f) * (PLOT_HEIGHT - 1));
+        y = y < 0 ? 0 : y >= PLOT_HEIGHT ? PLOT_HEIGHT - 1 : y;
+        unsigned char* p = pixels + y * stride + plot_column * 4;
+        p[0] = i == 0 ? 255 : 40;
+        p[1] = i == 1 ? 255 : 40;
+        p[2] = i == 2 ? 255 : 40;
+    }
+    dynamic_texture_mark(&plot, plot_column, 0, 1, PLOT_HEIGHT);
+    dynamic_texture_mark(&plot, cursor, 0, 1, PLOT_HEIGHT);
+    dynamic_texture_update(&plot);
+    plot_column = cursor;
+}
+
+void toggle_plot(void) {
+    if (!plot.texture) {
+        mipmap_options_t opts;
+        mipmap_options_defaults(&opts);
+        if (dynamic_texture_init(&plot, PLOT_WIDTH, PLOT_HEIGHT, 4, &opts) != 0) {
+            fprintf(stderr, "Out of memory for the plot\n");
+            return;
+        }
+        apply_texture_params(plot.texture);
+    }
+    show_plot = !show_plot;
+    printf("Live plot: %s\n", show_plot ? "on" : "off");
+}
+
 void init_gl(void) {
     glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
     glEnable(GL_DEPTH_TEST);
@@ -87,6 +261,8 @@ void init_gl(void) {
 }
 
 void display(void) {
+    stream_textures();
+    
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
     
@@ -95,6 +271,8 @@ void display(void) {
     glRotatef(rotation, 1.0f, 1.0f, 0.0f);
     
     /* Draw textured quad */
+    if (show_plot) update_plot();
+    glBindTexture(GL_TEXTURE_2D, show_plot ? plot.texture : current_texture());
     glColor3f(1.0f, 1.0f, 1.0f);
     glBegin(GL_QUADS);
         glTexCoord2f(0.0f + tex_scroll, 0.0f); glVertex3f(-1.5f, -1.5f, 0.0f);
@@ -104,10 +282,15 @@ void display(void) {
     glEnd();
     
     glutSwapBuffers();
+    if (first_frame) {
+        printf("First frame after %.1f ms\n", (timing_seconds() - start_time) * 1000.0);
+        first_frame = 0;
+    }
 }
 
 void idle(void) {
-    rotation += 0.3f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 18.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -122,10 +305,14 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27: case 'q': case 'Q':
+            texture_streamer_destroy(streamer);
+            if (plot.texture) dynamic_texture_free(&plot);
             glDeleteTextures(1, &texture_id);
+            free(tex_pixels);
             exit(0);
             break;
         case '1': case '2': case '3':
@@ -136,6 +323,23 @@ void keyboard(unsigned char key, int x, int y) {
             wrap_mode = (wrap_mode + 1) % 2;
             update_texture_params();
             break;
+        case 'g': case 'G':
+            mip_opts.gamma_correct = !mip_opts.gamma_correct;
+            rebuild_mipmaps();
+            break;
+        case 'k': case 'K':
+            mip_opts.filter = mip_opts.filter == MIPMAP_KAISER ? MIPMAP_BOX : MIPMAP_KAISER;
+            rebuild_mipmaps();
+            break;
+        case 'v': case 'V':
+            toggle_plot();
+            break;
+        case 'p': case 'P':
+            if (streamer) break;
+            pattern = (pattern + 1) % (int)(sizeof(pattern_names) / sizeof(pattern_names[0]));
+            generate_pattern();
+            build_mipmaps();
+            break;
         case 't': case 'T':
             tex_scroll += 0.1f;
             printf("Texture scroll: %.2f\n", tex_scroll);
@@ -144,16 +348,48 @@ void keyboard(unsigned char key, int x, int y) {
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench-mipmap") == 0) {
+        return bench_mipmap(argc, argv, argc > 2 ? atoi(argv[2]) : 4096);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-residency") == 0) {
+        return bench_residency(argc, argv, argc > 2 ? atoi(argv[2]) : 16);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-procedural") == 0) {
+        return bench_procedural(argc > 2 ? atoi(argv[2]) : 4096);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-dynamic") == 0) {
+        return bench_dynamic(argc, argv, argc > 2 ? atoi(argv[2]) : 2048);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-cache") == 0) {
+        return bench_cache(argc, argv, argc > 2 ? atoi(argv[2]) : 16, argc > 3 ? atoi(argv[3]) : 2048);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-atlas") == 0) {
+        return bench_atlas(argc, argv, argc > 2 ? atoi(argv[2]) : 1000);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-stream") == 0) {
+        return bench_stream(argc, argv, argc > 2 ? atoi(argv[2]) : 16, argc > 3 ? atoi(argv[3]) : 2048);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-load") == 0) {
+        return bench_load(argc > 2 ? atoi(argv[2]) : 2048);
+    }
+    if (argc > 1) image_path = argv[1];
+
     printf("Chapter 9: Textures\n");
     printf("===================\n");
+    printf("Usage: %s [image.tga|.ppm|.bmp]\n", argv[0]);
     printf("Controls:\n");
     printf("  1: NEAREST filtering\n");
     printf("  2: LINEAR filtering\n");
     printf("  3: LINEAR_MIPMAP_LINEAR filtering\n");
     printf("  W: Toggle wrap mode\n");
+    printf("  G: Toggle gamma-correct mipmaps\n");
+    printf("  K: Toggle Kaiser and box mipmap filters\n");
     printf("  T: Animate texture\n");
+    printf("  V: Toggle a live plot, updated a column at a time\n");
+    printf("  P: Next generated pattern (without an image file)\n");
     printf("  ESC/Q: Quit\n\n");
     
+    start_time = timing_seconds();
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
@@ -162,7 +398,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
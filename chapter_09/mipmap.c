@@ -0,0 +1,492 @@
+/*
+ * mipmap.c - Mipmap chains built on the CPU, uploaded level by level
+ */
+
+#include <GL/glut.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mipmap.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define KAISER_TAPS  3           /* Lobes either side, in destination texels */
+#define KAISER_BETA  4.0f
+
+void mipmap_options_defaults(mipmap_options_t* opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->filter = MIPMAP_BOX;
+}
+
+/* Whole-token search, so one extension name cannot match inside another */
+static int has_extension(const char* list, const char* name) {
+    size_t len = strlen(name);
+
+    for (const char* p = list; p && (p = strstr(p, name)) != NULL; p += len) {
+        if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) return 1;
+    }
+    return 0;
+}
+
+void mipmap_options_from_gl(mipmap_options_t* opts) {
+    const char* version = (const char*)glGetString(GL_VERSION);
+    GLint max_size = 0;
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    opts->max_size = max_size;
+    opts->npot = (version && atoi(version) >= 2) ||
+                 has_extension((const char*)glGetString(GL_EXTENSIONS),
+                               "GL_ARB_texture_non_power_of_two");
+}
+
+/* ------------------------------------------------------------------------
+ * 2x2 box filter, the common case
+ * ------------------------------------------------------------------------ */
+
+/* Halve an image whose sides are even (or 1), rounding to nearest */
+static void halve_box(const unsigned char* src, int src_width, int src_height, size_t src_stride,
+                      unsigned char* dst, int dst_width, int dst_height, size_t dst_stride,
+                      int channels) {
+    for (int y = 0; y < dst_height; y++) {
+        const unsigned char* r0 = src + (size_t)(2 * y) * src_stride;
+        const unsigned char* r1 = src_height > 1 ? r0 + src_stride : r0;
+        unsigned char* out = dst + (size_t)y * dst_stride;
+        int x = 0;
+
+#ifdef MIPMAP_SSE2
+        if (channels == 4 && src_width > 1) {
+            /* Eight source texels from each row make four output texels */
+            __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+            for (; x + 4 <= dst_width; x += 4) {
+                __m128i a0 = _mm_loadu_si128((const __m128i*)(r0 + x * 8));
+                __m128i a1 = _mm_loadu_si128((const __m128i*)(r0 + x * 8 + 16));
+                __m128i b0 = _mm_loadu_si128((const __m128i*)(r1 + x * 8));
+                __m128i b1 = _mm_loadu_si128((const __m128i*)(r1 + x * 8 + 16));
+
+                /* Column sums, two texels per register as 16-bit lanes */
+                __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+                __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+                __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+                __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+                /* Add each texel to its right-hand neighbour */
+                __m128i t01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+                __m128i t23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+                t01 = _mm_srli_epi16(_mm_add_epi16(t01, two), 2);
+                t23 = _mm_srli_epi16(_mm_add_epi16(t23, two), 2);
+                _mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(t01, t23));
+            }
+        }
+#endif
+        for (; x < dst_width; x++) {
+            const unsigned char* a = r0 + (size_t)2 * x * channels;
+            int right = src_width > 1 ? channels : 0;
+            const unsigned char* b = r1 + (size_t)2 * x * channels;
+            for (int k = 0; k < channels; k++) {
+                out[x * channels + k] = (unsigned char)((a[k] + a[k + right] + b[k] +
+                                                         b[k + right] + 2) >> 2);
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * General separable resampling: any sizes, gamma, Kaiser
+ * ------------------------------------------------------------------------ */
+
+typedef struct {
+    int first, count;            /* Source texels contributing */
+    const float* weights;
+} span_t;
+
+static float sinc(float x) {
+    if (fabsf(x) < 1e-5f) return 1.0f;
+    x *= 3.14159265f;
+    return sinf(x) / x;
+}
+
+/* Modified Bessel function of the first kind, order 0 */
+static float bessel_i0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static float filter_weight(const mipmap_options_t* opts, float d, float scale) {
+    if (opts->filter == MIPMAP_KAISER) {
+        float fs = scale > 1.0f ? scale : 1.0f;
+        float t = d / (KAISER_TAPS * fs);
+        if (t <= -1.0f || t >= 1.0f) return 0.0f;
+        return sinc(d / fs) * bessel_i0(KAISER_BETA * sqrtf(1.0f - t * t)) /
+               bessel_i0(KAISER_BETA);
+    }
+    if (scale >= 1.0f) {
+        /* Box: how much of source texel [d - 0.5, d + 0.5] the output covers */
+        float lo = d - 0.5f > -scale / 2 ? d - 0.5f : -scale / 2;
+        float hi = d + 0.5f < scale / 2 ? d + 0.5f : scale / 2;
+        return hi > lo ? hi - lo : 0.0f;
+    }
+    /* Magnifying: bilinear */
+    return fabsf(d) < 1.0f ? 1.0f - fabsf(d) : 0.0f;
+}
+
+/* Weights for each output texel along one axis; free() the result */
+static float* make_spans(int src, int dst, const mipmap_options_t* opts, span_t* spans,
+                         int* max_count) {
+    float scale = (float)src / dst;
+    float radius = opts->filter == MIPMAP_KAISER ? KAISER_TAPS * (scale > 1.0f ? scale : 1.0f)
+                                                 : (scale > 1.0f ? scale / 2 : 1.0f);
+    int taps = (int)ceilf(radius * 2) + 3;
+    float* weights = calloc((size_t)dst * taps, sizeof(float));
+    if (!weights) return NULL;
+
+    *max_count = 1;
+    for (int i = 0; i < dst; i++) {
+        float center = (i + 0.5f) * scale;
+        int lo = (int)floorf(center - radius - 0.5f), hi = (int)ceilf(center + radius + 0.5f);
+        int first = lo < 0 ? 0 : lo, last = hi > src - 1 ? src - 1 : hi;
+        float* w = weights + (size_t)i * taps;
+        float sum = 0.0f;
+
+        if (last - first + 1 > taps) last = first + taps - 1;
+        for (int j = lo; j <= hi; j++) {
+            /* Texels past the edge repeat the edge texel */
+            int k = j < first ? first : j > last ? last : j;
+            float v = filter_weight(opts, j + 0.5f - center, scale);
+            w[k - first] += v;
+            sum += v;
+        }
+        if (sum == 0.0f) {
+            int k = (int)center;
+            first = k < src ? k : src - 1;
+            last = first;
+            w[0] = sum = 1.0f;
+        }
+        for (int k = 0; k <= last - first; k++) w[k] /= sum;
+
+        /* Box spans reach one texel too far each side to be safe; drop the
+         * zero weights so they cost nothing */
+        while (last > first && w[last - first] == 0.0f) last--;
+        while (last > first && w[0] == 0.0f) {
+            memmove(w, w + 1, (last - first) * sizeof(float));
+            first++;
+        }
+
+        spans[i].first = first;
+        spans[i].count = last - first + 1;
+        spans[i].weights = w;
+        if (spans[i].count > *max_count) *max_count = spans[i].count;
+    }
+    return weights;
+}
+
+#define ENCODE_STEPS 4096          /* Linear values per encode lookup */
+
+typedef struct {
+    int channels;
+    int gamma;                   /* Some channels are sRGB */
+    int colour[4];               /* Which channels are sRGB */
+    float decode[4][256];        /* Byte to linear, per channel */
+    float midpoint[255];         /* Linear midpoints between sRGB bytes */
+    unsigned char guess[ENCODE_STEPS + 1];   /* sRGB byte near each linear step */
+} texel_codec_t;
+
+static void codec_init(texel_codec_t* codec, int channels, int gamma_correct) {
+    float srgb[256];
+
+    codec->channels = channels;
+    codec->gamma = gamma_correct;
+    for (int v = 0; v < 256; v++) {
+        float c = v / 255.0f;
+        srgb[v] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int k = 0; k < 4; k++) {
+        /* Luminance-alpha and RGBA keep their last channel linear */
+        int alpha = (channels == 2 || channels == 4) && k == channels - 1;
+        codec->colour[k] = gamma_correct && k < channels && !alpha;
+        for (int v = 0; v < 256; v++) codec->decode[k][v] = codec->colour[k] ? srgb[v] : v / 255.0f;
+    }
+    for (int v = 0; v < 255; v++) codec->midpoint[v] = (srgb[v] + srgb[v + 1]) * 0.5f;
+    for (int i = 0, v = 0; i <= ENCODE_STEPS; i++) {
+        while (v < 255 && codec->midpoint[v] < (float)i / ENCODE_STEPS) v++;
+        codec->guess[i] = (unsigned char)v;
+    }
+}
+
+static void decode_row(const texel_codec_t* codec, const unsigned char* src, int count,
+                       float* out) {
+    int c = codec->channels;
+    int i = 0;
+
+#ifdef MIPMAP_SSE2
+    if (!codec->gamma) {
+        /* Sixteen bytes widened to floats at a time */
+        __m128i zero = _mm_setzero_si128();
+        __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        int n = count * c;
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+            _mm_storeu_ps(out + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+            _mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+        }
+        for (; i < n; i++) out[i] = src[i] * (1.0f / 255.0f);
+        return;
+    }
+#endif
+    for (; i < count; i++) {
+        for (int k = 0; k < c; k++) out[i * c + k] = codec->decode[k][src[i * c + k]];
+    }
+}
+
+static unsigned char encode_linear(float v) {
+    v = v * 255.0f + 0.5f;
+    return (unsigned char)(v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v);
+}
+
+/* The sRGB byte whose linear value is nearest: the lookup lands within a
+ * byte or two, and the midpoints settle it */
+static unsigned char encode_srgb(const texel_codec_t* codec, float v) {
+    v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+    int b = codec->guess[(int)(v * ENCODE_STEPS)];
+    while (b > 0 && codec->midpoint[b - 1] >= v) b--;
+    while (b < 255 && codec->midpoint[b] < v) b++;
+    return (unsigned char)b;
+}
+
+static void encode_row(const texel_codec_t* codec, const float* in, int count,
+                       unsigned char* out) {
+    int c = codec->channels;
+    size_t n = (size_t)count * c, i = 0;
+
+    if (codec->gamma) {
+        for (int x = 0; x < count; x++) {
+            for (int k = 0; k < c; k++) {
+                float v = in[x * c + k];
+                out[x * c + k] = codec->colour[k] ? encode_srgb(codec, v) : encode_linear(v);
+            }
+        }
+        return;
+    }
+#ifdef MIPMAP_SSE2
+    /* Sixteen bytes at a time; the packs saturate to 0..255 */
+    __m128 scale = _mm_set1_ps(255.0f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        __m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 8), scale));
+        __m128i e = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 12), scale));
+        _mm_storeu_si128((__m128i*)(out + i),
+                         _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(d, e)));
+    }
+#endif
+    for (; i < n; i++) out[i] = encode_linear(in[i]);
+}
+
+/* Filter one source row along x */
+static void filter_row(const float* src, const span_t* spans, int dst_width, int channels,
+                       float* out) {
+    for (int x = 0; x < dst_width; x++) {
+        const span_t* s = &spans[x];
+        const float* in = src + (size_t)s->first * channels;
+        float* o = out + (size_t)x * channels;
+
+#ifdef MIPMAP_SSE2
+        if (channels == 4) {
+            __m128 acc = _mm_setzero_ps();
+            for (int j = 0; j < s->count; j++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(s->weights[j]),
+                                                 _mm_loadu_ps(in + j * 4)));
+            }
+            _mm_storeu_ps(o, acc);
+            continue;
+        }
+#endif
+        for (int k = 0; k < channels; k++) o[k] = 0.0f;
+        for (int j = 0; j < s->count; j++) {
+            for (int k = 0; k < channels; k++) o[k] += s->weights[j] * in[j * channels + k];
+        }
+    }
+}
+
+static int resample_general(const unsigned char* src, int src_width, int src_height,
+                            size_t src_stride, unsigned char* dst, int dst_width,
+                            int dst_height, size_t dst_stride, int channels,
+                            const mipmap_options_t* opts) {
+    span_t* xs = malloc(dst_width * sizeof(span_t));
+    span_t* ys = malloc(dst_height * sizeof(span_t));
+    int max_x, max_y;
+    float* x_weights = xs ? make_spans(src_width, dst_width, opts, xs, &max_x) : NULL;
+    float* y_weights = ys ? make_spans(src_height, dst_height, opts, ys, &max_y) : NULL;
+    size_t row_floats = (size_t)dst_width * channels;
+
+    /* Rows filtered along x, kept in a ring as the output moves down */
+    int ring = y_weights ? max_y : 0;
+    float* decoded = malloc((size_t)src_width * channels * sizeof(float));
+    float* rows = malloc((size_t)ring * row_floats * sizeof(float));
+    int* tags = malloc(ring * sizeof(int));
+    float* acc = malloc(row_floats * sizeof(float));
+    texel_codec_t codec;
+    int result = -1;
+
+    if (!x_weights || !y_weights || !decoded || !rows || !tags || !acc) goto done;
+    codec_init(&codec, channels, opts->gamma_correct);
+    for (int i = 0; i < ring; i++) tags[i] = -1;
+
+    for (int y = 0; y < dst_height; y++) {
+        const span_t* s = &ys[y];
+        unsigned char* out = dst + (size_t)y * dst_stride;
+
+        memset(acc, 0, row_floats * sizeof(float));
+        for (int j = 0; j < s->count; j++) {
+            int sy = s->first + j;
+            float* row = rows + (size_t)(sy % ring) * row_floats;
+            if (tags[sy % ring] != sy) {
+                decode_row(&codec, src + (size_t)sy * src_stride, src_width, decoded);
+                filter_row(decoded, xs, dst_width, channels, row);
+                tags[sy % ring] = sy;
+            }
+
+            size_t i = 0;
+            float w = s->weights[j];
+#ifdef MIPMAP_SSE2
+            __m128 wv = _mm_set1_ps(w);
+            for (; i + 4 <= row_floats; i += 4) {
+                _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i),
+                                                  _mm_mul_ps(wv, _mm_loadu_ps(row + i))));
+            }
+#endif
+            for (; i < row_floats; i++) acc[i] += w * row[i];
+        }
+        encode_row(&codec, acc, dst_width, out);
+    }
+    result = 0;
+
+done:
+    free(xs);
+    free(ys);
+    free(x_weights);
+    free(y_weights);
+    free(decoded);
+    free(rows);
+    free(tags);
+    free(acc);
+    return result;
+}
+
+int mipmap_resample(const unsigned char* src, int src_width, int src_height, size_t src_stride,
+                     unsigned char* dst, int dst_width, int dst_height, size_t dst_stride,
+                     int channels, const mipmap_options_t* opts) {
+    int halves_x = src_width == 2 * dst_width || (src_width == 1 && dst_width == 1);
+    int halves_y = src_height == 2 * dst_height || (src_height == 1 && dst_height == 1);
+
+    if (opts->filter == MIPMAP_BOX && !opts->gamma_correct && halves_x && halves_y) {
+        halve_box(src, src_width, src_height, src_stride, dst, dst_width, dst_height,
+                  dst_stride, channels);
+        return 0;
+    }
+    return resample_general(src, src_width, src_height, src_stride, dst, dst_width, dst_height,
+                            dst_stride, channels, opts);
+}
+
+/* ------------------------------------------------------------------------
+ * Chains
+ * ------------------------------------------------------------------------ */
+
+static int nearest_power_of_two(int n) {
+    int p = 1;
+    while (p * 2 <= n) p *= 2;
+    return n - p > 2 * p - n ? 2 * p : p;
+}
+
+int mipmap_build(mipmap_chain_t* chain, const unsigned char* pixels, int width, int height,
+                 size_t stride, int channels, const mipmap_options_t* opts) {
+    int w = opts->npot ? width : nearest_power_of_two(width);
+    int h = opts->npot ? height : nearest_power_of_two(height);
+    size_t total = 0;
+
+    while (opts->max_size > 0 && (w > opts->max_size || h > opts->max_size)) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    memset(chain, 0, sizeof(*chain));
+    chain->channels = channels;
+    for (;;) {
+        int i = chain->levels++;
+        chain->width[i] = w;
+        chain->height[i] = h;
+        chain->stride[i] = ((size_t)w * channels + 3) & ~(size_t)3;
+        total += chain->stride[i] * h;
+        if ((w == 1 && h == 1) || chain->levels == MIPMAP_MAX_LEVELS) break;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    /* Level 0 is the caller's image when it is already the right size and
+     * packed as OpenGL expects, saving a copy of the largest level */
+    int in_place = chain->width[0] == width && chain->height[0] == height &&
+                   stride == chain->stride[0];
+    if (in_place) total -= chain->stride[0] * height;
+
+    chain->pixels = malloc(total > 0 ? total : 1);
+    if (!chain->pixels) return -1;
+    total = 0;
+    for (int i = in_place ? 1 : 0; i < chain->levels; i++) {
+        chain->level[i] = chain->pixels + total;
+        total += chain->stride[i] * chain->height[i];
+    }
+
+    if (in_place) {
+        chain->level[0] = (unsigned char*)pixels;
+    } else if (chain->width[0] == width && chain->height[0] == height) {
+        for (int y = 0; y < height; y++) {
+            memcpy(chain->level[0] + y * chain->stride[0], pixels + y * stride,
+                   (size_t)width * channels);
+        }
+    } else if (mipmap_resample(pixels, width, height, stride, chain->level[0], chain->width[0],
+                               chain->height[0], chain->stride[0], channels, opts) != 0) {
+        mipmap_free(chain);
+        return -1;
+    }
+    for (int i = 1; i < chain->levels; i++) {
+        if (mipmap_resample(chain->level[i - 1], chain->width[i - 1], chain->height[i - 1],
+                            chain->stride[i - 1], chain->level[i], chain->width[i],
+                            chain->height[i], chain->stride[i], channels, opts) != 0) {
+            mipmap_free(chain);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void mipmap_upload(const mipmap_chain_t* chain) {
+    static const GLenum formats[] = {0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA};
+    GLenum format = formats[chain->channels];
+
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    for (int i = 0; i < chain->levels; i++) {
+        glTexImage2D(GL_TEXTURE_2D, i, format, chain->width[i], chain->height[i], 0,
+                     format, GL_UNSIGNED_BYTE, chain->level[i]);
+    }
+    glPopClientAttrib();
+}
+
+void mipmap_free(mipmap_chain_t* chain) {
+    free(chain->pixels);
+    chain->pixels = NULL;
+    chain->levels = 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * mipmap.h - Mipmap chains built on the CPU, uploaded level by level
+ *
+ * A replacement for gluBuild2DMipmaps. Building the chain is plain CPU
+ * work that needs no GL context, so it can run on any thread; uploading
+ * is one glTexImage2D per level.
+ *
+ *   mipmap_chain_t chain;
+ *   mipmap_options_t opts;
+ *   mipmap_options_defaults(&opts);
+ *   if (mipmap_build(&chain, pixels, width, height, stride, channels, &opts) == 0) {
+ *       mipmap_upload(&chain);             (to the bound GL_TEXTURE_2D)
+ *       mipmap_free(&chain);
+ *   }
+ *
+ * Each level halves the one above with a 2x2 box filter, sixteen bytes at
+ * a time with SSE2 for RGBA. Two slower filters are optional:
+ *
+ * - gamma_correct averages in linear light. Texels are stored as sRGB, so
+ *   a plain average of black and white gives 128, which displays darker
+ *   than the true mid-grey (about 188). Alpha is always averaged as is.
+ * - MIPMAP_KAISER uses a Kaiser-windowed sinc over 12 source texels per
+ *   axis instead of 2. Distant levels stay sharper, with a little ringing.
+ *
+ * OpenGL 1.1 needs power-of-two sizes. Other images are resampled to the
+ * nearest power of two first, as GLU does, unless npot is set (for
+ * drivers with GL_ARB_texture_non_power_of_two). Then each level is
+ * max(1, size / 2) of the one above, and odd sizes are area-filtered so
+ * every source texel counts.
+ */
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <stddef.h>
+
+#define MIPMAP_MAX_LEVELS 17     /* Up to 65536 texels a side */
+
+typedef enum {
+    MIPMAP_BOX,
+    MIPMAP_KAISER
+} mipmap_filter_t;
+
+typedef struct {
+    mipmap_filter_t filter;
+    int gamma_correct;           /* Filter in linear light, treating texels as sRGB */
+    int npot;                    /* Keep non-power-of-two sizes */
+    int max_size;                /* Largest level 0 side, 0 for no limit */
+} mipmap_options_t;
+
+typedef struct {
+    int levels;
+    int channels;                /* 1 to 4: luminance, luminance-alpha, RGB, RGBA */
+    int width[MIPMAP_MAX_LEVELS], height[MIPMAP_MAX_LEVELS];
+    size_t stride[MIPMAP_MAX_LEVELS];   /* Row bytes, padded to 4 */
+    unsigned char* level[MIPMAP_MAX_LEVELS];
+    unsigned char* pixels;       /* One block holding the levels built */
+} mipmap_chain_t;
+
+/*
+ * mipmap_options_defaults - Box filter, no gamma, power-of-two, no limit
+ */
+void mipmap_options_defaults(mipmap_options_t* opts);
+
+/*
+ * mipmap_options_from_gl - Take npot and max_size from the current context
+ */
+void mipmap_options_from_gl(mipmap_options_t* opts);
+
+/*
+ * mipmap_build - Build every level from 'pixels' down to 1x1
+ *
+ * @stride: Bytes between rows of 'pixels'
+ *
+ * If 'pixels' needs no resizing and its rows are padded to 4 bytes, level
+ * 0 points into it rather than copying it: keep it until the chain has
+ * been uploaded. Needs no GL context. Returns 0, or -1 if memory ran out (nothing is
+ * left allocated).
+ */
+int mipmap_build(mipmap_chain_t* chain, const unsigned char* pixels, int width, int height,
+                 size_t stride, int channels, const mipmap_options_t* opts);
+
+/*
+ * mipmap_upload - glTexImage2D every level into the bound GL_TEXTURE_2D
+ */
+void mipmap_upload(const mipmap_chain_t* chain);
+
+void mipmap_free(mipmap_chain_t* chain);
+
+/*
+ * mipmap_resample - Resize one image with the options' filter
+ *
+ * Used for each level, and for the power-of-two resize. Both sizes may be
+ * anything; strides are in bytes. Returns 0, or -1 if the filter's scratch
+ * memory ran out, in which case 'dst' is left untouched.
+ */
+int mipmap_resample(const unsigned char* src, int src_width, int src_height, size_t src_stride,
+                    unsigned char* dst, int dst_width, int dst_height, size_t dst_stride,
+                    int channels, const mipmap_options_t* opts);
+
+#endif /* MIPMAP_H */
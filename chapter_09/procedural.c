@@ -0,0 +1,460 @@
+/*
+ * procedural.c - Textures generated from a seed: noise, fBm, checkers, ramps
+ */
+
+#include <string.h>
+#include "procedural.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROCEDURAL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define MAX_OCTAVES   16
+#define MAX_PERIOD    (1 << 24)  /* Cells across the finest octave */
+#define CHUNK         512        /* Texels of a row summed at a time, on the stack */
+#define ROWS_PER_BATCH 8         /* Smallest run of rows handed to a thread */
+#define PERLIN_SCALE  1.4142136f /* Unit gradients reach 1/sqrt(2) at most */
+#define SIMPLEX_SCALE 10.9f      /* Brings the simplex kernel sums to about [-1, 1] */
+
+void procedural_options_defaults(procedural_options_t* opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->kind = PROCEDURAL_PERLIN;
+    opts->seed = 1;
+    opts->period_x = opts->period_y = 8;
+    opts->octaves = 1;
+    opts->gain = 0.5f;
+    opts->colors[0][3] = 255;
+    memset(opts->colors[1], 255, 4);
+}
+
+/* ------------------------------------------------------------------------
+ * The lattice
+ * ------------------------------------------------------------------------ */
+
+/* One octave of noise: its own seed and a lattice twice as fine as the last */
+typedef struct {
+    unsigned int seed;
+    int period_x, period_y;
+    float scale_x, scale_y;      /* Cells per texel */
+    float amplitude;             /* The octave's weight times the noise's own scale */
+} octave_t;
+
+/* Sixteen unit vectors, 22.5 degrees apart */
+static const float gradients[16][2] = {
+    { 1.0000000f,  0.0000000f}, { 0.9238795f,  0.3826834f}, { 0.7071068f,  0.7071068f},
+    { 0.3826834f,  0.9238795f}, { 0.0000000f,  1.0000000f}, {-0.3826834f,  0.9238795f},
+    {-0.7071068f,  0.7071068f}, {-0.9238795f,  0.3826834f}, {-1.0000000f,  0.0000000f},
+    {-0.9238795f, -0.3826834f}, {-0.7071068f, -0.7071068f}, {-0.3826834f, -0.9238795f},
+    { 0.0000000f, -1.0000000f}, { 0.3826834f, -0.9238795f}, { 0.7071068f, -0.7071068f},
+    { 0.9238795f, -0.3826834f}
+};
+
+static unsigned int hash(unsigned int seed, int x, int y) {
+    unsigned int h = seed;
+    h ^= (unsigned int)x * 0x8da6b343u;
+    h ^= (unsigned int)y * 0xd8163841u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Lattice coordinates are wrapped before hashing: this is what makes the tiling */
+static int wrap(int i, int period) {
+    if ((unsigned int)i < (unsigned int)period) return i;
+    i %= period;
+    return i < 0 ? i + period : i;
+}
+
+static float lattice_value(unsigned int seed, int x, int y) {
+    return (hash(seed, x, y) >> 8) * (1.0f / 16777216.0f);
+}
+
+static const float* lattice_gradient(unsigned int seed, int x, int y) {
+    return gradients[hash(seed, x, y) >> 28];
+}
+
+static float fade(float t) {
+    return t * t * (3.0f - 2.0f * t);
+}
+
+#ifdef PROCEDURAL_SSE2
+/* Lattice coordinates of texels x to x + 3 along a row */
+static __m128 lattice4(int x, float scale) {
+    return _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)),
+                      _mm_set1_ps(scale));
+}
+
+static __m128 fade4(__m128 t) {
+    return _mm_mul_ps(_mm_mul_ps(t, t),
+                      _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t)));
+}
+
+static void accumulate4(float* sums, __m128 n, float amplitude) {
+    _mm_storeu_ps(sums, _mm_add_ps(_mm_loadu_ps(sums), _mm_mul_ps(n, _mm_set1_ps(amplitude))));
+}
+#endif
+
+/*
+ * First texel after x, at most end, whose lattice coordinate
+ * x * scale + offset has left cell c. Found from the same float
+ * expression the texels use, so no texel lands in the wrong cell.
+ */
+static int cell_end(int x, int end, int c, float scale, float offset) {
+    float guess = ((float)(c + 1) - offset) / scale;
+    int e = guess <= (float)(x + 1) ? x + 1 : guess >= (float)end ? end : (int)guess;
+
+    while (e > x + 1 && (int)((float)(e - 1) * scale + offset) > c) e--;
+    while (e < end && (int)((float)e * scale + offset) <= c) e++;
+    return e;
+}
+
+/* ------------------------------------------------------------------------
+ * Noise, one octave of 'count' texels of a row at a time
+ *
+ * Each function walks the row a cell at a time: the cell's corners are
+ * hashed once, then its texels go four at a time through SSE2 and the
+ * last few one by one. Both paths do the same arithmetic in the same
+ * order, so the output is identical with or without SSE2.
+ * ------------------------------------------------------------------------ */
+
+static void value_row(const octave_t* o, int x0, int y, int count, float* sums) {
+    float v = (float)y * o->scale_y;
+    int cy = (int)v, end = x0 + count;
+    float fy = fade(v - (float)cy);
+    int y0 = wrap(cy, o->period_y), y1 = wrap(cy + 1, o->period_y);
+
+    for (int x = x0; x < end;) {
+        int cx = (int)((float)x * o->scale_x);
+        int stop = cell_end(x, end, cx, o->scale_x, 0.0f);
+        int xa = wrap(cx, o->period_x), xb = wrap(cx + 1, o->period_x);
+        float a = lattice_value(o->seed, xa, y0), b = lattice_value(o->seed, xb, y0);
+        float c = lattice_value(o->seed, xa, y1), d = lattice_value(o->seed, xb, y1);
+        /* Down the cell first: that part is the same all along the row */
+        float left = a + (c - a) * fy, right = b + (d - b) * fy;
+
+#ifdef PROCEDURAL_SSE2
+        __m128 l = _mm_set1_ps(left), span = _mm_set1_ps(right - left);
+        __m128 cell = _mm_set1_ps((float)cx);
+        for (; x + 4 <= stop; x += 4) {
+            __m128 fx = fade4(_mm_sub_ps(lattice4(x, o->scale_x), cell));
+            accumulate4(sums + (x - x0), _mm_add_ps(l, _mm_mul_ps(span, fx)), o->amplitude);
+        }
+#endif
+        for (; x < stop; x++) {
+            float fx = fade((float)x * o->scale_x - (float)cx);
+            sums[x - x0] += (left + (right - left) * fx) * o->amplitude;
+        }
+    }
+}
+
+static void perlin_row(const octave_t* o, int x0, int y, int count, float* sums) {
+    float v = (float)y * o->scale_y;
+    int cy = (int)v, end = x0 + count;
+    float fy = v - (float)cy, fade_y = fade(fy);
+    int y0 = wrap(cy, o->period_y), y1 = wrap(cy + 1, o->period_y);
+
+    for (int x = x0; x < end;) {
+        int cx = (int)((float)x * o->scale_x);
+        int stop = cell_end(x, end, cx, o->scale_x, 0.0f);
+        int xa = wrap(cx, o->period_x), xb = wrap(cx + 1, o->period_x);
+        const float* g[4] = {lattice_gradient(o->seed, xa, y0), lattice_gradient(o->seed, xb, y0),
+                             lattice_gradient(o->seed, xa, y1), lattice_gradient(o->seed, xb, y1)};
+        float gx[4], k[4];       /* Corners' x gradients, and the y half of each dot */
+
+        for (int i = 0; i < 4; i++) {
+            gx[i] = g[i][0];
+            k[i] = g[i][1] * (i < 2 ? fy : fy - 1.0f);
+        }
+#ifdef PROCEDURAL_SSE2
+        __m128 cell = _mm_set1_ps((float)cx), one = _mm_set1_ps(1.0f), vy = _mm_set1_ps(fade_y);
+        __m128 g0 = _mm_set1_ps(gx[0]), g1 = _mm_set1_ps(gx[1]);
+        __m128 g2 = _mm_set1_ps(gx[2]), g3 = _mm_set1_ps(gx[3]);
+        __m128 k0 = _mm_set1_ps(k[0]), k1 = _mm_set1_ps(k[1]);
+        __m128 k2 = _mm_set1_ps(k[2]), k3 = _mm_set1_ps(k[3]);
+        for (; x + 4 <= stop; x += 4) {
+            __m128 fx = _mm_sub_ps(lattice4(x, o->scale_x), cell);
+            __m128 fx1 = _mm_sub_ps(fx, one), u = fade4(fx);
+            __m128 d00 = _mm_add_ps(_mm_mul_ps(g0, fx), k0);
+            __m128 d10 = _mm_add_ps(_mm_mul_ps(g1, fx1), k1);
+            __m128 d01 = _mm_add_ps(_mm_mul_ps(g2, fx), k2);
+            __m128 d11 = _mm_add_ps(_mm_mul_ps(g3, fx1), k3);
+            __m128 top = _mm_add_ps(d00, _mm_mul_ps(_mm_sub_ps(d10, d00), u));
+            __m128 bottom = _mm_add_ps(d01, _mm_mul_ps(_mm_sub_ps(d11, d01), u));
+            accumulate4(sums + (x - x0), _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), vy)),
+                        o->amplitude);
+        }
+#endif
+        for (; x < stop; x++) {
+            float fx = (float)x * o->scale_x - (float)cx;
+            float fx1 = fx - 1.0f, u = fade(fx);
+            float d00 = gx[0] * fx + k[0], d10 = gx[1] * fx1 + k[1];
+            float d01 = gx[2] * fx + k[2], d11 = gx[3] * fx1 + k[3];
+            float top = d00 + (d10 - d00) * u;
+            float bottom = d01 + (d11 - d01) * u;
+            sums[x - x0] += (top + (bottom - top) * fade_y) * o->amplitude;
+        }
+    }
+}
+
+#ifdef PROCEDURAL_SSE2
+/* a where mask is set, else b */
+static __m128 select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/* One corner's share: (0.8 - |d|^2)^4 times the gradient's dot with d */
+static __m128 kernel4(__m128 dx, __m128 dyy, __m128 gx, __m128 k) {
+    __m128 w = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.8f), _mm_mul_ps(dx, dx)), dyy),
+                          _mm_setzero_ps());
+    w = _mm_mul_ps(w, w);
+    return _mm_mul_ps(_mm_mul_ps(w, w), _mm_add_ps(_mm_mul_ps(gx, dx), k));
+}
+#endif
+
+static float kernel(float dx, float dyy, float gx, float k) {
+    float w = 0.8f - dx * dx - dyy;
+    w = w > 0.0f ? w * w : 0.0f;
+    return w * w * (gx * dx + k);
+}
+
+/*
+ * Simplex noise on a sheared grid (Gustavson and McEwan's tiling variant):
+ * u = x + y / 2 splits each row of square cells into triangles with
+ * corners at half-integer x on odd rows. Corner positions are wrapped as
+ * (2x, y), which tiles for any period_x and an even period_y. Within a
+ * cell, the texels right of the diagonal take the lower-right corner as
+ * their second, the rest the upper-left; SSE2 picks per texel with a mask.
+ */
+static void simplex_row(const octave_t* o, int x0, int y, int count, float* sums) {
+    float py = (float)y * o->scale_y, half = 0.5f * py;
+    int iv = (int)py, end = x0 + count;
+    float fy = py - (float)iv, fy1 = fy - 1.0f;
+    int y0 = wrap(iv, o->period_y), y1 = wrap(iv + 1, o->period_y), period2 = 2 * o->period_x;
+    /* Corners: the base, its right and upper-left neighbours, and the upper-right */
+    float yy[4] = {fy * fy, fy * fy, fy1 * fy1, fy1 * fy1};
+
+    for (int x = x0; x < end;) {
+        int iu = (int)((float)x * o->scale_x + half);
+        int stop = cell_end(x, end, iu, o->scale_x, half);
+        int xx = 2 * iu - iv;
+        const float* g[4] = {lattice_gradient(o->seed, wrap(xx, period2), y0),
+                             lattice_gradient(o->seed, wrap(xx + 2, period2), y0),
+                             lattice_gradient(o->seed, wrap(xx - 1, period2), y1),
+                             lattice_gradient(o->seed, wrap(xx + 1, period2), y1)};
+        float gx[4], k[4];
+
+        for (int i = 0; i < 4; i++) {
+            gx[i] = g[i][0];
+            k[i] = g[i][1] * (i < 2 ? fy : fy1);
+        }
+#ifdef PROCEDURAL_SSE2
+        __m128 vhalf = _mm_set1_ps(half), cell = _mm_set1_ps((float)iu), vy = _mm_set1_ps(fy);
+        __m128 shift = _mm_set1_ps(0.5f * fy), one = _mm_set1_ps(1.0f), point5 = _mm_set1_ps(0.5f);
+        __m128 g0 = _mm_set1_ps(gx[0]), g1 = _mm_set1_ps(gx[1]), g2 = _mm_set1_ps(gx[2]);
+        __m128 g3 = _mm_set1_ps(gx[3]), k0 = _mm_set1_ps(k[0]), k1 = _mm_set1_ps(k[1]);
+        __m128 k2 = _mm_set1_ps(k[2]), k3 = _mm_set1_ps(k[3]);
+        __m128 yy0 = _mm_set1_ps(yy[0]), yy2 = _mm_set1_ps(yy[2]);
+        for (; x + 4 <= stop; x += 4) {
+            __m128 f = _mm_sub_ps(_mm_add_ps(lattice4(x, o->scale_x), vhalf), cell);
+            __m128 right = _mm_cmpge_ps(f, vy);
+            __m128 d0 = _mm_sub_ps(f, shift);
+            __m128 d1 = select4(right, _mm_sub_ps(d0, one), _mm_add_ps(d0, point5));
+            __m128 n = _mm_add_ps(kernel4(d0, yy0, g0, k0),
+                                  kernel4(d1, select4(right, yy0, yy2), select4(right, g1, g2),
+                                          select4(right, k1, k2)));
+            n = _mm_add_ps(n, kernel4(_mm_sub_ps(d0, point5), yy2, g3, k3));
+            accumulate4(sums + (x - x0), n, o->amplitude);
+        }
+#endif
+        for (; x < stop; x++) {
+            float f = (float)x * o->scale_x + half - (float)iu;
+            int c = f >= fy ? 1 : 2;
+            float d0 = f - 0.5f * fy;
+            float d1 = c == 1 ? d0 - 1.0f : d0 + 0.5f;
+            float n = kernel(d0, yy[0], gx[0], k[0]) + kernel(d1, yy[c], gx[c], k[c]);
+            n += kernel(d0 - 0.5f, yy[3], gx[3], k[3]);
+            sums[x - x0] += n * o->amplitude;
+        }
+    }
+}
+
+/* Triangle waves: 0 at the texture's edges, 1 halfway through each period */
+static void gradient_row(const octave_t* o, int x0, int y, int count, float* sums) {
+    float offset = (float)y * o->scale_y;
+    int x = x0, end = x0 + count;
+
+#ifdef PROCEDURAL_SSE2
+    __m128 one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+    for (; x + 4 <= end; x += 4) {
+        __m128 s = _mm_add_ps(lattice4(x, o->scale_x), _mm_set1_ps(offset));
+        __m128 f = _mm_sub_ps(s, _mm_cvtepi32_ps(_mm_cvttps_epi32(s)));
+        __m128 t = _mm_sub_ps(one, _mm_andnot_ps(sign, _mm_sub_ps(_mm_add_ps(f, f), one)));
+        _mm_storeu_ps(sums + (x - x0), t);
+    }
+#endif
+    for (; x < end; x++) {
+        float s = (float)x * o->scale_x + offset;
+        float f = s - (float)(int)s;
+        float t = f + f - 1.0f;
+        sums[x - x0] = 1.0f - (t < 0.0f ? -t : t);
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Rows to texels
+ * ------------------------------------------------------------------------ */
+
+typedef void (*row_fn)(const octave_t* o, int x0, int y, int count, float* sums);
+
+typedef struct {
+    const procedural_options_t* opts;
+    row_fn row;
+    octave_t octave[MAX_OCTAVES];
+    int octaves;
+    float mul, add;              /* Sums to 0..1 */
+    unsigned char palette[256][4];
+    unsigned char* pixels;
+    int width, height, channels;
+    size_t stride;
+} job_t;
+
+/* Through the palette: 0..1 to the nearest of 256 colours */
+static void write_texels(const job_t* job, const float* sums, int count, unsigned char* out) {
+    int index[CHUNK];
+    int i = 0;
+
+#ifdef PROCEDURAL_SSE2
+    __m128 mul = _mm_set1_ps(job->mul * 255.0f), add = _mm_set1_ps(job->add * 255.0f + 0.5f);
+    __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 t = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(sums + i), mul), add);
+        _mm_storeu_si128((__m128i*)(index + i), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(t, lo), hi)));
+    }
+#endif
+    for (; i < count; i++) {
+        float t = sums[i] * (job->mul * 255.0f) + (job->add * 255.0f + 0.5f);
+        index[i] = t < 0.0f ? 0 : t > 255.0f ? 255 : (int)t;
+    }
+
+    /* A fixed size per case, so each copy is a move rather than a call */
+    switch (job->channels) {
+        case 1: for (i = 0; i < count; i++) out[i] = job->palette[index[i]][0]; break;
+        case 2: for (i = 0; i < count; i++) memcpy(out + i * 2, job->palette[index[i]], 2); break;
+        case 3: for (i = 0; i < count; i++) memcpy(out + i * 3, job->palette[index[i]], 3); break;
+        default: for (i = 0; i < count; i++) memcpy(out + i * 4, job->palette[index[i]], 4); break;
+    }
+}
+
+/* Runs of one colour, copied from the run's first texel */
+static void checker_row(const job_t* job, int y, unsigned char* out) {
+    const procedural_options_t* opts = job->opts;
+    int c = job->channels, width = job->width;
+    long long cy = (long long)y * opts->period_y / job->height;
+
+    for (int cx = 0; cx < opts->period_x; cx++) {
+        int begin = (int)(((long long)cx * width + opts->period_x - 1) / opts->period_x);
+        int end = (int)(((long long)(cx + 1) * width + opts->period_x - 1) / opts->period_x);
+        if (begin >= end) continue;
+        unsigned char* run = out + (size_t)begin * c;
+        size_t done = (size_t)c, size = (size_t)(end - begin) * c;
+        memcpy(run, job->palette[(cx + cy) & 1 ? 255 : 0], (size_t)c);
+        while (done < size) {
+            size_t n = done < size - done ? done : size - done;
+            memcpy(run + done, run, n);
+            done += n;
+        }
+    }
+}
+
+static void generate_rows(void* ctx, int begin, int end) {
+    const job_t* job = ctx;
+    float sums[CHUNK];
+
+    for (int y = begin; y < end; y++) {
+        unsigned char* out = job->pixels + (size_t)y * job->stride;
+
+        if (job->opts->kind == PROCEDURAL_CHECKER) {
+            const procedural_options_t* opts = job->opts;
+            /* A row in the same band of squares as the last is the same row */
+            if (y > begin && (long long)y * opts->period_y / job->height ==
+                             (long long)(y - 1) * opts->period_y / job->height) {
+                memcpy(out, out - job->stride, (size_t)job->width * job->channels);
+            } else {
+                checker_row(job, y, out);
+            }
+            continue;
+        }
+
+        for (int x = 0; x < job->width; x += CHUNK) {
+            int count = job->width - x < CHUNK ? job->width - x : CHUNK;
+            memset(sums, 0, (size_t)count * sizeof(float));
+            for (int i = 0; i < job->octaves; i++) job->row(&job->octave[i], x, y, count, sums);
+            write_texels(job, sums, count, out + (size_t)x * job->channels);
+        }
+    }
+}
+
+int procedural_generate(thread_pool_t* pool, const procedural_options_t* opts,
+                        unsigned char* pixels, int width, int height, size_t stride,
+                        int channels) {
+    job_t job;
+    int octaves = opts->kind >= PROCEDURAL_VALUE ? opts->octaves : 1;
+    int min_period = opts->kind == PROCEDURAL_GRADIENT ? 0 : 1;
+    float weight = 1.0f, total = 0.0f;
+
+    if (width < 1 || height < 1 || channels < 1 || channels > 4 ||
+        stride < (size_t)width * channels || octaves < 1 || octaves > MAX_OCTAVES ||
+        opts->period_x < min_period || opts->period_y < min_period ||
+        opts->period_x > (MAX_PERIOD >> (octaves - 1)) ||
+        opts->period_y > (MAX_PERIOD >> (octaves - 1)) ||
+        (opts->kind == PROCEDURAL_SIMPLEX && (opts->period_y & 1))) {
+        return -1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.opts = opts;
+    job.octaves = octaves;
+    job.pixels = pixels;
+    job.width = width;
+    job.height = height;
+    job.channels = channels;
+    job.stride = stride;
+    for (int i = 0; i < 256; i++) {
+        for (int k = 0; k < 4; k++) {
+            job.palette[i][k] = (unsigned char)((opts->colors[0][k] * (255 - i) +
+                                                 opts->colors[1][k] * i + 127) / 255);
+        }
+    }
+
+    switch (opts->kind) {
+        case PROCEDURAL_GRADIENT: job.row = gradient_row; break;
+        case PROCEDURAL_VALUE: job.row = value_row; break;
+        case PROCEDURAL_PERLIN: job.row = perlin_row; break;
+        case PROCEDURAL_SIMPLEX: job.row = simplex_row; break;
+        default: break;
+    }
+    float scale = opts->kind == PROCEDURAL_PERLIN ? PERLIN_SCALE :
+                  opts->kind == PROCEDURAL_SIMPLEX ? SIMPLEX_SCALE : 1.0f;
+    for (int i = 0; i < octaves; i++) {
+        octave_t* o = &job.octave[i];
+        o->seed = opts->seed + (unsigned int)i * 0x9e3779b9u;
+        o->period_x = opts->period_x << i;
+        o->period_y = opts->period_y << i;
+        o->scale_x = (float)o->period_x / (float)width;
+        o->scale_y = (float)o->period_y / (float)height;
+        o->amplitude = weight * scale;
+        total += weight;
+        weight *= opts->gain;
+    }
+    /* Value noise is 0..1 already; gradient noises are signed */
+    int is_signed = opts->kind == PROCEDURAL_PERLIN || opts->kind == PROCEDURAL_SIMPLEX;
+    job.mul = (is_signed ? 0.5f : 1.0f) / total;
+    job.add = is_signed ? 0.5f : 0.0f;
+
+    thread_pool_parallel_for(pool, height, ROWS_PER_BATCH, generate_rows, &job);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * procedural.h - Textures generated from a seed: noise, fBm, checkers, ramps
+ *
+ * Every generator works on a lattice of cells laid over the texture, with
+ * a whole number of cells each way. Lattice points are hashed from their
+ * coordinates wrapped to that count, so the right edge continues into the
+ * left and the bottom into the top: the textures tile under GL_REPEAT.
+ * The output depends only on the options, not on the thread count:
+ *
+ *   procedural_options_t opts;
+ *   procedural_options_defaults(&opts);      (Perlin noise, 8 cells across)
+ *   opts.octaves = 6;                        (fBm: 6 layers, each finer)
+ *   procedural_generate(pool, &opts, pixels, 4096, 4096, 4096 * 4, 4);
+ *
+ * Rows are shared out across the pool. Within a row, texels are computed
+ * four at a time with SSE2: a cell's corners are hashed once, and every
+ * group of four texels inside it shares them.
+ */
+
+#ifndef PROCEDURAL_H
+#define PROCEDURAL_H
+
+#include <stddef.h>
+#include "thread_pool.h"
+
+typedef enum {
+    PROCEDURAL_CHECKER,          /* Squares of the two colours; tiles if both periods are even */
+    PROCEDURAL_GRADIENT,         /* Ramps there and back, period_x across and period_y down */
+    PROCEDURAL_VALUE,            /* Random values at lattice points, smoothly blended */
+    PROCEDURAL_PERLIN,           /* Random gradients at lattice points: less blocky */
+    PROCEDURAL_SIMPLEX           /* Gradients on a triangle lattice: no grid axes showing */
+} procedural_kind_t;
+
+typedef struct {
+    procedural_kind_t kind;
+    unsigned int seed;
+    int period_x, period_y;      /* Cells across and down; simplex needs period_y even */
+    int octaves;                 /* Noise layers, each with twice the cells; 1 is plain noise */
+    float gain;                  /* Each layer's weight relative to the one before */
+    unsigned char colors[2][4];  /* Colours for 0 and 1, as many channels as the texture */
+} procedural_options_t;
+
+/*
+ * procedural_options_defaults - Single-octave Perlin noise, 8x8 cells,
+ * black to white, seed 1
+ */
+void procedural_options_defaults(procedural_options_t* opts);
+
+/*
+ * procedural_generate - Fill a width x height texture
+ *
+ * @pool:  Threads to share the rows between, or NULL for this thread only
+ * @stride: Bytes from one row to the next
+ * @channels: 1 to 4, taken from the front of each colour
+ *
+ * The gradient takes a period of 0 for a ramp along one axis only; every
+ * other period must be at least 1. Returns 0, or -1 for bad options or
+ * no memory.
+ */
+int procedural_generate(thread_pool_t* pool, const procedural_options_t* opts,
+                        unsigned char* pixels, int width, int height, size_t stride,
+                        int channels);
+
+#endif /* PROCEDURAL_H */
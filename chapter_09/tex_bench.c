@@ -0,0 +1,1231 @@
+/*
+ * tex_bench.c - The chapter's --bench-* modes
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <GL/glut.h>
+#include <GL/glu.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "atlas.h"
+#include "dynamic_texture.h"
+#include "mipmap.h"
+#include "offscreen.h"
+#include "procedural.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "texture_manager.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "timing.h"
+#include "tex_bench.h"
+
+/* ------------------------------------------------------------------------
+ * Loader benchmark: writes test images in every supported layout, checks
+ * they decode to what was written, and times decoding
+ * ------------------------------------------------------------------------ */
+
+/* Blocks of flat colour (good for RLE) with every fourth block noisy */
+static void make_test_image(unsigned char* rgba, int width, int height) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char* p = rgba + ((size_t)y * width + x) * 4;
+            unsigned int block = (x / 16) * 7 + (y / 16) * 13;
+            unsigned int hash = (x * 73856093u) ^ (y * 19349663u);
+            hash = block % 4 == 0 ? hash * 2654435761u : block * 2654435761u;
+            p[0] = (unsigned char)(hash >> 24);
+            p[1] = (unsigned char)(hash >> 16);
+            p[2] = (unsigned char)(hash >> 8);
+            p[3] = (unsigned char)(hash >> 4);
+        }
+    }
+}
+
+static void put16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char* p, unsigned long v) {
+    put16(p, (unsigned int)(v & 0xFFFF));
+    put16(p + 2, (unsigned int)(v >> 16));
+}
+
+/* Write 'count' pixels from RGBA in a TGA file's layout */
+static void put_tga_pixels(FILE* file, const unsigned char* rgba, int count, int channels) {
+    unsigned char pixels[256 * 4];
+
+    for (int i = 0; i < count; i++) {
+        const unsigned char* p = rgba + i * 4;
+        unsigned char* d = pixels + i * channels;
+        if (channels == 1) {
+            d[0] = p[0];
+        } else {
+            d[0] = p[2]; d[1] = p[1]; d[2] = p[0];
+            if (channels == 4) d[3] = p[3];
+        }
+    }
+    fwrite(pixels, channels, count, file);
+}
+
+/* Rows bottom first. Channels 1 writes the red channel as grey. */
+static int write_tga(const char* path, const unsigned char* rgba, int width, int height,
+                     int channels, int rle) {
+    unsigned char header[18] = {0};
+    FILE* file = fopen(path, "wb");
+
+    if (!file) return -1;
+    header[2] = (channels == 1 ? 3 : 2) + (rle ? 8 : 0);
+    put16(header + 12, width);
+    put16(header + 14, height);
+    header[16] = (unsigned char)(channels * 8);
+    header[17] = channels == 4 ? 8 : 0;
+    fwrite(header, 1, sizeof(header), file);
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = rgba + (size_t)y * width * 4;
+        int x = 0;
+
+#define SAME(a, b) (memcmp(src + (a) * 4, src + (b) * 4, channels) == 0)
+        while (x < width) {
+            int n = 1;
+            if (!rle) {
+                n = width - x < 256 ? width - x : 256;
+            } else {
+                while (x + n < width && n < 128 && SAME(x + n, x)) n++;
+                if (n > 1) {
+                    /* A run packet: one pixel, repeated */
+                    fputc(0x80 | (n - 1), file);
+                    put_tga_pixels(file, src + x * 4, 1, channels);
+                    x += n;
+                    continue;
+                }
+                /* A raw packet, up to where the next run starts */
+                while (x + n < width && n < 128 && !(x + n + 1 < width && SAME(x + n, x + n + 1))) n++;
+                fputc(n - 1, file);
+            }
+            put_tga_pixels(file, src + x * 4, n, channels);
+            x += n;
+        }
+#undef SAME
+    }
+    return fclose(file);
+}
+
+/* Rows top first, as PPM has them */
+static int write_ppm(const char* path, const unsigned char* rgba, int width, int height) {
+    unsigned char* row = malloc((size_t)width * 3);
+    FILE* file = fopen(path, "wb");
+
+    if (!file || !row) {
+        if (file) fclose(file);
+        free(row);
+        return -1;
+    }
+    fprintf(file, "P6\n# test image\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) memcpy(row + x * 3, rgba + ((size_t)y * width + x) * 4, 3);
+        fwrite(row, 3, width, file);
+    }
+    free(row);
+    return fclose(file);
+}
+
+/* Rows bottom first, padded to 4 bytes; 32-bit pixels are BGRX */
+static int write_bmp(const char* path, const unsigned char* rgba, int width, int height, int bits) {
+    int bytes = bits / 8;
+    size_t stride = ((size_t)width * bytes + 3) & ~(size_t)3;
+    unsigned char header[54] = {'B', 'M'};
+    unsigned char* row = calloc(stride, 1);
+    FILE* file = fopen(path, "wb");
+
+    if (!file || !row) {
+        if (file) fclose(file);
+        free(row);
+        return -1;
+    }
+    put32(header + 2, 54 + stride * height);
+    put32(header + 10, 54);
+    put32(header + 14, 40);
+    put32(header + 18, width);
+    put32(header + 22, height);
+    put16(header + 26, 1);
+    put16(header + 28, bits);
+    put32(header + 34, stride * height);
+    fwrite(header, 1, sizeof(header), file);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const unsigned char* p = rgba + ((size_t)y * width + x) * 4;
+            unsigned char* d = row + x * bytes;
+            d[0] = p[2]; d[1] = p[1]; d[2] = p[0];
+        }
+        fwrite(row, 1, stride, file);
+    }
+    free(row);
+    return fclose(file);
+}
+
+/* Does every decoded pixel match the first 'channels' bytes of the source? */
+static int image_matches(const unsigned char* pixels, size_t stride, const unsigned char* rgba,
+                         int width, int height, int channels) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (memcmp(pixels + y * stride + x * channels,
+                       rgba + ((size_t)y * width + x) * 4, channels) != 0) return 0;
+        }
+    }
+    return 1;
+}
+
+int bench_load(int size) {
+    static const struct {
+        const char* name;
+        const char* file;
+        int channels, rle, bits;
+    } layouts[] = {
+        {"TGA 24-bit",      "bench24.tga",    3, 0, 0},
+        {"TGA 32-bit",      "bench32.tga",    4, 0, 0},
+        {"TGA 24-bit RLE",  "bench24rle.tga", 3, 1, 0},
+        {"TGA 32-bit RLE",  "bench32rle.tga", 4, 1, 0},
+        {"TGA 8-bit grey",  "bench8.tga",     1, 0, 0},
+        {"PPM",             "bench.ppm",      3, 0, 0},
+        {"BMP 24-bit",      "bench24.bmp",    3, 0, 24},
+        {"BMP 32-bit",      "bench32.bmp",    3, 0, 32},
+    };
+    const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    unsigned char* rgba = malloc((size_t)size * size * 4);
+    unsigned char* pixels = malloc((size_t)size * size * 4 + 4 * size);
+    unsigned char* chunk = malloc(IMAGE_CHUNK);
+    int all_ok = 1;
+
+    if (!rgba || !pixels || !chunk) {
+        printf("%dx%d: out of memory\n", size, size);
+        return 1;
+    }
+    make_test_image(rgba, size, size);
+    printf("%dx%d images in %s\n", size, size, dir);
+    printf("%-16s %8s %11s %11s %11s  %s\n", "layout", "file MB", "read MB/s",
+           "decode MB/s", "stream MB/s", "check");
+
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        char path[1024];
+        int written;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, layouts[l].file);
+        if (layouts[l].bits) {
+            written = write_bmp(path, rgba, size, size, layouts[l].bits);
+        } else if (strstr(layouts[l].file, ".ppm")) {
+            written = write_ppm(path, rgba, size, size);
+        } else {
+            written = write_tga(path, rgba, size, size, layouts[l].channels, layouts[l].rle);
+        }
+        if (written != 0) {
+            perror(path);
+            all_ok = 0;
+            continue;
+        }
+
+        double best[3] = {1e9, 1e9, 1e9};
+        long file_bytes = 0;
+        int ok = 1;
+        for (int run = 0; run < 3; run++) {
+            image_reader_t image;
+            FILE* file = fopen(path, "rb");
+            size_t got;
+
+            double start = timing_seconds();
+            file_bytes = 0;
+            while (file && (got = fread(chunk, 1, IMAGE_CHUNK, file)) > 0) file_bytes += (long)got;
+            if (file) fclose(file);
+            double t = timing_seconds() - start;
+            if (t < best[0]) best[0] = t;
+
+            start = timing_seconds();
+            if (image_open(&image, path) != 0) {
+                ok = 0;
+                break;
+            }
+            size_t stride = image_stride(&image, 4);
+            ok = image_decode(&image, pixels, stride) == 0 && ok;
+            image_close(&image);
+            t = timing_seconds() - start;
+            if (t < best[1]) best[1] = t;
+            ok = ok && image.channels == layouts[l].channels &&
+                 image_matches(pixels, stride, rgba, size, size, image.channels);
+
+            start = timing_seconds();
+            if (image_open(&image, path) != 0) {
+                ok = 0;
+                break;
+            }
+            int rows = 0;
+            while (image_read_row(&image, pixels) >= 0) rows++;
+            image_close(&image);
+            t = timing_seconds() - start;
+            if (t < best[2]) best[2] = t;
+            ok = ok && rows == size;
+        }
+
+        double decoded = (double)size * size * layouts[l].channels / 1048576.0;
+        printf("%-16s %8.1f %11.0f %11.0f %11.0f  %s\n", layouts[l].name,
+               file_bytes / 1048576.0, file_bytes / 1048576.0 / best[0], decoded / best[1],
+               decoded / best[2], ok ? "ok" : "MISMATCH");
+        fflush(stdout);
+        all_ok = all_ok && ok;
+        remove(path);
+    }
+
+    free(rgba);
+    free(pixels);
+    free(chunk);
+    return all_ok ? 0 : 1;
+}
+
+/* Largest difference between a texture level in GL and the same level of a chain */
+static int compare_level(const mipmap_chain_t* chain, int level, unsigned char* readback) {
+    int diff = 0, w = chain->width[level], h = chain->height[level];
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, readback);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w * 4; x++) {
+            int d = abs(readback[y * chain->stride[level] + x] -
+                        chain->level[level][y * chain->stride[level] + x]);
+            if (d > diff) diff = d;
+        }
+    }
+    return diff;
+}
+
+int bench_mipmap(int argc, char** argv, int size) {
+    static const struct {
+        const char* name;
+        mipmap_filter_t filter;
+        int gamma;
+    } filters[] = {
+        {"box", MIPMAP_BOX, 0},
+        {"box, gamma", MIPMAP_BOX, 1},
+        {"Kaiser", MIPMAP_KAISER, 0},
+        {"Kaiser, gamma", MIPMAP_KAISER, 1},
+    };
+    unsigned char* rgba = malloc((size_t)size * size * 4);
+    unsigned char* readback = malloc((size_t)size * size * 4);
+    int ok = 1;
+
+    if (!rgba || !readback) {
+        printf("%dx%d: out of memory\n", size, size);
+        return 1;
+    }
+    if (offscreen_create(&argc, argv, 64, 64, 0) != 0) return 1;
+    make_test_image(rgba, size, size);
+
+    /* GLU and the chains each get a texture whose storage is reused */
+    GLuint glu_tex, tex;
+    glGenTextures(1, &glu_tex);
+    glGenTextures(1, &tex);
+    printf("%s (%s)\n", (const char*)glGetString(GL_RENDERER), offscreen_backend());
+    printf("%-11s %-14s %9s %9s %9s %8s\n", "image", "builder", "build ms", "upload ms",
+           "total ms", "speedup");
+
+    for (int npot = 0; npot < 2; npot++) {
+        int n = size - npot;
+        double glu_ms = 1e9;
+        char image[32];
+
+        snprintf(image, sizeof(image), "%dx%d", n, n);
+        glBindTexture(GL_TEXTURE_2D, glu_tex);
+        for (int run = 0; run < 3; run++) {
+            double start = timing_seconds();
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, size);
+            gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, n, n, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glFinish();
+            double ms = (timing_seconds() - start) * 1000.0;
+            if (ms < glu_ms) glu_ms = ms;
+        }
+        printf("%-11s %-14s %9s %9s %9.1f %8s\n", image, "gluBuild2D...", "-", "-", glu_ms, "1.0x");
+
+        glBindTexture(GL_TEXTURE_2D, tex);
+        for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+            mipmap_options_t opts;
+            mipmap_chain_t chain;
+            double build_ms = 1e9, upload_ms = 1e9;
+
+            mipmap_options_defaults(&opts);
+            opts.filter = filters[f].filter;
+            opts.gamma_correct = filters[f].gamma;
+            for (int run = 0; run < 3; run++) {
+                double start = timing_seconds();
+                if (mipmap_build(&chain, rgba, n, n, (size_t)size * 4, 4, &opts) != 0) {
+                    printf("  out of memory\n");
+                    return 1;
+                }
+                double built = timing_seconds();
+                mipmap_upload(&chain);
+                glFinish();
+                double done = timing_seconds();
+                if ((built - start) * 1000.0 < build_ms) build_ms = (built - start) * 1000.0;
+                if ((done - built) * 1000.0 < upload_ms) upload_ms = (done - built) * 1000.0;
+                if (run < 2) mipmap_free(&chain);
+            }
+            printf("%-11s %-14s %9.1f %9.1f %9.1f %7.1fx", image, filters[f].name, build_ms,
+                   upload_ms, build_ms + upload_ms, glu_ms / (build_ms + upload_ms));
+
+            if (f == 0 && !npot) {
+                /* The box filter rounds as GLU does, so the chains match exactly */
+                int worst = 0;
+                glBindTexture(GL_TEXTURE_2D, glu_tex);
+                for (int level = 0; level < chain.levels; level++) {
+                    int d = compare_level(&chain, level, readback);
+                    if (d > worst) worst = d;
+                }
+                glBindTexture(GL_TEXTURE_2D, tex);
+                printf("  %s", worst == 0 ? "same texels as GLU" : "DIFFERS from GLU");
+                ok = ok && worst == 0;
+            }
+            printf("\n");
+            fflush(stdout);
+            mipmap_free(&chain);
+        }
+    }
+
+    glDeleteTextures(1, &glu_tex);
+    glDeleteTextures(1, &tex);
+    free(rgba);
+    free(readback);
+    offscreen_destroy();
+    return ok ? 0 : 1;
+}
+
+/* ------------------------------------------------------------------------
+ * Streaming benchmark: blocking loads against the background streamer
+ * ------------------------------------------------------------------------ */
+
+#define STREAM_MAX_FILES 64
+#define STREAM_FRAME_MS (1000.0 / 60.0)
+
+/* One small quad per texture, in a grid */
+static void draw_texture_grid(const GLuint* textures, int count) {
+    int columns = (int)ceil(sqrt(count));
+    float cell = 2.0f / columns;
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    for (int i = 0; i < count; i++) {
+        float x = -1.0f + (i % columns) * cell, y = -1.0f + (i / columns) * cell;
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glBegin(GL_QUADS);
+            glTexCoord2f(0.0f, 0.0f); glVertex2f(x, y);
+            glTexCoord2f(1.0f, 0.0f); glVertex2f(x + cell, y);
+            glTexCoord2f(1.0f, 1.0f); glVertex2f(x + cell, y + cell);
+            glTexCoord2f(0.0f, 1.0f); glVertex2f(x, y + cell);
+        glEnd();
+    }
+    glFinish();
+}
+
+int bench_stream(int argc, char** argv, int count, int size) {
+    const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char paths[STREAM_MAX_FILES][1024];
+    GLuint textures[STREAM_MAX_FILES];
+    int handles[STREAM_MAX_FILES];
+    unsigned char* rgba = malloc((size_t)size * size * 4);
+    int cpus = thread_pool_cpu_count();
+    mipmap_options_t opts;
+
+    if (count > STREAM_MAX_FILES) count = STREAM_MAX_FILES;
+    if (!rgba) {
+        printf("%dx%d: out of memory\n", size, size);
+        return 1;
+    }
+    make_test_image(rgba, size, size);
+    for (int i = 0; i < count; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/stream%d.tga", dir, i);
+        if (write_tga(paths[i], rgba, size, size, 4, 0) != 0) {
+            perror(paths[i]);
+            free(rgba);
+            return 1;
+        }
+    }
+    free(rgba);
+
+    if (offscreen_create(&argc, argv, 256, 256, 0) != 0) return 1;
+    glEnable(GL_TEXTURE_2D);
+    mipmap_options_defaults(&opts);
+    mipmap_options_from_gl(&opts);
+    printf("%d %dx%d RGBA TGA files, %d CPUs, %.1f ms upload budget per frame\n",
+           count, size, size, cpus, UPLOAD_BUDGET_MS);
+    printf("%-12s %14s %14s %7s %15s\n", "loader", "first frame ms", "all loaded ms",
+           "frames", "worst frame ms");
+
+    /* What init_gl used to do: everything before the first frame */
+    double start = timing_seconds();
+    glGenTextures(count, textures);
+    for (int i = 0; i < count; i++) {
+        int w, h, channels;
+        unsigned char* pixels = image_load(paths[i], &w, &h, &channels);
+        mipmap_chain_t chain;
+
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        if (pixels && mipmap_build(&chain, pixels, w, h, ((size_t)w * channels + 3) & ~(size_t)3,
+                                   channels, &opts) == 0) {
+            mipmap_upload(&chain);
+            mipmap_free(&chain);
+        }
+        free(pixels);
+    }
+    draw_texture_grid(textures, count);
+    double blocking_ms = (timing_seconds() - start) * 1000.0;
+    printf("%-12s %14.1f %14.1f %7d %15.1f\n", "blocking", blocking_ms, blocking_ms, 1, blocking_ms);
+    glDeleteTextures(count, textures);
+
+    for (int threads = 1;; threads *= 2) {
+        if (threads > cpus) threads = cpus;
+        texture_streamer_t* ts = texture_streamer_create(threads);
+        texture_streamer_stats_t stats;
+        double first_ms = 0.0, worst_ms = 0.0;
+        int frames = 0;
+        char name[32];
+
+        if (!ts) break;
+        start = timing_seconds();
+        for (int i = 0; i < count; i++) handles[i] = texture_streamer_load(ts, paths[i], &opts);
+        do {
+            uint64_t frame_start = timing_now_ns();
+            texture_streamer_update(ts, UPLOAD_BUDGET_MS);
+            for (int i = 0; i < count; i++) textures[i] = texture_streamer_texture(ts, handles[i]);
+            draw_texture_grid(textures, count);
+
+            double frame_ms = (timing_now_ns() - frame_start) / 1e6;
+            if (frames++ == 0) first_ms = (timing_seconds() - start) * 1000.0;
+            if (frame_ms > worst_ms) worst_ms = frame_ms;
+            texture_streamer_stats(ts, &stats);
+            /* The rest of the frame is the workers' */
+            timing_sleep_until_ns(frame_start + (uint64_t)(STREAM_FRAME_MS * 1e6));
+        } while (stats.loading > 0);
+
+        snprintf(name, sizeof(name), "%d worker%s", threads, threads > 1 ? "s" : "");
+        printf("%-12s %14.1f %14.1f %7d %15.1f\n", name, first_ms,
+               (timing_seconds() - start) * 1000.0, frames, worst_ms);
+        texture_streamer_destroy(ts);
+        if (threads == cpus) break;
+    }
+
+    for (int i = 0; i < count; i++) remove(paths[i]);
+    offscreen_destroy();
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Atlas benchmark: many objects, each with its own texture, drawn with a
+ * bind each and then from atlas pages
+ * ------------------------------------------------------------------------ */
+
+#define ATLAS_FRAMES 100
+
+static int bind_count;
+
+static void bind_texture(GLuint texture) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    bind_count++;
+}
+
+/* Draw 'frames' frames with 'draw'; returns ms per frame */
+static double time_frames(void (*draw)(void* ctx), void* ctx, int frames) {
+    draw(ctx);
+    glFinish();
+    double start = timing_seconds();
+    for (int f = 0; f < frames; f++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        draw(ctx);
+    }
+    glFinish();
+    return (timing_seconds() - start) * 1000.0 / frames;
+}
+
+typedef struct {
+    int count;
+    float* vertices;             /* 4 corners per object, x,y pairs */
+    float* texcoords;            /* The same, 0..1 or atlas space */
+    const GLuint* textures;      /* Per object, for the unbatched draws */
+    const int* order;            /* Object order */
+    int pages;
+    const int* page_first;       /* Batched: each page's corners */
+    const int* page_count;
+    const GLuint* page_textures;
+    int draw_calls;
+} atlas_scene_t;
+
+/* One bind and one draw per object, the way separate textures force */
+static void draw_objects(void* ctx) {
+    atlas_scene_t* scene = ctx;
+    GLuint bound = 0;
+
+    glVertexPointer(2, GL_FLOAT, 0, scene->vertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, scene->texcoords);
+    for (int n = 0; n < scene->count; n++) {
+        int i = scene->order[n];
+        if (scene->textures[i] != bound) {
+            bound = scene->textures[i];
+            bind_texture(bound);
+        }
+        glDrawArrays(GL_QUADS, i * 4, 4);
+        scene->draw_calls++;
+    }
+}
+
+/* One bind and one draw per atlas page */
+static void draw_pages(void* ctx) {
+    atlas_scene_t* scene = ctx;
+
+    glVertexPointer(2, GL_FLOAT, 0, scene->vertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, scene->texcoords);
+    for (int p = 0; p < scene->pages; p++) {
+        bind_texture(scene->page_textures[p]);
+        glDrawArrays(GL_QUADS, scene->page_first[p], scene->page_count[p]);
+        scene->draw_calls++;
+    }
+}
+
+/* Time one way of drawing and print its row */
+static void report_atlas_mode(const char* name, void (*draw)(void* ctx), atlas_scene_t* scene) {
+    bind_count = 0;
+    scene->draw_calls = 0;
+    double ms = time_frames(draw, scene, ATLAS_FRAMES);
+    printf("%-26s %8d %8d %9.2f\n", name, bind_count / (ATLAS_FRAMES + 1),
+           scene->draw_calls / (ATLAS_FRAMES + 1), ms);
+}
+
+int bench_atlas(int argc, char** argv, int count) {
+    static const float corners[8] = {0, 0, 1, 0, 1, 1, 0, 1};
+    atlas_image_t* images = calloc(count, sizeof(atlas_image_t));
+    atlas_rect_t* rects = calloc(count, sizeof(atlas_rect_t));
+    GLuint* textures = calloc(count, sizeof(GLuint));
+    int* order = malloc(count * sizeof(int));
+    float* vertices = malloc(count * 8 * sizeof(float));
+    float* texcoords = malloc(count * 8 * sizeof(float));
+    float* batched_vertices = malloc(count * 8 * sizeof(float));
+    float* batched_texcoords = malloc(count * 8 * sizeof(float));
+    int columns = (int)ceil(sqrt(count));
+    float cell = 2.0f / columns;
+    unsigned int seed = 12345;
+    mipmap_options_t opts;
+    atlas_t atlas;
+    int ok = 1;
+
+    if (!images || !rects || !textures || !order || !vertices || !texcoords ||
+        !batched_vertices || !batched_texcoords) {
+        printf("out of memory\n");
+        return 1;
+    }
+    if (offscreen_create(&argc, argv, 512, 512, 0) != 0) return 1;
+    mipmap_options_defaults(&opts);
+    mipmap_options_from_gl(&opts);
+
+    /* Distinct images, and a quad for each in a grid */
+    for (int i = 0; i < count; i++) {
+        int w, h;
+        seed = seed * 1103515245u + 12345u;
+        w = 16 << ((seed >> 16) % 3);
+        h = 16 << ((seed >> 20) % 3);
+        unsigned char* pixels = malloc((size_t)w * h * 4);
+        if (!pixels) return 1;
+        make_test_image(pixels, w, h);
+        for (int t = 0; t < w * h; t++) pixels[t * 4 + 2] = (unsigned char)(i * 37);
+        images[i].pixels = pixels;
+        images[i].width = w;
+        images[i].height = h;
+        images[i].stride = (size_t)w * 4;
+
+        float x = -1.0f + (i % columns) * cell, y = -1.0f + (i / columns) * cell;
+        for (int k = 0; k < 4; k++) {
+            vertices[i * 8 + k * 2] = x + corners[k * 2] * cell * 0.9f;
+            vertices[i * 8 + k * 2 + 1] = y + corners[k * 2 + 1] * cell * 0.9f;
+        }
+        memcpy(texcoords + i * 8, corners, sizeof(corners));
+        order[i] = i;
+    }
+
+    glEnable(GL_TEXTURE_2D);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    printf("%d objects, %s (%s)\n", count, (const char*)glGetString(GL_RENDERER),
+           offscreen_backend());
+    printf("%-26s %8s %8s %9s\n", "textures", "binds", "draws", "ms/frame");
+
+    /* Before: a texture per object */
+    glGenTextures(count, textures);
+    for (int i = 0; i < count; i++) {
+        mipmap_chain_t chain;
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        if (mipmap_build(&chain, images[i].pixels, images[i].width, images[i].height,
+                         images[i].stride, 4, &opts) != 0) {
+            return 1;
+        }
+        mipmap_upload(&chain);
+        mipmap_free(&chain);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    atlas_scene_t scene = {count, vertices, texcoords, textures, order, 0, NULL, NULL, NULL, 0};
+    report_atlas_mode("one per object", draw_objects, &scene);
+
+    /* After: pack, check every image landed intact, and upload */
+    double start = timing_seconds();
+    atlas_init(&atlas, 1024, 4, 4);
+    int placed = atlas_pack(&atlas, images, count, rects);
+    double pack_ms = (timing_seconds() - start) * 1000.0;
+    if (atlas_upload(&atlas, &opts) != 0) return 1;
+    for (int i = 0; i < count; i++) {
+        const unsigned char* page = atlas.pages[rects[i].page];
+        for (int y = 0; y < images[i].height && ok; y++) {
+            ok = memcmp(page + ((size_t)(rects[i].y + y) * atlas.page_size + rects[i].x) * 4,
+                        images[i].pixels + y * images[i].stride, images[i].width * 4) == 0;
+        }
+    }
+
+    /* Objects sorted by page, with texture coordinates in atlas space */
+    GLuint* object_pages = malloc(count * sizeof(GLuint));
+    int* page_first = calloc(atlas.page_count, sizeof(int));
+    int* page_count = calloc(atlas.page_count, sizeof(int));
+    if (!object_pages || !page_first || !page_count) return 1;
+    for (int i = 0; i < count; i++) {
+        atlas_remap_texcoords(&rects[i], texcoords + i * 8, 4);
+        object_pages[i] = atlas.textures[rects[i].page];
+    }
+    int n = 0;
+    for (int p = 0; p < atlas.page_count; p++) {
+        page_first[p] = n * 4;
+        for (int i = 0; i < count; i++) {
+            if (rects[i].page != p) continue;
+            order[n] = i;
+            memcpy(batched_vertices + n * 8, vertices + i * 8, 8 * sizeof(float));
+            memcpy(batched_texcoords + n * 8, texcoords + i * 8, 8 * sizeof(float));
+            n++;
+        }
+        page_count[p] = n * 4 - page_first[p];
+    }
+
+    scene.textures = object_pages;
+    report_atlas_mode("atlas, a draw per object", draw_objects, &scene);
+    scene.vertices = batched_vertices;
+    scene.texcoords = batched_texcoords;
+    scene.pages = atlas.page_count;
+    scene.page_first = page_first;
+    scene.page_count = page_count;
+    scene.page_textures = atlas.textures;
+    report_atlas_mode("atlas, a draw per page", draw_pages, &scene);
+
+    printf("\n%d of %d images in %d %dx%d pages, %.0f%% full, packed in %.1f ms: %s\n",
+           placed, count, atlas.page_count, atlas.page_size, atlas.page_size,
+           atlas_fill(&atlas) * 100.0f, pack_ms, ok && placed == count ? "all intact" : "FAILED");
+
+    glDeleteTextures(count, textures);
+    atlas_free(&atlas);
+    for (int i = 0; i < count; i++) free((void*)images[i].pixels);
+    free(images);
+    free(rects);
+    free(textures);
+    free(order);
+    free(vertices);
+    free(texcoords);
+    free(batched_vertices);
+    free(batched_texcoords);
+    free(object_pages);
+    free(page_first);
+    free(page_count);
+    offscreen_destroy();
+    return ok && placed == count ? 0 : 1;
+}
+
+/* ------------------------------------------------------------------------
+ * Residency benchmark: a walk past more textures than the budget holds
+ * ------------------------------------------------------------------------ */
+
+#define RESIDENCY_TEXTURES 256
+#define RESIDENCY_SIZE 256
+#define RESIDENCY_WINDOW 32      /* Textures drawn each frame */
+#define RESIDENCY_STEP 2         /* New textures the window reaches each frame */
+#define RESIDENCY_FRAMES 600
+
+/* A distinct 256x256 RGBA texture per index, rebuilt after eviction */
+static int build_residency_texture(void* ctx) {
+    static unsigned char pixels[RESIDENCY_SIZE * RESIDENCY_SIZE * 4];
+    int index = (int)(intptr_t)ctx;
+    mipmap_options_t opts;
+    mipmap_chain_t chain;
+
+    make_test_image(pixels, RESIDENCY_SIZE, RESIDENCY_SIZE);
+    for (int i = 0; i < RESIDENCY_SIZE * RESIDENCY_SIZE; i++) pixels[i * 4 + 2] = (unsigned char)index;
+    mipmap_options_defaults(&opts);
+    if (mipmap_build(&chain, pixels, RESIDENCY_SIZE, RESIDENCY_SIZE, RESIDENCY_SIZE * 4, 4,
+                     &opts) != 0) {
+        return -1;
+    }
+    mipmap_upload(&chain);
+    mipmap_free(&chain);
+    return 0;
+}
+
+int bench_residency(int argc, char** argv, int budget_mb) {
+    size_t budgets[2] = {0, (size_t)budget_mb << 20};
+    int ids[RESIDENCY_TEXTURES];
+
+    if (offscreen_create(&argc, argv, 256, 256, 0) != 0) return 1;
+    glEnable(GL_TEXTURE_2D);
+    printf("%d %dx%d RGBA textures, %d drawn per frame, %d new each frame, %d frames\n",
+           RESIDENCY_TEXTURES, RESIDENCY_SIZE, RESIDENCY_SIZE, RESIDENCY_WINDOW, RESIDENCY_STEP,
+           RESIDENCY_FRAMES);
+    printf("%-10s %8s %7s %9s %9s %9s %15s\n", "budget", "peak MB", "loads", "evictions",
+           "ms/frame", "worst ms", "driver resident");
+
+    for (int b = 0; b < 2; b++) {
+        texture_manager_t* tm = texture_manager_create(budgets[b]);
+        texture_manager_stats_t stats;
+        double worst = 0.0;
+        char name[32], overlay[128];
+
+        if (!tm) return 1;
+        for (int i = 0; i < RESIDENCY_TEXTURES; i++) {
+            ids[i] = texture_manager_add(tm, build_residency_texture, (void*)(intptr_t)i);
+        }
+
+        double start = timing_seconds();
+        for (int f = 0; f < RESIDENCY_FRAMES; f++) {
+            double frame_start = timing_seconds();
+            texture_manager_begin_frame(tm);
+            glClear(GL_COLOR_BUFFER_BIT);
+            for (int k = 0; k < RESIDENCY_WINDOW; k++) {
+                int i = (f * RESIDENCY_STEP + k) % RESIDENCY_TEXTURES;
+                float x = -1.0f + (k % 8) * 0.25f, y = -1.0f + (k / 8) * 0.5f;
+                glBindTexture(GL_TEXTURE_2D, texture_manager_use(tm, ids[i]));
+                glBegin(GL_QUADS);
+                    glTexCoord2f(0, 0); glVertex2f(x, y);
+                    glTexCoord2f(1, 0); glVertex2f(x + 0.25f, y);
+                    glTexCoord2f(1, 1); glVertex2f(x + 0.25f, y + 0.5f);
+                    glTexCoord2f(0, 1); glVertex2f(x, y + 0.5f);
+                glEnd();
+            }
+            glFinish();
+            double ms = (timing_seconds() - frame_start) * 1000.0;
+            if (f > 0 && ms > worst) worst = ms;     /* The first frame loads the whole window */
+        }
+        double ms = (timing_seconds() - start) * 1000.0 / RESIDENCY_FRAMES;
+
+        texture_manager_stats(tm, &stats, 1);
+        if (budgets[b]) snprintf(name, sizeof(name), "%d MB", budget_mb);
+        else snprintf(name, sizeof(name), "no limit");
+        printf("%-10s %8.1f %7d %9d %9.2f %9.2f %9d of %3d\n", name, stats.peak_bytes / 1048576.0,
+               stats.loads, stats.evictions, ms, worst, stats.driver_resident, stats.resident);
+        texture_manager_format_stats(&stats, overlay, sizeof(overlay));
+        printf("           %s\n", overlay);
+        texture_manager_destroy(tm);
+    }
+    offscreen_destroy();
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Cache benchmark: startup with and without the texture cache
+ * ------------------------------------------------------------------------ */
+
+/* Ask the kernel to forget a file's pages, as if the machine had just booted */
+static void drop_from_page_cache(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/*
+ * load_textures - What a program's startup does: every file, mipmapped
+ * and uploaded
+ *
+ * @cache_dir: NULL to decode every file
+ *
+ * Returns the milliseconds until the GPU has them all; 'prepare_ms' is the
+ * part spent before glTexImage2D, and 'built' counts cache misses.
+ */
+static double load_textures(char paths[][1024], int count, const char* cache_dir,
+                            const mipmap_options_t* opts, GLuint* textures,
+                            double* prepare_ms, int* built) {
+    double start = timing_seconds();
+
+    *prepare_ms = 0.0;
+    *built = 0;
+    for (int i = 0; i < count; i++) {
+        double t = timing_seconds();
+        texture_cache_file_t* file = NULL;
+        unsigned char* pixels = NULL;
+        mipmap_chain_t chain;
+        int ok = 0, w, h, channels;
+
+        if (cache_dir) {
+            int miss;
+            file = texture_cache_load(cache_dir, paths[i], opts, &miss);
+            if (file) chain = file->chain;
+            ok = file != NULL;
+            *built += miss;
+        } else if ((pixels = image_load(paths[i], &w, &h, &channels)) != NULL) {
+            ok = mipmap_build(&chain, pixels, w, h, ((size_t)w * channels + 3) & ~(size_t)3,
+                              channels, opts) == 0;
+            (*built)++;
+        }
+        *prepare_ms += (timing_seconds() - t) * 1000.0;
+
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        if (ok) mipmap_upload(&chain);
+        if (file) texture_cache_close(file);
+        else if (ok) mipmap_free(&chain);
+        free(pixels);
+    }
+    draw_texture_grid(textures, count);
+    return (timing_seconds() - start) * 1000.0;
+}
+
+int bench_cache(int argc, char** argv, int count, int size) {
+    const char* tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char paths[STREAM_MAX_FILES][1024], dir[1024], cache_paths[STREAM_MAX_FILES][1100];
+    GLuint textures[STREAM_MAX_FILES];
+    unsigned char* rgba = malloc((size_t)size * size * 4);
+    mipmap_options_t opts;
+    static const struct {
+        const char* name;
+        int use_cache, cold;
+    } runs[] = {
+        {"decode, files in memory", 0, 0},
+        {"decode, files on disk", 0, 1},
+        {"cache, first run", 1, 0},
+        {"cache, files in memory", 1, 0},
+        {"cache, files on disk", 1, 1},
+    };
+
+    if (count > STREAM_MAX_FILES) count = STREAM_MAX_FILES;
+    if (!rgba) {
+        printf("%dx%d: out of memory\n", size, size);
+        return 1;
+    }
+    snprintf(dir, sizeof(dir), "%s/texture_cache_bench", tmp);
+    for (int i = 0; i < count; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/cache%d.tga", tmp, i);
+        /* A different image each, or the cache would store one for all */
+        make_test_image(rgba, size, size);
+        for (int p = 0; p < size; p++) rgba[p * 4 + 2] = (unsigned char)i;
+        if (write_tga(paths[i], rgba, size, size, 4, 1) != 0) {
+            perror(paths[i]);
+            free(rgba);
+            return 1;
+        }
+    }
+    free(rgba);
+
+    if (offscreen_create(&argc, argv, 256, 256, 0) != 0) return 1;
+    glEnable(GL_TEXTURE_2D);
+    mipmap_options_defaults(&opts);
+    mipmap_options_from_gl(&opts);
+    for (int i = 0; i < count; i++) {
+        uint64_t key;
+        texture_cache_key(paths[i], &opts, &key);
+        texture_cache_path(dir, key, cache_paths[i], sizeof(cache_paths[i]));
+        remove(cache_paths[i]);
+    }
+
+    double prepare_ms;
+    int built;
+    glGenTextures(count, textures);
+    load_textures(paths, count, NULL, &opts, textures, &prepare_ms, &built);
+    glDeleteTextures(count, textures);
+
+    printf("%d %dx%d RGBA RLE TGA files, mipmapped, cache in %s\n", count, size, size, dir);
+    printf("%-24s %10s %11s %10s %8s\n", "startup", "total ms", "prepare ms", "upload ms",
+           "decoded");
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        if (runs[r].cold) {
+            for (int i = 0; i < count; i++) {
+                drop_from_page_cache(paths[i]);
+                drop_from_page_cache(cache_paths[i]);
+            }
+        }
+        glGenTextures(count, textures);
+        double ms = load_textures(paths, count, runs[r].use_cache ? dir : NULL, &opts,
+                                  textures, &prepare_ms, &built);
+        printf("%-24s %10.1f %11.1f %10.1f %5d/%d\n", runs[r].name, ms, prepare_ms,
+               ms - prepare_ms, built, count);
+        glDeleteTextures(count, textures);
+    }
+
+    /* Hashing the source is what a hit costs beyond the upload */
+    long bytes[2] = {0, 0};
+    for (int k = 0; k < 2; k++) {
+        FILE* f = fopen(k ? cache_paths[0] : paths[0], "rb");
+        if (f) {
+            fseek(f, 0, SEEK_END);
+            bytes[k] = ftell(f);
+            fclose(f);
+        }
+    }
+    size_t hash_size = (size_t)size * size * 4;
+    unsigned char* block = calloc(hash_size, 1);
+    if (block) {
+        double t = timing_seconds();
+        volatile uint64_t h = texture_cache_hash(block, hash_size, 0);
+        (void)h;
+        printf("\nper texture: %.1f MB source, %.1f MB cache file; hashing runs at %.0f MB/s\n",
+               bytes[0] / 1048576.0, bytes[1] / 1048576.0,
+               hash_size / 1048576.0 / (timing_seconds() - t));
+        free(block);
+    }
+
+    for (int i = 0; i < count; i++) {
+        remove(paths[i]);
+        remove(cache_paths[i]);
+    }
+    rmdir(dir);
+    offscreen_destroy();
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Dynamic texture benchmark: a live heat map, re-sent whole or by rectangle
+ * ------------------------------------------------------------------------ */
+
+#define HEATMAP_CELL 32          /* Texels per cell side */
+#define DYNAMIC_FRAMES 120
+
+/* Paint one cell a colour for 'value' (0..255), blue to red */
+static void paint_cell(dynamic_texture_t* dt, int cx, int cy, int value) {
+    unsigned char* level0 = dt->chain.level[0];
+    size_t stride = dt->chain.stride[0];
+
+    for (int y = 0; y < HEATMAP_CELL; y++) {
+        unsigned char* p = level0 + (size_t)(cy * HEATMAP_CELL + y) * stride +
+                           (size_t)cx * HEATMAP_CELL * 4;
+        for (int x = 0; x < HEATMAP_CELL; x++, p += 4) {
+            /* A one-texel border keeps the cells apart */
+            int edge = x == 0 || y == 0;
+            p[0] = (unsigned char)(edge ? 0 : value);
+            p[1] = (unsigned char)(edge ? 0 : 64);
+            p[2] = (unsigned char)(edge ? 0 : 255 - value);
+            p[3] = 255;
+        }
+    }
+}
+
+/*
+ * run_heatmap - Change 'cells' cells a frame for DYNAMIC_FRAMES frames
+ *
+ * @whole: Mark the whole texture each frame, as a full re-upload would
+ *
+ * Returns milliseconds per frame, from the first changed texel to the
+ * drawn frame; 'mb' gets megabytes sent per frame.
+ */
+static double run_heatmap(dynamic_texture_t* dt, int cells, int whole, double* mb) {
+    int grid = dt->chain.width[0] / HEATMAP_CELL;
+    unsigned seed = 12345;
+    size_t sent = 0;
+    double start = timing_seconds();
+
+    for (int f = 0; f < DYNAMIC_FRAMES; f++) {
+        for (int i = 0; i < cells; i++) {
+            seed = seed * 1103515245u + 12345u;
+            int cell = (int)((seed >> 8) % (unsigned)(grid * grid));
+            int cx = cell % grid, cy = cell / grid;
+            paint_cell(dt, cx, cy, (int)(seed >> 24));
+            if (!whole) {
+                dynamic_texture_mark(dt, cx * HEATMAP_CELL, cy * HEATMAP_CELL,
+                                     HEATMAP_CELL, HEATMAP_CELL);
+            }
+        }
+        if (whole) dynamic_texture_mark(dt, 0, 0, dt->chain.width[0], dt->chain.height[0]);
+        sent += dynamic_texture_update(dt);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        glBindTexture(GL_TEXTURE_2D, dt->texture);
+        glBegin(GL_QUADS);
+            glTexCoord2f(0, 0); glVertex2f(-1, -1);
+            glTexCoord2f(1, 0); glVertex2f(1, -1);
+            glTexCoord2f(1, 1); glVertex2f(1, 1);
+            glTexCoord2f(0, 1); glVertex2f(-1, 1);
+        glEnd();
+        glFinish();
+    }
+    *mb = sent / 1048576.0 / DYNAMIC_FRAMES;
+    return (timing_seconds() - start) * 1000.0 / DYNAMIC_FRAMES;
+}
+
+/* Every level the GL holds matches a chain built from scratch from level 0 */
+static int matches_full_build(const dynamic_texture_t* dt) {
+    mipmap_chain_t chain;
+    int same = 1;
+
+    if (mipmap_build(&chain, dt->chain.level[0], dt->chain.width[0], dt->chain.height[0],
+                     dt->chain.stride[0], dt->chain.channels, &dt->opts) != 0) {
+        return 0;
+    }
+    glBindTexture(GL_TEXTURE_2D, dt->texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int i = 0; same && i < dt->chain.levels; i++) {
+        size_t size = chain.stride[i] * chain.height[i];
+        unsigned char* gl = malloc(size);
+        if (!gl) break;
+        glGetTexImage(GL_TEXTURE_2D, i, GL_RGBA, GL_UNSIGNED_BYTE, gl);
+        same = chain.levels == dt->chain.levels && memcmp(gl, chain.level[i], size) == 0;
+        free(gl);
+    }
+    mipmap_free(&chain);
+    return same;
+}
+
+int bench_dynamic(int argc, char** argv, int size) {
+    static const int changes[] = {4, 16, 64, 256};
+    mipmap_options_t opts;
+
+    if (size < HEATMAP_CELL || (size & (size - 1))) {
+        printf("%d: size must be a power of two, at least %d\n", size, HEATMAP_CELL);
+        return 1;
+    }
+    if (offscreen_create(&argc, argv, 256, 256, 0) != 0) return 1;
+    glEnable(GL_TEXTURE_2D);
+    mipmap_options_defaults(&opts);
+    printf("%dx%d RGBA heat map, %d cells of %dx%d, %d frames\n", size, size,
+           (size / HEATMAP_CELL) * (size / HEATMAP_CELL), HEATMAP_CELL, HEATMAP_CELL,
+           DYNAMIC_FRAMES);
+    printf("%-10s %13s %9s %9s %9s %9s\n", "mipmaps", "cells/frame", "whole ms", "rects ms",
+           "whole MB", "rects MB");
+
+    /* Unmeasured, so the driver's first allocations land on no one */
+    dynamic_texture_t warm;
+    double warm_mb;
+    if (dynamic_texture_init(&warm, size, size, 4, &opts) == 0) {
+        run_heatmap(&warm, 16, 1, &warm_mb);
+        dynamic_texture_free(&warm);
+    }
+
+    for (int mipmapped = 0; mipmapped < 2; mipmapped++) {
+        int intact = 1;
+        for (size_t c = 0; c < sizeof(changes) / sizeof(changes[0]); c++) {
+            dynamic_texture_t dt;
+            double ms[2], mb[2];
+
+            for (int whole = 1; whole >= 0; whole--) {
+                if (dynamic_texture_init(&dt, size, size, 4, mipmapped ? &opts : NULL) != 0) {
+                    printf("out of memory\n");
+                    return 1;
+                }
+                ms[whole] = run_heatmap(&dt, changes[c], whole, &mb[whole]);
+                if (!whole) intact &= matches_full_build(&dt);
+                dynamic_texture_free(&dt);
+            }
+            printf("%-10s %13d %9.2f %9.2f %9.2f %9.2f\n", mipmapped ? "yes" : "no",
+                   changes[c], ms[1], ms[0], mb[1], mb[0]);
+        }
+        if (mipmapped) printf("\nrectangles: %s\n", intact ? "every level matches a full rebuild"
+                                                          : "LEVELS DIFFER from a full rebuild");
+    }
+    offscreen_destroy();
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Procedural texture benchmark: each generator at size x size, on one
+ * thread and on the pool, checked for determinism and tiling
+ * ------------------------------------------------------------------------ */
+
+/* Largest step between neighbouring texels, inside and across the wrap */
+static void tiling_steps(const unsigned char* rgba, int width, int height, int* inner, int* seam) {
+    *inner = *seam = 0;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = rgba + (size_t)y * width * 4;
+        const unsigned char* below = rgba + (size_t)((y + 1) % height) * width * 4;
+        for (int x = 0; x < width; x++) {
+            const unsigned char* right = row + ((x + 1) % width) * 4;
+            for (int k = 0; k < 4; k++) {
+                int h = abs(row[x * 4 + k] - right[k]), v = abs(row[x * 4 + k] - below[x * 4 + k]);
+                int* step_h = x == width - 1 ? seam : inner;
+                int* step_v = y == height - 1 ? seam : inner;
+                if (h > *step_h) *step_h = h;
+                if (v > *step_v) *step_v = v;
+            }
+        }
+    }
+}
+
+/* Best of three runs, in milliseconds */
+static double time_procedural(thread_pool_t* pool, const procedural_options_t* opts,
+                              unsigned char* rgba, int size) {
+    double best = 1e9;
+
+    for (int run = 0; run < 3; run++) {
+        double start = timing_seconds();
+        procedural_generate(pool, opts, rgba, size, size, (size_t)size * 4, 4);
+        double ms = (timing_seconds() - start) * 1000.0;
+        if (ms < best) best = ms;
+    }
+    return best;
+}
+
+int bench_procedural(int size) {
+    static const struct {
+        const char* name;
+        procedural_kind_t kind;
+        int period, octaves;
+    } tests[] = {
+        {"checker", PROCEDURAL_CHECKER, 64, 1},
+        {"gradient", PROCEDURAL_GRADIENT, 4, 1},
+        {"value", PROCEDURAL_VALUE, 8, 1},
+        {"perlin", PROCEDURAL_PERLIN, 8, 1},
+        {"simplex", PROCEDURAL_SIMPLEX, 8, 1},
+        {"value fBm", PROCEDURAL_VALUE, 8, 8},
+        {"perlin fBm", PROCEDURAL_PERLIN, 8, 8},
+        {"simplex fBm", PROCEDURAL_SIMPLEX, 8, 8},
+    };
+    thread_pool_t* pool = thread_pool_create(0);
+    size_t bytes = (size_t)size * size * 4;
+    unsigned char* single = malloc(bytes);
+    unsigned char* pooled = malloc(bytes);
+
+    if (size < 1 || !single || !pooled) {
+        printf("out of memory\n");
+        free(single);
+        free(pooled);
+        thread_pool_destroy(pool);
+        return 1;
+    }
+    printf("%dx%d RGBA, %d thread%s in the pool, best of 3\n", size, size, thread_pool_size(pool),
+           thread_pool_size(pool) == 1 ? "" : "s");
+    printf("%-12s %8s %11s %10s %10s %10s %13s\n", "generator", "octaves", "1 thread ms",
+           "pool ms", "Mtexel/s", "same bytes", "seam / inner");
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        procedural_options_t opts;
+        int inner, seam;
+
+        procedural_options_defaults(&opts);
+        opts.kind = tests[i].kind;
+        opts.seed = 1234;
+        opts.period_x = opts.period_y = tests[i].period;
+        opts.octaves = tests[i].octaves;
+
+        double one = time_procedural(NULL, &opts, single, size);
+        double many = time_procedural(pool, &opts, pooled, size);
+        tiling_steps(pooled, size, size, &inner, &seam);
+        printf("%-12s %8d %11.1f %10.1f %10.0f %10s %7d / %3d%s\n", tests[i].name, tests[i].octaves,
+               one, many, (double)size * size / 1000.0 / many,
+               memcmp(single, pooled, bytes) == 0 ? "yes" : "NO", seam, inner,
+               seam <= inner ? "" : " SEAM");
+    }
+
+    free(single);
+    free(pooled);
+    thread_pool_destroy(pool);
+    return 0;
+}
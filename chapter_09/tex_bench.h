@@ -0,0 +1,80 @@
+/*
+ * tex_bench.h - The chapter's --bench-* modes
+ *
+ * Each writes its own test images or textures, times the chapter's
+ * loaders, mipmap builder, streamer, atlas, residency budget, cache,
+ * dynamic textures and generators against the plain way, and checks the
+ * results match. All run offscreen and return the process exit code; the
+ * argc/argv taken by some are only passed on to offscreen_create.
+ */
+
+#ifndef TEX_BENCH_H
+#define TEX_BENCH_H
+
+#define UPLOAD_BUDGET_MS 2.0     /* GL thread time per frame for streamed uploads */
+
+/*
+ * bench_load - Decode a size x size image in each layout
+ *
+ * "decode" fills a whole image; "stream" decodes one row at a time into
+ * the same small buffer, as a caller uploading rows as they arrive would.
+ * "read" is just reading the file in IMAGE_CHUNK pieces, the ceiling for
+ * both. Rates are decoded megabytes (RGB or RGBA) per second, best of 3.
+ */
+int bench_load(int size);
+
+/*
+ * bench_mipmap - Time gluBuild2DMipmaps against mipmap_build + upload on a
+ * size x size RGBA image, and on one a texel smaller (not a power of two)
+ *
+ * Each is the best of 3. The box-filtered chain is read back from GLU's
+ * texture and compared level by level.
+ */
+int bench_mipmap(int argc, char** argv, int size);
+
+/*
+ * bench_stream - Load 'count' size x size TGA files the old way, blocking
+ * before the first frame, then with the streamer at 1 worker up to one
+ * per CPU
+ *
+ * Streamed runs draw at 60 frames a second, uploading for at most
+ * UPLOAD_BUDGET_MS a frame, until every texture is ready.
+ */
+int bench_stream(int argc, char** argv, int count, int size);
+
+/*
+ * bench_atlas - 'count' objects with their own 16 to 64 texel textures,
+ * drawn with separate textures and from an atlas
+ */
+int bench_atlas(int argc, char** argv, int count);
+
+/*
+ * bench_residency - Draw a sliding window of textures, without a budget
+ * and with 'budget_mb'
+ */
+int bench_residency(int argc, char** argv, int budget_mb);
+
+/*
+ * bench_cache - Start up with 'count' size x size RLE TGA files: decoding
+ * them, filling the cache, and from the cache, with the files in memory
+ * and then read from disk
+ *
+ * Each run gets new texture names, after one unmeasured run has paid
+ * for the driver's first allocations.
+ */
+int bench_cache(int argc, char** argv, int count, int size);
+
+/*
+ * bench_dynamic - A size x size heat map of 32x32 cells with some cells
+ * changing each frame, re-sent whole and by dirty rectangle, with and
+ * without mipmaps
+ */
+int bench_dynamic(int argc, char** argv, int size);
+
+/*
+ * bench_procedural - Generate each pattern at size x size on one thread
+ * and on the pool, checking the two match and that the pattern tiles
+ */
+int bench_procedural(int size);
+
+#endif /* TEX_BENCH_H */
@@ -0,0 +1,329 @@
+/*
+ * texture_cache.c - Mipmapped textures stored ready to upload
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "texture_cache.h"
+#include "texture_loader.h"
+
+typedef struct {
+    uint32_t width, height;
+    uint32_t stride;             /* Row bytes, a multiple of 4 */
+    uint32_t reserved;
+    uint64_t offset, size;       /* From the start of the file */
+} level_header_t;
+
+typedef struct {
+    char magic[4];               /* "GLTC" */
+    uint32_t version;
+    uint64_t key;
+    uint32_t channels, levels;
+    level_header_t level[MIPMAP_MAX_LEVELS];
+} file_header_t;
+
+static const char MAGIC[4] = {'G', 'L', 'T', 'C'};
+
+/* ------------------------------------------------------------------------
+ * Hashing: XXH64, 32 bytes a step, far faster than the disk it hashes
+ * ------------------------------------------------------------------------ */
+
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define PRIME5 2870177450012600261ULL
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * PRIME2, 31) * PRIME1;
+}
+
+static uint64_t hash_merge(uint64_t acc, uint64_t v) {
+    return (acc ^ hash_round(0, v)) * PRIME1 + PRIME4;
+}
+
+uint64_t texture_cache_hash(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = data;
+    const unsigned char* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2;
+        uint64_t v3 = seed, v4 = seed - PRIME1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = hash_merge(h, v1);
+        h = hash_merge(h, v2);
+        h = hash_merge(h, v3);
+        h = hash_merge(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+    h += size;
+
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ hash_round(0, read64(p)), 27) * PRIME1 + PRIME4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) h = rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* ------------------------------------------------------------------------
+ * Keys and file names
+ * ------------------------------------------------------------------------ */
+
+int texture_cache_key(const char* path, const mipmap_options_t* opts, uint64_t* key) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    uint64_t h = 0;
+
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+        posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+        h = texture_cache_hash(map, (size_t)st.st_size, 0);
+        munmap(map, (size_t)st.st_size);
+    }
+    close(fd);
+
+    /* Fields one by one, so struct padding never reaches the hash */
+    int32_t options[5] = {(int32_t)opts->filter, opts->gamma_correct != 0, opts->npot != 0,
+                          opts->max_size, TEXTURE_CACHE_VERSION};
+    *key = texture_cache_hash(options, sizeof(options), h);
+    return 0;
+}
+
+void texture_cache_path(const char* dir, uint64_t key, char* buf, size_t size) {
+    snprintf(buf, size, "%s/%08lx%08lx.mip", dir, (unsigned long)(key >> 32),
+             (unsigned long)(key & 0xffffffffUL));
+}
+
+/* mkdir -p */
+static int make_dirs(const char* dir) {
+    char path[1024];
+    size_t len = strlen(dir);
+
+    if (len == 0 || len >= sizeof(path)) return -1;
+    memcpy(path, dir, len + 1);
+    for (size_t i = 1; i <= len; i++) {
+        if (path[i] != '/' && path[i] != '\0') continue;
+        path[i] = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            perror(path);
+            return -1;
+        }
+        path[i] = i < len ? '/' : '\0';
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Writing
+ * ------------------------------------------------------------------------ */
+
+int texture_cache_write(const char* path, const mipmap_chain_t* chain, uint64_t key) {
+    static const unsigned char zeros[TEXTURE_CACHE_ALIGN];
+    file_header_t header;
+    char tmp[1100];
+    uint64_t offset = TEXTURE_CACHE_ALIGN;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.key = key;
+    header.channels = (uint32_t)chain->channels;
+    header.levels = (uint32_t)chain->levels;
+    for (int i = 0; i < chain->levels; i++) {
+        level_header_t* level = &header.level[i];
+        level->width = (uint32_t)chain->width[i];
+        level->height = (uint32_t)chain->height[i];
+        level->stride = (uint32_t)chain->stride[i];
+        level->offset = offset;
+        level->size = (uint64_t)chain->stride[i] * chain->height[i];
+        offset += level->size;
+    }
+
+    /* The process id keeps two programs filling the same entry apart */
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    FILE* f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(zeros, TEXTURE_CACHE_ALIGN - sizeof(header), 1, f);
+    for (int i = 0; i < chain->levels; i++) {
+        fwrite(chain->level[i], (size_t)header.level[i].size, 1, f);
+    }
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed) {
+        perror(tmp);
+        remove(tmp);
+        return -1;
+    }
+    if (rename(tmp, path) != 0) {
+        perror(path);
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Reading
+ * ------------------------------------------------------------------------ */
+
+static int header_ok(const file_header_t* header, uint64_t key, size_t map_size) {
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->version != TEXTURE_CACHE_VERSION || header->key != key ||
+        header->channels < 1 || header->channels > 4 ||
+        header->levels < 1 || header->levels > MIPMAP_MAX_LEVELS) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < header->levels; i++) {
+        const level_header_t* level = &header->level[i];
+        uint64_t row = ((uint64_t)level->width * header->channels + 3) & ~(uint64_t)3;
+        if (level->width == 0 || level->height == 0 || level->stride != row ||
+            level->size != row * level->height || level->offset < TEXTURE_CACHE_ALIGN ||
+            level->offset > map_size || level->size > map_size - level->offset) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+texture_cache_file_t* texture_cache_open(const char* path, uint64_t key) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < TEXTURE_CACHE_ALIGN) {
+        close(fd);
+        return NULL;
+    }
+
+    texture_cache_file_t* file = calloc(1, sizeof(texture_cache_file_t));
+    if (!file) {
+        close(fd);
+        return NULL;
+    }
+    file->map_size = (size_t)st.st_size;
+    file->map = mmap(NULL, file->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file->map == MAP_FAILED) {
+        free(file);
+        return NULL;
+    }
+
+    const file_header_t* header = file->map;
+    if (!header_ok(header, key, file->map_size)) {
+        munmap(file->map, file->map_size);
+        free(file);
+        return NULL;
+    }
+    /* Every byte is about to go to glTexImage2D: start reading it now */
+    posix_madvise(file->map, file->map_size, POSIX_MADV_WILLNEED);
+
+    file->key = key;
+    file->chain.levels = (int)header->levels;
+    file->chain.channels = (int)header->channels;
+    for (int i = 0; i < file->chain.levels; i++) {
+        file->chain.width[i] = (int)header->level[i].width;
+        file->chain.height[i] = (int)header->level[i].height;
+        file->chain.stride[i] = header->level[i].stride;
+        file->chain.level[i] = (unsigned char*)file->map + header->level[i].offset;
+    }
+    return file;
+}
+
+void texture_cache_close(texture_cache_file_t* file) {
+    if (!file) return;
+    if (file->map) {
+        munmap(file->map, file->map_size);
+    } else {
+        mipmap_free(&file->chain);
+        free(file->pixels);
+    }
+    free(file);
+}
+
+texture_cache_file_t* texture_cache_load(const char* dir, const char* path,
+                                         const mipmap_options_t* opts, int* built) {
+    char cache_path[1024];
+    uint64_t key;
+    int width, height, channels;
+
+    if (built) *built = 0;
+    if (texture_cache_key(path, opts, &key) != 0) return NULL;
+    texture_cache_path(dir, key, cache_path, sizeof(cache_path));
+    texture_cache_file_t* file = texture_cache_open(cache_path, key);
+    if (file) return file;
+
+    /* A miss: decode and build as if there were no cache, then store it */
+    unsigned char* pixels = image_load(path, &width, &height, &channels);
+    if (!pixels) return NULL;
+    file = calloc(1, sizeof(texture_cache_file_t));
+    /* image_load pads rows to 4 bytes */
+    if (!file || mipmap_build(&file->chain, pixels, width, height,
+                              ((size_t)width * channels + 3) & ~(size_t)3, channels, opts) != 0) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        free(file);
+        free(pixels);
+        return NULL;
+    }
+    file->key = key;
+    file->pixels = pixels;
+    if (built) *built = 1;
+    if (make_dirs(dir) == 0) texture_cache_write(cache_path, &file->chain, key);
+    return file;
+}
@@ -0,0 +1,92 @@
+/*
+ * texture_cache.h - Mipmapped textures stored ready to upload
+ *
+ * Decoding an image and building its mipmaps is the same work on every
+ * launch. The cache does it once and keeps the result in a file that is
+ * mapped, not read: a level's bytes go from the page cache straight to
+ * glTexImage2D, with no decode and no copy.
+ *
+ *   texture_cache_file_t* file = texture_cache_load(dir, "wall.tga", &opts, NULL);
+ *   if (file) {
+ *       mipmap_upload(&file->chain);         (to the bound GL_TEXTURE_2D)
+ *       texture_cache_close(file);
+ *   }
+ *
+ * Files in 'dir' are named after a hash of the source file's bytes and
+ * the mipmap options, so an edited image or new options never find a
+ * stale entry, and the same image under two names is stored once.
+ *
+ * The file holds a header, then at TEXTURE_CACHE_ALIGN every level from
+ * the largest down, back to back, rows padded to 4 bytes as
+ * GL_UNPACK_ALIGNMENT expects. Numbers are in the writing machine's byte
+ * order; a file from the other order fails the header check and is
+ * rebuilt.
+ */
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mipmap.h"
+
+#define TEXTURE_CACHE_ALIGN 4096         /* Offset of the first level: a page */
+#define TEXTURE_CACHE_VERSION 1
+
+typedef struct {
+    mipmap_chain_t chain;        /* Levels point into the mapping */
+    uint64_t key;
+    void* map;                   /* NULL if the chain was built in memory */
+    size_t map_size;
+    unsigned char* pixels;       /* Decoded image the in-memory chain may point into */
+} texture_cache_file_t;
+
+/*
+ * texture_cache_hash - 64-bit hash of a block of bytes (XXH64)
+ */
+uint64_t texture_cache_hash(const void* data, size_t size, uint64_t seed);
+
+/*
+ * texture_cache_key - Hash of an image file's bytes and the options
+ *
+ * Returns 0, or -1 after printing why if the file cannot be read.
+ */
+int texture_cache_key(const char* path, const mipmap_options_t* opts, uint64_t* key);
+
+/*
+ * texture_cache_path - "dir/<key in hex>.mip"
+ */
+void texture_cache_path(const char* dir, uint64_t key, char* buf, size_t size);
+
+/*
+ * texture_cache_write - Store a chain under 'key'
+ *
+ * Written to a temporary file and renamed, so a reader never sees half a
+ * file. Returns 0, or -1 after printing why.
+ */
+int texture_cache_write(const char* path, const mipmap_chain_t* chain, uint64_t key);
+
+/*
+ * texture_cache_open - Map a cache file and check it holds 'key'
+ *
+ * Returns NULL, quietly, if the file is missing, was written for another
+ * key, or is damaged.
+ */
+texture_cache_file_t* texture_cache_open(const char* path, uint64_t key);
+
+void texture_cache_close(texture_cache_file_t* file);
+
+/*
+ * texture_cache_load - The mipmap chain for an image file, built only once
+ *
+ * @dir: Cache directory, created if missing
+ * @built: Set to 1 if the cache missed and the image was decoded, may be NULL
+ *
+ * Needs no GL context. Returns NULL after printing why if the image
+ * cannot be loaded; if only the cache cannot be written, the chain comes
+ * back anyway, in memory rather than mapped.
+ */
+texture_cache_file_t* texture_cache_load(const char* dir, const char* path,
+                                         const mipmap_options_t* opts, int* built);
+
+#endif /* TEXTURE_CACHE_H */
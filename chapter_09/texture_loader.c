@@ -0,0 +1,431 @@
+/*
+ * texture_loader.c - TGA, PPM and BMP image loading
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "texture_loader.h"
+
+/* ------------------------------------------------------------------------
+ * Chunked file reading
+ * ------------------------------------------------------------------------ */
+
+/*
+ * At least 'unit' bytes (one pixel) at the read position, topping the
+ * chunk up from the file if needed. *got is how many of the 'want' bytes
+ * can be used from the returned pointer, a whole number of units.
+ */
+static const unsigned char* take(image_reader_t* im, size_t want, size_t unit, size_t* got) {
+    size_t avail = im->chunk_len - im->chunk_pos;
+
+    if (avail < unit) {
+        memmove(im->chunk, im->chunk + im->chunk_pos, avail);
+        im->chunk_pos = 0;
+        im->chunk_len = avail + fread(im->chunk + avail, 1, IMAGE_CHUNK - avail, im->file);
+        avail = im->chunk_len;
+        if (avail < unit) return NULL;
+    }
+
+    if (want > avail) want = avail - avail % unit;
+    *got = want;
+    im->chunk_pos += want;
+    return im->chunk + im->chunk_pos - want;
+}
+
+static int read_bytes(image_reader_t* im, void* out, size_t size) {
+    unsigned char* dst = out;
+
+    while (size > 0) {
+        size_t got;
+        const unsigned char* src = take(im, size, 1, &got);
+        if (!src) return -1;
+        memcpy(dst, src, got);
+        dst += got;
+        size -= got;
+    }
+    return 0;
+}
+
+static int skip_bytes(image_reader_t* im, size_t size) {
+    while (size > 0) {
+        size_t got;
+        if (!take(im, size, 1, &got)) return -1;
+        size -= got;
+    }
+    return 0;
+}
+
+static unsigned le16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long le32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/* ------------------------------------------------------------------------
+ * Headers
+ * ------------------------------------------------------------------------ */
+
+/* Next PPM header number, skipping whitespace and # comments */
+static long ppm_number(image_reader_t* im) {
+    unsigned char c;
+    long value = 0;
+    int digits = 0;
+
+    do {
+        if (read_bytes(im, &c, 1) != 0) return -1;
+        if (c == '#') {
+            while (c != '\n') {
+                if (read_bytes(im, &c, 1) != 0) return -1;
+            }
+        }
+    } while (isspace(c));
+
+    while (isdigit(c) && digits < 9) {
+        value = value * 10 + (c - '0');
+        digits++;
+        /* The single whitespace after the last number ends the header */
+        if (read_bytes(im, &c, 1) != 0) return -1;
+    }
+    return digits > 0 && isspace(c) ? value : -1;
+}
+
+static int open_ppm(image_reader_t* im, const unsigned char* magic) {
+    long width, height, maxval;
+
+    skip_bytes(im, 2);
+    width = ppm_number(im);
+    height = ppm_number(im);
+    maxval = ppm_number(im);
+    if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535) {
+        fprintf(stderr, "%s: bad PPM header\n", im->path);
+        return -1;
+    }
+
+    im->format = IMAGE_PPM;
+    im->width = (int)width;
+    im->height = (int)height;
+    im->channels = magic[1] == '6' ? 3 : 1;
+    im->maxval = (int)maxval;
+    im->file_bytes = im->channels * (maxval > 255 ? 2 : 1);
+    im->top_down = 1;
+    return 0;
+}
+
+static int open_tga(image_reader_t* im) {
+    unsigned char h[18];
+
+    if (read_bytes(im, h, sizeof(h)) != 0) return -1;
+
+    int type = h[2], bits = h[16];
+    int color = (type == 2 || type == 10) && (bits == 24 || bits == 32);
+    int grey = (type == 3 || type == 11) && bits == 8;
+    if (h[1] > 1 || (!color && !grey)) {
+        fprintf(stderr, "%s: not a supported image (TGA must be 8-bit grey or "
+                "24/32-bit colour)\n", im->path);
+        return -1;
+    }
+    if (h[17] & 0x10) {
+        fprintf(stderr, "%s: right-to-left TGA files are not supported\n", im->path);
+        return -1;
+    }
+
+    /* Skip the image ID and any colour map a true-colour image carries */
+    size_t colormap = h[1] ? le16(h + 5) * (size_t)((h[7] + 7) / 8) : 0;
+    if (skip_bytes(im, h[0] + colormap) != 0) return -1;
+
+    im->format = IMAGE_TGA;
+    im->width = le16(h + 12);
+    im->height = le16(h + 14);
+    im->channels = bits / 8;
+    im->file_bytes = bits / 8;
+    im->top_down = (h[17] & 0x20) != 0;
+    im->rle = type >= 9;
+    return 0;
+}
+
+static int open_bmp(image_reader_t* im) {
+    unsigned char h[14 + 56];
+    size_t offset = 14;
+
+    if (read_bytes(im, h, 18) != 0) return -1;
+
+    unsigned long data_offset = le32(h + 10), info_size = le32(h + 14);
+    if (info_size < 40 || info_size > 124 ||
+        read_bytes(im, h + 18, (info_size < 56 ? info_size : 56) - 4) != 0) {
+        fprintf(stderr, "%s: unsupported BMP header\n", im->path);
+        return -1;
+    }
+    offset += info_size < 56 ? info_size : 56;
+
+    long width = (long)le32(h + 18), height = (long)le32(h + 22);
+    if (width & 0x80000000L) width -= 0x100000000L;
+    if (height & 0x80000000L) height -= 0x100000000L;
+    int bits = le16(h + 28);
+    unsigned long compression = le32(h + 30), colors = le32(h + 46);
+
+    im->format = IMAGE_BMP;
+    im->width = (int)width;
+    im->height = (int)(height < 0 ? -height : height);
+    im->top_down = height < 0;
+    im->file_bytes = bits / 8;
+    im->channels = 3;
+    im->row_padding = (int)((4 - (size_t)width * im->file_bytes % 4) % 4);
+
+    if (compression == 3 && bits == 32) {
+        /* Bit fields follow a 40-byte header, or are part of a larger one */
+        unsigned char masks[16];
+        if (info_size == 40) {
+            if (read_bytes(im, masks, 12) != 0) return -1;
+            memset(masks + 12, 0, 4);
+            offset += 12;
+        } else {
+            memcpy(masks, h + 54, info_size >= 56 ? 16 : 12);
+            if (info_size < 56) memset(masks + 12, 0, 4);
+        }
+        if (le32(masks) != 0x00FF0000UL || le32(masks + 4) != 0x0000FF00UL ||
+            le32(masks + 8) != 0x000000FFUL) {
+            fprintf(stderr, "%s: unsupported BMP bit fields\n", im->path);
+            return -1;
+        }
+        if (le32(masks + 12) == 0xFF000000UL) im->channels = 4;
+    } else if (compression != 0 || (bits != 8 && bits != 24 && bits != 32)) {
+        fprintf(stderr, "%s: only uncompressed 8, 24 and 32-bit BMP files are supported\n",
+                im->path);
+        return -1;
+    }
+
+    if (bits == 8) {
+        unsigned char entry[4];
+        if (colors == 0 || colors > 256) colors = 256;
+        if (skip_bytes(im, 14 + info_size - offset) != 0) return -1;
+        offset = 14 + info_size;
+        memset(im->palette, 0, sizeof(im->palette));
+        for (unsigned long i = 0; i < colors; i++) {
+            if (read_bytes(im, entry, 4) != 0) return -1;
+            im->palette[i][0] = entry[2];
+            im->palette[i][1] = entry[1];
+            im->palette[i][2] = entry[0];
+        }
+        offset += colors * 4;
+        im->has_palette = 1;
+    }
+
+    if (data_offset < offset || skip_bytes(im, data_offset - offset) != 0) {
+        fprintf(stderr, "%s: bad BMP pixel offset\n", im->path);
+        return -1;
+    }
+    return 0;
+}
+
+int image_open(image_reader_t* image, const char* path) {
+    image_reader_t* im = image;
+    unsigned char magic[2];
+
+    memset(im, 0, sizeof(*im));
+    im->path = path;
+    im->file = fopen(path, "rb");
+    if (!im->file) {
+        perror(path);
+        return -1;
+    }
+    im->chunk = malloc(IMAGE_CHUNK);
+    if (!im->chunk) {
+        image_close(im);
+        return -1;
+    }
+
+    /* Look at the first bytes without consuming them */
+    int ok = -1;
+    if (read_bytes(im, magic, 2) == 0) {
+        im->chunk_pos = 0;
+        if (magic[0] == 'P' && (magic[1] == '6' || magic[1] == '5')) {
+            ok = open_ppm(im, magic);
+        } else if (magic[0] == 'B' && magic[1] == 'M') {
+            ok = open_bmp(im);
+        } else {
+            ok = open_tga(im);
+        }
+    } else {
+        fprintf(stderr, "%s: empty file\n", path);
+    }
+    if (ok == 0 && (im->width <= 0 || im->height <= 0 || im->width > 65536 ||
+                    im->height > 65536)) {
+        fprintf(stderr, "%s: bad image size %dx%d\n", path, im->width, im->height);
+        ok = -1;
+    }
+    if (ok != 0) {
+        image_close(im);
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Pixels
+ * ------------------------------------------------------------------------ */
+
+/* Convert 'count' pixels from the file's layout to the output's */
+static void convert(const image_reader_t* im, const unsigned char* src, size_t count,
+                    unsigned char* dst) {
+    if (im->format == IMAGE_PPM) {
+        size_t samples = count * im->channels;
+        if (im->maxval == 255) {
+            memcpy(dst, src, samples);
+        } else if (im->maxval < 256) {
+            for (size_t i = 0; i < samples; i++) {
+                unsigned v = src[i] > im->maxval ? im->maxval : src[i];
+                dst[i] = (unsigned char)((v * 255 + im->maxval / 2) / im->maxval);
+            }
+        } else {
+            for (size_t i = 0; i < samples; i++) {
+                unsigned long v = (src[i * 2] << 8) | src[i * 2 + 1];
+                if (v > (unsigned long)im->maxval) v = im->maxval;
+                dst[i] = (unsigned char)((v * 255 + im->maxval / 2) / im->maxval);
+            }
+        }
+        return;
+    }
+
+    if (im->has_palette) {
+        for (size_t i = 0; i < count; i++) memcpy(dst + i * 3, im->palette[src[i]], 3);
+        return;
+    }
+
+    switch (im->file_bytes * 8 + im->channels) {
+    case 8 + 1:                  /* Grey */
+        memcpy(dst, src, count);
+        break;
+    case 24 + 3:                 /* BGR */
+        for (size_t i = 0; i < count; i++, src += 3, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+        break;
+    case 32 + 3:                 /* BGRX, the X unused */
+        for (size_t i = 0; i < count; i++, src += 4, dst += 3) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+        break;
+    case 32 + 4:                 /* BGRA */
+        for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = src[3];
+        }
+        break;
+    }
+}
+
+/* Read and convert 'count' stored pixels */
+static int read_pixels(image_reader_t* im, size_t count, unsigned char* dst) {
+    size_t unit = im->file_bytes;
+
+    while (count > 0) {
+        size_t got;
+        const unsigned char* src = take(im, count * unit, unit, &got);
+        if (!src) return -1;
+        convert(im, src, got / unit, dst);
+        dst += got / unit * im->channels;
+        count -= got / unit;
+    }
+    return 0;
+}
+
+/* TGA run-length packets, which may carry on from one row to the next */
+static int read_rle(image_reader_t* im, unsigned char* row) {
+    int x = 0, channels = im->channels;
+
+    while (x < im->width) {
+        if (im->rle_left == 0) {
+            unsigned char packet;
+            if (read_bytes(im, &packet, 1) != 0) return -1;
+            im->rle_left = (packet & 0x7F) + 1;
+            im->rle_repeat = packet & 0x80;
+            if (im->rle_repeat && read_pixels(im, 1, im->rle_pixel) != 0) return -1;
+        }
+
+        int n = im->width - x < im->rle_left ? im->width - x : im->rle_left;
+        unsigned char* dst = row + (size_t)x * channels;
+        if (im->rle_repeat) {
+            for (int i = 0; i < n; i++) memcpy(dst + i * channels, im->rle_pixel, channels);
+        } else if (read_pixels(im, n, dst) != 0) {
+            return -1;
+        }
+        x += n;
+        im->rle_left -= n;
+    }
+    return 0;
+}
+
+static int next_row_number(const image_reader_t* im) {
+    return im->top_down ? im->height - 1 - im->rows_read : im->rows_read;
+}
+
+static int decode_row(image_reader_t* im, unsigned char* row) {
+    if (im->rle) {
+        if (read_rle(im, row) != 0) return -1;
+    } else if (read_pixels(im, im->width, row) != 0 || skip_bytes(im, im->row_padding) != 0) {
+        return -1;
+    }
+    im->rows_read++;
+    return 0;
+}
+
+size_t image_stride(const image_reader_t* image, int alignment) {
+    size_t bytes = (size_t)image->width * image->channels;
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+int image_read_row(image_reader_t* image, unsigned char* row) {
+    if (image->rows_read >= image->height) return -1;
+
+    int y = next_row_number(image);
+    return decode_row(image, row) == 0 ? y : -1;
+}
+
+int image_decode(image_reader_t* image, unsigned char* pixels, size_t stride) {
+    while (image->rows_read < image->height) {
+        int y = next_row_number(image);
+        if (decode_row(image, pixels + (size_t)y * stride) != 0) {
+            fprintf(stderr, "%s: truncated or corrupt after %d of %d rows\n",
+                    image->path, image->rows_read, image->height);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void image_close(image_reader_t* image) {
+    if (image->file) fclose(image->file);
+    free(image->chunk);
+    image->file = NULL;
+    image->chunk = NULL;
+}
+
+unsigned char* image_load(const char* path, int* width, int* height, int* channels) {
+    image_reader_t image;
+
+    if (image_open(&image, path) != 0) return NULL;
+
+    size_t stride = image_stride(&image, 4);
+    unsigned char* pixels = malloc(stride * image.height);
+    if (!pixels) {
+        fprintf(stderr, "%s: out of memory for %dx%d pixels\n", path, image.width, image.height);
+    } else if (image_decode(&image, pixels, stride) != 0) {
+        free(pixels);
+        pixels = NULL;
+    } else {
+        *width = image.width;
+        *height = image.height;
+        *channels = image.channels;
+    }
+    image_close(&image);
+    return pixels;
+}
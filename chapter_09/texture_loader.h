@@ -0,0 +1,103 @@
+/*
+ * texture_loader.h - TGA, PPM and BMP image loading
+ *
+ * Decodes uncompressed and RLE TGA (8-bit grey, 24 and 32-bit colour),
+ * binary PPM/PGM (P6/P5) and uncompressed BMP (8-bit paletted, 24 and
+ * 32-bit). The file is read in IMAGE_CHUNK-sized pieces and decoded a row
+ * at a time, straight into the caller's memory, so a large image is never
+ * held twice.
+ *
+ * Rows come out in OpenGL's order, bottom row first, as RGB, RGBA or
+ * luminance bytes ready for glTexImage2D:
+ *
+ *   image_reader_t image;
+ *   if (image_open(&image, "wall.tga") == 0) {
+ *       size_t stride = image_stride(&image, 4);      (GL_UNPACK_ALIGNMENT)
+ *       unsigned char* pixels = malloc(stride * image.height);
+ *       image_decode(&image, pixels, stride);
+ *       image_close(&image);
+ *   }
+ *
+ * Files stored top row first (PPM, and some TGA and BMP files) are still
+ * read in file order; image_read_row says where each row belongs.
+ */
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define IMAGE_CHUNK 65536        /* Bytes read from the file at a time */
+
+typedef enum {
+    IMAGE_TGA,
+    IMAGE_PPM,
+    IMAGE_BMP
+} image_format_t;
+
+typedef struct {
+    int width, height;
+    int channels;                /* 1 (luminance), 3 (RGB) or 4 (RGBA) */
+    image_format_t format;
+
+    /* Decoder state */
+    FILE* file;
+    const char* path;
+    unsigned char* chunk;        /* IMAGE_CHUNK bytes */
+    size_t chunk_pos, chunk_len;
+    int rows_read;
+    int top_down;                /* File stores the top row first */
+    int file_bytes;              /* Bytes per pixel in the file */
+    int rle;                     /* TGA run-length packets */
+    int rle_left, rle_repeat;    /* Pixels left in the current packet */
+    unsigned char rle_pixel[4];
+    int maxval;                  /* PPM samples run 0..maxval, 16-bit if > 255 */
+    int row_padding;             /* BMP rows are padded to 4 bytes */
+    int has_palette;             /* 8-bit BMP: indices into palette */
+    unsigned char palette[256][3];
+} image_reader_t;
+
+/*
+ * image_open - Open an image and read its header
+ *
+ * The format is told from the file's contents, not its name. Returns 0,
+ * or -1 after printing why to stderr.
+ */
+int image_open(image_reader_t* image, const char* path);
+
+/*
+ * image_stride - Bytes per decoded row, padded to 'alignment' (1, 2, 4, 8)
+ */
+size_t image_stride(const image_reader_t* image, int alignment);
+
+/*
+ * image_read_row - Decode the next row in the file
+ *
+ * @row: width * channels bytes
+ *
+ * Returns the row's number counting up from the bottom of the image, or
+ * -1 once every row has been read or if the file is truncated or corrupt.
+ */
+int image_read_row(image_reader_t* image, unsigned char* row);
+
+/*
+ * image_decode - Decode the remaining rows into one buffer
+ *
+ * @pixels: height rows of 'stride' bytes, bottom row first
+ *
+ * Returns 0, or -1 after printing why to stderr.
+ */
+int image_decode(image_reader_t* image, unsigned char* pixels, size_t stride);
+
+void image_close(image_reader_t* image);
+
+/*
+ * image_load - Open, decode and close in one go
+ *
+ * Rows are padded to 4 bytes, OpenGL's default GL_UNPACK_ALIGNMENT.
+ * Returns the pixels (free() them), or NULL after printing why to stderr.
+ */
+unsigned char* image_load(const char* path, int* width, int* height, int* channels);
+
+#endif /* TEXTURE_LOADER_H */
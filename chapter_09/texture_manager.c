@@ -0,0 +1,324 @@
+/*
+ * texture_manager.c - Texture memory budget with least-recently-used eviction
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "texture_loader.h"
+#include "texture_manager.h"
+#include "timing.h"
+
+typedef struct {
+    char* path;
+    mipmap_options_t opts;
+} file_source_t;
+
+typedef struct {
+    int refs;                    /* 0 for a free slot */
+    texture_build_fn build;
+    void* ctx;
+    file_source_t* file;         /* Owned, for texture_manager_load */
+    GLuint texture;              /* 0 while not resident */
+    size_t bytes;
+    unsigned last_frame;
+    int prev, next;              /* Resident list, least recently used first */
+} managed_t;
+
+struct texture_manager {
+    managed_t* items;
+    int count;
+    int lru_head, lru_tail;
+    unsigned frame;
+    size_t budget, bytes, peak_bytes;
+    int used_this_frame, loads_this_frame, evictions_this_frame;
+    int loads, evictions;
+    double load_ms;
+
+    /* Scratch for glPrioritizeTextures and glAreTexturesResident */
+    GLuint* names;
+    GLclampf* priorities;
+    GLboolean* residences;
+    int scratch_size;
+};
+
+texture_manager_t* texture_manager_create(size_t budget) {
+    texture_manager_t* tm = calloc(1, sizeof(texture_manager_t));
+    if (!tm) return NULL;
+    tm->budget = budget;
+    tm->lru_head = tm->lru_tail = -1;
+    tm->frame = 1;
+    return tm;
+}
+
+static void lru_unlink(texture_manager_t* tm, int id) {
+    managed_t* m = &tm->items[id];
+    if (m->prev >= 0) tm->items[m->prev].next = m->next;
+    else tm->lru_head = m->next;
+    if (m->next >= 0) tm->items[m->next].prev = m->prev;
+    else tm->lru_tail = m->prev;
+    m->prev = m->next = -1;
+}
+
+static void lru_append(texture_manager_t* tm, int id) {
+    managed_t* m = &tm->items[id];
+    m->prev = tm->lru_tail;
+    m->next = -1;
+    if (tm->lru_tail >= 0) tm->items[tm->lru_tail].next = id;
+    else tm->lru_head = id;
+    tm->lru_tail = id;
+}
+
+static void evict(texture_manager_t* tm, int id) {
+    managed_t* m = &tm->items[id];
+    if (!m->texture) return;
+    lru_unlink(tm, id);
+    glDeleteTextures(1, &m->texture);
+    m->texture = 0;
+    tm->bytes -= m->bytes;
+    m->bytes = 0;
+}
+
+/* Oldest first, stopping at the textures this frame has used */
+static void evict_to_budget(texture_manager_t* tm) {
+    while (tm->budget > 0 && tm->bytes > tm->budget && tm->lru_head >= 0 &&
+           tm->items[tm->lru_head].last_frame != tm->frame) {
+        evict(tm, tm->lru_head);
+        tm->evictions++;
+        tm->evictions_this_frame++;
+    }
+}
+
+void texture_manager_destroy(texture_manager_t* tm) {
+    if (!tm) return;
+    for (int i = 0; i < tm->count; i++) {
+        if (tm->items[i].texture) glDeleteTextures(1, &tm->items[i].texture);
+        if (tm->items[i].file) free(tm->items[i].file->path);
+        free(tm->items[i].file);
+    }
+    free(tm->items);
+    free(tm->names);
+    free(tm->priorities);
+    free(tm->residences);
+    free(tm);
+}
+
+void texture_manager_set_budget(texture_manager_t* tm, size_t budget) {
+    tm->budget = budget;
+    evict_to_budget(tm);
+}
+
+int texture_manager_add(texture_manager_t* tm, texture_build_fn build, void* ctx) {
+    int id = 0;
+
+    while (id < tm->count && tm->items[id].refs > 0) id++;
+    if (id == tm->count) {
+        managed_t* items = realloc(tm->items, (tm->count + 1) * sizeof(managed_t));
+        if (!items) return -1;
+        tm->items = items;
+        tm->count++;
+    }
+    memset(&tm->items[id], 0, sizeof(managed_t));
+    tm->items[id].refs = 1;
+    tm->items[id].build = build;
+    tm->items[id].ctx = ctx;
+    tm->items[id].prev = tm->items[id].next = -1;
+    return id;
+}
+
+static int build_from_file(void* ctx) {
+    const file_source_t* file = ctx;
+    int width, height, channels;
+    mipmap_chain_t chain;
+    unsigned char* pixels = image_load(file->path, &width, &height, &channels);
+
+    if (!pixels) return -1;
+    int result = mipmap_build(&chain, pixels, width, height,
+                              ((size_t)width * channels + 3) & ~(size_t)3, channels, &file->opts);
+    if (result == 0) {
+        mipmap_upload(&chain);
+        mipmap_free(&chain);
+    }
+    free(pixels);
+    return result;
+}
+
+int texture_manager_load(texture_manager_t* tm, const char* path, const mipmap_options_t* opts) {
+    file_source_t* file = malloc(sizeof(file_source_t));
+    int id = -1;
+
+    if (file && (file->path = malloc(strlen(path) + 1)) != NULL) {
+        strcpy(file->path, path);
+        file->opts = *opts;
+        id = texture_manager_add(tm, build_from_file, file);
+        if (id >= 0) {
+            tm->items[id].file = file;
+            return id;
+        }
+        free(file->path);
+    }
+    free(file);
+    return id;
+}
+
+void texture_manager_retain(texture_manager_t* tm, int id) {
+    if (id >= 0 && id < tm->count && tm->items[id].refs > 0) tm->items[id].refs++;
+}
+
+void texture_manager_release(texture_manager_t* tm, int id) {
+    if (id < 0 || id >= tm->count || tm->items[id].refs <= 0) return;
+    managed_t* m = &tm->items[id];
+
+    if (--m->refs > 0) return;
+    evict(tm, id);
+    if (m->file) free(m->file->path);
+    free(m->file);
+    m->file = NULL;
+}
+
+void texture_manager_invalidate(texture_manager_t* tm, int id) {
+    if (id >= 0 && id < tm->count && tm->items[id].refs > 0) evict(tm, id);
+}
+
+/* Bytes of every defined level, as the driver stores them */
+static size_t texture_bytes(void) {
+    static const GLenum sizes[] = {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE,
+                                   GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                                   GL_TEXTURE_LUMINANCE_SIZE, GL_TEXTURE_INTENSITY_SIZE};
+    GLint bits = 0, width = 0, height = 0;
+    size_t texels = 0;
+    int levels = 1;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        GLint b = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, sizes[i], &b);
+        bits += b;
+    }
+    /* A level past the last a texture can have is GL_INVALID_VALUE and leaves
+     * the outputs alone, so stop at floor(log2(size)) + 1 and clear them */
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    for (GLint n = width > height ? width : height; n > 1; n /= 2) levels++;
+    for (int level = 0; level < levels; level++) {
+        width = height = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width <= 0 || height <= 0) break;
+        texels += (size_t)width * height;
+    }
+    return texels * ((bits + 7) / 8);
+}
+
+static int make_resident(texture_manager_t* tm, int id) {
+    managed_t* m = &tm->items[id];
+    double start = timing_seconds();
+
+    glGenTextures(1, &m->texture);
+    glBindTexture(GL_TEXTURE_2D, m->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (m->build(m->ctx) != 0) {
+        glDeleteTextures(1, &m->texture);
+        m->texture = 0;
+        return -1;
+    }
+    m->bytes = texture_bytes();
+    tm->bytes += m->bytes;
+    if (tm->bytes > tm->peak_bytes) tm->peak_bytes = tm->bytes;
+    tm->loads++;
+    tm->loads_this_frame++;
+    tm->load_ms += (timing_seconds() - start) * 1000.0;
+    lru_append(tm, id);
+    return 0;
+}
+
+GLuint texture_manager_use(texture_manager_t* tm, int id) {
+    if (id < 0 || id >= tm->count || tm->items[id].refs <= 0) return 0;
+    managed_t* m = &tm->items[id];
+
+    if (!m->texture) {
+        if (make_resident(tm, id) != 0) return 0;
+    } else if (tm->lru_tail != id) {
+        lru_unlink(tm, id);
+        lru_append(tm, id);
+    }
+    if (m->last_frame != tm->frame) {
+        m->last_frame = tm->frame;
+        tm->used_this_frame++;
+    }
+    evict_to_budget(tm);
+    return m->texture;
+}
+
+static int grow_scratch(texture_manager_t* tm, int n) {
+    if (n <= tm->scratch_size) return 0;
+    GLuint* names = realloc(tm->names, n * sizeof(GLuint));
+    if (names) tm->names = names;
+    GLclampf* priorities = realloc(tm->priorities, n * sizeof(GLclampf));
+    if (priorities) tm->priorities = priorities;
+    GLboolean* residences = realloc(tm->residences, n * sizeof(GLboolean));
+    if (residences) tm->residences = residences;
+    if (!names || !priorities || !residences) return -1;
+    tm->scratch_size = n;
+    return 0;
+}
+
+void texture_manager_begin_frame(texture_manager_t* tm) {
+    int n = 0;
+
+    tm->frame++;
+    tm->used_this_frame = tm->loads_this_frame = tm->evictions_this_frame = 0;
+    evict_to_budget(tm);
+
+    /* Priority falls off with frames since last use: 1, 1/2, 1/3... */
+    for (int id = tm->lru_head; id >= 0; id = tm->items[id].next) n++;
+    if (n == 0 || grow_scratch(tm, n) != 0) return;
+    n = 0;
+    for (int id = tm->lru_head; id >= 0; id = tm->items[id].next) {
+        tm->names[n] = tm->items[id].texture;
+        tm->priorities[n++] = 1.0f / (float)(tm->frame - tm->items[id].last_frame);
+    }
+    glPrioritizeTextures(n, tm->names, tm->priorities);
+}
+
+void texture_manager_stats(texture_manager_t* tm, texture_manager_stats_t* stats, int query_driver) {
+    int n = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < tm->count; i++) {
+        if (tm->items[i].refs > 0) stats->textures++;
+    }
+    for (int id = tm->lru_head; id >= 0; id = tm->items[id].next) n++;
+    stats->resident = n;
+    stats->driver_resident = -1;
+    if (query_driver && n > 0 && grow_scratch(tm, n) == 0) {
+        n = 0;
+        for (int id = tm->lru_head; id >= 0; id = tm->items[id].next) {
+            tm->names[n++] = tm->items[id].texture;
+        }
+        if (glAreTexturesResident(n, tm->names, tm->residences)) {
+            stats->driver_resident = n;
+        } else {
+            stats->driver_resident = 0;
+            for (int i = 0; i < n; i++) stats->driver_resident += tm->residences[i] == GL_TRUE;
+        }
+    }
+    stats->used_this_frame = tm->used_this_frame;
+    stats->bytes = tm->bytes;
+    stats->peak_bytes = tm->peak_bytes;
+    stats->budget = tm->budget;
+    stats->loads_this_frame = tm->loads_this_frame;
+    stats->evictions_this_frame = tm->evictions_this_frame;
+    stats->loads = tm->loads;
+    stats->evictions = tm->evictions;
+    stats->load_ms = tm->load_ms;
+}
+
+void texture_manager_format_stats(const texture_manager_stats_t* stats, char* buf, size_t size) {
+    char budget[32] = "no limit";
+
+    if (stats->budget > 0) snprintf(budget, sizeof(budget), "%.1f MB", stats->budget / 1048576.0);
+    snprintf(buf, size, "Textures: %d of %d resident, %.1f MB of %s, +%d -%d this frame",
+             stats->resident, stats->textures, stats->bytes / 1048576.0, budget,
+             stats->loads_this_frame, stats->evictions_this_frame);
+}
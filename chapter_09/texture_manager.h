@@ -0,0 +1,115 @@
+/*
+ * texture_manager.h - Texture memory budget with least-recently-used eviction
+ *
+ * glGenTextures never says no: past the card's memory the driver starts
+ * paging textures over the bus every frame, and frame times fall off a
+ * cliff. The manager counts the bytes of every texture it owns, mipmap
+ * levels included, and keeps the total under a budget by deleting the
+ * textures that have gone longest without being drawn. A texture that is
+ * still referenced is rebuilt the next time it is used:
+ *
+ *   texture_manager_t* tm = texture_manager_create(64 << 20);
+ *   int wall = texture_manager_load(tm, "wall.tga", &opts);
+ *
+ *   Every frame:
+ *   texture_manager_begin_frame(tm);
+ *   glBindTexture(GL_TEXTURE_2D, texture_manager_use(tm, wall));
+ *
+ * Textures used in the current frame are never evicted, so a frame that
+ * needs more than the budget goes over it rather than thrashing. The
+ * manager also passes recency to glPrioritizeTextures, a hint drivers
+ * with their own paging may use to pick what leaves video memory first.
+ */
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <GL/glut.h>
+#include <stddef.h>
+#include "mipmap.h"
+
+typedef struct texture_manager texture_manager_t;
+
+/*
+ * Uploads a texture into the bound GL_TEXTURE_2D, every mipmap level it
+ * needs; called on first use and again after each eviction. Filters
+ * default to GL_LINEAR_MIPMAP_LINEAR / GL_LINEAR. Returns 0, or -1 on failure.
+ */
+typedef int (*texture_build_fn)(void* ctx);
+
+typedef struct {
+    int textures;                /* Referenced */
+    int resident;                /* Built, so holding memory */
+    int driver_resident;         /* Of those, in video memory per glAreTexturesResident */
+    int used_this_frame;
+    size_t bytes, peak_bytes, budget;
+    int loads_this_frame, evictions_this_frame;
+    int loads, evictions;        /* Since creation */
+    double load_ms;              /* Time spent in build callbacks */
+} texture_manager_stats_t;
+
+/*
+ * texture_manager_create - An empty manager
+ *
+ * @budget: Bytes of texture memory to stay under, 0 for no limit
+ */
+texture_manager_t* texture_manager_create(size_t budget);
+
+/* Deletes every texture; call with the GL context current */
+void texture_manager_destroy(texture_manager_t* tm);
+
+void texture_manager_set_budget(texture_manager_t* tm, size_t budget);
+
+/*
+ * texture_manager_add - Register a texture built by a callback
+ *
+ * Nothing is built until the first texture_manager_use. Returns an id
+ * with one reference, or -1 if out of memory.
+ */
+int texture_manager_add(texture_manager_t* tm, texture_build_fn build, void* ctx);
+
+/*
+ * texture_manager_load - Register a TGA, PPM or BMP file, mipmapped with 'opts'
+ */
+int texture_manager_load(texture_manager_t* tm, const char* path, const mipmap_options_t* opts);
+
+void texture_manager_retain(texture_manager_t* tm, int id);
+
+/* Drops a reference; the last one deletes the texture and frees the id */
+void texture_manager_release(texture_manager_t* tm, int id);
+
+/*
+ * texture_manager_invalidate - Delete the texture so the next use rebuilds it
+ */
+void texture_manager_invalidate(texture_manager_t* tm, int id);
+
+/*
+ * texture_manager_begin_frame - Start a frame
+ *
+ * Evicts down to the budget and updates glPrioritizeTextures.
+ */
+void texture_manager_begin_frame(texture_manager_t* tm);
+
+/*
+ * texture_manager_use - The texture for 'id', built if need be
+ *
+ * Marks it used this frame. Returns 0 if it could not be built. Leaves
+ * the texture bound if it had to be built.
+ */
+GLuint texture_manager_use(texture_manager_t* tm, int id);
+
+/*
+ * texture_manager_stats - Counters for a debug overlay
+ *
+ * driver_resident calls glAreTexturesResident, which may be slow, so it
+ * is only filled in when 'query_driver' is set (else -1).
+ */
+void texture_manager_stats(texture_manager_t* tm, texture_manager_stats_t* stats, int query_driver);
+
+/*
+ * texture_manager_format_stats - One line for an overlay, e.g.
+ * "Textures: 48 of 256 resident, 16.0 MB of 16.0 MB, +2 -2 this frame"
+ */
+void texture_manager_format_stats(const texture_manager_stats_t* stats, char* buf, size_t size);
+
+#endif /* TEXTURE_MANAGER_H */
@@ -0,0 +1,408 @@
+/*
+ * texture_streamer.c - Texture files loaded in the background
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+#define PLACEHOLDER_SIZE 8
+#define STRIP_BYTES (256 * 1024)   /* Uploaded between checks of the budget */
+#define WORKER_NICE 10
+
+typedef struct job {
+    struct job* next;
+    int handle;
+    unsigned generation;         /* Slot's generation when queued */
+    char* path;
+    char* cache_dir;             /* A copy of the streamer's, or NULL */
+    mipmap_options_t opts;
+    unsigned char* pixels;       /* Level 0 as decoded; the chain may point into it */
+    texture_cache_file_t* cached; /* Owns the chain instead, if set */
+    mipmap_chain_t chain;
+    int failed;
+} job_t;
+
+typedef struct {
+    int used;
+    unsigned generation;         /* Bumped on release, so stale jobs are dropped */
+    texture_state_t state;
+    GLuint texture;              /* 0 until ready */
+} slot_t;
+
+struct texture_streamer {
+    pthread_t* workers;
+    int worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    job_t* queue_head;           /* Waiting for a worker */
+    job_t* queue_tail;
+    job_t* done_head;            /* Decoded, waiting for the GL thread */
+    job_t* done_tail;
+    int shutdown;
+    double decode_ms;
+    char* cache_dir;
+
+    /* GL thread only */
+    GLuint placeholder;
+    slot_t* slots;
+    int slot_count;
+    job_t* uploading;            /* Being uploaded, a strip at a time */
+    GLuint upload_texture;
+    int upload_level, upload_row;
+    int ready, failed;
+    double upload_ms;
+    size_t bytes_uploaded;
+};
+
+static void push(job_t** head, job_t** tail, job_t* job) {
+    job->next = NULL;
+    if (*tail) (*tail)->next = job;
+    else *head = job;
+    *tail = job;
+}
+
+static job_t* pop(job_t** head, job_t** tail) {
+    job_t* job = *head;
+    if (job) {
+        *head = job->next;
+        if (!*head) *tail = NULL;
+    }
+    return job;
+}
+
+static void free_job(job_t* job) {
+    if (job->cached) texture_cache_close(job->cached);
+    else if (job->chain.pixels) mipmap_free(&job->chain);
+    free(job->pixels);
+    free(job->path);
+    free(job->cache_dir);
+    free(job);
+}
+
+/* Everything that does not need the GL context */
+static void decode_job(job_t* job) {
+    int width, height, channels;
+
+    if (job->cache_dir) {
+        job->cached = texture_cache_load(job->cache_dir, job->path, &job->opts, NULL);
+        if (job->cached) job->chain = job->cached->chain;
+        else job->failed = 1;
+        return;
+    }
+    job->pixels = image_load(job->path, &width, &height, &channels);
+    if (!job->pixels) {
+        job->failed = 1;
+        return;
+    }
+    /* image_load pads rows to 4 bytes */
+    size_t stride = ((size_t)width * channels + 3) & ~(size_t)3;
+    if (mipmap_build(&job->chain, job->pixels, width, height, stride, channels, &job->opts) != 0) {
+        job->failed = 1;
+    }
+}
+
+static void* worker_main(void* arg) {
+    texture_streamer_t* ts = arg;
+
+#ifdef __linux__
+    /* Each Linux thread has its own nice value. Lowering the workers' keeps
+     * frames smooth when there are fewer cores than threads. */
+    setpriority(PRIO_PROCESS, 0, WORKER_NICE);
+#endif
+    pthread_mutex_lock(&ts->lock);
+    for (;;) {
+        while (!ts->shutdown && !ts->queue_head) {
+            pthread_cond_wait(&ts->work_ready, &ts->lock);
+        }
+        if (ts->shutdown) break;
+        job_t* job = pop(&ts->queue_head, &ts->queue_tail);
+        pthread_mutex_unlock(&ts->lock);
+
+        double start = timing_seconds();
+        decode_job(job);
+        double ms = (timing_seconds() - start) * 1000.0;
+
+        pthread_mutex_lock(&ts->lock);
+        ts->decode_ms += ms;
+        push(&ts->done_head, &ts->done_tail, job);
+    }
+    pthread_mutex_unlock(&ts->lock);
+    return NULL;
+}
+
+static void set_params(void) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/* Grey checkerboard, mipmapped so any filter mode finds a complete texture */
+static GLuint make_placeholder(void) {
+    unsigned char pixels[PLACEHOLDER_SIZE * PLACEHOLDER_SIZE * 3];
+    mipmap_options_t opts;
+    mipmap_chain_t chain;
+    GLuint texture = 0;
+    GLint bound;
+
+    for (int y = 0; y < PLACEHOLDER_SIZE; y++) {
+        for (int x = 0; x < PLACEHOLDER_SIZE; x++) {
+            unsigned char v = ((x / 2) + (y / 2)) % 2 ? 160 : 96;
+            memset(pixels + (y * PLACEHOLDER_SIZE + x) * 3, v, 3);
+        }
+    }
+    mipmap_options_defaults(&opts);
+    if (mipmap_build(&chain, pixels, PLACEHOLDER_SIZE, PLACEHOLDER_SIZE,
+                     PLACEHOLDER_SIZE * 3, 3, &opts) != 0) {
+        return 0;
+    }
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    mipmap_upload(&chain);
+    set_params();
+    glBindTexture(GL_TEXTURE_2D, (GLuint)bound);
+    mipmap_free(&chain);
+    return texture;
+}
+
+texture_streamer_t* texture_streamer_create(int threads) {
+    texture_streamer_t* ts = calloc(1, sizeof(texture_streamer_t));
+    if (!ts) return NULL;
+
+    if (threads <= 0) threads = thread_pool_cpu_count();
+    pthread_mutex_init(&ts->lock, NULL);
+    pthread_cond_init(&ts->work_ready, NULL);
+    ts->placeholder = make_placeholder();
+    ts->workers = malloc(threads * sizeof(pthread_t));
+    if (!ts->placeholder || !ts->workers) {
+        texture_streamer_destroy(ts);
+        return NULL;
+    }
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&ts->workers[i], NULL, worker_main, ts) != 0) break;
+        ts->worker_count++;
+    }
+    if (ts->worker_count == 0) {
+        texture_streamer_destroy(ts);
+        return NULL;
+    }
+    return ts;
+}
+
+void texture_streamer_destroy(texture_streamer_t* ts) {
+    if (!ts) return;
+
+    pthread_mutex_lock(&ts->lock);
+    ts->shutdown = 1;
+    pthread_cond_broadcast(&ts->work_ready);
+    pthread_mutex_unlock(&ts->lock);
+    for (int i = 0; i < ts->worker_count; i++) {
+        pthread_join(ts->workers[i], NULL);
+    }
+
+    job_t* job;
+    while ((job = pop(&ts->queue_head, &ts->queue_tail)) != NULL) free_job(job);
+    while ((job = pop(&ts->done_head, &ts->done_tail)) != NULL) free_job(job);
+    if (ts->uploading) {
+        glDeleteTextures(1, &ts->upload_texture);
+        free_job(ts->uploading);
+    }
+    for (int i = 0; i < ts->slot_count; i++) {
+        if (ts->slots[i].texture) glDeleteTextures(1, &ts->slots[i].texture);
+    }
+    if (ts->placeholder) glDeleteTextures(1, &ts->placeholder);
+
+    pthread_cond_destroy(&ts->work_ready);
+    pthread_mutex_destroy(&ts->lock);
+    free(ts->workers);
+    free(ts->slots);
+    free(ts->cache_dir);
+    free(ts);
+}
+
+int texture_streamer_set_cache(texture_streamer_t* ts, const char* dir) {
+    char* copy = NULL;
+
+    if (dir && !(copy = malloc(strlen(dir) + 1))) return -1;
+    if (copy) strcpy(copy, dir);
+    free(ts->cache_dir);
+    ts->cache_dir = copy;
+    return 0;
+}
+
+int texture_streamer_load(texture_streamer_t* ts, const char* path, const mipmap_options_t* opts) {
+    int handle = 0;
+
+    while (handle < ts->slot_count && ts->slots[handle].used) handle++;
+    if (handle == ts->slot_count) {
+        int count = ts->slot_count ? ts->slot_count * 2 : 16;
+        slot_t* slots = realloc(ts->slots, count * sizeof(slot_t));
+        if (!slots) return -1;
+        memset(slots + ts->slot_count, 0, (count - ts->slot_count) * sizeof(slot_t));
+        ts->slots = slots;
+        ts->slot_count = count;
+    }
+
+    /* The job keeps its own copy of the cache directory, which
+     * texture_streamer_set_cache may free while the job is queued */
+    job_t* job = calloc(1, sizeof(job_t));
+    if (!job || !(job->path = malloc(strlen(path) + 1)) ||
+        (ts->cache_dir && !(job->cache_dir = malloc(strlen(ts->cache_dir) + 1)))) {
+        if (job) free(job->path);
+        free(job);
+        return -1;
+    }
+    strcpy(job->path, path);
+    if (job->cache_dir) strcpy(job->cache_dir, ts->cache_dir);
+    job->opts = *opts;
+    job->handle = handle;
+    job->generation = ts->slots[handle].generation;
+    ts->slots[handle].used = 1;
+    ts->slots[handle].state = TEXTURE_LOADING;
+
+    pthread_mutex_lock(&ts->lock);
+    push(&ts->queue_head, &ts->queue_tail, job);
+    pthread_cond_signal(&ts->work_ready);
+    pthread_mutex_unlock(&ts->lock);
+    return handle;
+}
+
+void texture_streamer_release(texture_streamer_t* ts, int handle) {
+    if (handle < 0 || handle >= ts->slot_count || !ts->slots[handle].used) return;
+    slot_t* slot = &ts->slots[handle];
+
+    if (slot->texture) glDeleteTextures(1, &slot->texture);
+    if (ts->uploading && ts->uploading->handle == handle) {
+        glDeleteTextures(1, &ts->upload_texture);
+        free_job(ts->uploading);
+        ts->uploading = NULL;
+    }
+    /* A job still queued or decoding finds the generation changed and is dropped */
+    slot->generation++;
+    slot->used = 0;
+    slot->texture = 0;
+}
+
+/* Claim the next decoded image, dropping released ones; NULL if none */
+static job_t* next_upload(texture_streamer_t* ts) {
+    for (;;) {
+        pthread_mutex_lock(&ts->lock);
+        job_t* job = pop(&ts->done_head, &ts->done_tail);
+        pthread_mutex_unlock(&ts->lock);
+        if (!job) return NULL;
+
+        slot_t* slot = &ts->slots[job->handle];
+        if (!slot->used || slot->generation != job->generation) {
+            free_job(job);
+        } else if (job->failed) {
+            slot->state = TEXTURE_FAILED;
+            ts->failed++;
+            free_job(job);
+        } else {
+            return job;
+        }
+    }
+}
+
+/* Upload one strip of rows; returns 1 once the whole chain is in */
+static int upload_strip(texture_streamer_t* ts) {
+    static const GLenum formats[] = {0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA};
+    const mipmap_chain_t* chain = &ts->uploading->chain;
+    GLenum format = formats[chain->channels];
+    int level = ts->upload_level, row = ts->upload_row;
+    int width = chain->width[level], height = chain->height[level];
+    size_t stride = chain->stride[level];
+    int rows = (int)(STRIP_BYTES / stride);
+
+    if (rows < 1) rows = 1;
+    if (rows > height - row) rows = height - row;
+    if (row == 0) {
+        /* Allocate each level as it is reached, spreading that cost too */
+        glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format,
+                     GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, row, width, rows, format, GL_UNSIGNED_BYTE,
+                    chain->level[level] + row * stride);
+    ts->bytes_uploaded += rows * stride;
+
+    ts->upload_row += rows;
+    if (ts->upload_row < height) return 0;
+    ts->upload_row = 0;
+    return ++ts->upload_level == chain->levels;
+}
+
+int texture_streamer_update(texture_streamer_t* ts, double budget_ms) {
+    double start = timing_seconds();
+    double deadline = start + budget_ms / 1000.0;
+    int finished = 0;
+    GLint bound;
+
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+
+    do {
+        if (!ts->uploading) {
+            if (!(ts->uploading = next_upload(ts))) break;
+            glGenTextures(1, &ts->upload_texture);
+            glBindTexture(GL_TEXTURE_2D, ts->upload_texture);
+            set_params();
+            ts->upload_level = ts->upload_row = 0;
+        } else {
+            glBindTexture(GL_TEXTURE_2D, ts->upload_texture);
+        }
+
+        if (upload_strip(ts)) {
+            /* Complete: from now on the handle draws with it */
+            slot_t* slot = &ts->slots[ts->uploading->handle];
+            slot->texture = ts->upload_texture;
+            slot->state = TEXTURE_READY;
+            ts->ready++;
+            finished++;
+            free_job(ts->uploading);
+            ts->uploading = NULL;
+        }
+    } while (timing_seconds() < deadline);
+
+    glPopClientAttrib();
+    glBindTexture(GL_TEXTURE_2D, (GLuint)bound);
+    ts->upload_ms += (timing_seconds() - start) * 1000.0;
+    return finished;
+}
+
+GLuint texture_streamer_texture(const texture_streamer_t* ts, int handle) {
+    if (handle < 0 || handle >= ts->slot_count || !ts->slots[handle].texture) {
+        return ts->placeholder;
+    }
+    return ts->slots[handle].texture;
+}
+
+texture_state_t texture_streamer_state(const texture_streamer_t* ts, int handle) {
+    if (handle < 0 || handle >= ts->slot_count || !ts->slots[handle].used) return TEXTURE_FAILED;
+    return ts->slots[handle].state;
+}
+
+void texture_streamer_stats(texture_streamer_t* ts, texture_streamer_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < ts->slot_count; i++) {
+        if (ts->slots[i].used && ts->slots[i].state == TEXTURE_LOADING) stats->loading++;
+    }
+    stats->ready = ts->ready;
+    stats->failed = ts->failed;
+    pthread_mutex_lock(&ts->lock);
+    stats->decode_ms = ts->decode_ms;
+    pthread_mutex_unlock(&ts->lock);
+    stats->upload_ms = ts->upload_ms;
+    stats->bytes_uploaded = ts->bytes_uploaded;
+}
@@ -0,0 +1,115 @@
+/*
+ * texture_streamer.h - Texture files loaded in the background
+ *
+ * Decoding an image and building its mipmaps takes far longer than
+ * uploading it, and neither needs the GL context. The streamer does both
+ * on worker threads, so a program can start drawing at once:
+ *
+ *   texture_streamer_t* ts = texture_streamer_create(0);
+ *   int brick = texture_streamer_load(ts, "brick.tga", &opts);
+ *
+ *   Every frame:
+ *   texture_streamer_update(ts, 2.0);             (upload for up to 2 ms)
+ *   glBindTexture(GL_TEXTURE_2D, texture_streamer_texture(ts, brick));
+ *
+ * Until a texture has been uploaded, texture_streamer_texture returns a
+ * small grey checkerboard placeholder, so drawing code never waits and
+ * never binds an empty texture.
+ *
+ * Uploads happen only in texture_streamer_update, on the GL thread, in
+ * strips of rows. A 4096x4096 texture is spread over as many frames as
+ * the budget needs, into a texture that is not drawn until it is
+ * complete. Only allocating a level (glTexImage2D) cannot be split: on
+ * llvmpipe a 2048x2048 level takes about 10 ms, so the frame that starts
+ * one runs over budget.
+ *
+ * On Linux the workers run at a lower priority, so on a machine with
+ * fewer cores than threads they take the time the GL thread leaves.
+ */
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <GL/glut.h>
+#include "mipmap.h"
+
+typedef struct texture_streamer texture_streamer_t;
+
+typedef enum {
+    TEXTURE_LOADING,             /* Queued, decoding or uploading */
+    TEXTURE_READY,
+    TEXTURE_FAILED               /* Could not be read; the placeholder stays */
+} texture_state_t;
+
+typedef struct {
+    int loading;                 /* Textures not yet ready or failed */
+    int ready, failed;
+    double decode_ms;            /* Worker time decoding and building mipmaps */
+    double upload_ms;            /* GL thread time uploading */
+    size_t bytes_uploaded;
+} texture_streamer_stats_t;
+
+/*
+ * texture_streamer_create - Start the workers and upload the placeholder
+ *
+ * @threads: Worker threads, 0 for one per online CPU
+ *
+ * Call with the GL context current. Returns NULL on failure.
+ */
+texture_streamer_t* texture_streamer_create(int threads);
+
+/*
+ * texture_streamer_destroy - Stop the workers and delete every texture
+ *
+ * Waits for images being decoded to finish; queued ones are dropped.
+ */
+void texture_streamer_destroy(texture_streamer_t* ts);
+
+/*
+ * texture_streamer_set_cache - Keep built mipmap chains in 'dir'
+ *
+ * Workers then map an image's chain from texture_cache.h instead of
+ * decoding it, once it has been built on an earlier run. NULL turns the
+ * cache off. Loads already queued keep the directory they were given.
+ * Returns 0, or -1 if out of memory.
+ */
+int texture_streamer_set_cache(texture_streamer_t* ts, const char* dir);
+
+/*
+ * texture_streamer_load - Queue an image file to be loaded
+ *
+ * @opts: Mipmap options, usually from mipmap_options_from_gl
+ *
+ * Returns a handle for the texture, or -1 if out of memory. The path is
+ * copied.
+ */
+int texture_streamer_load(texture_streamer_t* ts, const char* path, const mipmap_options_t* opts);
+
+/*
+ * texture_streamer_release - Delete a texture, or cancel its load
+ *
+ * The handle may be reused by a later load.
+ */
+void texture_streamer_release(texture_streamer_t* ts, int handle);
+
+/*
+ * texture_streamer_update - Upload finished images for up to 'budget_ms'
+ *
+ * At least one strip of rows is uploaded per call, so loading always
+ * moves forward. Restores the texture binding. Returns how many textures
+ * became ready.
+ */
+int texture_streamer_update(texture_streamer_t* ts, double budget_ms);
+
+/*
+ * texture_streamer_texture - Texture to bind for a handle
+ *
+ * The placeholder until the image is ready, or if it failed.
+ */
+GLuint texture_streamer_texture(const texture_streamer_t* ts, int handle);
+
+texture_state_t texture_streamer_state(const texture_streamer_t* ts, int handle);
+
+void texture_streamer_stats(texture_streamer_t* ts, texture_streamer_stats_t* stats);
+
+#endif /* TEXTURE_STREAMER_H */
@@ -2,10 +2,13 @@
 #include <GL/glut.h>
 #include <stdio.h>
 #include <math.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 static int blend_enabled = 0;
 static int fog_enabled = 0;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 
 void init_gl(void) {
     glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
@@ -40,12 +43,14 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     glutPostRedisplay();
 }
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     if (key == 27 || key == 'q') exit(0);
     if (key == 'b') { blend_enabled = !blend_enabled; printf("Blend: %s\n", blend_enabled?"ON":"OFF"); }
     if (key == 'f') { fog_enabled = !fog_enabled; printf("Fog: %s\n", fog_enabled?"ON":"OFF"); }
@@ -67,7 +72,9 @@ int main(int argc, char** argv) {
     glutCreateWindow("Chapter 10");
     init_gl();
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutMainLoop();
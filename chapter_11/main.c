@@ -1,10 +1,18 @@
 /* Chapter 11: Display Lists */
 #include <GL/glut.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "bench.h"
+#include "frame_pacer.h"
+#include "offscreen.h"
+#include "shape_cache.h"
+#include "timing.h"
 
 static GLuint sphere_list;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 
 void create_display_lists(void) {
     sphere_list = glGenLists(1);
@@ -18,7 +26,6 @@ void init_gl(void) {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_LIGHTING);
     glEnable(GL_LIGHT0);
-    create_display_lists();
 }
 
 void display(void) {
@@ -39,12 +46,22 @@ void display(void) {
         glCallList(sphere_list);
         glPopMatrix();
     }
+
+    /* The centrepiece comes from the shape cache, which makes a list like
+     * sphere_list for each shape the first time it is drawn */
+    glPushMatrix();
+    glRotatef(rotation, 0, 1, 0);
+    glRotatef(-90, 1, 0, 0);
+    shape_cache_solid_torus(0.25, 1.5, 16, 48);
+    shape_cache_solid_cone(0.6, 1.5, 24, 4);
+    glPopMatrix();
     
     glutSwapBuffers();
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     glutPostRedisplay();
 }
 
@@ -58,21 +75,202 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     if (key == 27 || key == 'q') {
         glDeleteLists(sphere_list, 1);
+        shape_cache_clear();
         exit(0);
     }
+    if (key == 's') {
+        shape_cache_stats_t stats;
+        shape_cache_get_stats(&stats);
+        printf("Shape cache: %lu hits, %lu misses, %lu evictions, %d lists, %zu bytes\n",
+               stats.hits, stats.misses, stats.evictions, stats.lists, stats.bytes);
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Benchmark
+ * ------------------------------------------------------------------------ */
+
+typedef struct {
+    int kind;                    /* 0 sphere, 1 cone, 2 torus, 3 cube */
+    double a, b;
+    int slices, stacks;
+} bench_shape_t;
+
+/* Every eighth object is one of the fine shapes, the rest coarse */
+static const bench_shape_t bench_shapes[8] = {
+    {0, 0.4, 0.0, 16, 12}, {1, 0.3, 0.8, 16, 4}, {2, 0.12, 0.3, 12, 24}, {3, 0.6, 0.0, 0, 0},
+    {0, 0.4, 0.0, 64, 48}, {1, 0.3, 0.8, 64, 16}, {2, 0.12, 0.3, 32, 64}, {0, 0.2, 0.0, 48, 32},
+};
+
+static int bench_shape_of(int i) {
+    return i % 8 == 7 ? 4 + (i / 8) % 4 : i % 4;
+}
+
+static double bench_shape_vertices(const bench_shape_t* s) {
+    switch (s->kind) {
+        case 0: return (s->slices + 1) * 2.0 * s->stacks;
+        case 1: return (s->slices + 1) * 2.0 * s->stacks + s->slices + 2;
+        case 2: return (s->stacks + 1) * 2.0 * s->slices;
+    }
+    return 24.0;
+}
+
+static void bench_draw_shapes(int objects) {
+    int side = (int)ceil(sqrt((double)objects));
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int i = 0; i < objects; i++) {
+        const bench_shape_t* s = &bench_shapes[bench_shape_of(i)];
+        glPushMatrix();
+        glTranslatef((i % side - side * 0.5f) * 1.2f, (i / side - side * 0.5f) * 1.2f, 0.0f);
+        glRotatef(i * 37.0f, 1.0f, 1.0f, 0.0f);
+        switch (s->kind) {
+            case 0: shape_cache_solid_sphere(s->a, s->slices, s->stacks); break;
+            case 1: shape_cache_solid_cone(s->a, s->b, s->slices, s->stacks); break;
+            case 2: shape_cache_solid_torus(s->a, s->b, s->slices, s->stacks); break;
+            default: shape_cache_solid_cube(s->a); break;
+        }
+        glPopMatrix();
+    }
+}
+
+/*
+ * run_benchmark - Draw a grid of mixed shapes offscreen, tessellated on
+ * every call ("immediate"), from the shape cache ("cached"), and from a
+ * cache with half the room the shapes need ("lru")
+ *
+ * Counts are objects per frame. The cache is cleared before each mode, and
+ * the first frame of a cold cache, which compiles the lists, is reported
+ * as prep_ms. Hit, miss and eviction counts go to stderr.
+ */
+int run_benchmark(int argc, char** argv) {
+    static const int default_counts[] = {20, 100, 500};
+    static const char* const modes[] = {"immediate", "cached", "lru"};
+    bench_options_t opts;
+    bench_report_t report;
+    FILE* out = stdout;
+
+    bench_options_init(&opts);
+    if (bench_parse_args(&opts, argc, argv) != 0) {
+        bench_print_usage(argv[0], "--bench");
+        fprintf(stderr, "  Modes: immediate, cached, lru. Counts are objects per frame.\n");
+        return 1;
+    }
+    if (opts.count_count == 0) {
+        opts.count_count = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(opts.counts, default_counts, sizeof(default_counts));
+    }
+
+    if (offscreen_create(&argc, argv, opts.width, opts.height, opts.software) != 0) {
+        return 1;
+    }
+    if (opts.output && !(out = fopen(opts.output, "w"))) {
+        perror(opts.output);
+        offscreen_destroy();
+        return 1;
+    }
+    double* frame_ms = malloc(opts.frames * sizeof(double));
+    if (!frame_ms) {
+        if (out != stdout) fclose(out);
+        offscreen_destroy();
+        return 1;
+    }
+
+    init_gl();
+    GLfloat light_pos[] = {5, 5, 5, 1};
+    glViewport(0, 0, opts.width, opts.height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(45.0, (double)opts.width / opts.height, 0.1, 100.0);
+    glMatrixMode(GL_MODELVIEW);
+
+    bench_report_begin(&report, out, opts.format, "chapter_11",
+                       (const char*)glGetString(GL_RENDERER), offscreen_backend());
+
+    for (int c = 0; c < opts.count_count; c++) {
+        int n = opts.counts[c];
+        double vertices = 0.0;
+
+        for (int i = 0; i < n; i++) vertices += bench_shape_vertices(&bench_shapes[bench_shape_of(i)]);
+        glLoadIdentity();
+        gluLookAt(0, 0, 1.5 * sqrt((double)n) + 3.0, 0, 0, 0, 0, 1, 0);
+        glLightfv(GL_LIGHT0, GL_POSITION, light_pos);
+
+        /* What the lists for this count take, to give "lru" half of it */
+        shape_cache_stats_t stats;
+        shape_cache_clear();
+        shape_cache_set_budget(SHAPE_CACHE_DEFAULT_BUDGET);
+        bench_draw_shapes(n);
+        shape_cache_get_stats(&stats);
+        size_t full_bytes = stats.bytes;
+
+        for (int mode = 0; mode < 3; mode++) {
+            bench_result_t result;
+
+            if (!bench_mode_selected(&opts, modes[mode])) continue;
+            shape_cache_clear();
+            if (mode == 0) shape_cache_set_budget(0);
+            else if (mode == 1) shape_cache_set_budget(SHAPE_CACHE_DEFAULT_BUDGET);
+            else shape_cache_set_budget(full_bytes / 2);
+
+            uint64_t cold_start = timing_now_ns();
+            bench_draw_shapes(n);
+            glFinish();
+            double cold_ms = (timing_now_ns() - cold_start) / 1e6;
+            for (int f = 0; f < opts.warmup; f++) {
+                bench_draw_shapes(n);
+                glFinish();
+            }
+            shape_cache_reset_stats();
+            for (int f = 0; f < opts.frames; f++) {
+                uint64_t frame_start = timing_now_ns();
+                bench_draw_shapes(n);
+                glFinish();
+                frame_ms[f] = (timing_now_ns() - frame_start) / 1e6;
+            }
+
+            shape_cache_get_stats(&stats);
+            memset(&result, 0, sizeof(result));
+            result.mode = modes[mode];
+            result.objects = n;
+            result.bytes = vertices * 24.0;
+            bench_compute(&result, frame_ms, opts.frames, n, vertices);
+            result.prep_ms = mode == 0 ? 0.0 : cold_ms;
+            bench_report_add(&report, &result);
+            fprintf(stderr, "  %4d objects %-9s %8.3f ms/frame: %lu hits, %lu misses, "
+                    "%lu evictions, %d lists, %zu of %zu bytes\n",
+                    n, modes[mode], result.mean_ms, stats.hits, stats.misses,
+                    stats.evictions, stats.lists, stats.bytes, stats.budget);
+        }
+    }
+
+    bench_report_end(&report);
+    shape_cache_clear();
+    free(frame_ms);
+    if (out != stdout) fclose(out);
+    offscreen_destroy();
+    return 0;
 }
 
 int main(int argc, char** argv) {
-    printf("Chapter 11: Display Lists\n20 spheres rendered using display lists\n");
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return run_benchmark(argc, argv);
+    }
+    printf("Chapter 11: Display Lists\n20 spheres from one display list, shapes from the shape cache\n"
+           "Controls: S - print cache statistics, ESC/Q - quit\n");
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
     glutCreateWindow("Chapter 11: Display Lists");
     init_gl();
+    create_display_lists();
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutMainLoop();
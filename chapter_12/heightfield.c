@@ -0,0 +1,134 @@
+/*
+ * heightfield.c - Parallel heightfield mesh build
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "heightfield.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HEIGHTFIELD_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#define MIN_ROWS 8    /* Rows per chunk handed to a thread */
+
+typedef struct {
+    heightfield_t* field;
+    terrain_height_fn height;
+    void* height_ctx;
+} build_job_t;
+
+/* Stage 1: each sample on its own - height, position and colour */
+static void height_rows(void* ctx, int begin, int end) {
+    build_job_t* job = ctx;
+    heightfield_t* f = job->field;
+
+    for (int z = begin; z < end; z++) {
+        size_t row = (size_t)z * f->width;
+        float* h = f->heights + row;
+        float* p = f->positions + row * 3;
+
+        terrain_sample_row(job->height, job->height_ctx, 0, z, f->width, h);
+        terrain_height_colors(h, f->width, f->colors + row * 3);
+        for (int x = 0; x < f->width; x++) {
+            p[x * 3 + 0] = x * f->spacing;
+            p[x * 3 + 1] = h[x] * f->height_scale;
+            p[x * 3 + 2] = z * f->spacing;
+        }
+    }
+}
+
+/* Unit normal from the slopes along x and z, as the SSE path computes it */
+static void store_normal(float gx, float gz, float* n) {
+    float len = sqrtf(gx * gx + 1.0f + gz * gz);
+    n[0] = -gx / len;
+    n[1] = 1.0f / len;
+    n[2] = -gz / len;
+}
+
+/* Stage 2: normals, which need the finished rows either side */
+static void normal_rows(void* ctx, int begin, int end) {
+    build_job_t* job = ctx;
+    heightfield_t* f = job->field;
+    int w = f->width;
+    float scale_x2 = f->height_scale / (2 * f->spacing);
+
+    for (int z = begin; z < end; z++) {
+        int z0 = z > 0 ? z - 1 : z;
+        int z1 = z < f->depth - 1 ? z + 1 : z;
+        const float* h = f->heights + (size_t)z * w;
+        const float* up = f->heights + (size_t)z0 * w;
+        const float* down = f->heights + (size_t)z1 * w;
+        float* n = f->normals + (size_t)z * w * 3;
+        float scale_z = f->height_scale / ((z1 - z0) * f->spacing);
+
+        /* Border columns have one-sided differences */
+        for (int x = 0; x < w; x += w > 1 ? w - 1 : 1) {
+            int x0 = x > 0 ? x - 1 : x;
+            int x1 = x < w - 1 ? x + 1 : x;
+            float scale_x = x1 > x0 ? f->height_scale / ((x1 - x0) * f->spacing) : 0.0f;
+            store_normal((h[x1] - h[x0]) * scale_x, (down[x] - up[x]) * scale_z, n + x * 3);
+        }
+
+        int x = 1;
+#ifdef HEIGHTFIELD_SSE
+        __m128 sign = _mm_set1_ps(-0.0f), one = _mm_set1_ps(1.0f);
+        for (; x + 4 <= w - 1; x += 4) {
+            __m128 gx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(h + x + 1), _mm_loadu_ps(h + x - 1)),
+                                   _mm_set1_ps(scale_x2));
+            __m128 gz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(down + x), _mm_loadu_ps(up + x)),
+                                   _mm_set1_ps(scale_z));
+            __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), one),
+                                                _mm_mul_ps(gz, gz)));
+            __m128 r[4];
+
+            r[0] = _mm_div_ps(_mm_xor_ps(gx, sign), len);
+            r[1] = _mm_div_ps(one, len);
+            r[2] = _mm_div_ps(_mm_xor_ps(gz, sign), len);
+            r[3] = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+            for (int k = 0; k < 4; k++) {
+                float* out = n + (x + k) * 3;
+                _mm_storel_pi((__m64*)out, r[k]);
+                _mm_store_ss(out + 2, _mm_movehl_ps(r[k], r[k]));
+            }
+        }
+#endif
+        for (; x < w - 1; x++) {
+            store_normal((h[x + 1] - h[x - 1]) * scale_x2, (down[x] - up[x]) * scale_z, n + x * 3);
+        }
+    }
+}
+
+int heightfield_build(heightfield_t* field, int width, int depth, float spacing,
+                      float height_scale, terrain_height_fn height, void* height_ctx,
+                      thread_pool_t* pool) {
+    size_t samples = (size_t)width * depth;
+    build_job_t job = {field, height, height_ctx};
+
+    field->width = width;
+    field->depth = depth;
+    field->spacing = spacing;
+    field->height_scale = height_scale;
+    field->heights = malloc(samples * sizeof(float));
+    field->positions = malloc(samples * 3 * sizeof(float));
+    field->normals = malloc(samples * 3 * sizeof(float));
+    field->colors = malloc(samples * 3 * sizeof(float));
+    if (!field->heights || !field->positions || !field->normals || !field->colors) {
+        heightfield_free(field);
+        return -1;
+    }
+
+    thread_pool_parallel_for(pool, depth, MIN_ROWS, height_rows, &job);
+    thread_pool_parallel_for(pool, depth, MIN_ROWS, normal_rows, &job);
+    return 0;
+}
+
+void heightfield_free(heightfield_t* field) {
+    free(field->heights);
+    free(field->positions);
+    free(field->normals);
+    free(field->colors);
+    field->heights = field->positions = field->normals = field->colors = NULL;
+}
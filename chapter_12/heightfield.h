@@ -0,0 +1,44 @@
+/*
+ * heightfield.h - Parallel heightfield mesh build
+ *
+ * Builds a whole grid at once: heights, positions, colours and normals.
+ * The work is split by rows across a thread pool and each row is computed
+ * four samples at a time with SSE. A row is always computed the same way,
+ * whichever thread gets it, so the result is identical for any number of
+ * threads.
+ *
+ * Normals come from central differences: the slope across a sample is
+ * the height to its right minus the height to its left, over the distance
+ * between them (one-sided at the border), and likewise along z.
+ */
+
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include "terrain.h"
+#include "thread_pool.h"
+
+typedef struct {
+    int width, depth;            /* Samples along x and z */
+    float spacing;               /* World units between samples */
+    float height_scale;          /* World height of a normalised 1.0 */
+    float* heights;              /* Normalised, row-major by z */
+    float* positions;            /* xyz, from (0, 0, 0) */
+    float* normals;              /* xyz, unit length */
+    float* colors;               /* rgb, the terrain's colour ramp */
+} heightfield_t;
+
+/*
+ * heightfield_build - Allocate and fill a width x depth heightfield
+ *
+ * @pool: Threads to build with, or NULL to build on this thread
+ *
+ * Returns 0, or -1 if memory ran out (nothing is left allocated).
+ */
+int heightfield_build(heightfield_t* field, int width, int depth, float spacing,
+                      float height_scale, terrain_height_fn height, void* height_ctx,
+                      thread_pool_t* pool);
+
+void heightfield_free(heightfield_t* field);
+
+#endif /* HEIGHTFIELD_H */
@@ -0,0 +1,162 @@
+/*
+ * heightmap.c - Memory-mapped 8/16-bit heightmaps (PGM and RAW)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "heightmap.h"
+
+/* Next header number, skipping whitespace and # comments */
+static long pgm_number(const unsigned char* data, size_t size, size_t* pos) {
+    long value = 0;
+    int digits = 0;
+
+    while (*pos < size) {
+        if (data[*pos] == '#') {
+            while (*pos < size && data[*pos] != '\n') (*pos)++;
+        } else if (isspace(data[*pos])) {
+            (*pos)++;
+        } else {
+            break;
+        }
+    }
+    while (*pos < size && isdigit(data[*pos]) && digits < 9) {
+        value = value * 10 + (data[(*pos)++] - '0');
+        digits++;
+    }
+    return digits > 0 ? value : -1;
+}
+
+static int parse_pgm(heightmap_t* map, const char* path) {
+    const unsigned char* data = map->map;
+    size_t pos = 2;
+
+    long width = pgm_number(data, map->map_size, &pos);
+    long height = pgm_number(data, map->map_size, &pos);
+    long maxval = pgm_number(data, map->map_size, &pos);
+    if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535 ||
+        pos >= map->map_size || !isspace(data[pos])) {
+        fprintf(stderr, "%s: bad PGM header\n", path);
+        return -1;
+    }
+
+    map->width = (int)width;
+    map->height = (int)height;
+    map->bits = maxval > 255 ? 16 : 8;
+    map->big_endian = 1;
+    map->scale = 1.0f / maxval;
+    map->samples = data + pos + 1;
+    return 0;
+}
+
+static int parse_raw(heightmap_t* map, const char* path, int width, int height, int bits) {
+    size_t size = map->map_size;
+
+    if (width <= 0 || height <= 0) {
+        /* Square maps only: n*n bytes is 8-bit, 2*n*n is 16-bit */
+        size_t n8 = (size_t)(sqrt((double)size) + 0.5);
+        size_t n16 = (size_t)(sqrt(size / 2.0) + 0.5);
+        if (bits != 16 && n8 * n8 == size) {
+            width = (int)n8;
+            bits = 8;
+        } else if (bits != 8 && n16 * n16 * 2 == size) {
+            width = (int)n16;
+            bits = 16;
+        } else {
+            width = 0;
+        }
+        height = width;
+    } else if (bits == 0) {
+        bits = size >= (size_t)width * height * 2 ? 16 : 8;
+    }
+
+    if ((bits != 8 && bits != 16) || width <= 0 ||
+        size < (size_t)width * height * (bits / 8)) {
+        fprintf(stderr, "%s: cannot tell the RAW size, give width, height and bits\n", path);
+        return -1;
+    }
+
+    map->width = width;
+    map->height = height;
+    map->bits = bits;
+    map->big_endian = 0;
+    map->scale = 1.0f / (bits == 16 ? 65535 : 255);
+    map->samples = map->map;
+    return 0;
+}
+
+heightmap_t* heightmap_open(const char* path, int width, int height, int bits) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < 4) {
+        fprintf(stderr, "%s: empty or unreadable\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    heightmap_t* map = calloc(1, sizeof(heightmap_t));
+    if (!map) {
+        close(fd);
+        return NULL;
+    }
+    map->map_size = (size_t)st.st_size;
+    map->map = mmap(NULL, map->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map->map == MAP_FAILED) {
+        perror(path);
+        free(map);
+        return NULL;
+    }
+
+    /* Patches read scattered rows; reading ahead would pull in the rows
+     * in between, which belong to patches nobody asked for yet */
+    posix_madvise(map->map, map->map_size, POSIX_MADV_RANDOM);
+
+    const unsigned char* data = map->map;
+    int ok = data[0] == 'P' && data[1] == '5' ? parse_pgm(map, path)
+                                               : parse_raw(map, path, width, height, bits);
+    if (ok == 0 && map->samples + (size_t)map->width * map->height * (map->bits / 8) >
+                   data + map->map_size) {
+        fprintf(stderr, "%s: file is shorter than its %dx%d samples\n",
+                path, map->width, map->height);
+        ok = -1;
+    }
+    if (ok != 0) {
+        heightmap_close(map);
+        return NULL;
+    }
+    return map;
+}
+
+void heightmap_close(heightmap_t* map) {
+    if (!map) return;
+    munmap(map->map, map->map_size);
+    free(map);
+}
+
+float heightmap_sample(void* ctx, int x, int z) {
+    const heightmap_t* map = ctx;
+
+    x = x < 0 ? 0 : x >= map->width ? map->width - 1 : x;
+    z = z < 0 ? 0 : z >= map->height ? map->height - 1 : z;
+
+    size_t i = (size_t)z * map->width + x;
+    if (map->bits == 8) return map->samples[i] * map->scale;
+
+    const unsigned char* s = &map->samples[i * 2];
+    unsigned v = map->big_endian ? (s[0] << 8) | s[1] : s[0] | (s[1] << 8);
+    return v * map->scale;
+}
@@ -0,0 +1,53 @@
+/*
+ * heightmap.h - Memory-mapped 8/16-bit heightmaps (PGM and RAW)
+ *
+ * The file is mapped, not read: opening a 16k x 16k map only parses the
+ * header, and a sample's page is read from disk the first time a terrain
+ * patch touches it. Startup time therefore follows the area around the
+ * camera rather than the size of the file, and pages the system needs
+ * back can be dropped and re-read at any time.
+ *
+ * Supported files:
+ *   .pgm  Binary (P5) greymap. A maxval above 255 means 16-bit samples,
+ *         stored big-endian as the format requires.
+ *   other Headerless RAW samples, row by row, 16-bit ones little-endian
+ *         as most terrain tools write them. If no size is given, the map
+ *         must be square and the size is worked out from the file length.
+ */
+
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <stddef.h>
+
+typedef struct {
+    int width, height;           /* Samples along x and z */
+    int bits;                    /* 8 or 16 */
+    int big_endian;              /* 16-bit byte order */
+    float scale;                 /* 1 / maxval */
+    const unsigned char* samples;
+    void* map;
+    size_t map_size;
+} heightmap_t;
+
+/*
+ * heightmap_open - Map a heightmap file
+ *
+ * @width, @height, @bits: Size and depth of a RAW file, or 0 to work them
+ *                         out from the file length. Ignored for PGM.
+ *
+ * Returns NULL and prints the reason if the file cannot be used.
+ */
+heightmap_t* heightmap_open(const char* path, int width, int height, int bits);
+
+void heightmap_close(heightmap_t* map);
+
+/*
+ * heightmap_sample - Normalised 0..1 height at sample (x, z)
+ *
+ * Coordinates outside the map are clamped to its edge. Matches
+ * terrain_height_fn, with the heightmap as ctx.
+ */
+float heightmap_sample(void* ctx, int x, int z);
+
+#endif /* HEIGHTMAP_H */
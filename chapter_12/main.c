@@ -1,32 +1,80 @@
 /* Chapter 12: Vertex Arrays */
 #include <GL/glut.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "bench.h"
+#include "frame_pacer.h"
+#include "heightfield.h"
+#include "heightmap.h"
+#include "light_bake.h"
+#include "mesh_opt.h"
+#include "offscreen.h"
+#include "quantize.h"
+#include "terrain.h"
+#include "thread_pool.h"
+#include "timing.h"
 
 #define GRID_SIZE 50
+#define GRID_SPACING 0.2f
 
-static GLfloat vertices[GRID_SIZE * GRID_SIZE * 3];
-static GLfloat colors[GRID_SIZE * GRID_SIZE * 3];
+static heightfield_t grid;      /* Positions, normals and colours */
 static GLuint indices[(GRID_SIZE-1) * (GRID_SIZE-1) * 6];
+static unsigned int* strip = NULL;
+
+/* The same grid in the compact format (C key) */
+static GLshort packed_vertices[GRID_SIZE * GRID_SIZE * 4];
+static GLubyte packed_colors[GRID_SIZE * GRID_SIZE * 4];
+static GLushort packed_indices[(GRID_SIZE-1) * (GRID_SIZE-1) * 6];
+static quantize_transform_t grid_xf;
+static int compact_vertices = 1;
+static int benchmarking = 0;   /* Keep stdout for the report */
+
+/* Lighting (L key): none, glLight per vertex each frame, or baked once
+ * into a second set of colours and drawn with GL_LIGHTING off */
+enum { LIGHTING_OFF, LIGHTING_LIVE, LIGHTING_BAKED };
+static light_bake_t scene_lighting;
+static float baked_colors[GRID_SIZE * GRID_SIZE * 3];
+static GLubyte packed_baked_colors[GRID_SIZE * GRID_SIZE * 4];
+
+static int strip_length = 0;
+static int use_strip = 0;
+static int lighting = LIGHTING_OFF;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
+
+/* Large streamed terrain (T key) and the camera flying over it */
+static terrain_t* terrain = NULL;
+static int show_terrain = 0;
+static float cam_x, cam_z, cam_yaw = 0.0f, cam_speed = 40.0f;
+static float view_distance = 600.0f;
+static int cull_patches = 1;
+static int bake_terrain = 1;
+static double stats_time = 0.0;
+static double load_start = 0.0;
+static heightmap_t* heightmap = NULL;   /* --heightmap file, or NULL for noise */
+
+/* The grid's surface, normalised to 0..1 */
+float grid_height(void* ctx, int x, int z) {
+    (void)ctx;
+    if (heightmap) {
+        /* The whole map, shrunk to the grid */
+        return heightmap_sample(heightmap, x * (heightmap->width - 1) / (GRID_SIZE - 1),
+                                z * (heightmap->height - 1) / (GRID_SIZE - 1));
+    }
+    float fx = (x - GRID_SIZE/2) * GRID_SPACING;
+    float fz = (z - GRID_SIZE/2) * GRID_SPACING;
+    return (sinf(fx*0.5f) * cosf(fz*0.5f) + 1.0f) * 0.5f;
+}
 
 void generate_terrain(void) {
-    int idx = 0;
-    for (int z = 0; z < GRID_SIZE; z++) {
-        for (int x = 0; x < GRID_SIZE; x++) {
-            float fx = (x - GRID_SIZE/2) * 0.2f;
-            float fz = (z - GRID_SIZE/2) * 0.2f;
-            float fy = sinf(fx*0.5f) * cosf(fz*0.5f);
-            
-            vertices[idx*3+0] = fx;
-            vertices[idx*3+1] = fy;
-            vertices[idx*3+2] = fz;
-            
-            colors[idx*3+0] = 0.2f + fy*0.5f;
-            colors[idx*3+1] = 0.8f - fy*0.3f;
-            colors[idx*3+2] = 0.3f;
-            idx++;
-        }
+    int idx;
+
+    if (heightfield_build(&grid, GRID_SIZE, GRID_SIZE, GRID_SPACING, 2.0f,
+                          grid_height, NULL, NULL) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
     }
     
     idx = 0;
@@ -46,6 +94,41 @@ void generate_terrain(void) {
             indices[idx++] = i3;
         }
     }
+
+    /* The grid does not move relative to its light, so bake it once */
+    double bake_start = timing_seconds();
+    light_bake_vertices(&scene_lighting, grid.positions, grid.normals, grid.colors,
+                        GRID_SIZE * GRID_SIZE, baked_colors);
+    double bake_ms = (timing_seconds() - bake_start) * 1000.0;
+    quantize_colors(baked_colors, 3, GRID_SIZE * GRID_SIZE, packed_baked_colors);
+
+    /* Same triangles, reordered so shared vertices hit the vertex cache */
+    float before = mesh_acmr(indices, idx, GRID_SIZE * GRID_SIZE, 0);
+    mesh_optimize_vertex_cache(indices, idx, GRID_SIZE * GRID_SIZE, 0);
+    strip_length = mesh_build_strip(indices, idx, GRID_SIZE * GRID_SIZE, &strip);
+    quantize_positions(grid.positions, 3, GRID_SIZE * GRID_SIZE, packed_vertices, 4, &grid_xf);
+    quantize_colors(grid.colors, 3, GRID_SIZE * GRID_SIZE, packed_colors);
+    quantize_indices(indices, idx, packed_indices);
+    if (benchmarking) return;
+
+    printf("Vertex cache ACMR: %.3f row by row, %.3f optimised\n",
+           before, mesh_acmr(indices, idx, GRID_SIZE * GRID_SIZE, 0));
+    if (strip_length > 0) {
+        printf("Triangle strip: %d indices instead of %d, ACMR %.3f\n", strip_length, idx,
+               mesh_strip_acmr(strip, strip_length, GRID_SIZE * GRID_SIZE, 0));
+    }
+    printf("Compact grid: %d bytes instead of %d, largest position error %.6f\n",
+           (int)(sizeof(packed_vertices) + sizeof(packed_colors) + sizeof(packed_indices)),
+           (int)(GRID_SIZE * GRID_SIZE * 6 * sizeof(GLfloat) + sizeof(indices)),
+           fmaxf(grid_xf.max_error[0], fmaxf(grid_xf.max_error[1], grid_xf.max_error[2])));
+    printf("Baked lighting into %d vertices in %.3f ms\n", GRID_SIZE * GRID_SIZE, bake_ms);
+}
+
+/* A sun from above and to one side, tinting the vertex colours */
+void setup_lighting(void) {
+    light_bake_defaults(&scene_lighting);
+    scene_lighting.material.color_material = 1;
+    light_bake_add_directional(&scene_lighting, 0.5f, 1.0f, 0.3f);
 }
 
 void init_gl(void) {
@@ -53,26 +136,105 @@ void init_gl(void) {
     glEnable(GL_DEPTH_TEST);
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_COLOR_ARRAY);
+    setup_lighting();
     generate_terrain();
 }
 
+void draw_terrain(void) {
+    float ground = terrain_height_at(terrain, cam_x, cam_z);
+    float cam_y = ground + 30.0f;
+    float dir_x = sinf(cam_yaw), dir_z = -cosf(cam_yaw);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    gluLookAt(cam_x, cam_y, cam_z,
+              cam_x + dir_x * 100.0f, cam_y - 20.0f, cam_z + dir_z * 100.0f,
+              0, 1, 0);
+
+    terrain_update(terrain, cam_x, cam_y, cam_z);
+    terrain_draw(terrain);
+}
+
+void display_terrain(void) {
+    draw_terrain();
+    glutSwapBuffers();
+
+    double now = timing_seconds();
+    if (load_start > 0.0) {
+        terrain_stats_t stats;
+        terrain_get_stats(terrain, &stats);
+        if (stats.pending == 0) {
+            printf("Terrain: first view loaded in %.0f ms\n", (now - load_start) * 1000.0);
+            load_start = 0.0;
+        }
+    }
+    if (now - stats_time >= 1.0) {
+        terrain_stats_t stats;
+        terrain_get_stats(terrain, &stats);
+        printf("Terrain: %d patches drawn, %d culled, %d loading, %ld of %ld triangles, "
+               "%.1f MB | LOD", stats.drawn, stats.culled, stats.pending, stats.triangles,
+               stats.total_triangles, stats.bytes / 1048576.0);
+        for (int i = 0; i < TERRAIN_LODS; i++) printf(" %d", stats.lod_patches[i]);
+        printf("\n");
+        stats_time = now;
+    }
+}
+
 void display(void) {
+    if (show_terrain) {
+        display_terrain();
+        return;
+    }
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
     gluLookAt(0, 5, 10, 0, 0, 0, 0, 1, 0);
     glRotatef(rotation, 0, 1, 0);
+    glTranslatef(-GRID_SIZE/2 * GRID_SPACING, -1.0f, -GRID_SIZE/2 * GRID_SPACING);
+
+    /* The light is given in grid space, where it was baked */
+    int live = lighting == LIGHTING_LIVE;
+    int baked = lighting == LIGHTING_BAKED;
+    if (live) {
+        light_bake_apply(&scene_lighting);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, grid.normals);
+    }
+    if (compact_vertices && !live) {
+        /* Scale and offset the shorts back into place */
+        glTranslatef(grid_xf.offset[0], grid_xf.offset[1], grid_xf.offset[2]);
+        glScalef(grid_xf.scale[0], grid_xf.scale[1], grid_xf.scale[2]);
+        glVertexPointer(3, GL_SHORT, 4 * sizeof(GLshort), packed_vertices);
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, baked ? packed_baked_colors : packed_colors);
+    } else {
+        glVertexPointer(3, GL_FLOAT, 0, grid.positions);
+        glColorPointer(3, GL_FLOAT, 0, baked ? baked_colors : grid.colors);
+    }
     
-    glVertexPointer(3, GL_FLOAT, 0, vertices);
-    glColorPointer(3, GL_FLOAT, 0, colors);
-    
-    glDrawElements(GL_TRIANGLES, (GRID_SIZE-1)*(GRID_SIZE-1)*6, 
-                   GL_UNSIGNED_INT, indices);
+    if (use_strip) {
+        glDrawElements(GL_TRIANGLE_STRIP, strip_length, GL_UNSIGNED_INT, strip);
+    } else if (compact_vertices && !live) {
+        glDrawElements(GL_TRIANGLES, (GRID_SIZE-1)*(GRID_SIZE-1)*6,
+                       GL_UNSIGNED_SHORT, packed_indices);
+    } else {
+        glDrawElements(GL_TRIANGLES, (GRID_SIZE-1)*(GRID_SIZE-1)*6, 
+                       GL_UNSIGNED_INT, indices);
+    }
+    if (live) {
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisable(GL_LIGHTING);
+    }
     
     glutSwapBuffers();
 }
 
 void idle(void) {
-    rotation += 0.3f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 18.0f * dt;
+    if (show_terrain) {
+        cam_x += sinf(cam_yaw) * cam_speed * dt;
+        cam_z -= cosf(cam_yaw) * cam_speed * dt;
+    }
     glutPostRedisplay();
 }
 
@@ -80,32 +242,605 @@ void reshape(int w, int h) {
     glViewport(0, 0, w, h);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluPerspective(45.0, (double)w/h, 0.1, 100.0);
+    gluPerspective(45.0, (double)w/h, show_terrain ? 1.0 : 0.1,
+                   show_terrain ? view_distance + 400.0 : 100.0);
     glMatrixMode(GL_MODELVIEW);
 }
 
+/* (Re)create the streamed terrain in the current vertex format */
+int create_terrain(void) {
+    terrain_config_t config;
+
+    terrain_config_defaults(&config);
+    config.view_distance = view_distance;
+    config.compact = compact_vertices;
+    config.cull = cull_patches;
+    config.lighting = bake_terrain ? &scene_lighting : NULL;
+    if (heightmap) {
+        config.size_x = heightmap->width;
+        config.size_z = heightmap->height;
+        config.height = heightmap_sample;
+        config.height_ctx = heightmap;
+    }
+
+    terrain_destroy(terrain);
+    load_start = timing_seconds();
+    terrain = terrain_create(&config);
+    if (!terrain) {
+        fprintf(stderr, "Could not create the terrain\n");
+        return -1;
+    }
+    if (!benchmarking) printf("Terrain: %dx%d samples, %d-quad patches, %d LODs, %s vertices%s\n",
+           config.size_x, config.size_z, TERRAIN_PATCH_QUADS, TERRAIN_LODS,
+           config.compact ? "compact" : "float", config.lighting ? ", baked lighting" : "");
+    return 0;
+}
+
+void enable_terrain_fog(void) {
+    /* Fog hides patches streaming in at the edge of the view */
+    GLfloat fog_color[] = {0.3f, 0.4f, 0.6f, 1.0f};
+    glFogi(GL_FOG_MODE, GL_LINEAR);
+    glFogfv(GL_FOG_COLOR, fog_color);
+    glFogf(GL_FOG_START, view_distance * 0.5f);
+    glFogf(GL_FOG_END, view_distance);
+    glEnable(GL_FOG);
+}
+
+void toggle_terrain(void) {
+    if (!terrain) {
+        float width, depth;
+
+        if (create_terrain() != 0) return;
+        terrain_extent(terrain, &width, &depth);
+        cam_x = width / 2;
+        cam_z = depth / 2;
+    }
+
+    show_terrain = !show_terrain;
+    if (show_terrain) {
+        enable_terrain_fog();
+    } else {
+        glDisable(GL_FOG);
+    }
+    reshape(glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+}
+
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
-    if (key == 27 || key == 'q') exit(0);
+    frame_pacer_wake();
+    if (key == 27 || key == 'q') {
+        terrain_destroy(terrain);
+        heightmap_close(heightmap);
+        exit(0);
+    }
     if (key == 'w') {
         static int wireframe = 0;
         wireframe = !wireframe;
         glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
     }
+    if (key == 's' && strip_length > 0) {
+        use_strip = !use_strip;
+        printf("Drawing the grid as a triangle %s\n", use_strip ? "strip" : "list");
+    }
+    if (key == 'c') {
+        compact_vertices = !compact_vertices;
+        printf("Vertex format: %s\n", compact_vertices ? "compact (12 bytes)" : "float (24 bytes)");
+        if (terrain) create_terrain();
+    }
+    if (key == 'l') {
+        /* The normals are unit length for the float vertices only; the
+         * compact scale would stretch them. Baked colours need no normals. */
+        static const char* const names[] = {"off", "live (glLight)", "baked into colours"};
+        lighting = (lighting + 1) % 3;
+        printf("Lighting %s%s\n", names[lighting],
+               lighting == LIGHTING_LIVE && compact_vertices ? " (drawing float vertices)" : "");
+    }
+    if (key == 'b') {
+        bake_terrain = !bake_terrain;
+        printf("Terrain lighting %s\n", bake_terrain ? "baked" : "off");
+        if (terrain) create_terrain();
+    }
+    if (key == 'f') {
+        cull_patches = !cull_patches;
+        printf("Frustum culling %s\n", cull_patches ? "on" : "off");
+        if (terrain) terrain_set_cull(terrain, cull_patches);
+    }
+    if (key == 't') toggle_terrain();
+}
+
+void special(int key, int x, int y) {
+    (void)x; (void)y;
+    frame_pacer_wake();
+    switch (key) {
+        case GLUT_KEY_LEFT:  cam_yaw -= 0.1f; break;
+        case GLUT_KEY_RIGHT: cam_yaw += 0.1f; break;
+        case GLUT_KEY_UP:    cam_speed += 20.0f; break;
+        case GLUT_KEY_DOWN:  cam_speed = cam_speed > 20.0f ? cam_speed - 20.0f : 0.0f; break;
+    }
+}
+
+/*
+ * bench_mesh_opt - Compare index orders on square grids of 64 quads up to
+ * max_size quads a side: row-by-row list, optimised list and strip
+ */
+int bench_mesh_opt(int max_size) {
+    printf("%6s %10s %9s %9s %9s %10s %10s %9s\n", "grid", "triangles", "row ACMR",
+           "opt ACMR", "opt ms", "strip len", "strip ACMR", "strip ms");
+
+    for (int n = 64; n <= max_size; n *= 2) {
+        int verts = (n + 1) * (n + 1);
+        int count = n * n * 6;
+        unsigned int* list = malloc((size_t)count * sizeof(unsigned int));
+        unsigned int* grid_strip = NULL;
+        int idx = 0;
+
+        if (!list) {
+            printf("%6d: out of memory\n", n);
+            return 1;
+        }
+        for (int z = 0; z < n; z++) {
+            for (int x = 0; x < n; x++) {
+                unsigned int i0 = z * (n + 1) + x, i2 = i0 + n + 1;
+                list[idx++] = i0;     list[idx++] = i2; list[idx++] = i0 + 1;
+                list[idx++] = i0 + 1; list[idx++] = i2; list[idx++] = i2 + 1;
+            }
+        }
+
+        float row_acmr = mesh_acmr(list, count, verts, 0);
+        double start = timing_seconds();
+        int failed = mesh_optimize_vertex_cache(list, count, verts, 0) != 0;
+        double opt_ms = (timing_seconds() - start) * 1000.0;
+        float opt_acmr = mesh_acmr(list, count, verts, 0);
+
+        start = timing_seconds();
+        int length = failed ? -1 : mesh_build_strip(list, count, verts, &grid_strip);
+        double strip_ms = (timing_seconds() - start) * 1000.0;
+        free(list);
+        if (length < 0) {
+            printf("%6d: out of memory\n", n);
+            return 1;
+        }
+
+        printf("%6d %10d %9.3f %9.3f %9.1f %10d %10.3f %9.1f\n", n, count / 3, row_acmr,
+               opt_acmr, opt_ms, length, mesh_strip_acmr(grid_strip, length, verts, 0), strip_ms);
+        fflush(stdout);
+        free(grid_strip);
+    }
+    return 0;
+}
+
+/*
+ * run_benchmark - Fly the terrain offscreen in each vertex format
+ *
+ * --counts selects the view distances; each is loaded completely before
+ * timing, then the camera turns on the spot so no patches stream in.
+ * "float" and "compact" draw every patch; "culled" is compact with
+ * frustum culling, and prints what it submits as the camera turns.
+ */
+int run_benchmark(int argc, char** argv) {
+    static const int default_counts[] = {300, 600, 1200};
+    static const char* const formats[] = {"float", "compact", "culled"};
+    bench_options_t opts;
+    bench_report_t report;
+    FILE* out = stdout;
+
+    bench_options_init(&opts);
+    if (bench_parse_args(&opts, argc, argv) != 0) {
+        bench_print_usage(argv[0], "--bench");
+        fprintf(stderr, "  Modes: float, compact, culled. Counts are view distances.\n");
+        return 1;
+    }
+    if (opts.count_count == 0) {
+        opts.count_count = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(opts.counts, default_counts, sizeof(default_counts));
+    }
+
+    if (offscreen_create(&argc, argv, opts.width, opts.height, opts.software) != 0) {
+        return 1;
+    }
+    if (opts.output && !(out = fopen(opts.output, "w"))) {
+        perror(opts.output);
+        offscreen_destroy();
+        return 1;
+    }
+
+    double* frame_ms = malloc(opts.frames * sizeof(double));
+    if (!frame_ms) {
+        if (out != stdout) fclose(out);
+        offscreen_destroy();
+        return 1;
+    }
+    benchmarking = 1;
+    init_gl();
+    show_terrain = 1;
+    bench_report_begin(&report, out, opts.format, "chapter_12",
+                       (const char*)glGetString(GL_RENDERER), offscreen_backend());
+
+    for (int c = 0; c < opts.count_count; c++) {
+        for (int mode = 0; mode < 3; mode++) {
+            bench_result_t result;
+            terrain_stats_t stats;
+            float width, depth;
+
+            if (!bench_mode_selected(&opts, formats[mode])) continue;
+
+            view_distance = (float)opts.counts[c];
+            compact_vertices = mode > 0;
+            cull_patches = mode == 2;
+            if (create_terrain() != 0) break;
+            terrain_extent(terrain, &width, &depth);
+            cam_x = width / 2;
+            cam_z = depth / 2;
+            cam_yaw = 0.0f;
+            reshape(opts.width, opts.height);
+            enable_terrain_fog();
+
+            terrain_update(terrain, cam_x, 0.0f, cam_z);
+            terrain_wait(terrain);
+            for (int f = 0; f < opts.warmup; f++) {
+                draw_terrain();
+                glFinish();
+            }
+
+            long submitted = 0, total = 0;
+            for (int f = 0; f < opts.frames; f++) {
+                uint64_t start = timing_now_ns();
+                draw_terrain();
+                glFinish();
+                frame_ms[f] = (timing_now_ns() - start) / 1e6;
+
+                terrain_get_stats(terrain, &stats);
+                submitted += stats.triangles;
+                total += stats.total_triangles;
+                if (cull_patches && f % (opts.frames / 8 > 0 ? opts.frames / 8 : 1) == 0) {
+                    fprintf(stderr, "  heading %3.0f: %3d of %3d patches, %7ld of %7ld triangles "
+                            "(%2.0f%%), %d boxes tested\n",
+                            cam_yaw * 57.29578f, stats.drawn, stats.resident, stats.triangles,
+                            stats.total_triangles,
+                            stats.total_triangles > 0 ?
+                                100.0 * stats.triangles / stats.total_triangles : 0.0,
+                            stats.nodes_tested);
+                }
+                cam_yaw += 6.2831853f / opts.frames;
+            }
+
+            memset(&result, 0, sizeof(result));
+            result.mode = formats[mode];
+            result.objects = opts.counts[c];
+            result.bytes = (double)stats.bytes;
+            bench_compute(&result, frame_ms, opts.frames,
+                          (double)stats.draw_calls, (double)submitted / opts.frames * 3);
+            bench_report_add(&report, &result);
+            fprintf(stderr, "  %s, view %d: %d patches, %.1f MB, largest error %.5f, "
+                    "%.0f%% of triangles submitted\n",
+                    formats[mode], opts.counts[c], stats.resident, stats.bytes / 1048576.0,
+                    stats.max_error, total > 0 ? 100.0 * submitted / total : 0.0);
+        }
+    }
+
+    bench_report_end(&report);
+    free(frame_ms);
+    terrain_destroy(terrain);
+    heightmap_close(heightmap);
+    if (out != stdout) fclose(out);
+    offscreen_destroy();
+    return 0;
+}
+
+/* FNV-1a over a build's output, to compare builds bit for bit */
+unsigned int hash_floats(unsigned int hash, const float* data, size_t count) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < count * sizeof(float); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+unsigned int hash_heightfield(const heightfield_t* field) {
+    size_t samples = (size_t)field->width * field->depth;
+    unsigned int hash = 2166136261u;
+    hash = hash_floats(hash, field->positions, samples * 3);
+    hash = hash_floats(hash, field->normals, samples * 3);
+    return hash_floats(hash, field->colors, samples * 3);
+}
+
+/*
+ * bench_build - Time heightfield_build on a size x size procedural grid
+ * with 1, 2, 4 ... threads, and check every build is identical
+ */
+int bench_build(int size) {
+    unsigned int seed = 1234, first_hash = 0;
+    int max_threads = thread_pool_cpu_count() > 8 ? thread_pool_cpu_count() : 8;
+    int identical = 1;
+    heightfield_t field;
+
+    /* The old way for comparison: one sample at a time, no normals */
+    if (heightfield_build(&field, size, size, 1.0f, 120.0f,
+                          terrain_procedural_height, &seed, NULL) != 0) {
+        printf("%dx%d: out of memory\n", size, size);
+        return 1;
+    }
+    double start = timing_seconds();
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            size_t i = (size_t)z * size + x;
+            float h = terrain_procedural_height(&seed, x, z);
+            field.positions[i * 3 + 0] = (float)x;
+            field.positions[i * 3 + 1] = h * 120.0f;
+            field.positions[i * 3 + 2] = (float)z;
+            terrain_height_colors(&h, 1, &field.colors[i * 3]);
+        }
+    }
+    printf("%dx%d heightfield\n", size, size);
+    printf("  per-sample loop, no normals: %8.1f ms\n", (timing_seconds() - start) * 1000.0);
+    heightfield_free(&field);
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        thread_pool_t* pool = thread_pool_create(threads);
+
+        start = timing_seconds();
+        int failed = heightfield_build(&field, size, size, 1.0f, 120.0f,
+                                       terrain_procedural_height, &seed, pool) != 0;
+        double ms = (timing_seconds() - start) * 1000.0;
+        thread_pool_destroy(pool);
+        if (failed) {
+            printf("  out of memory\n");
+            return 1;
+        }
+
+        unsigned int hash = hash_heightfield(&field);
+        if (threads == 1) first_hash = hash;
+        identical = identical && hash == first_hash;
+        printf("  build, %2d thread%s:           %8.1f ms  hash %08x\n",
+               threads, threads == 1 ? " " : "s", ms, hash);
+        heightfield_free(&field);
+    }
+    printf("  %s (on %d CPUs)\n", identical ? "Every build identical" : "BUILDS DIFFER",
+           thread_pool_cpu_count());
+    return identical ? 0 : 1;
+}
+
+/* Rolling hills over the whole grid, whatever its size */
+float wave_height(void* ctx, int x, int z) {
+    float n = (float)*(int*)ctx;
+    float fx = x / n * 6.2831853f, fz = z / n * 6.2831853f;
+    return (sinf(fx * 1.5f) * cosf(fz) + sinf(fx * 0.5f + fz * 2.0f) * 0.5f + 1.5f) / 3.0f;
+}
+
+void draw_lit_grid(const heightfield_t* field, const unsigned int* list, int count,
+                   const light_bake_t* lights, const float* baked) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    gluLookAt(4, 6, 11, 4, 0, 3.5, 0, 1, 0);
+    glVertexPointer(3, GL_FLOAT, 0, field->positions);
+    if (baked) {
+        glColorPointer(3, GL_FLOAT, 0, baked);
+    } else {
+        light_bake_apply(lights);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, field->normals);
+        glColorPointer(3, GL_FLOAT, 0, field->colors);
+    }
+    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, list);
+    if (!baked) {
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisable(GL_LIGHTING);
+    }
+}
+
+#define BAKE_TOLERANCE 3   /* Largest difference per channel, out of 255 */
+
+/*
+ * bench_lighting - Draw lit grids offscreen with glLight ("live") and with
+ * baked colours ("baked"), time both, and compare the images pixel by pixel
+ *
+ * Counts are grid sizes in quads. A sun and an attenuated point light
+ * shine on a shiny material, so every term of the lighting model is used.
+ * Fails if any channel of any pixel differs by more than BAKE_TOLERANCE.
+ */
+int bench_lighting(int argc, char** argv) {
+    static const int default_counts[] = {64, 256};
+    static const char* const modes[] = {"live", "baked"};
+    bench_options_t opts;
+    bench_report_t report;
+    FILE* out = stdout;
+    int passed = 1;
+
+    /* A 1024-quad grid takes most of a second a frame in software, so it
+     * is only drawn when asked for, and few frames are enough either way */
+    bench_options_init(&opts);
+    opts.frames = 20;
+    opts.warmup = 3;
+    if (bench_parse_args(&opts, argc, argv) != 0) {
+        bench_print_usage(argv[0], "--bench-lighting");
+        fprintf(stderr, "  Modes: live, baked. Counts are grid sizes in quads (default 64,256).\n");
+        return 1;
+    }
+    if (opts.count_count == 0) {
+        opts.count_count = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(opts.counts, default_counts, sizeof(default_counts));
+    }
+
+    if (offscreen_create(&argc, argv, opts.width, opts.height, opts.software) != 0) {
+        return 1;
+    }
+    if (opts.output && !(out = fopen(opts.output, "w"))) {
+        perror(opts.output);
+        offscreen_destroy();
+        return 1;
+    }
+
+    size_t pixels = (size_t)opts.width * opts.height * 3;
+    double* frame_ms = malloc(opts.frames * sizeof(double));
+    unsigned char* images[2] = {malloc(pixels), malloc(pixels)};
+    if (!frame_ms || !images[0] || !images[1]) {
+        fprintf(stderr, "Out of memory\n");
+        free(frame_ms);
+        free(images[0]);
+        free(images[1]);
+        if (out != stdout) fclose(out);
+        offscreen_destroy();
+        return 1;
+    }
+
+    light_bake_t lights;
+    light_bake_defaults(&lights);
+    lights.material.color_material = 1;
+    lights.material.specular[0] = lights.material.specular[1] = lights.material.specular[2] = 0.4f;
+    lights.material.shininess = 24.0f;
+    bake_light_t* sun = light_bake_add_directional(&lights, 0.4f, 1.0f, 0.5f);
+    sun->diffuse[0] = sun->diffuse[1] = sun->diffuse[2] = 0.7f;
+    bake_light_t* lamp = light_bake_add_point(&lights, 2.0f, 2.0f, 5.0f);
+    lamp->diffuse[1] = 0.8f;
+    lamp->diffuse[2] = 0.5f;
+    lamp->ambient[0] = lamp->ambient[1] = lamp->ambient[2] = 0.1f;
+    lamp->attenuation[1] = 0.2f;
+    lamp->attenuation[2] = 0.05f;
+
+    glClearColor(0.3f, 0.4f, 0.6f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glViewport(0, 0, opts.width, opts.height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(45.0, (double)opts.width / opts.height, 0.1, 100.0);
+    glMatrixMode(GL_MODELVIEW);
+
+    /* Specular depends on the view, so bake for the one the bench uses */
+    GLfloat view[16];
+    glLoadIdentity();
+    gluLookAt(4, 6, 11, 4, 0, 3.5, 0, 1, 0);
+    glGetFloatv(GL_MODELVIEW_MATRIX, view);
+    light_bake_set_view(&lights, view);
+
+    bench_report_begin(&report, out, opts.format, "chapter_12",
+                       (const char*)glGetString(GL_RENDERER), offscreen_backend());
+
+    for (int c = 0; c < opts.count_count; c++) {
+        int n = opts.counts[c], verts = (n + 1) * (n + 1), count = n * n * 6, idx = 0;
+        heightfield_t field;
+        unsigned int* list = malloc((size_t)count * sizeof(unsigned int));
+        float* baked = malloc((size_t)verts * 3 * sizeof(float));
+
+        if (!list || !baked || heightfield_build(&field, n + 1, n + 1, 8.0f / n, 1.5f,
+                                                 wave_height, &n, NULL) != 0) {
+            fprintf(stderr, "%d: out of memory\n", n);
+            free(list);
+            free(baked);
+            passed = 0;
+            break;
+        }
+        for (int z = 0; z < n; z++) {
+            for (int x = 0; x < n; x++) {
+                unsigned int i0 = z * (n + 1) + x, i2 = i0 + n + 1;
+                list[idx++] = i0;     list[idx++] = i2; list[idx++] = i0 + 1;
+                list[idx++] = i0 + 1; list[idx++] = i2; list[idx++] = i2 + 1;
+            }
+        }
+
+        double start = timing_seconds();
+        light_bake_vertices(&lights, field.positions, field.normals, field.colors, verts, baked);
+        double bake_ms = (timing_seconds() - start) * 1000.0;
+
+        for (int mode = 0; mode < 2; mode++) {
+            const float* colors = mode == 1 ? baked : NULL;
+            bench_result_t result;
+
+            for (int f = 0; f < opts.warmup; f++) {
+                draw_lit_grid(&field, list, count, &lights, colors);
+                glFinish();
+            }
+            for (int f = 0; f < opts.frames; f++) {
+                uint64_t frame_start = timing_now_ns();
+                draw_lit_grid(&field, list, count, &lights, colors);
+                glFinish();
+                frame_ms[f] = (timing_now_ns() - frame_start) / 1e6;
+            }
+            glReadPixels(0, 0, opts.width, opts.height, GL_RGB, GL_UNSIGNED_BYTE, images[mode]);
+
+            if (!bench_mode_selected(&opts, modes[mode])) continue;
+            memset(&result, 0, sizeof(result));
+            result.mode = modes[mode];
+            result.objects = n;
+            result.bytes = (double)verts * (mode == 1 ? 6 : 9) * sizeof(float);
+            bench_compute(&result, frame_ms, opts.frames, 1.0, count);
+            result.prep_ms = mode == 1 ? bake_ms : 0.0;
+            bench_report_add(&report, &result);
+        }
+
+        int max_diff = 0, over = 0;
+        double total = 0.0;
+        for (size_t i = 0; i < pixels; i++) {
+            int d = abs(images[0][i] - images[1][i]);
+            if (d > max_diff) max_diff = d;
+            if (d > 1) over++;
+            total += d;
+        }
+        passed = passed && max_diff <= BAKE_TOLERANCE;
+        fprintf(stderr, "  %4d quads: baked %d vertices in %.2f ms; live vs baked: max %d, "
+                "mean %.4f, %d channels off by more than 1 - %s\n",
+                n, verts, bake_ms, max_diff, total / pixels, over,
+                max_diff <= BAKE_TOLERANCE ? "match" : "DIFFERENT");
+
+        heightfield_free(&field);
+        free(list);
+        free(baked);
+    }
+
+    bench_report_end(&report);
+    free(frame_ms);
+    free(images[0]);
+    free(images[1]);
+    if (out != stdout) fclose(out);
+    offscreen_destroy();
+    return passed ? 0 : 1;
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench-build") == 0) {
+        return bench_build(argc > 2 ? atoi(argv[2]) : 4096);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return run_benchmark(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-lighting") == 0) {
+        return bench_lighting(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-meshopt") == 0) {
+        return bench_mesh_opt(argc > 2 ? atoi(argv[2]) : 4096);
+    }
+    if (argc > 2 && strcmp(argv[1], "--heightmap") == 0) {
+        /* --heightmap FILE [WIDTH HEIGHT BITS], the size only for RAW files */
+        heightmap = heightmap_open(argv[2], argc > 3 ? atoi(argv[3]) : 0,
+                                   argc > 4 ? atoi(argv[4]) : 0, argc > 5 ? atoi(argv[5]) : 0);
+        if (!heightmap) return 1;
+        printf("Heightmap: %s, %dx%d %d-bit\n", argv[2], heightmap->width,
+               heightmap->height, heightmap->bits);
+    }
+
     printf("Chapter 12: Vertex Arrays\nRendering %dx%d terrain grid\nW: Toggle wireframe\n", 
            GRID_SIZE, GRID_SIZE);
+    printf("S: Toggle drawing the grid as one triangle strip\n"
+           "C: Toggle compact (short/byte) and float vertices\n"
+           "L: Cycle lighting: off, live (glLight), baked into colours\n"
+           "B: Toggle baked lighting on the streamed terrain\n"
+           "F: Toggle frustum culling of terrain patches\n"
+           "T: Toggle the large streamed terrain\n"
+           "Arrows: Steer and change speed over the terrain\n");
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
     glutCreateWindow("Chapter 12: Vertex Arrays");
     init_gl();
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
+    glutSpecialFunc(special);
     glutMainLoop();
     return 0;
 }
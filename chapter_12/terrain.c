@@ -0,0 +1,1114 @@
+/*
+ * terrain.c - Chunked, streamed terrain with geomipmapping
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <GL/glut.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mat4.h"
+#include "mesh_opt.h"
+#include "quantize.h"
+#include "terrain.h"
+#include "thread_pool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TERRAIN_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#define PATCH_VERTS (TERRAIN_PATCH_QUADS + 1)
+#define RING_VERTS  (PATCH_VERTS + 2)   /* A patch plus one sample all round */
+#define MAX_THREADS 16
+
+enum { SIDE_NORTH, SIDE_SOUTH, SIDE_WEST, SIDE_EAST, SIDE_COUNT };
+
+enum { SLOT_EMPTY, SLOT_PENDING, SLOT_READY };
+
+typedef struct {
+    GLushort* indices;
+    int count;
+} index_list_t;
+
+typedef struct {
+    GLfloat* positions;          /* PATCH_VERTS^2 xyz, row-major by z */
+    GLfloat* colors;
+    GLshort* packed_positions;   /* Compact format instead: xyz plus padding */
+    GLubyte* packed_colors;      /* RGBA */
+    quantize_transform_t xf;     /* Undoes the packing, applied at draw time */
+    float min_y, max_y;
+} patch_data_t;
+
+typedef struct {
+    int px, pz;
+    int state;
+    unsigned ticket;             /* Bumped whenever the slot changes hands */
+    int lod;
+    patch_data_t* data;
+} patch_slot_t;
+
+typedef struct {
+    int slot, px, pz;
+    unsigned ticket;
+} patch_job_t;
+
+/* Quadtree over the window of patch slots around the camera. Level 0 has
+ * one node per patch; each level above merges 2x2 nodes. */
+typedef struct {
+    float min_y, max_y;
+    int count;                   /* Ready patches underneath */
+} quad_node_t;
+
+typedef struct {
+    int slot;
+    int lod;
+    int edge_lods[SIDE_COUNT];
+} patch_draw_t;
+
+typedef struct patch_result {
+    int slot;
+    unsigned ticket;
+    patch_data_t* data;
+    struct patch_result* next;
+} patch_result_t;
+
+struct terrain {
+    terrain_config_t config;
+    int patches_x, patches_z;
+    float patch_world;           /* World size of one patch */
+    light_bake_t lighting;       /* The config's lighting, if it had any */
+
+    /* Resident patches live in a toroidal grid one ring wider than the
+     * view radius, so a patch's slot is its coordinates modulo the grid */
+    int radius;
+    int grid_dim;
+    patch_slot_t* slots;
+    int (*ring)[2];              /* Offsets within the radius, nearest first */
+    int ring_count;
+
+    /* Frustum culling: the quadtree covers quad_size^2 patches from
+     * (window_x, window_z), and each frame's visible patches go to draws */
+    int center_x, center_z;
+    int window_x, window_z;
+    int quad_size, quad_levels;
+    quad_node_t* quad[16];
+    patch_draw_t* draws;
+    int draw_count;
+
+    index_list_t interior[TERRAIN_LODS];
+    index_list_t edges[SIDE_COUNT][TERRAIN_LODS][TERRAIN_LODS];
+
+    float cam_x, cam_z, cam_height;
+    terrain_stats_t stats;
+
+    /* Generator threads; everything below is protected by lock */
+    pthread_t threads[MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    patch_job_t* queue;
+    int queue_capacity, queue_head, queue_count;
+    int busy;
+    int shutdown;
+    patch_result_t* finished;
+};
+
+/* ------------------------------------------------------------------------
+ * Index lists
+ * ------------------------------------------------------------------------ */
+
+static void push_triangle(index_list_t* list, const int a[2], const int b[2], const int c[2]) {
+    /* Keep every triangle counter-clockwise seen from above */
+    int cross = (b[1] - a[1]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[1] - a[1]);
+    if (cross == 0) return;
+    if (cross < 0) {
+        const int* t = b;
+        b = c;
+        c = t;
+    }
+    list->indices[list->count++] = (GLushort)(a[1] * PATCH_VERTS + a[0]);
+    list->indices[list->count++] = (GLushort)(b[1] * PATCH_VERTS + b[0]);
+    list->indices[list->count++] = (GLushort)(c[1] * PATCH_VERTS + c[0]);
+}
+
+static int build_interior(index_list_t* list, int step) {
+    int n = TERRAIN_PATCH_QUADS;
+    int cells = (n - 2 * step) / step;
+
+    list->count = 0;
+    list->indices = malloc((size_t)(cells > 0 ? cells * cells * 6 : 1) * sizeof(GLushort));
+    if (!list->indices) return -1;
+
+    for (int z = step; z < n - step; z += step) {
+        for (int x = step; x < n - step; x += step) {
+            int p0[2] = {x, z}, p1[2] = {x + step, z};
+            int p2[2] = {x, z + step}, p3[2] = {x + step, z + step};
+            push_triangle(list, p0, p2, p1);
+            push_triangle(list, p1, p2, p3);
+        }
+    }
+    return 0;
+}
+
+static void side_point(int side, int t, int depth, int out[2]) {
+    int n = TERRAIN_PATCH_QUADS;
+    switch (side) {
+        case SIDE_NORTH: out[0] = t;         out[1] = depth;     break;
+        case SIDE_SOUTH: out[0] = t;         out[1] = n - depth; break;
+        case SIDE_WEST:  out[0] = depth;     out[1] = t;         break;
+        default:         out[0] = n - depth; out[1] = t;         break;
+    }
+}
+
+/*
+ * The ring of cells along one side, between the patch border (vertices
+ * every 'edge_step', matching the neighbour) and the first interior row
+ * (vertices every 'step'). The two rows are zipped together by always
+ * advancing whichever has the nearer next vertex.
+ */
+static int build_edge(index_list_t* list, int side, int step, int edge_step) {
+    int n = TERRAIN_PATCH_QUADS;
+    int outer_count = n / edge_step + 1;
+    int inner_count = (n - 2 * step) / step + 1;
+    int i = 0, j = 0;
+
+    list->count = 0;
+    list->indices = malloc((size_t)(outer_count + inner_count) * 3 * sizeof(GLushort));
+    if (!list->indices) return -1;
+
+    while (i < outer_count - 1 || j < inner_count - 1) {
+        int o0[2], o1[2], i0[2], i1[2];
+        int next_outer = (i + 1) * edge_step;
+        int next_inner = step + (j + 1) * step;
+
+        side_point(side, i * edge_step, 0, o0);
+        side_point(side, step + j * step, step, i0);
+        if (j == inner_count - 1 || (i < outer_count - 1 && next_outer <= next_inner)) {
+            side_point(side, next_outer, 0, o1);
+            push_triangle(list, o0, o1, i0);
+            i++;
+        } else {
+            side_point(side, next_inner, step, i1);
+            push_triangle(list, o0, i1, i0);
+            j++;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Reorder a list for the post-transform vertex cache. Built row by row, a
+ * full-detail interior transforms each vertex about twice; in cache order
+ * it is closer to once. The edge lists are a single zipped row, which is
+ * already cache order.
+ */
+static int optimize_list(index_list_t* list) {
+    unsigned int* indices = malloc((size_t)(list->count > 0 ? list->count : 1) * sizeof(unsigned int));
+    if (!indices) return -1;
+
+    for (int i = 0; i < list->count; i++) indices[i] = list->indices[i];
+    if (mesh_optimize_vertex_cache(indices, list->count, PATCH_VERTS * PATCH_VERTS, 0) != 0) {
+        free(indices);
+        return -1;
+    }
+    for (int i = 0; i < list->count; i++) list->indices[i] = (GLushort)indices[i];
+    free(indices);
+    return 0;
+}
+
+static int build_index_lists(terrain_t* t) {
+    for (int lod = 0; lod < TERRAIN_LODS; lod++) {
+        if (build_interior(&t->interior[lod], 1 << lod) != 0) return -1;
+        if (optimize_list(&t->interior[lod]) != 0) return -1;
+        for (int side = 0; side < SIDE_COUNT; side++) {
+            for (int nlod = 0; nlod < TERRAIN_LODS; nlod++) {
+                int edge_lod = nlod > lod ? nlod : lod;
+                if (build_edge(&t->edges[side][lod][nlod], side, 1 << lod, 1 << edge_lod) != 0) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Patch generation (generator threads)
+ * ------------------------------------------------------------------------ */
+
+/*
+ * Height colour ramp. Written as a sum of clamped segments rather than a
+ * search for the segment, so four samples can take the same path.
+ */
+#define RAMP_STOPS 5
+
+static const float ramp_height[RAMP_STOPS] = {0.00f, 0.25f, 0.55f, 0.75f, 0.90f};
+static const float ramp_color[RAMP_STOPS][3] = {
+    {0.76f, 0.70f, 0.50f},   /* Sand */
+    {0.30f, 0.60f, 0.25f},   /* Grass */
+    {0.25f, 0.45f, 0.20f},   /* Forest */
+    {0.50f, 0.45f, 0.40f},   /* Rock */
+    {0.95f, 0.95f, 0.97f},   /* Snow */
+};
+
+static float ramp_weight(float h, int i) {
+    float f = (h - ramp_height[i-1]) / (ramp_height[i] - ramp_height[i-1]);
+    return f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f;
+}
+
+void terrain_height_colors(const float* heights, int count, float* rgb) {
+    int i = 0;
+#ifdef TERRAIN_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128 h = _mm_loadu_ps(heights + i);
+        __m128 c[4];
+
+        for (int k = 0; k < 3; k++) c[k] = _mm_set1_ps(ramp_color[0][k]);
+        for (int s = 1; s < RAMP_STOPS; s++) {
+            __m128 f = _mm_div_ps(_mm_sub_ps(h, _mm_set1_ps(ramp_height[s-1])),
+                                  _mm_set1_ps(ramp_height[s] - ramp_height[s-1]));
+            f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            for (int k = 0; k < 3; k++) {
+                float delta = ramp_color[s][k] - ramp_color[s-1][k];
+                c[k] = _mm_add_ps(c[k], _mm_mul_ps(_mm_set1_ps(delta), f));
+            }
+        }
+
+        /* Four rgb0 rows, one per sample */
+        c[3] = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+        for (int k = 0; k < 4; k++) {
+            float* out = rgb + (i + k) * 3;
+            _mm_storel_pi((__m64*)out, c[k]);
+            _mm_store_ss(out + 2, _mm_movehl_ps(c[k], c[k]));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        float* out = rgb + i * 3;
+        for (int k = 0; k < 3; k++) out[k] = ramp_color[0][k];
+        for (int s = 1; s < RAMP_STOPS; s++) {
+            float f = ramp_weight(heights[i], s);
+            for (int k = 0; k < 3; k++) out[k] += (ramp_color[s][k] - ramp_color[s-1][k]) * f;
+        }
+    }
+}
+
+/* Vertex data held by one patch */
+static size_t patch_bytes(const terrain_t* t) {
+    size_t verts = (size_t)PATCH_VERTS * PATCH_VERTS;
+    return t->config.compact ? verts * (4 * sizeof(GLshort) + 4 * sizeof(GLubyte))
+                             : verts * 6 * sizeof(GLfloat);
+}
+
+/* Unit normals from central differences over the ring of heights */
+static void patch_normals(const terrain_config_t* cfg, const float* around, float* normals) {
+    float scale = cfg->height_scale / (2 * cfg->spacing);
+
+    for (int z = 0; z < PATCH_VERTS; z++) {
+        for (int x = 0; x < PATCH_VERTS; x++) {
+            const float* h = around + (z + 1) * RING_VERTS + x + 1;
+            float gx = (h[1] - h[-1]) * scale;
+            float gz = (h[RING_VERTS] - h[-RING_VERTS]) * scale;
+            float len = sqrtf(gx * gx + 1.0f + gz * gz);
+            float* n = normals + (z * PATCH_VERTS + x) * 3;
+
+            n[0] = -gx / len;
+            n[1] = 1.0f / len;
+            n[2] = -gz / len;
+        }
+    }
+}
+
+static patch_data_t* build_patch(const terrain_t* t, int px, int pz) {
+    const terrain_config_t* cfg = &t->config;
+    int verts = PATCH_VERTS * PATCH_VERTS;
+    patch_data_t* data = malloc(sizeof(patch_data_t) + patch_bytes(t));
+    if (!data) return NULL;
+
+    /* The compact format is packed from floats built in a scratch buffer */
+    GLfloat* positions = (GLfloat*)(data + 1);
+    if (cfg->compact) {
+        positions = malloc((size_t)verts * 6 * sizeof(GLfloat));
+        if (!positions) {
+            free(data);
+            return NULL;
+        }
+    }
+    GLfloat* colors = positions + verts * 3;
+
+    /* Lighting needs normals, and they need a ring of heights around the
+     * patch so neighbouring patches agree along their shared edge */
+    float* around = NULL;
+    if (cfg->lighting) {
+        around = malloc((size_t)(RING_VERTS * RING_VERTS + verts * 3) * sizeof(float));
+        if (!around) {
+            if (cfg->compact) free(positions);
+            free(data);
+            return NULL;
+        }
+    }
+
+    data->min_y = cfg->height_scale;
+    data->max_y = 0.0f;
+
+    int base_x = px * TERRAIN_PATCH_QUADS;
+    int base_z = pz * TERRAIN_PATCH_QUADS;
+    if (around) {
+        for (int z = 0; z < RING_VERTS; z++) {
+            terrain_sample_row(cfg->height, cfg->height_ctx, base_x - 1, base_z - 1 + z,
+                               RING_VERTS, around + z * RING_VERTS);
+        }
+    }
+    for (int z = 0; z < PATCH_VERTS; z++) {
+        float row[PATCH_VERTS];
+        const float* heights = row;
+
+        if (around) {
+            heights = around + (z + 1) * RING_VERTS + 1;
+        } else {
+            terrain_sample_row(cfg->height, cfg->height_ctx, base_x, base_z + z, PATCH_VERTS, row);
+        }
+        terrain_height_colors(heights, PATCH_VERTS, &colors[z * PATCH_VERTS * 3]);
+        for (int x = 0; x < PATCH_VERTS; x++) {
+            float y = heights[x] * cfg->height_scale;
+            GLfloat* p = &positions[(z * PATCH_VERTS + x) * 3];
+
+            p[0] = (base_x + x) * cfg->spacing;
+            p[1] = y;
+            p[2] = (base_z + z) * cfg->spacing;
+            if (y < data->min_y) data->min_y = y;
+            if (y > data->max_y) data->max_y = y;
+        }
+    }
+
+    if (around) {
+        float* normals = around + RING_VERTS * RING_VERTS;
+        patch_normals(cfg, around, normals);
+        light_bake_vertices(cfg->lighting, positions, normals, colors, verts, colors);
+        free(around);
+    }
+
+    if (cfg->compact) {
+        data->positions = data->colors = NULL;
+        data->packed_positions = (GLshort*)(data + 1);
+        data->packed_colors = (GLubyte*)(data->packed_positions + verts * 4);
+        quantize_positions(positions, 3, verts, data->packed_positions, 4, &data->xf);
+        quantize_colors(colors, 3, verts, data->packed_colors);
+        free(positions);
+    } else {
+        data->positions = positions;
+        data->colors = colors;
+        data->packed_positions = NULL;
+        data->packed_colors = NULL;
+        memset(&data->xf, 0, sizeof(data->xf));
+    }
+    return data;
+}
+
+static void* generator_main(void* arg) {
+    terrain_t* t = arg;
+
+    pthread_mutex_lock(&t->lock);
+    for (;;) {
+        while (!t->shutdown && t->queue_count == 0) {
+            pthread_cond_wait(&t->work_ready, &t->lock);
+        }
+        if (t->shutdown) break;
+
+        patch_job_t job = t->queue[t->queue_head];
+        t->queue_head = (t->queue_head + 1) % t->queue_capacity;
+        t->queue_count--;
+
+        /* The slot was reassigned or evicted after this job was queued */
+        if (t->slots[job.slot].ticket != job.ticket) {
+            if (t->queue_count == 0 && t->busy == 0) pthread_cond_broadcast(&t->work_done);
+            continue;
+        }
+
+        t->busy++;
+        pthread_mutex_unlock(&t->lock);
+
+        patch_result_t* result = malloc(sizeof(patch_result_t));
+        patch_data_t* data = build_patch(t, job.px, job.pz);
+
+        pthread_mutex_lock(&t->lock);
+        if (result) {
+            result->slot = job.slot;
+            result->ticket = job.ticket;
+            result->data = data;
+            result->next = t->finished;
+            t->finished = result;
+        } else {
+            free(data);
+        }
+        t->busy--;
+        if (t->queue_count == 0 && t->busy == 0) pthread_cond_broadcast(&t->work_done);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------
+ * Streaming (main thread)
+ * ------------------------------------------------------------------------ */
+
+static int wrap(int v, int dim) {
+    int m = v % dim;
+    return m < 0 ? m + dim : m;
+}
+
+static patch_slot_t* slot_for(terrain_t* t, int px, int pz) {
+    return &t->slots[wrap(pz, t->grid_dim) * t->grid_dim + wrap(px, t->grid_dim)];
+}
+
+/* Horizontal distance from the camera to the nearest point of a patch */
+static float patch_distance(const terrain_t* t, int px, int pz) {
+    float x0 = px * t->patch_world, z0 = pz * t->patch_world;
+    float dx = t->cam_x < x0 ? x0 - t->cam_x
+             : (t->cam_x > x0 + t->patch_world ? t->cam_x - x0 - t->patch_world : 0.0f);
+    float dz = t->cam_z < z0 ? z0 - t->cam_z
+             : (t->cam_z > z0 + t->patch_world ? t->cam_z - z0 - t->patch_world : 0.0f);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+static int in_terrain(const terrain_t* t, int px, int pz) {
+    return px >= 0 && pz >= 0 && px < t->patches_x && pz < t->patches_z;
+}
+
+/* Level of detail from the 3D distance; a function of the patch
+ * coordinates only, so neighbours always agree on each other's level */
+static int patch_lod(const terrain_t* t, int px, int pz) {
+    float d = patch_distance(t, px, pz);
+    float dist = sqrtf(d * d + t->cam_height * t->cam_height);
+    int lod = 0;
+
+    while (lod < TERRAIN_LODS - 1 && dist > t->config.lod_distance * (float)(1 << lod)) {
+        lod++;
+    }
+    return lod;
+}
+
+static void release_slot(terrain_t* t, patch_slot_t* slot) {
+    free(slot->data);
+    slot->data = NULL;
+    slot->state = SLOT_EMPTY;
+    pthread_mutex_lock(&t->lock);
+    slot->ticket++;              /* Cancels any queued job for the old patch */
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void collect_finished(terrain_t* t) {
+    pthread_mutex_lock(&t->lock);
+    patch_result_t* result = t->finished;
+    t->finished = NULL;
+    pthread_mutex_unlock(&t->lock);
+
+    while (result) {
+        patch_result_t* next = result->next;
+        patch_slot_t* slot = &t->slots[result->slot];
+
+        if (slot->ticket == result->ticket && slot->state == SLOT_PENDING && result->data) {
+            slot->data = result->data;
+            slot->state = SLOT_READY;
+        } else {
+            free(result->data);
+        }
+        free(result);
+        result = next;
+    }
+}
+
+static void refresh_slots(terrain_t* t);
+
+void terrain_config_defaults(terrain_config_t* config) {
+    static unsigned int default_seed = 1234;
+
+    memset(config, 0, sizeof(*config));
+    config->size_x = 8193;
+    config->size_z = 8193;
+    config->spacing = 1.0f;
+    config->height_scale = 120.0f;
+    config->lod_distance = 48.0f;
+    config->view_distance = 600.0f;
+    config->compact = 1;
+    config->cull = 1;
+    config->height = terrain_procedural_height;
+    config->height_ctx = &default_seed;
+}
+
+terrain_t* terrain_create(const terrain_config_t* config) {
+    terrain_t* t = calloc(1, sizeof(terrain_t));
+    if (!t) return NULL;
+
+    t->config = *config;
+    if (config->lighting) {
+        t->lighting = *config->lighting;
+        t->config.lighting = &t->lighting;
+    }
+    t->patches_x = (config->size_x - 1) / TERRAIN_PATCH_QUADS;
+    t->patches_z = (config->size_z - 1) / TERRAIN_PATCH_QUADS;
+    t->patch_world = TERRAIN_PATCH_QUADS * config->spacing;
+    t->radius = (int)ceilf(config->view_distance / t->patch_world);
+    t->grid_dim = 2 * (t->radius + 1) + 1;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->work_ready, NULL);
+    pthread_cond_init(&t->work_done, NULL);
+
+    int slot_count = t->grid_dim * t->grid_dim;
+    int side = 2 * t->radius + 1;
+    t->slots = calloc(slot_count, sizeof(patch_slot_t));
+    t->ring = malloc(side * side * sizeof(*t->ring));
+    t->queue_capacity = 2 * slot_count;
+    t->queue = malloc(t->queue_capacity * sizeof(patch_job_t));
+    t->draws = malloc(slot_count * sizeof(patch_draw_t));
+    if (!t->slots || !t->ring || !t->queue || !t->draws || build_index_lists(t) != 0) {
+        terrain_destroy(t);
+        return NULL;
+    }
+
+    /* The quadtree window has to reach a patch kept by the hysteresis
+     * (radius + 2 from the camera's patch) on either side */
+    for (t->quad_size = 1; t->quad_size < 2 * (t->radius + 3); t->quad_size *= 2) {}
+    for (int size = t->quad_size; size >= 1; size /= 2) {
+        t->quad[t->quad_levels] = calloc((size_t)size * size, sizeof(quad_node_t));
+        if (!t->quad[t->quad_levels++]) {
+            terrain_destroy(t);
+            return NULL;
+        }
+    }
+
+    /* Offsets sorted nearest first, so the closest patches load first */
+    for (int dz = -t->radius; dz <= t->radius; dz++) {
+        for (int dx = -t->radius; dx <= t->radius; dx++) {
+            int k = t->ring_count++;
+            int d2 = dx * dx + dz * dz;
+            while (k > 0 && t->ring[k-1][0] * t->ring[k-1][0] +
+                            t->ring[k-1][1] * t->ring[k-1][1] > d2) {
+                t->ring[k][0] = t->ring[k-1][0];
+                t->ring[k][1] = t->ring[k-1][1];
+                k--;
+            }
+            t->ring[k][0] = dx;
+            t->ring[k][1] = dz;
+        }
+    }
+
+    int threads = config->threads > 0 ? config->threads : thread_pool_cpu_count();
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&t->threads[i], NULL, generator_main, t) != 0) break;
+        t->thread_count++;
+    }
+    if (t->thread_count == 0) {
+        terrain_destroy(t);
+        return NULL;
+    }
+    return t;
+}
+
+void terrain_destroy(terrain_t* t) {
+    if (!t) return;
+
+    pthread_mutex_lock(&t->lock);
+    t->shutdown = 1;
+    pthread_cond_broadcast(&t->work_ready);
+    pthread_mutex_unlock(&t->lock);
+    for (int i = 0; i < t->thread_count; i++) pthread_join(t->threads[i], NULL);
+
+    collect_finished(t);
+    if (t->slots) {
+        for (int i = 0; i < t->grid_dim * t->grid_dim; i++) free(t->slots[i].data);
+    }
+    for (int lod = 0; lod < TERRAIN_LODS; lod++) {
+        free(t->interior[lod].indices);
+        for (int side = 0; side < SIDE_COUNT; side++) {
+            for (int nlod = 0; nlod < TERRAIN_LODS; nlod++) {
+                free(t->edges[side][lod][nlod].indices);
+            }
+        }
+    }
+    pthread_cond_destroy(&t->work_done);
+    pthread_cond_destroy(&t->work_ready);
+    pthread_mutex_destroy(&t->lock);
+    for (int l = 0; l < t->quad_levels; l++) free(t->quad[l]);
+    free(t->draws);
+    free(t->queue);
+    free(t->ring);
+    free(t->slots);
+    free(t);
+}
+
+void terrain_update(terrain_t* t, float cam_x, float cam_y, float cam_z) {
+    int center_x, center_z, queued = 0;
+
+    t->cam_x = cam_x;
+    t->cam_z = cam_z;
+    t->cam_height = fabsf(cam_y - terrain_height_at(t, cam_x, cam_z));
+    center_x = (int)floorf(cam_x / t->patch_world);
+    center_z = (int)floorf(cam_z / t->patch_world);
+    t->center_x = center_x;
+    t->center_z = center_z;
+
+    collect_finished(t);
+
+    /* Drop patches that have fallen out of range, with one patch of
+     * hysteresis so hovering on a border does not thrash */
+    for (int i = 0; i < t->grid_dim * t->grid_dim; i++) {
+        patch_slot_t* slot = &t->slots[i];
+        if (slot->state != SLOT_EMPTY &&
+            patch_distance(t, slot->px, slot->pz) > t->config.view_distance + t->patch_world) {
+            release_slot(t, slot);
+        }
+    }
+
+    pthread_mutex_lock(&t->lock);
+    for (int r = 0; r < t->ring_count; r++) {
+        int px = center_x + t->ring[r][0];
+        int pz = center_z + t->ring[r][1];
+        if (!in_terrain(t, px, pz) || patch_distance(t, px, pz) > t->config.view_distance) {
+            continue;
+        }
+
+        patch_slot_t* slot = slot_for(t, px, pz);
+        if (slot->state != SLOT_EMPTY && slot->px == px && slot->pz == pz) continue;
+        if (t->queue_count == t->queue_capacity) break;
+
+        /* Whatever held the slot is farther away than the radius */
+        free(slot->data);
+        slot->data = NULL;
+        slot->px = px;
+        slot->pz = pz;
+        slot->state = SLOT_PENDING;
+        slot->ticket++;
+
+        patch_job_t* job = &t->queue[(t->queue_head + t->queue_count) % t->queue_capacity];
+        job->slot = (int)(slot - t->slots);
+        job->px = px;
+        job->pz = pz;
+        job->ticket = slot->ticket;
+        t->queue_count++;
+        queued++;
+    }
+    if (queued) pthread_cond_broadcast(&t->work_ready);
+    pthread_mutex_unlock(&t->lock);
+
+    refresh_slots(t);
+}
+
+void terrain_wait(terrain_t* t) {
+    pthread_mutex_lock(&t->lock);
+    while (t->queue_count > 0 || t->busy > 0) {
+        pthread_cond_wait(&t->work_done, &t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    collect_finished(t);
+    refresh_slots(t);
+}
+
+/* The levels of detail a patch's four edges are stitched to */
+static void edge_lods(const terrain_t* t, const patch_slot_t* slot, int lods[SIDE_COUNT]) {
+    static const int neighbours[SIDE_COUNT][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+
+    for (int side = 0; side < SIDE_COUNT; side++) {
+        int nx = slot->px + neighbours[side][0];
+        int nz = slot->pz + neighbours[side][1];
+        lods[side] = in_terrain(t, nx, nz) ? patch_lod(t, nx, nz) : slot->lod;
+    }
+}
+
+static long patch_triangles(const terrain_t* t, const patch_slot_t* slot) {
+    int lods[SIDE_COUNT];
+    long count = t->interior[slot->lod].count;
+
+    edge_lods(t, slot, lods);
+    for (int side = 0; side < SIDE_COUNT; side++) {
+        count += t->edges[side][slot->lod][lods[side]].count;
+    }
+    return count / 3;
+}
+
+/* Rebuild the quadtree over the window centred on the camera's patch */
+static void build_quadtree(terrain_t* t) {
+    int size = t->quad_size;
+
+    t->window_x = t->center_x - size / 2;
+    t->window_z = t->center_z - size / 2;
+    memset(t->quad[0], 0, (size_t)size * size * sizeof(quad_node_t));
+    for (int i = 0; i < t->grid_dim * t->grid_dim; i++) {
+        const patch_slot_t* slot = &t->slots[i];
+        int x = slot->px - t->window_x, z = slot->pz - t->window_z;
+        if (slot->state != SLOT_READY || x < 0 || z < 0 || x >= size || z >= size) continue;
+
+        quad_node_t* leaf = &t->quad[0][z * size + x];
+        leaf->min_y = slot->data->min_y;
+        leaf->max_y = slot->data->max_y;
+        leaf->count = 1;
+    }
+
+    for (int l = 1; l < t->quad_levels; l++) {
+        int dim = size >> l;
+        for (int z = 0; z < dim; z++) {
+            for (int x = 0; x < dim; x++) {
+                quad_node_t* node = &t->quad[l][z * dim + x];
+                node->count = 0;
+                for (int k = 0; k < 4; k++) {
+                    const quad_node_t* child =
+                        &t->quad[l-1][(2 * z + k / 2) * (2 * dim) + 2 * x + k % 2];
+                    if (child->count == 0) continue;
+                    if (node->count == 0 || child->min_y < node->min_y) node->min_y = child->min_y;
+                    if (node->count == 0 || child->max_y > node->max_y) node->max_y = child->max_y;
+                    node->count += child->count;
+                }
+            }
+        }
+    }
+}
+
+/* Pick each ready patch's level of detail and recount the statistics */
+static void refresh_slots(terrain_t* t) {
+    t->stats.resident = 0;
+    t->stats.pending = 0;
+    t->stats.bytes = 0;
+    t->stats.max_error = 0.0f;
+    t->stats.total_triangles = 0;
+    for (int i = 0; i < t->grid_dim * t->grid_dim; i++) {
+        patch_slot_t* slot = &t->slots[i];
+        if (slot->state == SLOT_READY) {
+            slot->lod = patch_lod(t, slot->px, slot->pz);
+            t->stats.resident++;
+            t->stats.bytes += patch_bytes(t);
+            for (int k = 0; k < 3; k++) {
+                if (slot->data->xf.max_error[k] > t->stats.max_error) {
+                    t->stats.max_error = slot->data->xf.max_error[k];
+                }
+            }
+        } else if (slot->state == SLOT_PENDING) {
+            t->stats.pending++;
+        }
+    }
+
+    /* Needs every patch's level first */
+    for (int i = 0; i < t->grid_dim * t->grid_dim; i++) {
+        if (t->slots[i].state == SLOT_READY) {
+            t->stats.total_triangles += patch_triangles(t, &t->slots[i]);
+        }
+    }
+    build_quadtree(t);
+}
+
+static void draw_list(terrain_t* t, const index_list_t* list) {
+    if (list->count == 0) return;
+    glDrawElements(GL_TRIANGLES, list->count, GL_UNSIGNED_SHORT, list->indices);
+    t->stats.triangles += list->count / 3;
+    t->stats.draw_calls++;
+}
+
+static void add_draw(terrain_t* t, const patch_slot_t* slot) {
+    patch_draw_t* draw = &t->draws[t->draw_count++];
+    draw->slot = (int)(slot - t->slots);
+    draw->lod = slot->lod;
+    edge_lods(t, slot, draw->edge_lods);
+}
+
+/* Frustum planes (a, b, c, d), inside where ax + by + cz + d >= 0, from
+ * the current projection and modelview matrices */
+static void frustum_planes(float planes[6][4]) {
+    float projection[16], modelview[16], m[16];
+
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    mat4_multiply(m, projection, modelview);
+
+    for (int i = 0; i < 6; i++) {
+        int row = i / 2;
+        float sign = i % 2 ? -1.0f : 1.0f;
+        for (int k = 0; k < 4; k++) planes[i][k] = m[k * 4 + 3] + sign * m[k * 4 + row];
+    }
+}
+
+/* 0 if the box is outside the frustum, 2 if wholly inside, 1 if it
+ * straddles a plane */
+static int box_in_frustum(const float planes[6][4], const float lo[3], const float hi[3]) {
+    int result = 2;
+    for (int i = 0; i < 6; i++) {
+        const float* p = planes[i];
+        /* The corners farthest along and against the plane's normal */
+        float far = p[3], near = p[3];
+        for (int k = 0; k < 3; k++) {
+            far += p[k] * (p[k] > 0.0f ? hi[k] : lo[k]);
+            near += p[k] * (p[k] > 0.0f ? lo[k] : hi[k]);
+        }
+        if (far < 0.0f) return 0;
+        if (near < 0.0f) result = 1;
+    }
+    return result;
+}
+
+static void cull_node(terrain_t* t, const float planes[6][4], int level, int x, int z,
+                      int inside) {
+    int dim = t->quad_size >> level;
+    const quad_node_t* node = &t->quad[level][z * dim + x];
+    if (node->count == 0) return;
+
+    if (!inside) {
+        float span = (float)(1 << level) * t->patch_world;
+        float lo[3] = {(t->window_x + (x << level)) * t->patch_world, node->min_y,
+                       (t->window_z + (z << level)) * t->patch_world};
+        float hi[3] = {lo[0] + span, node->max_y, lo[2] + span};
+
+        t->stats.nodes_tested++;
+        inside = box_in_frustum(planes, lo, hi);
+        if (inside == 0) {
+            t->stats.culled += node->count;
+            return;
+        }
+        inside = inside == 2;
+    }
+
+    if (level == 0) {
+        add_draw(t, slot_for(t, t->window_x + x, t->window_z + z));
+        return;
+    }
+    for (int k = 0; k < 4; k++) {
+        cull_node(t, planes, level - 1, 2 * x + k % 2, 2 * z + k / 2, inside);
+    }
+}
+
+/* Fill t->draws with the patches to draw this frame */
+static void collect_draws(terrain_t* t) {
+    int size = t->quad_size;
+
+    t->draw_count = 0;
+    if (t->config.cull) {
+        float planes[6][4];
+        frustum_planes(planes);
+        cull_node(t, planes, t->quad_levels - 1, 0, 0, 0);
+    }
+
+    /* Everything when not culling, plus any patch the window misses */
+    for (int i = 0; i < t->grid_dim * t->grid_dim; i++) {
+        const patch_slot_t* slot = &t->slots[i];
+        int x = slot->px - t->window_x, z = slot->pz - t->window_z;
+        if (slot->state != SLOT_READY) continue;
+        if (!t->config.cull || x < 0 || z < 0 || x >= size || z >= size) add_draw(t, slot);
+    }
+}
+
+void terrain_draw(terrain_t* t) {
+    t->stats.drawn = 0;
+    t->stats.culled = 0;
+    t->stats.nodes_tested = 0;
+    t->stats.triangles = 0;
+    t->stats.draw_calls = 0;
+    memset(t->stats.lod_patches, 0, sizeof(t->stats.lod_patches));
+
+    collect_draws(t);
+    for (int i = 0; i < t->draw_count; i++) {
+        const patch_draw_t* draw = &t->draws[i];
+        const patch_data_t* data = t->slots[draw->slot].data;
+
+        if (data->packed_positions) {
+            glPushMatrix();
+            glTranslatef(data->xf.offset[0], data->xf.offset[1], data->xf.offset[2]);
+            glScalef(data->xf.scale[0], data->xf.scale[1], data->xf.scale[2]);
+            glVertexPointer(3, GL_SHORT, 4 * sizeof(GLshort), data->packed_positions);
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, data->packed_colors);
+        } else {
+            glVertexPointer(3, GL_FLOAT, 0, data->positions);
+            glColorPointer(3, GL_FLOAT, 0, data->colors);
+        }
+
+        draw_list(t, &t->interior[draw->lod]);
+        for (int side = 0; side < SIDE_COUNT; side++) {
+            draw_list(t, &t->edges[side][draw->lod][draw->edge_lods[side]]);
+        }
+        if (data->packed_positions) glPopMatrix();
+        t->stats.drawn++;
+        t->stats.lod_patches[draw->lod]++;
+    }
+}
+
+float terrain_height_at(const terrain_t* t, float x, float z) {
+    const terrain_config_t* cfg = &t->config;
+    float sx = x / cfg->spacing, sz = z / cfg->spacing;
+    float max_x = (float)(cfg->size_x - 1), max_z = (float)(cfg->size_z - 1);
+
+    if (sx < 0.0f) sx = 0.0f;
+    if (sz < 0.0f) sz = 0.0f;
+    if (sx > max_x - 1.0f) sx = max_x - 1.0f;
+    if (sz > max_z - 1.0f) sz = max_z - 1.0f;
+
+    int ix = (int)sx, iz = (int)sz;
+    float fx = sx - ix, fz = sz - iz;
+    float h00 = cfg->height(cfg->height_ctx, ix, iz);
+    float h10 = cfg->height(cfg->height_ctx, ix + 1, iz);
+    float h01 = cfg->height(cfg->height_ctx, ix, iz + 1);
+    float h11 = cfg->height(cfg->height_ctx, ix + 1, iz + 1);
+    float h0 = h00 + (h10 - h00) * fx;
+    float h1 = h01 + (h11 - h01) * fx;
+    return (h0 + (h1 - h0) * fz) * cfg->height_scale;
+}
+
+void terrain_extent(const terrain_t* t, float* width, float* depth) {
+    *width = t->patches_x * t->patch_world;
+    *depth = t->patches_z * t->patch_world;
+}
+
+void terrain_get_stats(const terrain_t* t, terrain_stats_t* stats) {
+    *stats = t->stats;
+}
+
+void terrain_set_cull(terrain_t* t, int cull) {
+    t->config.cull = cull;
+}
+
+/* ------------------------------------------------------------------------
+ * Procedural heights
+ * ------------------------------------------------------------------------ */
+
+static float lattice(unsigned int seed, int x, int z) {
+    unsigned int h = seed;
+    h ^= (unsigned int)x * 0x8da6b343u;
+    h ^= (unsigned int)z * 0xd8163841u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+static int floor_div(int a, int b) {
+    return a >= 0 ? a / b : (a - b + 1) / b;
+}
+
+static float value_noise(unsigned int seed, int x, int z, int period) {
+    int cx = floor_div(x, period);
+    int cz = floor_div(z, period);
+    float fx = (float)(x - cx * period) / period;
+    float fz = (float)(z - cz * period) / period;
+
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+
+    float a = lattice(seed, cx, cz), b = lattice(seed, cx + 1, cz);
+    float c = lattice(seed, cx, cz + 1), d = lattice(seed, cx + 1, cz + 1);
+    float top = a + (b - a) * fx;
+    float bottom = c + (d - c) * fx;
+    return top + (bottom - top) * fz;
+}
+
+/* The sum clusters around 0.5; stretch it to use the full range */
+static float shape_height(float sum, float total) {
+    float h = (sum / total - 0.2f) / 0.6f;
+    if (h < 0.0f) h = 0.0f;
+    if (h > 1.0f) h = 1.0f;
+    return h * h * (3.0f - 2.0f * h);    /* Flatter valleys, sharper peaks */
+}
+
+float terrain_procedural_height(void* ctx, int x, int z) {
+    unsigned int seed = ctx ? *(const unsigned int*)ctx : 0u;
+    float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+
+    /* Octaves from 1024 samples down to 4 */
+    for (int period = 1024; period >= 4; period /= 2) {
+        sum += value_noise(seed + (unsigned int)period, x, z, period) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+    }
+    return shape_height(sum, total);
+}
+
+/*
+ * One octave of a row of procedural_row. Each lattice cell is hashed once
+ * instead of once per sample. Periods are multiples of four, so an aligned
+ * group of four samples never straddles two cells, and the arithmetic is
+ * the same, operation for operation, as value_noise().
+ */
+static void noise_row(unsigned int seed, int period, int x0, int z, int count,
+                      float amplitude, float* sums) {
+    int cz = floor_div(z, period);
+    float fz = (float)(z - cz * period) / period;
+    fz = fz * fz * (3.0f - 2.0f * fz);
+
+    int x = x0, end = x0 + count;
+    while (x < end) {
+        int cx = floor_div(x, period);
+        int cell_end = (cx + 1) * period < end ? (cx + 1) * period : end;
+        float a = lattice(seed, cx, cz), b = lattice(seed, cx + 1, cz);
+        float c = lattice(seed, cx, cz + 1), d = lattice(seed, cx + 1, cz + 1);
+
+        while (x < cell_end && ((x & 3) != 0 || x + 4 > cell_end)) {
+            float fx = (float)(x - cx * period) / period;
+            fx = fx * fx * (3.0f - 2.0f * fx);
+            float top = a + (b - a) * fx;
+            float bottom = c + (d - c) * fx;
+            sums[x - x0] += (top + (bottom - top) * fz) * amplitude;
+            x++;
+        }
+#ifdef TERRAIN_SSE
+        __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+        __m128 vc = _mm_set1_ps(c), vd = _mm_set1_ps(d);
+        for (; x + 4 <= cell_end; x += 4) {
+            __m128 fx = _mm_add_ps(_mm_set1_ps((float)(x - cx * period)),
+                                   _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+            fx = _mm_div_ps(fx, _mm_set1_ps((float)period));
+            fx = _mm_mul_ps(_mm_mul_ps(fx, fx),
+                            _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), fx)));
+            __m128 top = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), fx));
+            __m128 bottom = _mm_add_ps(vc, _mm_mul_ps(_mm_sub_ps(vd, vc), fx));
+            __m128 v = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(fz)));
+            __m128 sum = _mm_loadu_ps(sums + (x - x0));
+            _mm_storeu_ps(sums + (x - x0), _mm_add_ps(sum, _mm_mul_ps(v, _mm_set1_ps(amplitude))));
+        }
+#endif
+        while (x < cell_end) {
+            float fx = (float)(x - cx * period) / period;
+            fx = fx * fx * (3.0f - 2.0f * fx);
+            float top = a + (b - a) * fx;
+            float bottom = c + (d - c) * fx;
+            sums[x - x0] += (top + (bottom - top) * fz) * amplitude;
+            x++;
+        }
+    }
+}
+
+/* terrain_procedural_height() for 'count' samples along a row */
+static void procedural_row(unsigned int seed, int x0, int z, int count, float* out) {
+    float amplitude = 1.0f, total = 0.0f;
+
+    memset(out, 0, (size_t)count * sizeof(float));
+    for (int period = 1024; period >= 4; period /= 2) {
+        noise_row(seed + (unsigned int)period, period, x0, z, count, amplitude, out);
+        total += amplitude;
+        amplitude *= 0.5f;
+    }
+
+    int i = 0;
+#ifdef TERRAIN_SSE
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 h = _mm_div_ps(_mm_loadu_ps(out + i), _mm_set1_ps(total));
+        h = _mm_div_ps(_mm_sub_ps(h, _mm_set1_ps(0.2f)), _mm_set1_ps(0.6f));
+        h = _mm_min_ps(_mm_max_ps(h, _mm_setzero_ps()), one);
+        h = _mm_mul_ps(_mm_mul_ps(h, h), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), h)));
+        _mm_storeu_ps(out + i, h);
+    }
+#endif
+    for (; i < count; i++) out[i] = shape_height(out[i], total);
+}
+
+void terrain_sample_row(terrain_height_fn height, void* ctx, int x0, int z, int count,
+                        float* out) {
+    if (height == terrain_procedural_height) {
+        procedural_row(ctx ? *(const unsigned int*)ctx : 0u, x0, z, count, out);
+        return;
+    }
+    for (int i = 0; i < count; i++) out[i] = height(ctx, x0 + i, z);
+}
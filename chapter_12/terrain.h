@@ -0,0 +1,150 @@
+/*
+ * terrain.h - Chunked, streamed terrain with geomipmapping
+ *
+ * The heightfield is split into square patches of TERRAIN_PATCH_QUADS
+ * quads. Only the patches within view distance of the camera are resident;
+ * they are generated on background threads, nearest first, and dropped
+ * again once the camera moves away, so the size of the heightfield only
+ * limits the coordinates, not the memory used.
+ *
+ * Each patch keeps its full-resolution vertices and is drawn at one of
+ * TERRAIN_LODS levels of detail chosen by distance, using index lists
+ * shared by every patch. Where a patch borders a coarser one, its edge is
+ * stitched to the coarser vertex spacing so no cracks open between them.
+ *
+ * With 'compact' set, patches store GLshort positions and GLubyte colours
+ * (12 bytes a vertex instead of 24), unpacked by the modelview matrix.
+ *
+ * With 'cull' set, a quadtree of patch bounding boxes (using each patch's
+ * lowest and highest point) is tested against the view frustum, so whole
+ * blocks of patches behind the camera are skipped with one test.
+ *
+ * With 'lighting' set, each patch's normals are worked out as it is
+ * generated and the lights are baked into its colours (see light_bake.h),
+ * so the terrain looks lit while being drawn with GL_LIGHTING off.
+ */
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "light_bake.h"
+
+#define TERRAIN_PATCH_QUADS 64   /* Quads per patch side at full detail */
+#define TERRAIN_LODS        5    /* Vertex steps 1, 2, 4, 8 and 16 */
+
+/*
+ * Height source: the height of sample (x, z), normalised to 0..1. It is
+ * called from the generator threads, so it must be thread-safe.
+ */
+typedef float (*terrain_height_fn)(void* ctx, int x, int z);
+
+typedef struct {
+    int size_x, size_z;          /* Samples along each axis */
+    float spacing;               /* World units between samples */
+    float height_scale;          /* World height of a normalised 1.0 */
+    float lod_distance;          /* Full detail within this distance */
+    float view_distance;         /* Patches beyond this are not resident */
+    int threads;                 /* Generator threads, 0 = one per CPU */
+    int compact;                 /* Quantised vertices, see quantize.h */
+    int cull;                    /* Skip patches outside the view frustum */
+    const light_bake_t* lighting;/* Baked into the colours, NULL for none; copied */
+    terrain_height_fn height;
+    void* height_ctx;
+} terrain_config_t;
+
+typedef struct {
+    int resident;                /* Patches with vertex data */
+    int pending;                 /* Patches queued or being generated */
+    int drawn;                   /* Patches drawn by the last terrain_draw */
+    int culled;                  /* Ready patches it skipped */
+    int nodes_tested;            /* Quadtree boxes it tested */
+    long triangles;              /* Triangles drawn by the last terrain_draw */
+    long total_triangles;        /* Triangles in every ready patch */
+    long draw_calls;
+    size_t bytes;                /* Vertex data held by resident patches */
+    float max_error;             /* Largest position error of compact patches */
+    int lod_patches[TERRAIN_LODS];
+} terrain_stats_t;
+
+typedef struct terrain terrain_t;
+
+/*
+ * terrain_config_defaults - An 8193x8193 procedural terrain, compact
+ * vertices and culling on
+ */
+void terrain_config_defaults(terrain_config_t* config);
+
+/*
+ * terrain_create - Start the generator threads
+ *
+ * Returns NULL if memory or threads could not be allocated.
+ */
+terrain_t* terrain_create(const terrain_config_t* config);
+
+void terrain_destroy(terrain_t* terrain);
+
+/*
+ * terrain_update - Stream patches around the camera
+ *
+ * Collects finished patches, queues missing ones nearest first, frees
+ * those out of range and picks each patch's level of detail. Call once a
+ * frame before terrain_draw.
+ */
+void terrain_update(terrain_t* terrain, float cam_x, float cam_y, float cam_z);
+
+/*
+ * terrain_wait - Block until every queued patch has been generated
+ */
+void terrain_wait(terrain_t* terrain);
+
+/*
+ * terrain_draw - Draw the resident patches with vertex arrays
+ *
+ * Expects GL_VERTEX_ARRAY and GL_COLOR_ARRAY to be enabled and the
+ * modelview matrix to be current. Culling uses the current projection and
+ * modelview matrices.
+ */
+void terrain_draw(terrain_t* terrain);
+
+/*
+ * terrain_height_at - Interpolated world height at world (x, z)
+ */
+float terrain_height_at(const terrain_t* terrain, float x, float z);
+
+/*
+ * terrain_extent - World size of the terrain along x and z
+ */
+void terrain_extent(const terrain_t* terrain, float* width, float* depth);
+
+void terrain_get_stats(const terrain_t* terrain, terrain_stats_t* stats);
+
+/*
+ * terrain_set_cull - Turn frustum culling on or off
+ */
+void terrain_set_cull(terrain_t* terrain, int cull);
+
+/*
+ * terrain_procedural_height - Fractal value noise, the default height source
+ *
+ * @ctx: Pointer to an unsigned int seed, or NULL for seed 0
+ */
+float terrain_procedural_height(void* ctx, int x, int z);
+
+/*
+ * terrain_sample_row - Heights of 'count' samples from (x0, z) along +x
+ *
+ * The procedural source is evaluated a row at a time with SSE; the
+ * results are identical to calling it for each sample.
+ */
+void terrain_sample_row(terrain_height_fn height, void* ctx, int x0, int z, int count,
+                        float* out);
+
+/*
+ * terrain_height_colors - The terrain's colour ramp (sand to snow) as RGB
+ *
+ * @heights: 'count' normalised heights
+ * @rgb:     3 * count floats
+ */
+void terrain_height_colors(const float* heights, int count, float* rgb);
+
+#endif /* TERRAIN_H */
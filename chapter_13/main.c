@@ -2,6 +2,8 @@
 #include <GL/glut.h>
 #include <stdio.h>
 #include <math.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 static struct {
     float x, y, z;
@@ -10,6 +12,7 @@ static struct {
 } camera = {0, 0, 5, 0, 20};
 
 static int mouse_x, mouse_y, mouse_dragging = 0;
+static frame_clock_t frame_clock;
 
 void init_gl(void) {
     glClearColor(0.3f, 0.5f, 0.7f, 1.0f);
@@ -18,8 +21,8 @@ void init_gl(void) {
     glEnable(GL_LIGHT0);
 }
 
-void update_camera(void) {
-    float speed = 0.1f;
+void update_camera(float dt) {
+    float speed = 6.0f * dt; /* Units per second */
     float dx = 0, dz = 0;
     
     if (camera.keys['w']) dz -= speed;
@@ -73,7 +76,10 @@ void display(void) {
 }
 
 void idle(void) {
-    update_camera();
+    update_camera((float)frame_clock_tick(&frame_clock));
+    /* Held keys send no events, so keep on-demand frames coming while moving */
+    frame_pacer_set_animating(camera.keys['w'] || camera.keys['s'] ||
+                              camera.keys['a'] || camera.keys['d']);
     glutPostRedisplay();
 }
 
@@ -87,16 +93,19 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     camera.keys[key] = 1;
     if (key == 27 || key == 'q') exit(0);
 }
 
 void keyboardUp(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     camera.keys[key] = 0;
 }
 
 void mouse(int button, int state, int x, int y) {
+    frame_pacer_wake();
     if (button == GLUT_LEFT_BUTTON) {
         mouse_dragging = (state == GLUT_DOWN);
         mouse_x = x;
@@ -105,6 +114,7 @@ void mouse(int button, int state, int x, int y) {
 }
 
 void motion(int x, int y) {
+    frame_pacer_wake();
     if (mouse_dragging) {
         camera.yaw += (x - mouse_x) * 0.5f;
         camera.pitch += (y - mouse_y) * 0.5f;
@@ -124,7 +134,8 @@ int main(int argc, char** argv) {
     glutCreateWindow("Chapter 13: Input & Interaction");
     init_gl();
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutKeyboardUpFunc(keyboardUp);
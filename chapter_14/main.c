@@ -3,11 +3,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 static int fps_counter = 0;
 static float fps = 0.0f;
-static int last_time = 0;
+static double last_time = 0.0;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 
 void draw_text_2d(int x, int y, const char* text, void* font) {
     glRasterPos2i(x, y);
@@ -87,9 +90,9 @@ void display(void) {
     
     /* Update FPS */
     fps_counter++;
-    int current_time = glutGet(GLUT_ELAPSED_TIME);
-    if (current_time - last_time > 1000) {
-        fps = fps_counter * 1000.0f / (current_time - last_time);
+    double current_time = timing_seconds();
+    if (current_time - last_time > 1.0) {
+        fps = fps_counter / (float)(current_time - last_time);
         fps_counter = 0;
         last_time = current_time;
     }
@@ -98,7 +101,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     glutPostRedisplay();
 }
 
@@ -112,6 +116,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     if (key == 27 || key == 'q') exit(0);
 }
 
@@ -122,9 +127,11 @@ int main(int argc, char** argv) {
     glutInitWindowSize(800, 600);
     glutCreateWindow("Chapter 14: Text & UI");
     init_gl();
-    last_time = glutGet(GLUT_ELAPSED_TIME);
+    last_time = timing_seconds();
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutMainLoop();
@@ -9,17 +9,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-#include <sys/time.h>
+#include <string.h>
+#include "bench.h"
+#include "frame_pacer.h"
+#include "mat4.h"
+#include "offscreen.h"
+#include "tess_bench.h"
+#include "thread_pool.h"
+#include "timing.h"
 
-#define NUM_OBJECTS 500
+#define DEFAULT_OBJECTS 500
+#define CUBE_VERTICES 24
+#define CUBE_CORNERS 8
+#define BATCH_FLOATS_PER_VERTEX 6 /* GL_C3F_V3F: r, g, b, x, y, z */
+#define TRANSFORM_MIN_BATCH 256   /* Cubes per worker task */
+#define TRANSFORM_REPORT_MIN 10000
 
-static int render_mode = 0; /* 0=immediate, 1=vertex array, 2=display list */
+static int render_mode = 0; /* Index into render_modes */
+static int object_count = DEFAULT_OBJECTS;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static GLuint display_list;
 static int fps_count = 0;
 static float fps = 0.0f;
 static double last_fps_time = 0.0;
 
+/* Work submitted during the current frame, for the benchmark report */
+static long frame_draw_calls = 0;
+static long frame_vertices = 0;
+static long frame_bytes = 0;       /* Vertex and index data referenced */
+static double frame_prep_ms = 0.0;
+
+/* Transform stage: every cube's matrix (or batched vertices) is computed
+ * on the pool before any GL call of the frame is made */
+static thread_pool_t* transform_pool = NULL;
+static float* modelview_matrices = NULL;   /* 16 floats per cube */
+static int matrix_capacity = 0;
+
 /* Vertex array data */
 static GLfloat cube_vertices[] = {
     -0.5f, -0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f,  0.5f,  0.5f, -0.5f,  0.5f,  0.5f, /* Front */
@@ -39,25 +65,180 @@ static GLfloat cube_colors[] = {
     0,1,1, 0,1,1, 0,1,1, 0,1,1
 };
 
-double get_time(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
+/* Colour and position interleaved per vertex (GL_C3F_V3F), built from the
+ * two arrays above by init_gl */
+static GLfloat cube_interleaved[CUBE_VERTICES * 6];
+
+/* Indexed cube: the 8 corners, each coloured by its position, shared by
+ * all six faces. Corner n has x, y, z set from bits 0, 1 and 2 of n. */
+static GLfloat corner_vertices[CUBE_CORNERS * 3] = {
+    -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+    -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,   0.5f,  0.5f,  0.5f
+};
+
+static GLfloat corner_colors[CUBE_CORNERS * 3] = {
+    0,0,0, 1,0,0, 0,1,0, 1,1,0,
+    0,0,1, 1,0,1, 0,1,1, 1,1,1
+};
+
+static GLubyte cube_indices[CUBE_VERTICES] = {
+    4, 5, 7, 6,  /* Front */
+    0, 2, 3, 1,  /* Back */
+    2, 6, 7, 3,  /* Top */
+    0, 1, 5, 4,  /* Bottom */
+    1, 3, 7, 5,  /* Right */
+    0, 4, 6, 2   /* Left */
+};
+
+#define CUBE_ARRAY_BYTES (CUBE_VERTICES * 6 * sizeof(GLfloat))
+#define CUBE_INDEXED_BYTES (CUBE_CORNERS * 6 * sizeof(GLfloat) + sizeof(cube_indices))
 
 void draw_cube_immediate(void) {
     glBegin(GL_QUADS);
-    for (int i = 0; i < 24; i++) {
+    for (int i = 0; i < CUBE_VERTICES; i++) {
         glColor3fv(&cube_colors[i*3]);
         glVertex3fv(&cube_vertices[i*3]);
     }
     glEnd();
+    frame_draw_calls++;
+    frame_vertices += CUBE_VERTICES;
+    frame_bytes += CUBE_ARRAY_BYTES;
 }
 
 void draw_cube_vertex_array(void) {
     glVertexPointer(3, GL_FLOAT, 0, cube_vertices);
     glColorPointer(3, GL_FLOAT, 0, cube_colors);
-    glDrawArrays(GL_QUADS, 0, 24);
+    glDrawArrays(GL_QUADS, 0, CUBE_VERTICES);
+    frame_draw_calls++;
+    frame_vertices += CUBE_VERTICES;
+    frame_bytes += CUBE_ARRAY_BYTES;
+}
+
+/* Interleaved: one pointer call per frame instead of two per cube */
+void begin_interleaved(void) {
+    glInterleavedArrays(GL_C3F_V3F, 0, cube_interleaved);
+}
+
+void draw_cube_interleaved(void) {
+    glDrawArrays(GL_QUADS, 0, CUBE_VERTICES);
+    frame_draw_calls++;
+    frame_vertices += CUBE_VERTICES;
+    frame_bytes += CUBE_ARRAY_BYTES;
+}
+
+/* Indexed: 8 shared corners instead of 24 vertices, pointers set per frame */
+void begin_indexed(void) {
+    glVertexPointer(3, GL_FLOAT, 0, corner_vertices);
+    glColorPointer(3, GL_FLOAT, 0, corner_colors);
+}
+
+void draw_cube_indexed(void) {
+    glDrawElements(GL_QUADS, CUBE_VERTICES, GL_UNSIGNED_BYTE, cube_indices);
+    frame_draw_calls++;
+    frame_vertices += CUBE_VERTICES;
+    frame_bytes += CUBE_INDEXED_BYTES;
+}
+
+void draw_cube_display_list(void) {
+    glCallList(display_list);
+    frame_draw_calls++;
+    frame_vertices += CUBE_VERTICES;
+    frame_bytes += CUBE_ARRAY_BYTES;
+}
+
+/* Pre-transformed batch: every cube's vertices in world space, in one
+ * interleaved array that is drawn with a single glDrawArrays call */
+static GLfloat* batch_vertices = NULL;
+static int batch_capacity = 0;   /* In cubes */
+
+/* Position, spin and size of cube i, as applied by draw_scene */
+static void cube_placement(int i, float* x, float* y, float* z, float* spin) {
+    float angle = i * 7.2f + rotation;
+    float radius = 5.0f + (i % 10) * 1.5f;
+    *x = radius * cosf(angle * 0.017453f);
+    *z = radius * sinf(angle * 0.017453f);
+    *y = sinf(i * 0.3f + rotation * 0.05f) * 3.0f;
+    *spin = rotation * 2 + i * 10;
+}
+
+static int batch_reserve(int count) {
+    if (count <= batch_capacity) return 0;
+
+    size_t floats = (size_t)count * CUBE_VERTICES * BATCH_FLOATS_PER_VERTEX;
+    GLfloat* data = realloc(batch_vertices, floats * sizeof(GLfloat));
+    if (!data) return -1;
+
+    /* Colours never change, so they are only written for new cubes */
+    for (int i = batch_capacity; i < count; i++) {
+        GLfloat* cube = data + (size_t)i * CUBE_VERTICES * BATCH_FLOATS_PER_VERTEX;
+        for (int v = 0; v < CUBE_VERTICES; v++) {
+            memcpy(cube + v * BATCH_FLOATS_PER_VERTEX, &cube_colors[v * 3], 3 * sizeof(GLfloat));
+        }
+    }
+    batch_vertices = data;
+    batch_capacity = count;
+    return 0;
+}
+
+static int matrices_reserve(int count) {
+    if (count <= matrix_capacity) return 0;
+
+    float* data = realloc(modelview_matrices, (size_t)count * 16 * sizeof(float));
+    if (!data) return -1;
+    modelview_matrices = data;
+    matrix_capacity = count;
+    return 0;
+}
+
+/* Worker task: view * model for cubes [begin, end) */
+static void modelview_range(void* ctx, int begin, int end) {
+    const float* view = ctx;
+    for (int i = begin; i < end; i++) {
+        float model[16], x, y, z, spin;
+        cube_placement(i, &x, &y, &z, &spin);
+        mat4_translate_rotate_scale(model, x, y, z, spin, 1, 1, 0, 0.5f);
+        mat4_multiply(&modelview_matrices[(size_t)i * 16], view, model);
+    }
+}
+
+/* Worker task: world-space vertices of cubes [begin, end) for the batch */
+static void batch_range(void* ctx, int begin, int end) {
+    (void)ctx;
+    for (int i = begin; i < end; i++) {
+        float m[16], x, y, z, spin;
+        GLfloat* cube = batch_vertices + (size_t)i * CUBE_VERTICES * BATCH_FLOATS_PER_VERTEX;
+
+        cube_placement(i, &x, &y, &z, &spin);
+        mat4_translate_rotate_scale(m, x, y, z, spin, 1, 1, 0, 0.5f);
+        mat4_transform_points(m, cube_vertices, 3, cube + 3, BATCH_FLOATS_PER_VERTEX,
+                              CUBE_VERTICES);
+    }
+}
+
+/*
+ * Run the transform stage for a frame on 'pool' (NULL = this thread only)
+ * and return how long the calling thread spent on it, in milliseconds, or
+ * -1.0 if there was no memory for 'count' cubes.
+ */
+static double prepare_transforms(thread_pool_t* pool, int batched, int count, float* view) {
+    uint64_t start = timing_now_ns();
+
+    if (batched) {
+        if (batch_reserve(count) != 0) return -1.0;
+        thread_pool_parallel_for(pool, count, TRANSFORM_MIN_BATCH, batch_range, NULL);
+    } else {
+        if (matrices_reserve(count) != 0) return -1.0;
+        thread_pool_parallel_for(pool, count, TRANSFORM_MIN_BATCH, modelview_range, view);
+    }
+    return (timing_now_ns() - start) / 1e6;
+}
+
+void draw_cubes_batched(int count) {
+    glInterleavedArrays(GL_C3F_V3F, 0, batch_vertices);
+    glDrawArrays(GL_QUADS, 0, count * CUBE_VERTICES);
+    frame_draw_calls++;
+    frame_vertices += (long)count * CUBE_VERTICES;
+    frame_bytes += (long)count * CUBE_ARRAY_BYTES;
 }
 
 void create_display_list(void) {
@@ -67,6 +248,24 @@ void create_display_list(void) {
     glEndList();
 }
 
+typedef struct {
+    const char* name;          /* Used by --modes and in reports */
+    const char* label;
+    void (*begin)(void);            /* Per-frame setup, may be NULL */
+    void (*draw_cube)(void);        /* Called per cube with its matrix set */
+    void (*draw_all)(int count);    /* Or draws the whole field at once */
+} render_mode_t;
+
+static const render_mode_t render_modes[] = {
+    {"immediate",     "Immediate Mode",        NULL, draw_cube_immediate,    NULL},
+    {"vertex_arrays", "Vertex Arrays",         NULL, draw_cube_vertex_array, NULL},
+    {"display_lists", "Display Lists",         NULL, draw_cube_display_list, NULL},
+    {"batched",       "Pre-transformed Batch", NULL, NULL, draw_cubes_batched},
+    {"interleaved",   "Interleaved Arrays",    begin_interleaved, draw_cube_interleaved, NULL},
+    {"indexed",       "Indexed Elements",      begin_indexed, draw_cube_indexed, NULL},
+};
+#define NUM_RENDER_MODES (int)(sizeof(render_modes) / sizeof(render_modes[0]))
+
 void init_gl(void) {
     glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
     glEnable(GL_DEPTH_TEST);
@@ -75,55 +274,99 @@ void init_gl(void) {
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_COLOR_ARRAY);
     
+    for (int i = 0; i < CUBE_VERTICES; i++) {
+        memcpy(&cube_interleaved[i * 6], &cube_colors[i * 3], 3 * sizeof(GLfloat));
+        memcpy(&cube_interleaved[i * 6 + 3], &cube_vertices[i * 3], 3 * sizeof(GLfloat));
+    }
     create_display_list();
-    last_fps_time = get_time();
+    last_fps_time = timing_seconds();
 }
 
-void display(void) {
+/* Returns 0, or -1 with only the clear drawn if the transforms ran out of memory */
+int draw_scene(int mode, int count) {
+    void (*draw_cube)(void) = render_modes[mode].draw_cube;
+    int batched = render_modes[mode].draw_all != NULL;
+    float view[16];
+
+    frame_draw_calls = 0;
+    frame_vertices = 0;
+    frame_bytes = 0;
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
     gluLookAt(0, 15, 30, 0, 0, 0, 0, 1, 0);
+    glGetFloatv(GL_MODELVIEW_MATRIX, view);
+
+    frame_prep_ms = prepare_transforms(transform_pool, batched, count, view);
+    if (frame_prep_ms < 0.0) return -1;
+
+    if (batched) {
+        render_modes[mode].draw_all(count);
+        return 0;
+    }
     
-    /* Draw grid of cubes */
-    for (int i = 0; i < NUM_OBJECTS; i++) {
-        glPushMatrix();
-        
-        float angle = i * 7.2f + rotation;
-        float radius = 5.0f + (i % 10) * 1.5f;
-        float x = radius * cosf(angle * 0.017453f);
-        float z = radius * sinf(angle * 0.017453f);
-        float y = sinf(i * 0.3f + rotation * 0.05f) * 3.0f;
-        
-        glTranslatef(x, y, z);
-        glRotatef(rotation * 2 + i * 10, 1, 1, 0);
-        glScalef(0.5f, 0.5f, 0.5f);
-        
-        switch (render_mode) {
-            case 0: draw_cube_immediate(); break;
-            case 1: draw_cube_vertex_array(); break;
-            case 2: glCallList(display_list); break;
+    /* Draw grid of cubes: the GL thread only loads the finished matrices */
+    if (render_modes[mode].begin) render_modes[mode].begin();
+    for (int i = 0; i < count; i++) {
+        glLoadMatrixf(&modelview_matrices[(size_t)i * 16]);
+        draw_cube();
+    }
+    glLoadMatrixf(view);
+    return 0;
+}
+
+/*
+ * How much GL-thread time the pool frees: the transform stage timed on
+ * this thread alone and again on the pool, without any drawing.
+ */
+static void report_transform_savings(int count, int frames) {
+    float view[16];
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, view);
+    for (int batched = 0; batched <= 1; batched++) {
+        double serial = 0.0, pooled = 0.0;
+        for (int f = 0; f < frames; f++) {
+            double alone = prepare_transforms(NULL, batched, count, view);
+            double shared = prepare_transforms(transform_pool, batched, count, view);
+            if (alone < 0.0 || shared < 0.0) {
+                fprintf(stderr, "  %d cubes: out of memory for the transforms\n", count);
+                return;
+            }
+            serial += alone;
+            pooled += shared;
         }
-        
-        glPopMatrix();
+        serial /= frames;
+        pooled /= frames;
+        fprintf(stderr, "  %s transforms, %d cubes: %.3f ms on the GL thread alone, "
+                "%.3f ms on %d threads, %.3f ms freed per frame\n",
+                batched ? "batch vertex" : "matrix", count, serial, pooled,
+                thread_pool_size(transform_pool), serial - pooled);
     }
-    
+}
+
+void display(void) {
+    static int out_of_memory = 0;   /* Say so once, not every frame */
+    int failed = draw_scene(render_mode, object_count) != 0;
+
+    if (failed && !out_of_memory) fprintf(stderr, "Out of memory for %d cubes\n", object_count);
+    out_of_memory = failed;
     glutSwapBuffers();
     
     /* Update FPS */
     fps_count++;
-    double current_time = get_time();
+    double current_time = timing_seconds();
     if (current_time - last_fps_time >= 1.0) {
         fps = fps_count / (current_time - last_fps_time);
         fps_count = 0;
         last_fps_time = current_time;
         
-        const char* mode_names[] = {"Immediate Mode", "Vertex Arrays", "Display Lists"};
-        printf("Mode: %-20s | FPS: %.1f\n", mode_names[render_mode], fps);
+        printf("Mode: %-20s | FPS: %.1f\n", render_modes[render_mode].label, fps);
     }
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -138,43 +381,150 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27: case 'q': case 'Q':
             glDeleteLists(display_list, 1);
+            thread_pool_destroy(transform_pool);
             exit(0);
             break;
-        case '1':
-            render_mode = 0;
-            printf("\n=== Switched to Immediate Mode ===\n");
-            fps_count = 0;
-            last_fps_time = get_time();
-            break;
-        case '2':
-            render_mode = 1;
-            printf("\n=== Switched to Vertex Arrays ===\n");
+        case '1': case '2': case '3': case '4': case '5': case '6':
+            render_mode = key - '1';
+            printf("\n=== Switched to %s ===\n", render_modes[render_mode].label);
             fps_count = 0;
-            last_fps_time = get_time();
-            break;
-        case '3':
-            render_mode = 2;
-            printf("\n=== Switched to Display Lists ===\n");
-            fps_count = 0;
-            last_fps_time = get_time();
+            last_fps_time = timing_seconds();
             break;
     }
 }
 
+/*
+ * Headless benchmark: every selected mode at every object count, a fixed
+ * number of frames each. glFinish() after each frame makes the timing cover
+ * the GPU work rather than just command submission, and the rotation
+ * advances by a fixed step so every run draws the same frames.
+ */
+int run_benchmark(int argc, char** argv) {
+    static const int default_counts[] = {500, 5000, 50000, 100000};
+    bench_options_t opts;
+    bench_report_t report;
+    FILE* out = stdout;
+    int failed = 0;
+
+    bench_options_init(&opts);
+    if (bench_parse_args(&opts, argc, argv) != 0) {
+        bench_print_usage(argv[0], "--bench");
+        fprintf(stderr, "  Modes: immediate, vertex_arrays, display_lists, batched,\n"
+                        "         interleaved, indexed\n");
+        return 1;
+    }
+    if (opts.count_count == 0) {
+        opts.count_count = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(opts.counts, default_counts, sizeof(default_counts));
+    }
+
+    if (offscreen_create(&argc, argv, opts.width, opts.height, opts.software) != 0) {
+        return 1;
+    }
+    if (opts.output && !(out = fopen(opts.output, "w"))) {
+        perror(opts.output);
+        offscreen_destroy();
+        return 1;
+    }
+
+    double* frame_ms = malloc(opts.frames * sizeof(double));
+    if (!frame_ms) {
+        if (out != stdout) fclose(out);
+        offscreen_destroy();
+        return 1;
+    }
+
+    init_gl();
+    reshape(opts.width, opts.height);
+    transform_pool = thread_pool_create(opts.threads);
+    bench_report_begin(&report, out, opts.format, "chapter_16",
+                       (const char*)glGetString(GL_RENDERER), offscreen_backend());
+
+    for (int c = 0; c < opts.count_count && !failed; c++) {
+        for (int mode = 0; mode < NUM_RENDER_MODES && !failed; mode++) {
+            bench_result_t result;
+
+            if (!bench_mode_selected(&opts, render_modes[mode].name)) continue;
+
+            rotation = 0.0f;
+            for (int f = 0; f < opts.warmup && !failed; f++) {
+                failed = draw_scene(mode, opts.counts[c]) != 0;
+                glFinish();
+                rotation += 0.5f;
+            }
+
+            double prep_total = 0.0;
+            rotation = 0.0f;
+            for (int f = 0; f < opts.frames && !failed; f++) {
+                uint64_t start = timing_now_ns();
+                failed = draw_scene(mode, opts.counts[c]) != 0;
+                glFinish();
+                frame_ms[f] = (timing_now_ns() - start) / 1e6;
+                prep_total += frame_prep_ms;
+                rotation += 0.5f;
+            }
+            if (failed) {
+                fprintf(stderr, "%s, %d cubes: out of memory\n", render_modes[mode].name,
+                        opts.counts[c]);
+                break;
+            }
+
+            memset(&result, 0, sizeof(result));
+            result.mode = render_modes[mode].name;
+            result.objects = opts.counts[c];
+            result.prep_ms = prep_total / opts.frames;
+            result.bytes = (double)frame_bytes;
+            bench_compute(&result, frame_ms, opts.frames,
+                          (double)frame_draw_calls, (double)frame_vertices);
+            bench_report_add(&report, &result);
+        }
+        if (!failed && opts.counts[c] >= TRANSFORM_REPORT_MIN) {
+            report_transform_savings(opts.counts[c], opts.frames);
+        }
+    }
+
+    bench_report_end(&report);
+    free(frame_ms);
+    glDeleteLists(display_list, 1);
+    free(batch_vertices);
+    free(modelview_matrices);
+    thread_pool_destroy(transform_pool);
+    if (out != stdout) fclose(out);
+    offscreen_destroy();
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return run_benchmark(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-tessellation") == 0) {
+        return run_tessellation_benchmark(argc, argv);
+    }
+    if (argc > 1) {
+        object_count = atoi(argv[1]);
+        if (object_count <= 0) object_count = DEFAULT_OBJECTS;
+    }
+
     printf("Chapter 16: Performance Tips\n");
     printf("============================\n");
-    printf("Rendering %d animated cubes\n", NUM_OBJECTS);
+    printf("Rendering %d animated cubes\n", object_count);
     printf("\nControls:\n");
     printf("  1: Immediate mode (slowest)\n");
     printf("  2: Vertex arrays (faster)\n");
     printf("  3: Display lists (fastest for static geometry)\n");
+    printf("  4: Pre-transformed batch (one draw call for every cube)\n");
+    printf("  5: Interleaved arrays (pointers set once per frame)\n");
+    printf("  6: Indexed elements (8 shared corners per cube)\n");
     printf("  ESC/Q: Quit\n\n");
-    printf("Watch the FPS counter to see performance differences!\n\n");
+    printf("Watch the FPS counter to see performance differences!\n");
+    printf("Run with a number to change the cube count, or --bench or\n"
+           "--bench-tessellation for the headless benchmarks (see README).\n\n");
     
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
@@ -182,9 +532,13 @@ int main(int argc, char** argv) {
     glutCreateWindow("Chapter 16: Performance Tips");
     
     init_gl();
+    transform_pool = thread_pool_create(0);
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
+    frame_pacer_set_target_fps(0); /* Uncapped so the modes can be compared */
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
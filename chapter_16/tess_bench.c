@@ -0,0 +1,532 @@
+/*
+ * tess_bench.c - Where each submission path wins as spheres get finer
+ */
+
+#include <GL/glut.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "mat4.h"
+#include "offscreen.h"
+#include "thread_pool.h"
+#include "timing.h"
+#include "tess_bench.h"
+
+#define TESS_LEVELS 6
+#define TESS_MAX_VERTICES (4 * 1024 * 1024) /* Default --max-vertices a frame */
+#define FLOATS_PER_VERTEX 6                 /* GL_N3F_V3F: normal, then position */
+#define VERTEX_BYTES (FLOATS_PER_VERTEX * sizeof(GLfloat))
+#define INSTANCE_MIN_BATCH 64               /* Instances per worker task */
+#define TIE_MARGIN 1.05                     /* Within 5% of the fastest counts as a tie */
+#define PI 3.14159265358979323846
+
+static const int tess_slices[TESS_LEVELS] = {8, 16, 32, 64, 128, 256};
+
+/* A unit sphere of 'slices' around and slices / 2 stacks from pole to pole */
+typedef struct {
+    int slices, stacks;
+    int vertex_count;
+    GLfloat* grid;               /* Shared vertices, (stacks + 1) rings of slices + 1 */
+    int index_count;             /* Three per triangle */
+    GLuint* indices;
+    GLfloat* expanded;           /* The grid vertex for every index, for unindexed paths */
+    GLuint list;
+} sphere_mesh_t;
+
+/* One frame's work, shared with the worker tasks */
+typedef struct {
+    const sphere_mesh_t* mesh;
+    int count;
+    float rotation;
+    float* matrices;             /* 16 per instance */
+    GLfloat* batch;              /* Every instance's grid, transformed */
+    GLuint* batch_indices;
+} tess_frame_t;
+
+static void sphere_free(sphere_mesh_t* mesh) {
+    if (mesh->list) glDeleteLists(mesh->list, 1);
+    free(mesh->grid);
+    free(mesh->indices);
+    free(mesh->expanded);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+/*
+ * sphere_build - Vertices, indices and a display list for one tessellation
+ *
+ * The pole rows have one triangle per slice rather than a degenerate pair,
+ * so every path draws the same slices * (2 * stacks - 2) triangles.
+ */
+static int sphere_build(sphere_mesh_t* mesh, int slices) {
+    int ring = slices + 1, idx = 0;
+
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->slices = slices;
+    mesh->stacks = slices / 2;
+    mesh->vertex_count = ring * (mesh->stacks + 1);
+    mesh->index_count = slices * (2 * mesh->stacks - 2) * 3;
+    mesh->grid = malloc((size_t)mesh->vertex_count * VERTEX_BYTES);
+    mesh->indices = malloc((size_t)mesh->index_count * sizeof(GLuint));
+    mesh->expanded = malloc((size_t)mesh->index_count * VERTEX_BYTES);
+    if (!mesh->grid || !mesh->indices || !mesh->expanded) {
+        sphere_free(mesh);
+        return -1;
+    }
+
+    for (int i = 0; i <= mesh->stacks; i++) {
+        double theta = PI * i / mesh->stacks;
+        for (int j = 0; j <= slices; j++) {
+            double phi = 2.0 * PI * j / slices;
+            GLfloat* v = &mesh->grid[(size_t)(i * ring + j) * FLOATS_PER_VERTEX];
+            v[0] = v[3] = (GLfloat)(sin(theta) * cos(phi));
+            v[1] = v[4] = (GLfloat)(sin(theta) * sin(phi));
+            v[2] = v[5] = (GLfloat)cos(theta);
+        }
+    }
+    for (int i = 0; i < mesh->stacks; i++) {
+        for (int j = 0; j < slices; j++) {
+            GLuint a = i * ring + j, b = a + ring;
+            if (i > 0) {
+                mesh->indices[idx++] = a; mesh->indices[idx++] = b; mesh->indices[idx++] = a + 1;
+            }
+            if (i < mesh->stacks - 1) {
+                mesh->indices[idx++] = a + 1; mesh->indices[idx++] = b; mesh->indices[idx++] = b + 1;
+            }
+        }
+    }
+    for (int k = 0; k < mesh->index_count; k++) {
+        memcpy(&mesh->expanded[(size_t)k * FLOATS_PER_VERTEX],
+               &mesh->grid[(size_t)mesh->indices[k] * FLOATS_PER_VERTEX], VERTEX_BYTES);
+    }
+
+    /* The pointer is client state, so it is set now; the draw is compiled */
+    glInterleavedArrays(GL_N3F_V3F, 0, mesh->grid);
+    mesh->list = glGenLists(1);
+    glNewList(mesh->list, GL_COMPILE);
+    glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_INT, mesh->indices);
+    glEndList();
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Placing and transforming the instances
+ * ------------------------------------------------------------------------ */
+
+/* A square grid filling the view, so the covered area barely depends on the count */
+static void instance_matrix(float m[16], int i, int count, float rotation, int normals) {
+    int side = (int)ceil(sqrt((double)count));
+    float cell = 2.0f / side;
+    float x = -1.0f + cell * (i % side + 0.5f);
+    float y = -1.0f + cell * (i / side + 0.5f);
+    float spin = rotation + i * 37.0f;
+
+    if (normals) mat4_translate_rotate_scale(m, 0.0f, 0.0f, 0.0f, spin, 1, 1, 0, 1.0f);
+    else mat4_translate_rotate_scale(m, x, y, 0.0f, spin, 1, 1, 0, 0.45f * cell);
+}
+
+/* Worker task: modelview matrices of instances [begin, end); the view is identity */
+static void matrix_range(void* ctx, int begin, int end) {
+    tess_frame_t* frame = ctx;
+    for (int i = begin; i < end; i++) {
+        instance_matrix(&frame->matrices[(size_t)i * 16], i, frame->count, frame->rotation, 0);
+    }
+}
+
+/* Worker task: instances [begin, end) of the batch, positions and normals */
+static void batch_range(void* ctx, int begin, int end) {
+    tess_frame_t* frame = ctx;
+    const sphere_mesh_t* mesh = frame->mesh;
+
+    for (int i = begin; i < end; i++) {
+        GLfloat* out = frame->batch + (size_t)i * mesh->vertex_count * FLOATS_PER_VERTEX;
+        float m[16];
+
+        instance_matrix(m, i, frame->count, frame->rotation, 0);
+        mat4_transform_points(m, mesh->grid + 3, FLOATS_PER_VERTEX, out + 3, FLOATS_PER_VERTEX,
+                              mesh->vertex_count);
+        instance_matrix(m, i, frame->count, frame->rotation, 1);
+        mat4_transform_points(m, mesh->grid, FLOATS_PER_VERTEX, out, FLOATS_PER_VERTEX,
+                              mesh->vertex_count);
+    }
+}
+
+/* Allocate the matrices or the batch for 'count' instances of the frame's mesh */
+static int frame_reserve(tess_frame_t* frame, int batched) {
+    const sphere_mesh_t* mesh = frame->mesh;
+    int count = frame->count;
+
+    free(frame->matrices);
+    free(frame->batch);
+    free(frame->batch_indices);
+    frame->matrices = NULL;
+    frame->batch = NULL;
+    frame->batch_indices = NULL;
+    if (!batched) {
+        frame->matrices = malloc((size_t)count * 16 * sizeof(float));
+        return frame->matrices ? 0 : -1;
+    }
+
+    frame->batch = malloc((size_t)count * mesh->vertex_count * VERTEX_BYTES);
+    frame->batch_indices = malloc((size_t)count * mesh->index_count * sizeof(GLuint));
+    if (!frame->batch || !frame->batch_indices) return -1;
+    for (int i = 0; i < count; i++) {
+        GLuint* out = frame->batch_indices + (size_t)i * mesh->index_count;
+        GLuint base = (GLuint)i * mesh->vertex_count;
+        for (int k = 0; k < mesh->index_count; k++) out[k] = mesh->indices[k] + base;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * The submission paths
+ * ------------------------------------------------------------------------ */
+
+static void draw_immediate(const sphere_mesh_t* mesh) {
+    glBegin(GL_TRIANGLES);
+    for (int k = 0; k < mesh->index_count; k++) {
+        const GLfloat* v = &mesh->expanded[(size_t)k * FLOATS_PER_VERTEX];
+        glNormal3fv(v);
+        glVertex3fv(v + 3);
+    }
+    glEnd();
+}
+
+static void begin_arrays(const sphere_mesh_t* mesh) {
+    glInterleavedArrays(GL_N3F_V3F, 0, mesh->expanded);
+}
+
+static void draw_arrays(const sphere_mesh_t* mesh) {
+    glDrawArrays(GL_TRIANGLES, 0, mesh->index_count);
+}
+
+static void begin_indexed(const sphere_mesh_t* mesh) {
+    glInterleavedArrays(GL_N3F_V3F, 0, mesh->grid);
+}
+
+static void draw_indexed(const sphere_mesh_t* mesh) {
+    glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_INT, mesh->indices);
+}
+
+static void draw_list(const sphere_mesh_t* mesh) {
+    glCallList(mesh->list);
+}
+
+typedef struct {
+    const char* name;            /* Used by --modes and in reports */
+    const char* label;           /* In the summary */
+    void (*begin)(const sphere_mesh_t* mesh);   /* Per-frame setup, may be NULL */
+    void (*draw)(const sphere_mesh_t* mesh);    /* Per instance, or NULL for the batch */
+} tess_path_t;
+
+static const tess_path_t tess_paths[] = {
+    {"immediate",     "immediate", NULL,          draw_immediate},
+    {"vertex_arrays", "arrays",    begin_arrays,  draw_arrays},
+    {"indexed",       "indexed",   begin_indexed, draw_indexed},
+    {"display_lists", "lists",     NULL,          draw_list},
+    {"batched",       "batch",     NULL,          NULL},
+};
+#define NUM_TESS_PATHS (int)(sizeof(tess_paths) / sizeof(tess_paths[0]))
+
+/* Vertex and index data one frame refers to */
+static double frame_bytes(int path, const sphere_mesh_t* mesh, int count) {
+    double indexed = (double)mesh->vertex_count * VERTEX_BYTES +
+                     (double)mesh->index_count * sizeof(GLuint);
+
+    if (tess_paths[path].draw == draw_indexed) return indexed;
+    if (tess_paths[path].draw == NULL) return indexed * count;
+    return (double)mesh->index_count * VERTEX_BYTES;
+}
+
+/* Draw one frame; returns the milliseconds spent preparing transforms */
+static double draw_frame(thread_pool_t* pool, tess_frame_t* frame, int path) {
+    const tess_path_t* p = &tess_paths[path];
+    const sphere_mesh_t* mesh = frame->mesh;
+    uint64_t start = timing_now_ns();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!p->draw) {
+        thread_pool_parallel_for(pool, frame->count, INSTANCE_MIN_BATCH, batch_range, frame);
+        double prep_ms = (timing_now_ns() - start) / 1e6;
+        glLoadIdentity();
+        glInterleavedArrays(GL_N3F_V3F, 0, frame->batch);
+        glDrawElements(GL_TRIANGLES, frame->count * mesh->index_count, GL_UNSIGNED_INT,
+                       frame->batch_indices);
+        return prep_ms;
+    }
+
+    thread_pool_parallel_for(pool, frame->count, INSTANCE_MIN_BATCH, matrix_range, frame);
+    double prep_ms = (timing_now_ns() - start) / 1e6;
+    if (p->begin) p->begin(mesh);
+    for (int i = 0; i < frame->count; i++) {
+        glLoadMatrixf(&frame->matrices[(size_t)i * 16]);
+        p->draw(mesh);
+    }
+    glLoadIdentity();
+    return prep_ms;
+}
+
+/* ------------------------------------------------------------------------
+ * Summary
+ * ------------------------------------------------------------------------ */
+
+/* Index of the fastest path with a result, or -1 */
+static int fastest(const double* mean_ms) {
+    int best = -1;
+    for (int p = 0; p < NUM_TESS_PATHS; p++) {
+        if (mean_ms[p] >= 0.0 && (best < 0 || mean_ms[p] < mean_ms[best])) best = p;
+    }
+    return best;
+}
+
+/* True if a path other than 'best' is within TIE_MARGIN of it */
+static int near_tie(const double* mean_ms, int best) {
+    for (int p = 0; p < NUM_TESS_PATHS; p++) {
+        if (p != best && mean_ms[p] >= 0.0 && mean_ms[p] <= mean_ms[best] * TIE_MARGIN) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Along one axis, the winner changes only once the previous winner falls
+ * more than TIE_MARGIN behind, so timing noise between close paths does
+ * not show up as a crossover. Returns the path now in the lead.
+ */
+static int print_crossover(const double* mean_ms, int last, int at, const char* unit) {
+    int best = fastest(mean_ms);
+
+    if (best < 0 || best == last) return last;
+    if (last >= 0 && mean_ms[last] >= 0.0 && mean_ms[last] <= mean_ms[best] * TIE_MARGIN) {
+        return last;
+    }
+    if (last < 0) fprintf(stderr, " %s", tess_paths[best].label);
+    else fprintf(stderr, ", %s from %d%s", tess_paths[best].label, at, unit);
+    return best;
+}
+
+static int over_limit(const sphere_mesh_t* mesh, int count, long max_vertices) {
+    return (double)mesh->index_count * count > (double)max_vertices;
+}
+
+/*
+ * print_summary - The fastest path for every combination, then the ones
+ * skipped, then where the fastest path changes along each axis
+ */
+static void print_summary(const bench_options_t* opts, const sphere_mesh_t* meshes,
+                          double (*mean_ms)[BENCH_MAX_COUNTS][NUM_TESS_PATHS],
+                          long max_vertices) {
+    int skipped = 0;
+
+    fprintf(stderr, "\nFastest path, mean ms per frame (* another path within %.0f%%)\n",
+            (TIE_MARGIN - 1.0) * 100.0);
+    fprintf(stderr, "%6s %10s", "slices", "triangles");
+    for (int c = 0; c < opts->count_count; c++) fprintf(stderr, " %18d", opts->counts[c]);
+    fprintf(stderr, "\n");
+    for (int t = 0; t < TESS_LEVELS; t++) {
+        fprintf(stderr, "%6d %10d", tess_slices[t], meshes[t].index_count / 3);
+        for (int c = 0; c < opts->count_count; c++) {
+            int best = fastest(mean_ms[t][c]);
+            if (over_limit(&meshes[t], opts->counts[c], max_vertices)) {
+                fprintf(stderr, " %18s", "skipped");
+                skipped++;
+            } else if (best < 0) {
+                fprintf(stderr, " %18s", "-");
+            } else {
+                fprintf(stderr, " %9s %7.2f%c", tess_paths[best].label, mean_ms[t][c][best],
+                        near_tie(mean_ms[t][c], best) ? '*' : ' ');
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+
+    if (skipped > 0) {
+        fprintf(stderr, "\nSkipped, over %ld vertices a frame (raise with --max-vertices)\n",
+                max_vertices);
+        for (int t = 0; t < TESS_LEVELS; t++) {
+            int first = 1;
+            for (int c = 0; c < opts->count_count; c++) {
+                if (!over_limit(&meshes[t], opts->counts[c], max_vertices)) continue;
+                if (first) fprintf(stderr, "  %3d slices: %d", tess_slices[t], opts->counts[c]);
+                else fprintf(stderr, ", %d", opts->counts[c]);
+                first = 0;
+            }
+            if (!first) fprintf(stderr, " instances\n");
+        }
+    }
+
+    fprintf(stderr, "\nCrossovers as the instance count grows\n");
+    for (int t = 0; t < TESS_LEVELS; t++) {
+        int last = -1;
+        fprintf(stderr, "  %3d slices:", tess_slices[t]);
+        for (int c = 0; c < opts->count_count; c++) {
+            last = print_crossover(mean_ms[t][c], last, opts->counts[c], " instances");
+        }
+        fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "\nCrossovers as the tessellation grows\n");
+    for (int c = 0; c < opts->count_count; c++) {
+        int last = -1;
+        fprintf(stderr, "  %5d instances:", opts->counts[c]);
+        for (int t = 0; t < TESS_LEVELS; t++) {
+            last = print_crossover(mean_ms[t][c], last, tess_slices[t], " slices");
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Benchmark
+ * ------------------------------------------------------------------------ */
+
+/* Take --max-vertices N out of argv, which bench_parse_args would reject */
+static int take_max_vertices(int* argc, char** argv, long* max_vertices) {
+    for (int i = 2; i < *argc; i++) {
+        if (strcmp(argv[i], "--max-vertices") != 0) continue;
+        if (i + 1 >= *argc || (*max_vertices = atol(argv[i + 1])) <= 0) {
+            fprintf(stderr, "Invalid value for --max-vertices: %s\n",
+                    i + 1 < *argc ? argv[i + 1] : "(missing)");
+            return -1;
+        }
+        for (int j = i + 2; j <= *argc; j++) argv[j - 2] = argv[j];
+        *argc -= 2;
+        i--;
+    }
+    return 0;
+}
+
+int run_tessellation_benchmark(int argc, char** argv) {
+    static const int default_counts[] = {1, 10, 100, 1000, 10000};
+    static double mean_ms[TESS_LEVELS][BENCH_MAX_COUNTS][NUM_TESS_PATHS];
+    sphere_mesh_t meshes[TESS_LEVELS];
+    tess_frame_t frame;
+    bench_options_t opts;
+    bench_report_t report;
+    FILE* out = stdout;
+    long max_vertices = TESS_MAX_VERTICES;
+    int failed = 0;
+
+    /* The full matrix is 150 combinations, so fewer frames than --bench */
+    bench_options_init(&opts);
+    opts.frames = 20;
+    opts.warmup = 3;
+    if (take_max_vertices(&argc, argv, &max_vertices) != 0 ||
+        bench_parse_args(&opts, argc, argv) != 0) {
+        bench_print_usage(argv[0], "--bench-tessellation");
+        fprintf(stderr, "  --max-vertices N    Skip combinations drawing more a frame "
+                        "(default %d)\n"
+                        "  Modes: immediate, vertex_arrays, indexed, display_lists, batched.\n"
+                        "  Counts are spheres per frame. Defaults: --frames 20 --warmup 3\n",
+                TESS_MAX_VERTICES);
+        return 1;
+    }
+    if (opts.count_count == 0) {
+        opts.count_count = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(opts.counts, default_counts, sizeof(default_counts));
+    }
+
+    if (offscreen_create(&argc, argv, opts.width, opts.height, opts.software) != 0) {
+        return 1;
+    }
+    if (opts.output && !(out = fopen(opts.output, "w"))) {
+        perror(opts.output);
+        offscreen_destroy();
+        return 1;
+    }
+
+    GLfloat light_dir[] = {0.3f, 0.5f, 1.0f, 0.0f};
+    double aspect = (double)opts.width / opts.height;
+    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_NORMALIZE);
+    glViewport(0, 0, opts.width, opts.height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-aspect, aspect, -1.0, 1.0, -2.0, 2.0);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glLightfv(GL_LIGHT0, GL_POSITION, light_dir);
+
+    for (int t = 0; t < TESS_LEVELS; t++) {
+        if (sphere_build(&meshes[t], tess_slices[t]) != 0) failed = 1;
+    }
+    thread_pool_t* pool = thread_pool_create(opts.threads);
+    double* frame_ms = malloc(opts.frames * sizeof(double));
+    memset(&frame, 0, sizeof(frame));
+    if (failed || !frame_ms) {
+        fprintf(stderr, "Out of memory\n");
+        opts.count_count = 0;
+        failed = 1;
+    }
+
+    bench_report_begin_detail(&report, out, opts.format, "chapter_16_tessellation",
+                              (const char*)glGetString(GL_RENDERER), offscreen_backend(),
+                              "slices");
+
+    for (int t = 0; t < TESS_LEVELS; t++) {
+        for (int c = 0; c < opts.count_count; c++) {
+            double vertices = (double)meshes[t].index_count * opts.counts[c];
+
+            for (int p = 0; p < NUM_TESS_PATHS; p++) mean_ms[t][c][p] = -1.0;
+            if (over_limit(&meshes[t], opts.counts[c], max_vertices)) continue;
+
+            frame.mesh = &meshes[t];
+            frame.count = opts.counts[c];
+            for (int p = 0; p < NUM_TESS_PATHS; p++) {
+                bench_result_t result;
+                double prep_total = 0.0;
+
+                if (!bench_mode_selected(&opts, tess_paths[p].name)) continue;
+                if (frame_reserve(&frame, tess_paths[p].draw == NULL) != 0) {
+                    fprintf(stderr, "%s, %d slices, %d spheres: out of memory\n",
+                            tess_paths[p].name, tess_slices[t], frame.count);
+                    failed = 1;
+                    continue;
+                }
+
+                frame.rotation = 0.0f;
+                for (int f = 0; f < opts.warmup; f++) {
+                    draw_frame(pool, &frame, p);
+                    glFinish();
+                    frame.rotation += 0.5f;
+                }
+                frame.rotation = 0.0f;
+                for (int f = 0; f < opts.frames; f++) {
+                    uint64_t start = timing_now_ns();
+                    prep_total += draw_frame(pool, &frame, p);
+                    glFinish();
+                    frame_ms[f] = (timing_now_ns() - start) / 1e6;
+                    frame.rotation += 0.5f;
+                }
+
+                memset(&result, 0, sizeof(result));
+                result.mode = tess_paths[p].name;
+                result.objects = frame.count;
+                result.detail = tess_slices[t];
+                result.prep_ms = prep_total / opts.frames;
+                result.bytes = frame_bytes(p, &meshes[t], frame.count);
+                bench_compute(&result, frame_ms, opts.frames,
+                              tess_paths[p].draw ? frame.count : 1, vertices);
+                bench_report_add(&report, &result);
+                mean_ms[t][c][p] = result.mean_ms;
+            }
+        }
+    }
+
+    bench_report_end(&report);
+    if (!failed) print_summary(&opts, meshes, mean_ms, max_vertices);
+
+    free(frame.matrices);
+    free(frame.batch);
+    free(frame.batch_indices);
+    free(frame_ms);
+    for (int t = 0; t < TESS_LEVELS; t++) sphere_free(&meshes[t]);
+    thread_pool_destroy(pool);
+    if (out != stdout) fclose(out);
+    offscreen_destroy();
+    return failed ? 1 : 0;
+}
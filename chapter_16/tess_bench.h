@@ -0,0 +1,24 @@
+/*
+ * tess_bench.h - Where each submission path wins as spheres get finer
+ *
+ * Draws lit spheres of 8 to 256 slices, 1 to 10000 at a time, through
+ * every path the chapter covers: glBegin/glEnd, vertex arrays, indexed
+ * arrays, display lists and one pre-transformed batch. Each combination
+ * is timed offscreen and reported like the cube benchmark, with the
+ * slice count as an extra column. Then the fastest path for each
+ * combination, and where the fastest path changes, go to stderr.
+ */
+
+#ifndef TESS_BENCH_H
+#define TESS_BENCH_H
+
+/*
+ * run_tessellation_benchmark - The --bench-tessellation entry point
+ *
+ * Takes the shared benchmark flags; --counts sets the instance counts and
+ * --max-vertices the most vertices a frame may draw, 4M unless given.
+ * Returns the process exit code.
+ */
+int run_tessellation_benchmark(int argc, char** argv);
+
+#endif /* TESS_BENCH_H */
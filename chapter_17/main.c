@@ -9,8 +9,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static int show_normals = 1;
 static int wireframe = 0;
 
@@ -195,7 +198,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -211,6 +215,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27: case 'q': case 'Q': exit(0); break;
@@ -246,7 +251,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
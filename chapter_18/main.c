@@ -8,8 +8,11 @@
 #include <GL/glu.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 
 void print_platform_info(void) {
     printf("\n=== Platform Information ===\n");
@@ -96,7 +99,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -111,6 +115,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     if (key == 27 || key == 'q' || key == 'Q') exit(0);
     if (key == 'i' || key == 'I') print_platform_info();
 }
@@ -132,7 +137,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
@@ -9,12 +9,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 
 /* Asset path handling */
 char* get_asset_path(const char* asset_name) {
@@ -124,7 +127,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -139,6 +143,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     if (key == 27 || key == 'q' || key == 'Q') exit(0);
     if (key == 'i' || key == 'I') print_packaging_info();
 }
@@ -160,7 +165,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
@@ -10,11 +10,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 #define MAX_PARTICLES 200
 
 static int demo_mode = 0;
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static int terrain_size = 30;
 
 /* Particle system */
@@ -47,7 +50,7 @@ void update_particles(float dt) {
         particles[i].x += particles[i].vx * dt;
         particles[i].y += particles[i].vy * dt;
         particles[i].z += particles[i].vz * dt;
-        particles[i].vy -= 0.001f; /* Gravity */
+        particles[i].vy -= 0.001f * dt; /* Gravity */
         particles[i].life -= dt * 0.01f;
         
         if (particles[i].life <= 0.0f) {
@@ -136,12 +139,8 @@ void project_teapot_materials(void) {
 
 /* Project 3: Particle System */
 void project_particles(void) {
-    static int last_time = 0;
-    int current_time = glutGet(GLUT_ELAPSED_TIME);
-    float dt = (current_time - last_time) / 16.0f;
-    last_time = current_time;
-    
-    update_particles(dt);
+    /* Particle speeds are tuned per 60 Hz frame */
+    update_particles((float)(frame_clock.dt * 60.0));
     
     glDisable(GL_LIGHTING);
     glEnable(GL_BLEND);
@@ -268,7 +267,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -283,6 +283,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27: case 'q': case 'Q': exit(0); break;
@@ -291,6 +292,19 @@ void keyboard(unsigned char key, int x, int y) {
             rotation = 0.0f;
             printf("Project %d\n", demo_mode + 1);
             break;
+        case 'p': case 'P':
+            frame_clock_set_paused(&frame_clock, !frame_clock.paused);
+            frame_pacer_set_animating(!frame_clock.paused);
+            printf("Time %s\n", frame_clock.paused ? "paused" : "running");
+            break;
+        case '[':
+            frame_clock_set_scale(&frame_clock, frame_clock.scale * 0.5);
+            printf("Time scale: %.3fx\n", frame_clock.scale);
+            break;
+        case ']':
+            frame_clock_set_scale(&frame_clock, frame_clock.scale * 2.0);
+            printf("Time scale: %.3fx\n", frame_clock.scale);
+            break;
     }
 }
 
@@ -305,6 +319,8 @@ int main(int argc, char** argv) {
     printf("  5 - Solar System (hierarchical transforms)\n");
     printf("\nControls:\n");
     printf("  1-5: Switch project\n");
+    printf("  P: Pause time\n");
+    printf("  [ / ]: Halve / double time scale\n");
     printf("  ESC/Q: Quit\n\n");
     
     glutInit(&argc, argv);
@@ -315,7 +331,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     
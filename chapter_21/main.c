@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include "frame_pacer.h"
+#include "timing.h"
 
 /* Camera state */
 static struct {
@@ -20,6 +22,7 @@ static struct {
 } camera = {15.0f, 45.0f, 30.0f};
 
 static float rotation = 0.0f;
+static frame_clock_t frame_clock;
 static int show_info = 1;
 static int wireframe = 0;
 static int lighting_enabled = 1;
@@ -222,7 +225,8 @@ void display(void) {
 }
 
 void idle(void) {
-    rotation += 0.5f;
+    float dt = (float)frame_clock_tick(&frame_clock);
+    rotation += 30.0f * dt;
     if (rotation >= 360.0f) rotation -= 360.0f;
     glutPostRedisplay();
 }
@@ -237,6 +241,7 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     
     switch (key) {
         case 27: case 'q': case 'Q': exit(0); break;
@@ -261,6 +266,7 @@ void keyboard(unsigned char key, int x, int y) {
 
 void special(int key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     switch (key) {
         case GLUT_KEY_LEFT: camera.angle_h -= 5; break;
         case GLUT_KEY_RIGHT: camera.angle_h += 5; break;
@@ -304,7 +310,9 @@ int main(int argc, char** argv) {
     init_gl();
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_clock_init(&frame_clock, FRAME_CLOCK_RAW);
+    frame_pacer_start(idle);
+    frame_pacer_set_animating(1);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(special);
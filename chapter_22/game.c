@@ -10,11 +10,21 @@
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#include "starfield.h"
+#include "kdtree.h"
+#include "bench.h"
+#include "offscreen.h"
+#include "shape_cache.h"
+#include "frame_pacer.h"
+#include "timing.h"
 
 /* Configuration */
 #define MAX_ENEMIES 20
 #define MAX_PROJECTILES 50
 #define MAX_PARTICLES 100
+#define PROJECTILE_SPEED 0.125f
+#define HOMING_RANGE 40.0f
+#define HOMING_TURN_RATE 0.004f /* Fraction of course correction per ms */
 #define WINDOW_WIDTH 1200
 #define WINDOW_HEIGHT 800
 
@@ -32,6 +42,7 @@ typedef struct {
     float vx, vy, vz;
     float rotation;
     int active;
+    int homing;
 } entity_t;
 
 typedef struct {
@@ -61,12 +72,16 @@ static struct {
     int wave;
     int enemies_killed;
     float spawn_timer;
-    int last_time;
+    frame_clock_t clock;
     
     /* Input */
     int keys[256];
     int mouse_x;
     int mouse_initialized;
+    
+    /* Homing targeting */
+    kdtree_t enemy_tree;
+    int worker_threads;
 } game = {
     .state = STATE_MENU,
     .player_x = 0, .player_y = 0, .player_z = 0,
@@ -166,26 +181,26 @@ void draw_player_ship(void) {
     
     glPushMatrix();
     glScalef(0.3f, 0.15f, 0.6f);
-    glutSolidCube(1.0);
+    shape_cache_solid_cube(1.0);
     glPopMatrix();
     
     /* Wings */
     glPushMatrix();
     glTranslatef(0.4f, 0, -0.1f);
     glScalef(0.4f, 0.05f, 0.3f);
-    glutSolidCube(1.0);
+    shape_cache_solid_cube(1.0);
     glPopMatrix();
     
     glPushMatrix();
     glTranslatef(-0.4f, 0, -0.1f);
     glScalef(0.4f, 0.05f, 0.3f);
-    glutSolidCube(1.0);
+    shape_cache_solid_cube(1.0);
     glPopMatrix();
     
     glPopMatrix();
 }
 
-void shoot_projectile(void) {
+void shoot_projectile(int homing) {
     for (int i = 0; i < MAX_PROJECTILES; i++) {
         if (!game.projectiles[i].active) {
             game.projectiles[i].x = game.player_x;
@@ -193,11 +208,12 @@ void shoot_projectile(void) {
             game.projectiles[i].z = game.player_z;
             
             float rad = game.player_rotation * 0.017453f;
-            game.projectiles[i].vx = sinf(rad) * 0.125f;  /* Reduced speed to 25% */
-            game.projectiles[i].vz = cosf(rad) * 0.125f;  /* Reduced speed to 25% */
+            game.projectiles[i].vx = sinf(rad) * PROJECTILE_SPEED;
+            game.projectiles[i].vz = cosf(rad) * PROJECTILE_SPEED;
             game.projectiles[i].vy = 0;
             
             game.projectiles[i].active = 1;
+            game.projectiles[i].homing = homing;
             break;
         }
     }
@@ -232,12 +248,12 @@ void draw_enemy(entity_t* enemy) {
     glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
     glMaterialf(GL_FRONT, GL_SHININESS, 40.0f);
     
-    glutSolidSphere(0.3, 10, 10);
+    shape_cache_solid_sphere(0.3, 10, 10);
     
     /* Spikes */
     glPushMatrix();
     glRotatef(90, 0, 1, 0);
-    glutSolidCone(0.15, 0.5, 8, 1);
+    shape_cache_solid_cone(0.15, 0.5, 8, 1);
     glPopMatrix();
     
     glPopMatrix();
@@ -281,12 +297,15 @@ void draw_projectile(entity_t* proj) {
     glPushMatrix();
     glTranslatef(proj->x, proj->y, proj->z);
     
-    GLfloat mat_emission[] = {0.5f, 1.0f, 0.5f, 1.0f};
-    GLfloat mat_diffuse[] = {0.2f, 1.0f, 0.2f, 1.0f};
-    glMaterialfv(GL_FRONT, GL_EMISSION, mat_emission);
-    glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+    /* Green bolts, orange homing missiles */
+    GLfloat bolt_emission[] = {0.5f, 1.0f, 0.5f, 1.0f};
+    GLfloat bolt_diffuse[] = {0.2f, 1.0f, 0.2f, 1.0f};
+    GLfloat homing_emission[] = {1.0f, 0.6f, 0.2f, 1.0f};
+    GLfloat homing_diffuse[] = {1.0f, 0.5f, 0.1f, 1.0f};
+    glMaterialfv(GL_FRONT, GL_EMISSION, proj->homing ? homing_emission : bolt_emission);
+    glMaterialfv(GL_FRONT, GL_DIFFUSE, proj->homing ? homing_diffuse : bolt_diffuse);
     
-    glutSolidSphere(0.1, 8, 8);
+    shape_cache_solid_sphere(0.1, 8, 8);
     
     GLfloat no_emission[] = {0.0f, 0.0f, 0.0f, 1.0f};
     glMaterialfv(GL_FRONT, GL_EMISSION, no_emission);
@@ -294,7 +313,71 @@ void draw_projectile(entity_t* proj) {
     glPopMatrix();
 }
 
+/* Rebuild a k-d tree over the live enemies and steer every homing
+ * projectile toward its nearest one with a single batched query */
+void steer_homing_projectiles(float dt) {
+    kd_point_t points[MAX_ENEMIES];
+    float queries[MAX_PROJECTILES * 3];
+    int owners[MAX_PROJECTILES];
+    int targets[MAX_PROJECTILES];
+    int enemy_count = 0;
+    int query_count = 0;
+    
+    for (int i = 0; i < MAX_PROJECTILES; i++) {
+        entity_t* p = &game.projectiles[i];
+        if (!p->active || !p->homing) continue;
+        queries[query_count*3+0] = p->x;
+        queries[query_count*3+1] = p->y;
+        queries[query_count*3+2] = p->z;
+        owners[query_count++] = i;
+    }
+    if (query_count == 0) return;
+    
+    for (int i = 0; i < MAX_ENEMIES; i++) {
+        entity_t* e = &game.enemies[i];
+        if (!e->active) continue;
+        points[enemy_count].x = e->x;
+        points[enemy_count].y = e->y;
+        points[enemy_count].z = e->z;
+        points[enemy_count].id = i;
+        enemy_count++;
+    }
+    if (enemy_count == 0) return;
+    
+    if (kdtree_build(&game.enemy_tree, points, enemy_count, game.worker_threads) != 0) return;
+    kdtree_nearest_batch(&game.enemy_tree, queries, query_count, HOMING_RANGE,
+                         targets, game.worker_threads);
+    
+    float turn = HOMING_TURN_RATE * dt;
+    if (turn > 1.0f) turn = 1.0f;
+    
+    for (int k = 0; k < query_count; k++) {
+        if (targets[k] < 0) continue;
+        entity_t* p = &game.projectiles[owners[k]];
+        entity_t* e = &game.enemies[targets[k]];
+        
+        float dx = e->x - p->x;
+        float dy = e->y - p->y;
+        float dz = e->z - p->z;
+        float dist = sqrtf(dx*dx + dy*dy + dz*dz);
+        if (dist < 0.001f) continue;
+        
+        /* Blend velocity toward the target, then restore full speed */
+        p->vx += (dx / dist * PROJECTILE_SPEED - p->vx) * turn;
+        p->vy += (dy / dist * PROJECTILE_SPEED - p->vy) * turn;
+        p->vz += (dz / dist * PROJECTILE_SPEED - p->vz) * turn;
+        float speed = sqrtf(p->vx*p->vx + p->vy*p->vy + p->vz*p->vz);
+        if (speed > 0.0f) {
+            p->vx *= PROJECTILE_SPEED / speed;
+            p->vy *= PROJECTILE_SPEED / speed;
+            p->vz *= PROJECTILE_SPEED / speed;
+        }
+    }
+}
+
 void update_projectiles(float dt) {
+    steer_homing_projectiles(dt);
+    
     for (int i = 0; i < MAX_PROJECTILES; i++) {
         if (game.projectiles[i].active) {
             game.projectiles[i].x += game.projectiles[i].vx * dt;
@@ -352,17 +435,7 @@ void draw_grid(void) {
 void draw_starfield(void) {
     glDisable(GL_LIGHTING);
     glPointSize(2.0f);
-    glBegin(GL_POINTS);
-    srand(12345); /* Fixed seed for consistent stars */
-    for (int i = 0; i < 200; i++) {
-        float brightness = 0.5f + randf() * 0.5f;
-        glColor3f(brightness, brightness, brightness);
-        float x = (randf() - 0.5f) * 100.0f;
-        float y = randf() * 30.0f + 10.0f;
-        float z = (randf() - 0.5f) * 100.0f;
-        glVertex3f(x, y, z);
-    }
-    glEnd();
+    starfield_draw();
     glEnable(GL_LIGHTING);
 }
 
@@ -396,7 +469,8 @@ void draw_hud(void) {
         draw_text(w/2 - 150, h/2 + 50, "COSMIC DEFENDER");
         draw_text(w/2 - 100, h/2, "Press SPACE to Start");
         draw_text(w/2 - 120, h/2 - 50, "WASD: Move  Space: Shoot");
-        draw_text(w/2 - 80, h/2 - 80, "Mouse: Turn");
+        draw_text(w/2 - 80, h/2 - 80, "E: Homing missile");
+        draw_text(w/2 - 80, h/2 - 110, "Mouse: Turn");
     } else if (game.state == STATE_PLAYING || game.state == STATE_PAUSED) {
         /* Health bar */
         glColor3f(0.2f, 0.2f, 0.2f);
@@ -542,10 +616,12 @@ void init_gl(void) {
     /* Secondary light */
     GLfloat light1_diffuse[] = {0.4f, 0.2f, 0.2f, 1};
     glLightfv(GL_LIGHT1, GL_DIFFUSE, light1_diffuse);
+    
+    starfield_init(12345, game.player_x, game.player_z);
 }
 
-void display(void) {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+/* Camera behind the player, and the lights that follow it */
+void place_camera(void) {
     glLoadIdentity();
     
     /* Camera follows player */
@@ -564,21 +640,31 @@ void display(void) {
     GLfloat light1_pos[] = {game.player_x - 10, 5, game.player_z - 10, 1};
     glLightfv(GL_LIGHT0, GL_POSITION, light0_pos);
     glLightfv(GL_LIGHT1, GL_POSITION, light1_pos);
+}
+
+/* The ship, enemies and bolts: every shape the game draws */
+void draw_entities(void) {
+    draw_player_ship();
+    
+    for (int i = 0; i < MAX_ENEMIES; i++) {
+        if (game.enemies[i].active) draw_enemy(&game.enemies[i]);
+    }
+    
+    for (int i = 0; i < MAX_PROJECTILES; i++) {
+        if (game.projectiles[i].active) draw_projectile(&game.projectiles[i]);
+    }
+}
+
+void display(void) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    place_camera();
     
     /* Draw scene */
     if (game.state != STATE_MENU) {
+        starfield_update(game.player_x, game.player_z);
         draw_grid();
         draw_starfield();
-        draw_player_ship();
-        
-        for (int i = 0; i < MAX_ENEMIES; i++) {
-            if (game.enemies[i].active) draw_enemy(&game.enemies[i]);
-        }
-        
-        for (int i = 0; i < MAX_PROJECTILES; i++) {
-            if (game.projectiles[i].active) draw_projectile(&game.projectiles[i]);
-        }
-        
+        draw_entities();
         draw_particles();
     }
     
@@ -589,11 +675,14 @@ void display(void) {
 }
 
 void idle(void) {
-    int current_time = glutGet(GLUT_ELAPSED_TIME);
-    float dt = (current_time - game.last_time);
-    game.last_time = current_time;
+    /* Game logic works in milliseconds; the median filter keeps a single
+     * slow frame from throwing entities across the arena */
+    float dt = (float)(frame_clock_tick(&game.clock) * 1000.0);
     
     update_game(dt);
+    
+    /* In on-demand pacing, keep frames coming while the game is live */
+    frame_pacer_set_animating(game.state == STATE_PLAYING);
     glutPostRedisplay();
 }
 
@@ -607,18 +696,26 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     game.keys[key] = 1;
     
-    if (key == 27) exit(0); /* ESC */
+    if (key == 27) { /* ESC */
+        shape_cache_clear();
+        exit(0);
+    }
     
     if (key == ' ') {
         if (game.state == STATE_MENU) {
             reset_game();
         } else if (game.state == STATE_PLAYING) {
-            shoot_projectile();
+            shoot_projectile(0);
         }
     }
     
+    if ((key == 'e' || key == 'E') && game.state == STATE_PLAYING) {
+        shoot_projectile(1);
+    }
+    
     if ((key == 'p' || key == 'P') && game.state == STATE_PLAYING) {
         game.state = STATE_PAUSED;
     } else if ((key == 'p' || key == 'P') && game.state == STATE_PAUSED) {
@@ -632,17 +729,20 @@ void keyboard(unsigned char key, int x, int y) {
 
 void keyboard_up(unsigned char key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     game.keys[key] = 0;
 }
 
 void special(int key, int x, int y) {
     (void)x; (void)y;
+    frame_pacer_wake();
     /* Arrow keys no longer used for rotation - mouse motion is used instead */
     (void)key;
 }
 
 void mouse_motion(int x, int y) {
     (void)y; /* Only use horizontal motion */
+    frame_pacer_wake();
     
     if (!game.mouse_initialized) {
         game.mouse_x = x;
@@ -658,7 +758,227 @@ void mouse_motion(int x, int y) {
     game.mouse_x = x;
 }
 
+/* Benchmark: k-d tree build and batched query cost against a linear scan.
+ * Run with ./game --bench-kdtree [points] [queries] */
+static int linear_nearest(const kd_point_t* points, int count, const float* q, float* out_d2) {
+    int best = -1;
+    float best_d2 = HOMING_RANGE * HOMING_RANGE;
+    for (int i = 0; i < count; i++) {
+        float dx = points[i].x - q[0];
+        float dy = points[i].y - q[1];
+        float dz = points[i].z - q[2];
+        float d2 = dx*dx + dy*dy + dz*dz;
+        if (d2 < best_d2) {
+            best_d2 = d2;
+            best = points[i].id;
+        }
+    }
+    *out_d2 = best_d2;
+    return best;
+}
+
+int run_kdtree_benchmark(int point_count, int query_count) {
+    const int runs = 5;
+    int threads = kdtree_cpu_count();
+    kd_point_t* points = malloc(point_count * sizeof(kd_point_t));
+    float* queries = malloc(query_count * 3 * sizeof(float));
+    int* ids = malloc(query_count * sizeof(int));
+    kdtree_t tree;
+    kdtree_init(&tree);
+    
+    if (!points || !queries || !ids) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    
+    /* Enemies and projectiles spread through a 200-unit arena */
+    srand(1);
+    for (int i = 0; i < point_count; i++) {
+        points[i].x = (randf() - 0.5f) * 200.0f;
+        points[i].y = (randf() - 0.5f) * 20.0f;
+        points[i].z = (randf() - 0.5f) * 200.0f;
+        points[i].id = i;
+    }
+    for (int i = 0; i < query_count * 3; i += 3) {
+        queries[i+0] = (randf() - 0.5f) * 200.0f;
+        queries[i+1] = (randf() - 0.5f) * 20.0f;
+        queries[i+2] = (randf() - 0.5f) * 200.0f;
+    }
+    
+    printf("k-d tree benchmark: %d points x %d queries, %d CPU(s)\n",
+           point_count, query_count, threads);
+    printf("%-28s %12s\n", "stage", "ms (best of 5)");
+    
+    int thread_counts[2] = {1, threads};
+    for (int t = 0; t < (threads > 1 ? 2 : 1); t++) {
+        double best_build = 1e9, best_query = 1e9;
+        for (int r = 0; r < runs; r++) {
+            double t0 = timing_seconds();
+            kdtree_build(&tree, points, point_count, thread_counts[t]);
+            double t1 = timing_seconds();
+            kdtree_nearest_batch(&tree, queries, query_count, HOMING_RANGE,
+                                 ids, thread_counts[t]);
+            double t2 = timing_seconds();
+            if (t1 - t0 < best_build) best_build = t1 - t0;
+            if (t2 - t1 < best_query) best_query = t2 - t1;
+        }
+        printf("build   (%2d thread%s)        %12.3f\n", thread_counts[t],
+               thread_counts[t] == 1 ? " " : "s", best_build * 1000.0);
+        printf("queries (%2d thread%s)        %12.3f\n", thread_counts[t],
+               thread_counts[t] == 1 ? " " : "s", best_query * 1000.0);
+    }
+    
+    /* Brute-force reference, also used to check the tree's answers */
+    int mismatches = 0;
+    double t0 = timing_seconds();
+    for (int i = 0; i < query_count; i++) {
+        float tree_d2, scan_d2;
+        int scan_id = linear_nearest(points, point_count, &queries[i*3], &scan_d2);
+        if (ids[i] < 0 || scan_id < 0) {
+            if (ids[i] != scan_id) mismatches++;
+            continue;
+        }
+        const kd_point_t* p = &points[ids[i]];
+        float dx = p->x - queries[i*3+0];
+        float dy = p->y - queries[i*3+1];
+        float dz = p->z - queries[i*3+2];
+        tree_d2 = dx*dx + dy*dy + dz*dz;
+        if (tree_d2 != scan_d2) mismatches++;
+    }
+    double t1 = timing_seconds();
+    printf("linear scan (1 thread)       %12.3f\n", (t1 - t0) * 1000.0);
+    printf("mismatches vs linear scan: %d\n", mismatches);
+    
+    kdtree_free(&tree);
+    free(points);
+    free(queries);
+    free(ids);
+    return mismatches == 0 ? 0 : 1;
+}
+
+/*
+ * run_shapes_benchmark - Time the ship, enemies and bolts offscreen, drawn
+ * from the shape cache ("cached") and tessellated on every call
+ * ("immediate", a cache budget of 0, which is what glutSolid* costs)
+ *
+ * Counts are enemies in the arena, each with 2.5 bolts in flight, up to
+ * the game's limits of 20 enemies and 50 bolts.
+ * Run with ./game --bench-shapes [options]
+ */
+int run_shapes_benchmark(int argc, char** argv) {
+    static const int default_counts[] = {5, MAX_ENEMIES};
+    static const char* const modes[] = {"immediate", "cached"};
+    bench_options_t opts;
+    bench_report_t report;
+    FILE* out = stdout;
+
+    bench_options_init(&opts);
+    if (bench_parse_args(&opts, argc, argv) != 0) {
+        bench_print_usage(argv[0], "--bench-shapes");
+        fprintf(stderr, "  Modes: immediate, cached. Counts are enemies, at most %d.\n",
+                MAX_ENEMIES);
+        return 1;
+    }
+    if (opts.count_count == 0) {
+        opts.count_count = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+        memcpy(opts.counts, default_counts, sizeof(default_counts));
+    }
+
+    if (offscreen_create(&argc, argv, opts.width, opts.height, opts.software) != 0) {
+        return 1;
+    }
+    if (opts.output && !(out = fopen(opts.output, "w"))) {
+        perror(opts.output);
+        offscreen_destroy();
+        return 1;
+    }
+    double* frame_ms = malloc(opts.frames * sizeof(double));
+    if (!frame_ms) {
+        if (out != stdout) fclose(out);
+        offscreen_destroy();
+        return 1;
+    }
+
+    init_gl();
+    reshape(opts.width, opts.height);
+    bench_report_begin(&report, out, opts.format, "chapter_22_shapes",
+                       (const char*)glGetString(GL_RENDERER), offscreen_backend());
+
+    for (int c = 0; c < opts.count_count; c++) {
+        int enemies = opts.counts[c] < MAX_ENEMIES ? opts.counts[c] : MAX_ENEMIES;
+        int bolts = enemies * MAX_PROJECTILES / MAX_ENEMIES;
+
+        /* Enemies in an arc ahead of the ship, bolts on the way to them */
+        srand(1);
+        for (int i = 0; i < MAX_ENEMIES; i++) {
+            float angle = (randf() - 0.5f) * 1.5f;
+            float dist = 6.0f + randf() * 14.0f;
+            game.enemies[i].x = sinf(angle) * dist;
+            game.enemies[i].y = randf() * 4.0f - 2.0f;
+            game.enemies[i].z = cosf(angle) * dist;
+            game.enemies[i].active = i < enemies;
+        }
+        for (int i = 0; i < MAX_PROJECTILES; i++) {
+            const entity_t* target = &game.enemies[i % MAX_ENEMIES];
+            float t = randf();
+            game.projectiles[i].x = target->x * t;
+            game.projectiles[i].y = target->y * t;
+            game.projectiles[i].z = target->z * t;
+            game.projectiles[i].homing = i % 5 == 0;
+            game.projectiles[i].active = i < bolts;
+        }
+
+        for (int mode = 0; mode < 2; mode++) {
+            bench_result_t result;
+            shape_cache_stats_t stats;
+
+            if (!bench_mode_selected(&opts, modes[mode])) continue;
+            shape_cache_clear();
+            shape_cache_set_budget(mode == 0 ? 0 : SHAPE_CACHE_DEFAULT_BUDGET);
+
+            for (int f = -opts.warmup; f < opts.frames; f++) {
+                uint64_t start = timing_now_ns();
+                if (f == 0) shape_cache_reset_stats();
+                for (int i = 0; i < MAX_ENEMIES; i++) game.enemies[i].rotation += 2.0f;
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                place_camera();
+                draw_entities();
+                glFinish();
+                if (f >= 0) frame_ms[f] = (timing_now_ns() - start) / 1e6;
+            }
+
+            shape_cache_get_stats(&stats);
+            memset(&result, 0, sizeof(result));
+            result.mode = modes[mode];
+            result.objects = 1 + enemies + bolts;
+            /* Vertices as the cache tessellates them: cube 24, enemy sphere
+             * 220 and cone 28, bolt 144 */
+            bench_compute(&result, frame_ms, opts.frames, 3 + enemies * 2 + bolts,
+                          3 * 24 + enemies * (220.0 + 18.0 + 10.0) + bolts * 144.0);
+            bench_report_add(&report, &result);
+            fprintf(stderr, "  %d enemies, %d bolts, %-9s: %lu hits, %lu misses, %d lists\n",
+                    enemies, bolts, modes[mode], stats.hits, stats.misses, stats.lists);
+        }
+    }
+
+    bench_report_end(&report);
+    shape_cache_clear();
+    free(frame_ms);
+    if (out != stdout) fclose(out);
+    offscreen_destroy();
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench-shapes") == 0) {
+        return run_shapes_benchmark(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-kdtree") == 0) {
+        int points = argc > 2 ? atoi(argv[2]) : 10000;
+        int queries = argc > 3 ? atoi(argv[3]) : 10000;
+        return run_kdtree_benchmark(points, queries);
+    }
+    
     printf("===========================================\n");
     printf("  COSMIC DEFENDER - Final Project\n");
     printf("===========================================\n");
@@ -668,6 +988,7 @@ int main(int argc, char** argv) {
     printf("  WASD       - Move\n");
     printf("  Mouse      - Turn\n");
     printf("  Space      - Shoot\n");
+    printf("  E          - Homing missile\n");
     printf("  P          - Pause\n");
     printf("  R          - Restart\n");
     printf("  ESC        - Quit\n\n");
@@ -675,6 +996,8 @@ int main(int argc, char** argv) {
     printf("===========================================\n\n");
     
     srand(time(NULL));
+    kdtree_init(&game.enemy_tree);
+    game.worker_threads = kdtree_cpu_count();
     
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
@@ -682,10 +1005,10 @@ int main(int argc, char** argv) {
     glutCreateWindow("Cosmic Defender - OpenGL 1.1 Final Project");
     
     init_gl();
-    game.last_time = glutGet(GLUT_ELAPSED_TIME);
+    frame_clock_init(&game.clock, FRAME_CLOCK_MEDIAN);
     
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
+    frame_pacer_start(idle);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutKeyboardUpFunc(keyboard_up);
@@ -0,0 +1,206 @@
+/*
+ * kdtree.c - 3D k-d tree implementation
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "kdtree.h"
+
+/* Below these sizes a thread costs more than it saves */
+#define KD_PARALLEL_BUILD_MIN 4096
+#define KD_PARALLEL_QUERY_MIN 1024
+#define KD_MAX_THREADS        64
+
+static float coord(const kd_point_t* p, int axis) {
+    return axis == 0 ? p->x : (axis == 1 ? p->y : p->z);
+}
+
+static void swap_points(kd_point_t* a, int i, int j) {
+    kd_point_t t = a[i];
+    a[i] = a[j];
+    a[j] = t;
+}
+
+/* Quickselect: move the k-th smallest point along 'axis' into slot k, with
+ * everything before it <= and everything after it >= on that axis. */
+static void select_median(kd_point_t* a, int lo, int hi, int k, int axis) {
+    while (hi - lo > 1) {
+        float c0 = coord(&a[lo], axis);
+        float c1 = coord(&a[lo + (hi - lo) / 2], axis);
+        float c2 = coord(&a[hi - 1], axis);
+        float pivot = (c0 < c1) ? ((c1 < c2) ? c1 : (c0 < c2 ? c2 : c0))
+                                : ((c0 < c2) ? c0 : (c1 < c2 ? c2 : c1));
+
+        /* Three-way partition keeps duplicate coordinates from degrading */
+        int lt = lo, i = lo, gt = hi;
+        while (i < gt) {
+            float c = coord(&a[i], axis);
+            if (c < pivot) swap_points(a, lt++, i++);
+            else if (c > pivot) swap_points(a, i, --gt);
+            else i++;
+        }
+
+        if (k < lt) hi = lt;
+        else if (k >= gt) lo = gt;
+        else return;
+    }
+}
+
+typedef struct {
+    kd_point_t* nodes;
+    int lo, hi, depth, threads;
+} build_job_t;
+
+static void build_range(kd_point_t* nodes, int lo, int hi, int depth, int threads);
+
+static void* build_thread(void* arg) {
+    build_job_t* job = arg;
+    build_range(job->nodes, job->lo, job->hi, job->depth, job->threads);
+    return NULL;
+}
+
+static void build_range(kd_point_t* nodes, int lo, int hi, int depth, int threads) {
+    if (hi - lo <= 1) return;
+
+    int mid = lo + (hi - lo) / 2;
+    select_median(nodes, lo, hi, mid, depth % 3);
+
+    /* The two halves are disjoint, so the left one can go to another thread */
+    if (threads > 1 && hi - lo >= KD_PARALLEL_BUILD_MIN) {
+        build_job_t job = {nodes, lo, mid, depth + 1, threads / 2};
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, build_thread, &job) == 0) {
+            build_range(nodes, mid + 1, hi, depth + 1, threads - threads / 2);
+            pthread_join(thread, NULL);
+            return;
+        }
+    }
+
+    build_range(nodes, lo, mid, depth + 1, 1);
+    build_range(nodes, mid + 1, hi, depth + 1, 1);
+}
+
+void kdtree_init(kdtree_t* tree) {
+    tree->nodes = NULL;
+    tree->count = 0;
+    tree->capacity = 0;
+}
+
+void kdtree_free(kdtree_t* tree) {
+    free(tree->nodes);
+    kdtree_init(tree);
+}
+
+int kdtree_build(kdtree_t* tree, const kd_point_t* points, int count, int threads) {
+    if (count > tree->capacity) {
+        kd_point_t* nodes = realloc(tree->nodes, count * sizeof(kd_point_t));
+        if (!nodes) return -1;
+        tree->nodes = nodes;
+        tree->capacity = count;
+    }
+
+    if (count > 0) memcpy(tree->nodes, points, count * sizeof(kd_point_t));
+    tree->count = count;
+    build_range(tree->nodes, 0, count, 0, threads);
+    return 0;
+}
+
+static void nearest_range(const kd_point_t* nodes, int lo, int hi, int depth,
+                          const float q[3], int* best, float* best_d2) {
+    while (hi > lo) {
+        int mid = lo + (hi - lo) / 2;
+        const kd_point_t* p = &nodes[mid];
+
+        float dx = p->x - q[0];
+        float dy = p->y - q[1];
+        float dz = p->z - q[2];
+        float d2 = dx*dx + dy*dy + dz*dz;
+        if (d2 < *best_d2) {
+            *best_d2 = d2;
+            *best = p->id;
+        }
+
+        int axis = depth % 3;
+        float diff = q[axis] - coord(p, axis);
+        depth++;
+
+        /* Search the side containing the query first; the other side only
+         * matters if the splitting plane is closer than the best so far */
+        if (diff < 0) {
+            nearest_range(nodes, lo, mid, depth, q, best, best_d2);
+            if (diff * diff >= *best_d2) return;
+            lo = mid + 1;
+        } else {
+            nearest_range(nodes, mid + 1, hi, depth, q, best, best_d2);
+            if (diff * diff >= *best_d2) return;
+            hi = mid;
+        }
+    }
+}
+
+int kdtree_nearest(const kdtree_t* tree, float x, float y, float z,
+                   float max_dist, float* out_dist2) {
+    float q[3] = {x, y, z};
+    int best = -1;
+    float best_d2 = max_dist * max_dist;
+
+    nearest_range(tree->nodes, 0, tree->count, 0, q, &best, &best_d2);
+    if (out_dist2) *out_dist2 = best_d2;
+    return best;
+}
+
+typedef struct {
+    const kdtree_t* tree;
+    const float* queries;
+    int* out_ids;
+    int begin, end;
+    float max_dist;
+} query_job_t;
+
+static void* query_thread(void* arg) {
+    query_job_t* job = arg;
+    for (int i = job->begin; i < job->end; i++) {
+        const float* q = &job->queries[i * 3];
+        job->out_ids[i] = kdtree_nearest(job->tree, q[0], q[1], q[2],
+                                         job->max_dist, NULL);
+    }
+    return NULL;
+}
+
+void kdtree_nearest_batch(const kdtree_t* tree, const float* queries, int count,
+                          float max_dist, int* out_ids, int threads) {
+    pthread_t handles[KD_MAX_THREADS];
+    query_job_t jobs[KD_MAX_THREADS];
+
+    if (threads > count / KD_PARALLEL_QUERY_MIN) threads = count / KD_PARALLEL_QUERY_MIN;
+    if (threads > KD_MAX_THREADS) threads = KD_MAX_THREADS;
+    if (threads < 1) threads = 1;
+
+    for (int t = 0; t < threads; t++) {
+        jobs[t].tree = tree;
+        jobs[t].queries = queries;
+        jobs[t].out_ids = out_ids;
+        jobs[t].begin = (int)((long long)count * t / threads);
+        jobs[t].end = (int)((long long)count * (t + 1) / threads);
+        jobs[t].max_dist = max_dist;
+    }
+    /* Slice 0 runs on the calling thread; any slice whose thread could not
+     * be started is run there too */
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&handles[t], NULL, query_thread, &jobs[t]) != 0) break;
+        started = t;
+    }
+    query_thread(&jobs[0]);
+    for (int t = 1; t <= started; t++) pthread_join(handles[t], NULL);
+    for (int t = started + 1; t < threads; t++) query_thread(&jobs[t]);
+}
+
+int kdtree_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
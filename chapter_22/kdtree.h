@@ -0,0 +1,60 @@
+/*
+ * kdtree.h - 3D k-d tree for nearest-neighbour queries
+ *
+ * The tree is stored implicitly in one array: each range [lo, hi) keeps its
+ * median at (lo + hi) / 2, split on axis depth % 3, with the left and right
+ * halves on either side. No child pointers are needed, and the whole tree
+ * is rebuilt from scratch each tick.
+ */
+
+#ifndef KDTREE_H
+#define KDTREE_H
+
+typedef struct {
+    float x, y, z;
+    int id;          /* Caller's index, returned by queries */
+} kd_point_t;
+
+typedef struct {
+    kd_point_t* nodes;
+    int count;
+    int capacity;
+} kdtree_t;
+
+void kdtree_init(kdtree_t* tree);
+void kdtree_free(kdtree_t* tree);
+
+/*
+ * kdtree_build - Rebuild the tree from a set of points
+ *
+ * @threads: Worker threads to use; subtrees too small to be worth a thread
+ *           are always built serially
+ *
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int kdtree_build(kdtree_t* tree, const kd_point_t* points, int count, int threads);
+
+/*
+ * kdtree_nearest - Find the point closest to (x, y, z)
+ *
+ * Returns the point's id, or -1 if the tree is empty or nothing lies within
+ * max_dist. The squared distance is stored in out_dist2 when not NULL.
+ */
+int kdtree_nearest(const kdtree_t* tree, float x, float y, float z,
+                   float max_dist, float* out_dist2);
+
+/*
+ * kdtree_nearest_batch - Run kdtree_nearest for many queries at once
+ *
+ * @queries: count packed x,y,z triples
+ * @out_ids: count results, -1 where nothing was within max_dist
+ */
+void kdtree_nearest_batch(const kdtree_t* tree, const float* queries, int count,
+                          float max_dist, int* out_ids, int threads);
+
+/*
+ * kdtree_cpu_count - Number of online CPUs, at least 1
+ */
+int kdtree_cpu_count(void);
+
+#endif /* KDTREE_H */
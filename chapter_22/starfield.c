@@ -0,0 +1,153 @@
+/*
+ * starfield.c - Procedurally streamed starfield implementation
+ */
+
+#include <GL/glut.h>
+#include <stdlib.h>
+#include <math.h>
+#include "starfield.h"
+
+/* Cells are stored in a toroidal grid one ring wider than the resident
+ * area, so a cell's slot is just its coordinates modulo the grid size and
+ * no lookup table is needed. */
+#define GRID_DIM  (2 * (STARFIELD_RADIUS + 1) + 1)
+#define GRID_SIZE (GRID_DIM * GRID_DIM)
+#define RING_SIZE ((2 * STARFIELD_RADIUS + 1) * (2 * STARFIELD_RADIUS + 1))
+
+typedef struct {
+    int cx, cz;
+    int resident;
+    GLfloat vertices[STARFIELD_STARS_PER_CELL * 3];
+    GLfloat colors[STARFIELD_STARS_PER_CELL * 3];
+} star_cell_t;
+
+static star_cell_t cells[GRID_SIZE];
+static int ring[RING_SIZE][2]; /* Cell offsets sorted nearest first */
+static unsigned int field_seed;
+static int center_x, center_z;
+
+static unsigned int hash_cell(int cx, int cz) {
+    unsigned int h = field_seed;
+    h ^= (unsigned int)cx * 0x8da6b343u;
+    h ^= (unsigned int)cz * 0xd8163841u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h ? h : 1u; /* xorshift state must not be zero */
+}
+
+static float next_rand(unsigned int* state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static int wrap(int v) {
+    int m = v % GRID_DIM;
+    return m < 0 ? m + GRID_DIM : m;
+}
+
+static star_cell_t* slot_for(int cx, int cz) {
+    return &cells[wrap(cz) * GRID_DIM + wrap(cx)];
+}
+
+static int cell_distance(int cx, int cz) {
+    int dx = abs(cx - center_x);
+    int dz = abs(cz - center_z);
+    return dx > dz ? dx : dz;
+}
+
+static void build_cell(star_cell_t* cell, int cx, int cz) {
+    unsigned int state = hash_cell(cx, cz);
+    float base_x = cx * STARFIELD_CELL_SIZE;
+    float base_z = cz * STARFIELD_CELL_SIZE;
+
+    for (int i = 0; i < STARFIELD_STARS_PER_CELL; i++) {
+        float brightness = 0.5f + next_rand(&state) * 0.5f;
+        cell->vertices[i*3+0] = base_x + next_rand(&state) * STARFIELD_CELL_SIZE;
+        cell->vertices[i*3+1] = next_rand(&state) * 30.0f + 10.0f;
+        cell->vertices[i*3+2] = base_z + next_rand(&state) * STARFIELD_CELL_SIZE;
+        cell->colors[i*3+0] = brightness;
+        cell->colors[i*3+1] = brightness;
+        cell->colors[i*3+2] = brightness;
+    }
+    cell->cx = cx;
+    cell->cz = cz;
+    cell->resident = 1;
+}
+
+static int compare_offsets(const void* a, const void* b) {
+    const int* oa = a;
+    const int* ob = b;
+    return (oa[0]*oa[0] + oa[1]*oa[1]) - (ob[0]*ob[0] + ob[1]*ob[1]);
+}
+
+static void set_center(float x, float z) {
+    center_x = (int)floorf(x / STARFIELD_CELL_SIZE);
+    center_z = (int)floorf(z / STARFIELD_CELL_SIZE);
+}
+
+/* Runs up to 'budget' cell builds and evictions */
+static void stream_cells(int budget) {
+    /* Build missing cells, nearest first */
+    for (int i = 0; i < RING_SIZE && budget > 0; i++) {
+        int cx = center_x + ring[i][0];
+        int cz = center_z + ring[i][1];
+        star_cell_t* cell = slot_for(cx, cz);
+        if (cell->resident && cell->cx == cx && cell->cz == cz) continue;
+        build_cell(cell, cx, cz);
+        budget--;
+    }
+
+    /* Evict cells that fell outside the hysteresis ring. A build may
+     * already have reused a stale slot, which counts as its eviction. */
+    for (int i = 0; i < GRID_SIZE && budget > 0; i++) {
+        if (cells[i].resident &&
+            cell_distance(cells[i].cx, cells[i].cz) > STARFIELD_RADIUS + 1) {
+            cells[i].resident = 0;
+            budget--;
+        }
+    }
+}
+
+void starfield_init(unsigned int seed, float x, float z) {
+    int n = 0;
+    for (int dz = -STARFIELD_RADIUS; dz <= STARFIELD_RADIUS; dz++) {
+        for (int dx = -STARFIELD_RADIUS; dx <= STARFIELD_RADIUS; dx++) {
+            ring[n][0] = dx;
+            ring[n][1] = dz;
+            n++;
+        }
+    }
+    qsort(ring, RING_SIZE, sizeof(ring[0]), compare_offsets);
+
+    field_seed = seed;
+    for (int i = 0; i < GRID_SIZE; i++) cells[i].resident = 0;
+
+    /* No frame to protect yet, so fill the whole ring at once */
+    set_center(x, z);
+    stream_cells(RING_SIZE);
+}
+
+void starfield_update(float x, float z) {
+    set_center(x, z);
+    stream_cells(STARFIELD_WORK_PER_FRAME);
+}
+
+void starfield_draw(void) {
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    for (int i = 0; i < GRID_SIZE; i++) {
+        if (!cells[i].resident) continue;
+        glVertexPointer(3, GL_FLOAT, 0, cells[i].vertices);
+        glColorPointer(3, GL_FLOAT, 0, cells[i].colors);
+        glDrawArrays(GL_POINTS, 0, STARFIELD_STARS_PER_CELL);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
@@ -0,0 +1,41 @@
+/*
+ * starfield.h - Procedurally streamed starfield
+ *
+ * The sky is divided into square cells on the XZ plane. Each cell's stars
+ * are generated from a hash of its coordinates, so the field is infinite
+ * and identical every time a cell is revisited. Only the cells around the
+ * camera are kept resident as vertex arrays.
+ */
+
+#ifndef STARFIELD_H
+#define STARFIELD_H
+
+#define STARFIELD_CELL_SIZE      25.0f /* World units per cell side */
+#define STARFIELD_STARS_PER_CELL 12    /* Same density as the old 200 in 100x100 */
+#define STARFIELD_RADIUS         3     /* Cells kept resident around the camera */
+#define STARFIELD_WORK_PER_FRAME 3     /* Cell builds/evictions allowed per frame */
+
+/*
+ * starfield_init - Reset the cache and build every cell around the start
+ *
+ * @seed: Seed mixed into every cell hash
+ * @x, @z: Initial camera position
+ */
+void starfield_init(unsigned int seed, float x, float z);
+
+/*
+ * starfield_update - Stream cells in and out around the camera
+ *
+ * Does at most STARFIELD_WORK_PER_FRAME builds or evictions, nearest cells
+ * first, so crossing cell borders never stalls a frame.
+ */
+void starfield_update(float x, float z);
+
+/*
+ * starfield_draw - Draw all resident cells as GL_POINTS
+ *
+ * Lighting and point size are left to the caller.
+ */
+void starfield_draw(void);
+
+#endif /* STARFIELD_H */
@@ -0,0 +1,235 @@
+/*
+ * bench.c - Rendering benchmark options, statistics and reports
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+void bench_options_init(bench_options_t* opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->frames = 300;
+    opts->warmup = 30;
+    opts->width = 1000;
+    opts->height = 700;
+    opts->format = BENCH_CSV;
+}
+
+void bench_print_usage(const char* program, const char* flag) {
+    fprintf(stderr,
+            "Usage: %s %s [options]\n"
+            "  --frames N          Timed frames per configuration (default 300)\n"
+            "  --warmup N          Untimed frames first (default 30)\n"
+            "  --modes a,b,...     Render modes to run (default all)\n"
+            "  --counts n,m,...    Object counts to run\n"
+            "  --format csv|json   Report format (default csv)\n"
+            "  --output FILE       Write the report to FILE instead of stdout\n"
+            "  --size WxH          Render target size (default 1000x700)\n"
+            "  --threads N         Worker threads for CPU-side work (default: one per CPU)\n"
+            "  --software          Force the software rasteriser\n",
+            program, flag);
+}
+
+static int parse_counts(bench_options_t* opts, const char* list) {
+    const char* p = list;
+    opts->count_count = 0;
+    while (*p) {
+        char* end;
+        long n = strtol(p, &end, 10);
+        if (end == p || n <= 0 || opts->count_count == BENCH_MAX_COUNTS) return -1;
+        if (*end && *end != ',') return -1;
+        opts->counts[opts->count_count++] = (int)n;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return opts->count_count > 0 ? 0 : -1;
+}
+
+int bench_parse_args(bench_options_t* opts, int argc, char** argv) {
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int ok = 1;
+
+        if (strcmp(arg, "--software") == 0) {
+            opts->software = 1;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return -1;
+        }
+
+        if (strcmp(arg, "--frames") == 0) {
+            opts->frames = atoi(value);
+            ok = opts->frames > 0;
+        } else if (strcmp(arg, "--warmup") == 0) {
+            opts->warmup = atoi(value);
+            ok = opts->warmup >= 0;
+        } else if (strcmp(arg, "--modes") == 0) {
+            opts->modes = value;
+        } else if (strcmp(arg, "--counts") == 0) {
+            ok = parse_counts(opts, value) == 0;
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "csv") == 0) opts->format = BENCH_CSV;
+            else if (strcmp(value, "json") == 0) opts->format = BENCH_JSON;
+            else ok = 0;
+        } else if (strcmp(arg, "--threads") == 0) {
+            opts->threads = atoi(value);
+            ok = opts->threads > 0;
+        } else if (strcmp(arg, "--output") == 0) {
+            opts->output = value;
+        } else if (strcmp(arg, "--size") == 0) {
+            ok = sscanf(value, "%dx%d", &opts->width, &opts->height) == 2 &&
+                 opts->width > 0 && opts->height > 0;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return -1;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Invalid value for %s: %s\n", arg, value);
+            return -1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+int bench_mode_selected(const bench_options_t* opts, const char* name) {
+    size_t len = strlen(name);
+    const char* p = opts->modes;
+
+    if (!p) return 1;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == len && strncmp(p, name, len) == 0) return 1;
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static double percentile(const double* sorted, int n, double p) {
+    int rank = (int)ceil(p * n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+void bench_compute(bench_result_t* result, double* frame_ms, int frames,
+                   double draw_calls, double vertices) {
+    double sum = 0.0;
+
+    qsort(frame_ms, frames, sizeof(double), compare_doubles);
+    for (int i = 0; i < frames; i++) sum += frame_ms[i];
+
+    result->frames = frames;
+    result->mean_ms = sum / frames;
+    result->p50_ms = percentile(frame_ms, frames, 0.50);
+    result->p95_ms = percentile(frame_ms, frames, 0.95);
+    result->p99_ms = percentile(frame_ms, frames, 0.99);
+    result->min_ms = frame_ms[0];
+    result->max_ms = frame_ms[frames - 1];
+    result->draw_calls = draw_calls;
+    result->vertices = vertices;
+    result->draw_calls_per_sec = draw_calls * 1000.0 / result->mean_ms;
+    result->vertices_per_sec = vertices * 1000.0 / result->mean_ms;
+}
+
+static void json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        if ((unsigned char)*s >= 0x20) fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+void bench_report_begin(bench_report_t* report, FILE* out, bench_format_t format,
+                        const char* name, const char* renderer, const char* backend) {
+    bench_report_begin_detail(report, out, format, name, renderer, backend, NULL);
+}
+
+void bench_report_begin_detail(bench_report_t* report, FILE* out, bench_format_t format,
+                               const char* name, const char* renderer, const char* backend,
+                               const char* detail) {
+    report->out = out;
+    report->format = format;
+    report->rows = 0;
+    report->detail = detail;
+
+    if (format == BENCH_JSON) {
+        fprintf(out, "{\n  \"benchmark\": ");
+        json_string(out, name);
+        fprintf(out, ",\n  \"renderer\": ");
+        json_string(out, renderer);
+        fprintf(out, ",\n  \"backend\": ");
+        json_string(out, backend);
+        fprintf(out, ",\n  \"results\": [");
+    } else {
+        fprintf(out, "mode,objects,%s%sframes,mean_ms,p50_ms,p95_ms,p99_ms,min_ms,max_ms,"
+                     "prep_ms,draw_calls,vertices,bytes,draw_calls_per_sec,vertices_per_sec\n",
+                detail ? detail : "", detail ? "," : "");
+    }
+
+    fprintf(stderr, "%s on %s (%s)\n", name, renderer, backend);
+    fprintf(stderr, "%-18s %8s ", "mode", "objects");
+    if (detail) fprintf(stderr, "%8s ", detail);
+    fprintf(stderr, "%9s %9s %9s %9s %9s %10s\n",
+            "mean ms", "p50 ms", "p95 ms", "p99 ms", "prep ms", "Mverts/s");
+}
+
+void bench_report_add(bench_report_t* report, const bench_result_t* r) {
+    FILE* out = report->out;
+
+    if (report->format == BENCH_JSON) {
+        fprintf(out, "%s\n    {\"mode\": ", report->rows ? "," : "");
+        json_string(out, r->mode);
+        fprintf(out, ", \"objects\": %d, ", r->objects);
+        if (report->detail) {
+            json_string(out, report->detail);
+            fprintf(out, ": %d, ", r->detail);
+        }
+        fprintf(out, "\"frames\": %d, "
+                     "\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, "
+                     "\"p99_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, "
+                     "\"prep_ms\": %.4f, \"draw_calls\": %.0f, \"vertices\": %.0f, "
+                     "\"bytes\": %.0f, "
+                     "\"draw_calls_per_sec\": %.1f, \"vertices_per_sec\": %.1f}",
+                r->frames, r->mean_ms, r->p50_ms, r->p95_ms,
+                r->p99_ms, r->min_ms, r->max_ms, r->prep_ms, r->draw_calls,
+                r->vertices, r->bytes, r->draw_calls_per_sec, r->vertices_per_sec);
+    } else {
+        fprintf(out, "%s,%d,", r->mode, r->objects);
+        if (report->detail) fprintf(out, "%d,", r->detail);
+        fprintf(out, "%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.0f,%.0f,%.0f,%.1f,%.1f\n",
+                r->frames, r->mean_ms, r->p50_ms, r->p95_ms,
+                r->p99_ms, r->min_ms, r->max_ms, r->prep_ms, r->draw_calls, r->vertices,
+                r->bytes, r->draw_calls_per_sec, r->vertices_per_sec);
+    }
+    fflush(out);
+    report->rows++;
+
+    fprintf(stderr, "%-18s %8d ", r->mode, r->objects);
+    if (report->detail) fprintf(stderr, "%8d ", r->detail);
+    fprintf(stderr, "%9.3f %9.3f %9.3f %9.3f %9.3f %10.2f\n",
+            r->mean_ms, r->p50_ms, r->p95_ms, r->p99_ms,
+            r->prep_ms, r->vertices_per_sec / 1e6);
+}
+
+void bench_report_end(bench_report_t* report) {
+    if (report->format == BENCH_JSON) {
+        fprintf(report->out, "\n  ]\n}\n");
+    }
+    fflush(report->out);
+}
@@ -0,0 +1,100 @@
+/*
+ * bench.h - Rendering benchmark options, statistics and reports
+ *
+ * A chapter's benchmark mode renders a fixed number of frames per
+ * configuration, times each one with glFinish() fencing, and reports the
+ * frame-time distribution as CSV or JSON on stdout (or --output file).
+ * A human-readable summary goes to stderr so the report stays parseable.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+#define BENCH_MAX_COUNTS 16
+
+typedef enum {
+    BENCH_CSV,
+    BENCH_JSON
+} bench_format_t;
+
+typedef struct {
+    int frames;              /* Timed frames per configuration */
+    int warmup;              /* Untimed frames before each configuration */
+    int width, height;       /* Render target size */
+    int software;            /* Force a software rasteriser */
+    int threads;             /* Worker threads for CPU stages, 0 = per CPU */
+    bench_format_t format;
+    const char* output;      /* Report file, NULL for stdout */
+    const char* modes;       /* Comma-separated mode names, NULL for all */
+    int counts[BENCH_MAX_COUNTS];
+    int count_count;         /* 0 = use the chapter's defaults */
+} bench_options_t;
+
+typedef struct {
+    const char* mode;
+    int objects;
+    int detail;              /* For the report's detail column, if it has one */
+    int frames;
+    double mean_ms, p50_ms, p95_ms, p99_ms, min_ms, max_ms;
+    double prep_ms;          /* Mean CPU preparation time on the GL thread */
+    double draw_calls;       /* Per frame */
+    double vertices;         /* Per frame */
+    double bytes;            /* Vertex and index data per frame */
+    double draw_calls_per_sec;
+    double vertices_per_sec;
+} bench_result_t;
+
+typedef struct {
+    FILE* out;
+    bench_format_t format;
+    int rows;
+    const char* detail;      /* Name of the detail column, NULL for none */
+} bench_report_t;
+
+void bench_options_init(bench_options_t* opts);
+
+/*
+ * bench_parse_args - Parse the shared benchmark flags
+ *
+ * Recognises --frames, --warmup, --modes, --counts, --format, --output,
+ * --size WxH, --threads and --software. argv[0] and the flag that selected benchmark
+ * mode (e.g. --bench) are skipped. Returns 0, or -1 after printing an
+ * error for anything it does not understand.
+ */
+int bench_parse_args(bench_options_t* opts, int argc, char** argv);
+
+void bench_print_usage(const char* program, const char* flag);
+
+/*
+ * bench_mode_selected - True if 'name' is in opts->modes (or modes is NULL)
+ */
+int bench_mode_selected(const bench_options_t* opts, const char* name);
+
+/*
+ * bench_compute - Fill in the statistics for a set of frame times
+ *
+ * @frame_ms:   Frame times in milliseconds; reordered in place
+ * @draw_calls: Draw calls issued per frame
+ * @vertices:   Vertices submitted per frame
+ *
+ * mode, objects, prep_ms and bytes are left for the caller to fill in.
+ */
+void bench_compute(bench_result_t* result, double* frame_ms, int frames,
+                   double draw_calls, double vertices);
+
+void bench_report_begin(bench_report_t* report, FILE* out, bench_format_t format,
+                        const char* name, const char* renderer, const char* backend);
+
+/*
+ * bench_report_begin_detail - Begin a report with one more column, after
+ * objects, holding each result's 'detail' (e.g. "slices" per object)
+ */
+void bench_report_begin_detail(bench_report_t* report, FILE* out, bench_format_t format,
+                               const char* name, const char* renderer, const char* backend,
+                               const char* detail);
+void bench_report_add(bench_report_t* report, const bench_result_t* result);
+void bench_report_end(bench_report_t* report);
+
+#endif /* BENCH_H */
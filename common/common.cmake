@@ -0,0 +1,47 @@
+# common.cmake - Shared helper modules for the chapter demos
+#
+# Include from a chapter CMakeLists.txt, then add ${COMMON_SOURCES} to the
+# executable and link ${COMMON_LIBRARIES}:
+#
+#   include(${CMAKE_CURRENT_SOURCE_DIR}/../common/common.cmake)
+
+set(COMMON_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(COMMON_SOURCES
+    ${COMMON_DIR}/timing.c
+    ${COMMON_DIR}/frame_pacer.c
+    ${COMMON_DIR}/mat4.c
+)
+include_directories(${COMMON_DIR})
+
+set(COMMON_LIBRARIES)
+if(UNIX AND NOT APPLE)
+    list(APPEND COMMON_LIBRARIES m)
+endif()
+
+# Benchmark harness: add ${BENCH_SOURCES} and link ${BENCH_LIBRARIES}.
+# EGL gives a windowless context; without it the harness opens a GLUT window.
+set(BENCH_SOURCES
+    ${COMMON_DIR}/bench.c
+    ${COMMON_DIR}/offscreen.c
+)
+set(BENCH_LIBRARIES)
+find_package(OpenGL QUIET COMPONENTS EGL)
+if(OpenGL_EGL_FOUND)
+    set_source_files_properties(${COMMON_DIR}/offscreen.c PROPERTIES COMPILE_DEFINITIONS HAVE_EGL)
+    list(APPEND BENCH_LIBRARIES OpenGL::EGL)
+endif()
+
+# Worker thread pool: add ${THREAD_POOL_SOURCES} and link ${THREAD_POOL_LIBRARIES}.
+set(THREAD_POOL_SOURCES ${COMMON_DIR}/thread_pool.c)
+find_package(Threads REQUIRED)
+set(THREAD_POOL_LIBRARIES Threads::Threads)
+
+# Mesh processing (vertex cache order, strips, compact vertex formats):
+# add ${MESH_OPT_SOURCES}.
+set(MESH_OPT_SOURCES ${COMMON_DIR}/mesh_opt.c ${COMMON_DIR}/quantize.c)
+
+# Fixed-function lighting baked into vertex colours: add ${LIGHT_BAKE_SOURCES}.
+set(LIGHT_BAKE_SOURCES ${COMMON_DIR}/light_bake.c)
+
+# Display lists of GLUT-style shapes, built on first use: add ${SHAPE_CACHE_SOURCES}.
+set(SHAPE_CACHE_SOURCES ${COMMON_DIR}/shape_cache.c)
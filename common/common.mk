@@ -0,0 +1,31 @@
+# common.mk - Shared helper modules for the chapter demos
+#
+# Include from a chapter Makefile once CFLAGS/LDFLAGS are set, then add
+# $(COMMON_SOURCES) to the chapter's sources:
+#
+#   include ../common/common.mk
+
+COMMON_DIR := $(dir $(lastword $(MAKEFILE_LIST)))
+COMMON_SOURCES = $(COMMON_DIR)timing.c $(COMMON_DIR)frame_pacer.c $(COMMON_DIR)mat4.c
+CFLAGS += -I$(COMMON_DIR)
+
+# Benchmark harness: bench.c plus an offscreen context. EGL is used when
+# pkg-config finds it; otherwise the harness falls back to a GLUT window.
+BENCH_SOURCES = $(COMMON_DIR)bench.c $(COMMON_DIR)offscreen.c
+ifneq ($(shell pkg-config --exists egl 2>/dev/null && echo yes),)
+BENCH_CFLAGS = -DHAVE_EGL $(shell pkg-config --cflags egl)
+BENCH_LDFLAGS = $(shell pkg-config --libs egl)
+endif
+
+# Worker thread pool: add $(THREAD_POOL_SOURCES) and build with -pthread.
+THREAD_POOL_SOURCES = $(COMMON_DIR)thread_pool.c
+
+# Mesh processing (vertex cache order, strips, compact vertex formats):
+# add $(MESH_OPT_SOURCES).
+MESH_OPT_SOURCES = $(COMMON_DIR)mesh_opt.c $(COMMON_DIR)quantize.c
+
+# Fixed-function lighting baked into vertex colours: add $(LIGHT_BAKE_SOURCES).
+LIGHT_BAKE_SOURCES = $(COMMON_DIR)light_bake.c
+
+# Display lists of GLUT-style shapes, built on first use: add $(SHAPE_CACHE_SOURCES).
+SHAPE_CACHE_SOURCES = $(COMMON_DIR)shape_cache.c
@@ -0,0 +1,181 @@
+/*
+ * frame_pacer.c - Frame scheduler for GLUT main loops
+ */
+
+#include <GL/glut.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_pacer.h"
+#include "timing.h"
+
+#define NS_PER_SEC     1000000000ull
+#define SPIN_NS        1000000ull         /* Spin the last 1 ms of each wait */
+#define LINGER_NS      (2 * NS_PER_SEC)   /* On-demand frames kept after input */
+#define STATS_WINDOW_NS NS_PER_SEC
+
+static struct {
+    void (*update)(void);
+    pacer_mode_t mode;
+    uint64_t period_ns;        /* 0 = uncapped */
+    uint64_t next_deadline;
+    uint64_t last_frame;
+    uint64_t last_wake;
+    int animating;
+    int idle_installed;
+
+    /* Current statistics window */
+    uint64_t window_start;
+    uint64_t window_cpu_start;
+    int window_frames;
+    double interval_sum;
+    double interval_sum_sq;
+    double interval_max;
+    pacer_stats_t stats;
+
+    /* Periodic report */
+    uint64_t report_interval;
+    uint64_t last_report;
+} pacer;
+
+static void pacer_idle(void);
+
+static void install_idle(int install) {
+    if (install == pacer.idle_installed) return;
+    glutIdleFunc(install ? pacer_idle : NULL);
+    pacer.idle_installed = install;
+}
+
+static void wait_for_deadline(void) {
+    uint64_t now = timing_now_ns();
+
+    if (pacer.period_ns == 0) return;
+
+    /* Fell more than a frame behind: resynchronise instead of bursting */
+    if (pacer.next_deadline + pacer.period_ns < now) {
+        pacer.next_deadline = now;
+    }
+
+    if (pacer.next_deadline > now + SPIN_NS) {
+        timing_sleep_until_ns(pacer.next_deadline - SPIN_NS);
+    }
+    while (timing_now_ns() < pacer.next_deadline) {
+        /* Spin: the OS sleep is too coarse for the final stretch */
+    }
+
+    pacer.next_deadline += pacer.period_ns;
+}
+
+static void reset_window(uint64_t now) {
+    pacer.window_start = now;
+    pacer.window_cpu_start = timing_cpu_ns();
+    pacer.window_frames = 0;
+    pacer.interval_sum = 0.0;
+    pacer.interval_sum_sq = 0.0;
+    pacer.interval_max = 0.0;
+}
+
+static void record_frame(uint64_t now) {
+    if (pacer.last_frame != 0) {
+        double ms = (now - pacer.last_frame) / 1e6;
+        pacer.interval_sum += ms;
+        pacer.interval_sum_sq += ms * ms;
+        if (ms > pacer.interval_max) pacer.interval_max = ms;
+        pacer.window_frames++;
+    }
+    pacer.last_frame = now;
+
+    uint64_t elapsed = now - pacer.window_start;
+    if (elapsed < STATS_WINDOW_NS) return;
+
+    /* CPU time is measured over the whole window, including any time spent
+     * blocked in on-demand mode, so it reflects real power use */
+    double wall_ns = (double)elapsed;
+    double cpu_ns = (double)(timing_cpu_ns() - pacer.window_cpu_start);
+    int n = pacer.window_frames;
+
+    pacer.stats.fps = n / (wall_ns / 1e9);
+    pacer.stats.cpu_percent = 100.0 * cpu_ns / wall_ns;
+    if (n > 0) {
+        double mean = pacer.interval_sum / n;
+        double var = pacer.interval_sum_sq / n - mean * mean;
+        pacer.stats.frame_ms = mean;
+        pacer.stats.jitter_ms = var > 0.0 ? sqrt(var) : 0.0;
+        pacer.stats.worst_ms = pacer.interval_max;
+    }
+    reset_window(now);
+
+    if (pacer.report_interval && now - pacer.last_report >= pacer.report_interval) {
+        printf("[pacer] %.1f fps | frame %.2f ms | jitter %.3f ms | worst %.2f ms | CPU %.1f%%\n",
+               pacer.stats.fps, pacer.stats.frame_ms, pacer.stats.jitter_ms,
+               pacer.stats.worst_ms, pacer.stats.cpu_percent);
+        pacer.last_report = now;
+    }
+}
+
+static void pacer_idle(void) {
+    if (pacer.mode == PACER_ON_DEMAND && !pacer.animating &&
+        timing_now_ns() - pacer.last_wake > LINGER_NS) {
+        /* Nothing to animate: let GLUT block until the next event */
+        install_idle(0);
+        pacer.last_frame = 0;
+        return;
+    }
+
+    wait_for_deadline();
+    record_frame(timing_now_ns());
+    pacer.update();
+}
+
+void frame_pacer_start(void (*update)(void)) {
+    const char* env;
+    uint64_t now = timing_now_ns();
+
+    memset(&pacer, 0, sizeof(pacer));
+    pacer.update = update;
+    pacer.mode = PACER_CONTINUOUS;
+    pacer.last_wake = now;
+    pacer.last_report = now;
+    reset_window(now);
+    frame_pacer_set_target_fps(60.0);
+
+    if ((env = getenv("FRAME_PACER_FPS")) != NULL) {
+        frame_pacer_set_target_fps(atof(env));
+    }
+    if ((env = getenv("FRAME_PACER_REPORT")) != NULL) {
+        pacer.report_interval = (uint64_t)(atof(env) * NS_PER_SEC);
+    }
+
+    env = getenv("FRAME_PACER_MODE");
+    frame_pacer_set_mode((env && strcmp(env, "on-demand") == 0)
+                         ? PACER_ON_DEMAND : PACER_CONTINUOUS);
+    install_idle(1);
+}
+
+void frame_pacer_set_target_fps(double fps) {
+    pacer.period_ns = fps > 0.0 ? (uint64_t)(NS_PER_SEC / fps) : 0;
+    pacer.next_deadline = timing_now_ns();
+}
+
+void frame_pacer_set_mode(pacer_mode_t mode) {
+    pacer.mode = mode;
+    frame_pacer_wake();
+}
+
+void frame_pacer_wake(void) {
+    pacer.last_wake = timing_now_ns();
+    if (pacer.update && !pacer.idle_installed) {
+        pacer.next_deadline = pacer.last_wake;
+        install_idle(1);
+    }
+}
+
+void frame_pacer_set_animating(int animating) {
+    pacer.animating = animating;
+    if (animating) frame_pacer_wake();
+}
+
+void frame_pacer_get_stats(pacer_stats_t* stats) {
+    *stats = pacer.stats;
+}
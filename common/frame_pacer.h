@@ -0,0 +1,65 @@
+/*
+ * frame_pacer.h - Frame scheduler for GLUT main loops
+ *
+ * Replaces a bare glutIdleFunc that redraws as fast as possible. Frames are
+ * capped at a target rate by sleeping most of the remaining frame time and
+ * spinning only the last fraction of a millisecond. In on-demand mode the
+ * idle callback is removed entirely once input stops, so GLUT blocks in
+ * its event wait and the process uses no CPU.
+ *
+ * Environment overrides, read by frame_pacer_start():
+ *   FRAME_PACER_FPS=<fps>          Target rate, 0 for uncapped (default 60)
+ *   FRAME_PACER_MODE=on-demand     Redraw only on input or animation
+ *   FRAME_PACER_REPORT=<seconds>   Print CPU use and jitter periodically
+ */
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+typedef enum {
+    PACER_CONTINUOUS,   /* Run every frame at the target rate */
+    PACER_ON_DEMAND     /* Run only after input or while animating */
+} pacer_mode_t;
+
+typedef struct {
+    double fps;          /* Frames per second over the last window */
+    double frame_ms;     /* Mean frame interval */
+    double jitter_ms;    /* Standard deviation of the frame interval */
+    double worst_ms;     /* Longest frame interval */
+    double cpu_percent;  /* Process CPU time / wall time; 100 = one core */
+} pacer_stats_t;
+
+/*
+ * frame_pacer_start - Install the pacer as the GLUT idle callback
+ *
+ * @update: Called once per paced frame; typically advances animation and
+ *          calls glutPostRedisplay(), like a classic idle callback
+ */
+void frame_pacer_start(void (*update)(void));
+
+void frame_pacer_set_target_fps(double fps);
+void frame_pacer_set_mode(pacer_mode_t mode);
+
+/*
+ * frame_pacer_wake - Note user input
+ *
+ * Call from input callbacks. In on-demand mode this resumes frames for a
+ * short linger period; in continuous mode it does nothing.
+ */
+void frame_pacer_wake(void);
+
+/*
+ * frame_pacer_set_animating - Keep on-demand mode running while nonzero
+ *
+ * On-demand mode otherwise stops drawing shortly after the last input, so
+ * anything that moves on its own must call this with 1 when it starts
+ * moving and 0 when it comes to rest.
+ */
+void frame_pacer_set_animating(int animating);
+
+/*
+ * frame_pacer_get_stats - Statistics for the last completed one-second window
+ */
+void frame_pacer_get_stats(pacer_stats_t* stats);
+
+#endif /* FRAME_PACER_H */
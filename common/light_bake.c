@@ -0,0 +1,319 @@
+/*
+ * light_bake.c - Fixed-function lighting evaluated on the CPU
+ */
+
+#include <GL/glut.h>
+#include <math.h>
+#include <string.h>
+#include "light_bake.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHT_BAKE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+static void set4(float* v, float a, float b, float c, float d) {
+    v[0] = a; v[1] = b; v[2] = c; v[3] = d;
+}
+
+void light_bake_defaults(light_bake_t* bake) {
+    memset(bake, 0, sizeof(*bake));
+    set4(bake->scene_ambient, 0.2f, 0.2f, 0.2f, 1.0f);
+    bake->eye_dir[2] = 1.0f;
+    set4(bake->material.ambient, 0.2f, 0.2f, 0.2f, 1.0f);
+    set4(bake->material.diffuse, 0.8f, 0.8f, 0.8f, 1.0f);
+    set4(bake->material.specular, 0.0f, 0.0f, 0.0f, 1.0f);
+    set4(bake->material.emission, 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+static bake_light_t* add_light(light_bake_t* bake, float x, float y, float z, float w) {
+    if (bake->light_count >= LIGHT_BAKE_MAX_LIGHTS) return NULL;
+
+    bake_light_t* light = &bake->lights[bake->light_count++];
+    set4(light->position, x, y, z, w);
+    set4(light->ambient, 0.0f, 0.0f, 0.0f, 1.0f);
+    set4(light->diffuse, 1.0f, 1.0f, 1.0f, 1.0f);
+    set4(light->specular, 1.0f, 1.0f, 1.0f, 1.0f);
+    light->attenuation[0] = 1.0f;
+    light->attenuation[1] = light->attenuation[2] = 0.0f;
+    return light;
+}
+
+bake_light_t* light_bake_add_directional(light_bake_t* bake, float x, float y, float z) {
+    return add_light(bake, x, y, z, 0.0f);
+}
+
+bake_light_t* light_bake_add_point(light_bake_t* bake, float x, float y, float z) {
+    return add_light(bake, x, y, z, 1.0f);
+}
+
+void light_bake_set_view(light_bake_t* bake, const float modelview[16]) {
+    /* The eye looks down -z, so the viewer is at +z in eye space; the
+     * transpose of the camera rotation takes that back to world space */
+    float x = modelview[2], y = modelview[6], z = modelview[10];
+    float len = sqrtf(x * x + y * y + z * z);
+
+    if (len > 0.0f) {
+        bake->eye_dir[0] = x / len;
+        bake->eye_dir[1] = y / len;
+        bake->eye_dir[2] = z / len;
+    }
+}
+
+void light_bake_apply(const light_bake_t* bake) {
+    const bake_material_t* m = &bake->material;
+
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, bake->scene_ambient);
+    glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, GL_FALSE);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, m->ambient);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, m->diffuse);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, m->specular);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, m->emission);
+    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, m->shininess);
+    if (m->color_material) {
+        glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+        glEnable(GL_COLOR_MATERIAL);
+    } else {
+        glDisable(GL_COLOR_MATERIAL);
+    }
+
+    for (int i = 0; i < LIGHT_BAKE_MAX_LIGHTS; i++) {
+        GLenum id = GL_LIGHT0 + i;
+        if (i >= bake->light_count) {
+            glDisable(id);
+            continue;
+        }
+
+        const bake_light_t* light = &bake->lights[i];
+        glLightfv(id, GL_POSITION, light->position);
+        glLightfv(id, GL_AMBIENT, light->ambient);
+        glLightfv(id, GL_DIFFUSE, light->diffuse);
+        glLightfv(id, GL_SPECULAR, light->specular);
+        glLightf(id, GL_SPOT_CUTOFF, 180.0f);
+        glLightf(id, GL_CONSTANT_ATTENUATION, light->attenuation[0]);
+        glLightf(id, GL_LINEAR_ATTENUATION, light->attenuation[1]);
+        glLightf(id, GL_QUADRATIC_ATTENUATION, light->attenuation[2]);
+        glEnable(id);
+    }
+    glEnable(GL_LIGHTING);
+}
+
+/* Terms that do not depend on the vertex, worked out once per bake */
+typedef struct {
+    float dir[3];                /* Unit direction to a directional light */
+    float half[3];               /* Its half vector, also fixed */
+    float ambient[3];            /* Light ambient times material ambient, if fixed */
+    float diffuse[3];
+    float specular[3];           /* Light specular times material specular */
+} light_terms_t;
+
+static void normalize3(float* v) {
+    float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 0.0f) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    }
+}
+
+static void prepare(const light_bake_t* bake, light_terms_t* terms, float* base) {
+    const bake_material_t* m = &bake->material;
+
+    for (int k = 0; k < 3; k++) {
+        base[k] = m->emission[k];
+        if (!m->color_material) base[k] += bake->scene_ambient[k] * m->ambient[k];
+    }
+    for (int i = 0; i < bake->light_count; i++) {
+        const bake_light_t* light = &bake->lights[i];
+        light_terms_t* t = &terms[i];
+
+        for (int k = 0; k < 3; k++) {
+            t->dir[k] = light->position[k];
+            t->ambient[k] = light->ambient[k] * (m->color_material ? 1.0f : m->ambient[k]);
+            t->diffuse[k] = light->diffuse[k] * (m->color_material ? 1.0f : m->diffuse[k]);
+            t->specular[k] = light->specular[k] * m->specular[k];
+        }
+        normalize3(t->dir);
+        for (int k = 0; k < 3; k++) t->half[k] = t->dir[k] + bake->eye_dir[k];
+        normalize3(t->half);
+    }
+}
+
+static int has_specular(const light_terms_t* t) {
+    return t->specular[0] != 0.0f || t->specular[1] != 0.0f || t->specular[2] != 0.0f;
+}
+
+/* max(N.H, 0)^shininess, with 0^0 = 1 as GL has it */
+static float specular_power(float n_dot_h, float shininess) {
+    if (n_dot_h <= 0.0f) return shininess == 0.0f ? 1.0f : 0.0f;
+    return powf(n_dot_h, shininess);
+}
+
+static float clamp01(float c) {
+    return c < 0.0f ? 0.0f : c > 1.0f ? 1.0f : c;
+}
+
+static void bake_vertex(const light_bake_t* bake, const light_terms_t* terms,
+                        const float* base, const float* p, const float* n,
+                        const float* color, float* out) {
+    const bake_material_t* m = &bake->material;
+    float c[3], mat[3];
+
+    for (int k = 0; k < 3; k++) {
+        mat[k] = m->color_material ? color[k] : 1.0f;
+        c[k] = base[k] + (m->color_material ? bake->scene_ambient[k] * mat[k] : 0.0f);
+    }
+
+    for (int i = 0; i < bake->light_count; i++) {
+        const bake_light_t* light = &bake->lights[i];
+        const light_terms_t* t = &terms[i];
+        float l[3], h[3], att = 1.0f;
+
+        if (light->position[3] != 0.0f) {
+            float dist;
+            for (int k = 0; k < 3; k++) l[k] = light->position[k] - p[k];
+            dist = sqrtf(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+            normalize3(l);
+            att = 1.0f / (light->attenuation[0] + light->attenuation[1] * dist
+                          + light->attenuation[2] * dist * dist);
+            for (int k = 0; k < 3; k++) h[k] = l[k] + bake->eye_dir[k];
+            normalize3(h);
+        } else {
+            memcpy(l, t->dir, sizeof(l));
+            memcpy(h, t->half, sizeof(h));
+        }
+
+        float n_dot_l = n[0] * l[0] + n[1] * l[1] + n[2] * l[2];
+        float spec = 0.0f;
+        if (n_dot_l < 0.0f) n_dot_l = 0.0f;
+        if (n_dot_l > 0.0f && has_specular(t)) {
+            spec = specular_power(n[0] * h[0] + n[1] * h[1] + n[2] * h[2], m->shininess);
+        }
+        for (int k = 0; k < 3; k++) {
+            c[k] += att * ((t->ambient[k] + n_dot_l * t->diffuse[k]) * mat[k]
+                           + spec * t->specular[k]);
+        }
+    }
+
+    for (int k = 0; k < 3; k++) out[k] = clamp01(c[k]);
+}
+
+#ifdef LIGHT_BAKE_SSE
+/* Four xyz triples into one register per component */
+static void load_xyz4(const float* v, __m128* x, __m128* y, __m128* z) {
+    *x = _mm_set_ps(v[9], v[6], v[3], v[0]);
+    *y = _mm_set_ps(v[10], v[7], v[4], v[1]);
+    *z = _mm_set_ps(v[11], v[8], v[5], v[2]);
+}
+
+static __m128 dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+/* Scale (x, y, z) to unit length; returns the original length */
+static __m128 normalize4(__m128* x, __m128* y, __m128* z) {
+    __m128 len = _mm_sqrt_ps(dot3(*x, *y, *z, *x, *y, *z));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), len);
+
+    *x = _mm_mul_ps(*x, inv);
+    *y = _mm_mul_ps(*y, inv);
+    *z = _mm_mul_ps(*z, inv);
+    return len;
+}
+
+static void bake_vertices4(const light_bake_t* bake, const light_terms_t* terms,
+                           const float* base, const float* p, const float* n,
+                           const float* color, float* out) {
+    const bake_material_t* m = &bake->material;
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 px, py, pz, nx, ny, nz, mat[3], c[3];
+
+    load_xyz4(p, &px, &py, &pz);
+    load_xyz4(n, &nx, &ny, &nz);
+    if (m->color_material) {
+        load_xyz4(color, &mat[0], &mat[1], &mat[2]);
+    } else {
+        mat[0] = mat[1] = mat[2] = one;
+    }
+    for (int k = 0; k < 3; k++) {
+        c[k] = _mm_set1_ps(base[k]);
+        if (m->color_material) {
+            c[k] = _mm_add_ps(c[k], _mm_mul_ps(_mm_set1_ps(bake->scene_ambient[k]), mat[k]));
+        }
+    }
+
+    for (int i = 0; i < bake->light_count; i++) {
+        const bake_light_t* light = &bake->lights[i];
+        const light_terms_t* t = &terms[i];
+        __m128 lx, ly, lz, hx, hy, hz, att = one;
+
+        if (light->position[3] != 0.0f) {
+            lx = _mm_sub_ps(_mm_set1_ps(light->position[0]), px);
+            ly = _mm_sub_ps(_mm_set1_ps(light->position[1]), py);
+            lz = _mm_sub_ps(_mm_set1_ps(light->position[2]), pz);
+            __m128 dist = normalize4(&lx, &ly, &lz);
+            __m128 k = _mm_add_ps(_mm_set1_ps(light->attenuation[0]),
+                                  _mm_mul_ps(dist, _mm_add_ps(_mm_set1_ps(light->attenuation[1]),
+                                      _mm_mul_ps(dist, _mm_set1_ps(light->attenuation[2])))));
+            att = _mm_div_ps(one, k);
+            hx = _mm_add_ps(lx, _mm_set1_ps(bake->eye_dir[0]));
+            hy = _mm_add_ps(ly, _mm_set1_ps(bake->eye_dir[1]));
+            hz = _mm_add_ps(lz, _mm_set1_ps(bake->eye_dir[2]));
+            normalize4(&hx, &hy, &hz);
+        } else {
+            lx = _mm_set1_ps(t->dir[0]);
+            ly = _mm_set1_ps(t->dir[1]);
+            lz = _mm_set1_ps(t->dir[2]);
+            hx = _mm_set1_ps(t->half[0]);
+            hy = _mm_set1_ps(t->half[1]);
+            hz = _mm_set1_ps(t->half[2]);
+        }
+
+        __m128 n_dot_l = _mm_max_ps(dot3(nx, ny, nz, lx, ly, lz), zero);
+        __m128 spec = zero;
+        if (has_specular(t) && _mm_movemask_ps(_mm_cmpgt_ps(n_dot_l, zero))) {
+            float n_dot_h[4], lit[4], s[4];
+            _mm_storeu_ps(n_dot_h, dot3(nx, ny, nz, hx, hy, hz));
+            _mm_storeu_ps(lit, n_dot_l);
+            for (int k = 0; k < 4; k++) {
+                s[k] = lit[k] > 0.0f ? specular_power(n_dot_h[k], m->shininess) : 0.0f;
+            }
+            spec = _mm_loadu_ps(s);
+        }
+        for (int k = 0; k < 3; k++) {
+            __m128 lit = _mm_add_ps(_mm_set1_ps(t->ambient[k]),
+                                    _mm_mul_ps(n_dot_l, _mm_set1_ps(t->diffuse[k])));
+            lit = _mm_add_ps(_mm_mul_ps(lit, mat[k]), _mm_mul_ps(spec, _mm_set1_ps(t->specular[k])));
+            c[k] = _mm_add_ps(c[k], _mm_mul_ps(att, lit));
+        }
+    }
+
+    __m128 r[4];
+    for (int k = 0; k < 3; k++) r[k] = _mm_min_ps(_mm_max_ps(c[k], zero), one);
+    r[3] = zero;
+    _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+    for (int k = 0; k < 4; k++) {
+        _mm_storel_pi((__m64*)(out + k * 3), r[k]);
+        _mm_store_ss(out + k * 3 + 2, _mm_movehl_ps(r[k], r[k]));
+    }
+}
+#endif
+
+void light_bake_vertices(const light_bake_t* bake, const float* positions,
+                         const float* normals, const float* colors, int count, float* out) {
+    light_terms_t terms[LIGHT_BAKE_MAX_LIGHTS];
+    float base[3];
+    int i = 0;
+
+    prepare(bake, terms, base);
+#ifdef LIGHT_BAKE_SSE
+    for (; i + 4 <= count; i += 4) {
+        bake_vertices4(bake, terms, base, positions + i * 3, normals + i * 3,
+                       colors ? colors + i * 3 : NULL, out + i * 3);
+    }
+#endif
+    for (; i < count; i++) {
+        bake_vertex(bake, terms, base, positions + i * 3, normals + i * 3,
+                    colors ? colors + i * 3 : NULL, out + i * 3);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * light_bake.h - Fixed-function lighting evaluated on the CPU
+ *
+ * OpenGL's per-vertex lighting is redone for every vertex every frame,
+ * even when nothing in the scene moves. For static geometry the result
+ * can be computed once and stored in the colour array, then drawn with
+ * GL_LIGHTING disabled.
+ *
+ * The model is the one glLightfv/glMaterialfv set up, per vertex:
+ *
+ *   colour = emission + scene_ambient * ambient
+ *          + sum over lights of attenuation * (ambient * light_ambient
+ *              + max(N.L, 0) * diffuse * light_diffuse
+ *              + (N.L > 0) * max(N.H, 0)^shininess * specular * light_specular)
+ *
+ * clamped to 0..1, where L points at the light and H is halfway between L
+ * and the viewer. Directional (w = 0) and point (w = 1) lights are
+ * supported; spotlights are not. Vertices are lit four at a time with SSE.
+ *
+ * Baked lighting is computed in world space. It matches live lighting as
+ * long as the lights are given in world space, i.e. set after the camera
+ * transform. Specular highlights also depend on the viewing direction
+ * (eye_dir), so they are only right for the view they were baked for.
+ */
+
+#ifndef LIGHT_BAKE_H
+#define LIGHT_BAKE_H
+
+#define LIGHT_BAKE_MAX_LIGHTS 8
+
+typedef struct {
+    float position[4];           /* w = 0: direction to the light, w = 1: point */
+    float ambient[4], diffuse[4], specular[4];
+    float attenuation[3];        /* Constant, linear and quadratic, point lights only */
+} bake_light_t;
+
+typedef struct {
+    float ambient[4], diffuse[4], specular[4], emission[4];
+    float shininess;
+    int color_material;          /* Ambient and diffuse from the vertex colours,
+                                  * like GL_COLOR_MATERIAL with GL_AMBIENT_AND_DIFFUSE */
+} bake_material_t;
+
+typedef struct {
+    float scene_ambient[4];      /* GL_LIGHT_MODEL_AMBIENT */
+    float eye_dir[3];            /* Unit vector towards the viewer, for specular */
+    bake_material_t material;
+    bake_light_t lights[LIGHT_BAKE_MAX_LIGHTS];
+    int light_count;
+} light_bake_t;
+
+/*
+ * light_bake_defaults - OpenGL's default material and light model, no lights
+ */
+void light_bake_defaults(light_bake_t* bake);
+
+/*
+ * light_bake_add_directional / light_bake_add_point - Add a white light
+ *
+ * The light has GL_LIGHT0's defaults (diffuse and specular 1, no ambient);
+ * adjust the returned light for anything else. Returns NULL when
+ * LIGHT_BAKE_MAX_LIGHTS are in use.
+ */
+bake_light_t* light_bake_add_directional(light_bake_t* bake, float x, float y, float z);
+bake_light_t* light_bake_add_point(light_bake_t* bake, float x, float y, float z);
+
+/*
+ * light_bake_set_view - Take eye_dir from a modelview matrix
+ *
+ * @modelview: Column-major, as from glGetFloatv(GL_MODELVIEW_MATRIX),
+ *             with only the camera transform applied
+ */
+void light_bake_set_view(light_bake_t* bake, const float modelview[16]);
+
+/*
+ * light_bake_apply - Issue the glLight/glMaterial calls for live lighting
+ *
+ * Light positions go through the current modelview matrix, as for
+ * glLightfv, so call it after the camera transform. Enables GL_LIGHTING
+ * and the lights used, and disables the rest.
+ */
+void light_bake_apply(const light_bake_t* bake);
+
+/*
+ * light_bake_vertices - Light 'count' vertices
+ *
+ * @positions, @normals: xyz per vertex; normals must be unit length
+ * @colors:              rgb per vertex, used with color_material, else NULL
+ * @out:                 rgb per vertex; may be the same array as colors
+ */
+void light_bake_vertices(const light_bake_t* bake, const float* positions,
+                         const float* normals, const float* colors, int count, float* out);
+
+#endif /* LIGHT_BAKE_H */
@@ -0,0 +1,101 @@
+/*
+ * mat4.c - 4x4 matrices laid out the way OpenGL expects
+ */
+
+#include <math.h>
+#include <string.h>
+#include "mat4.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAT4_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void mat4_identity(float m[16]) {
+    memset(m, 0, 16 * sizeof(float));
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+void mat4_multiply(float out[16], const float a[16], const float b[16]) {
+    float r[16];
+
+#ifdef MAT4_SSE
+    /* Each result column is a's columns weighted by one column of b */
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int c = 0; c < 4; c++) {
+        const float* bc = b + c * 4;
+        __m128 col = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+        col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+        col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+        col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+        _mm_storeu_ps(r + c * 4, col);
+    }
+#else
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            r[c * 4 + row] = a[row] * b[c * 4] + a[4 + row] * b[c * 4 + 1] +
+                             a[8 + row] * b[c * 4 + 2] + a[12 + row] * b[c * 4 + 3];
+        }
+    }
+#endif
+    memcpy(out, r, sizeof(r));
+}
+
+void mat4_translate_rotate_scale(float m[16], float tx, float ty, float tz,
+                                 float angle, float ax, float ay, float az, float s) {
+    float len = sqrtf(ax * ax + ay * ay + az * az);
+    float rad = angle * 0.017453292519943f;
+    float c = cosf(rad), sn = sinf(rad), t = 1.0f - c;
+
+    if (len > 0.0f) {
+        ax /= len; ay /= len; az /= len;
+    }
+
+    /* Rotation columns (same formula as the glRotate man page), scaled */
+    m[0]  = (t * ax * ax + c) * s;
+    m[1]  = (t * ax * ay + sn * az) * s;
+    m[2]  = (t * ax * az - sn * ay) * s;
+    m[3]  = 0.0f;
+    m[4]  = (t * ax * ay - sn * az) * s;
+    m[5]  = (t * ay * ay + c) * s;
+    m[6]  = (t * ay * az + sn * ax) * s;
+    m[7]  = 0.0f;
+    m[8]  = (t * ax * az + sn * ay) * s;
+    m[9]  = (t * ay * az - sn * ax) * s;
+    m[10] = (t * az * az + c) * s;
+    m[11] = 0.0f;
+    m[12] = tx;
+    m[13] = ty;
+    m[14] = tz;
+    m[15] = 1.0f;
+}
+
+void mat4_transform_points(const float m[16], const float* in, int in_stride,
+                           float* out, int out_stride, int count) {
+#ifdef MAT4_SSE
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+
+    for (int i = 0; i < count; i++, in += in_stride, out += out_stride) {
+        __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[0])), c3);
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[2])));
+
+        /* Store x, y then z so the float after the position is untouched */
+        _mm_storel_pi((__m64*)out, r);
+        _mm_store_ss(out + 2, _mm_movehl_ps(r, r));
+    }
+#else
+    for (int i = 0; i < count; i++, in += in_stride, out += out_stride) {
+        float x = in[0], y = in[1], z = in[2];
+        out[0] = m[0] * x + m[4] * y + m[8]  * z + m[12];
+        out[1] = m[1] * x + m[5] * y + m[9]  * z + m[13];
+        out[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+    }
+#endif
+}
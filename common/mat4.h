@@ -0,0 +1,38 @@
+/*
+ * mat4.h - 4x4 matrices laid out the way OpenGL expects
+ *
+ * Matrices are column-major float[16], so they can be handed straight to
+ * glLoadMatrixf/glMultMatrixf, and the builders produce exactly what the
+ * matching glTranslatef/glRotatef/glScalef calls would. The point
+ * transform uses SSE when the compiler targets it, with a plain C fallback.
+ */
+
+#ifndef MAT4_H
+#define MAT4_H
+
+void mat4_identity(float m[16]);
+
+/* out = a * b; out may alias a or b */
+void mat4_multiply(float out[16], const float a[16], const float b[16]);
+
+/*
+ * mat4_translate_rotate_scale - Build T * R * S
+ *
+ * Equivalent to glTranslatef(tx, ty, tz); glRotatef(angle, ax, ay, az);
+ * glScalef(s, s, s) applied to an identity matrix. The angle is in degrees.
+ */
+void mat4_translate_rotate_scale(float m[16], float tx, float ty, float tz,
+                                 float angle, float ax, float ay, float az, float s);
+
+/*
+ * mat4_transform_points - Transform xyz points by m (w = 1)
+ *
+ * @in_stride, out_stride: Distance between points in floats, so positions
+ *                         can be read from or written into interleaved arrays
+ *
+ * Only the three position floats of each output point are written.
+ */
+void mat4_transform_points(const float m[16], const float* in, int in_stride,
+                           float* out, int out_stride, int count);
+
+#endif /* MAT4_H */
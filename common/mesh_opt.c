@@ -0,0 +1,246 @@
+/*
+ * mesh_opt.c - Vertex cache optimisation for indexed triangle meshes
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_opt.h"
+
+/* Vertex -> triangle adjacency: the triangles using vertex v are
+ * triangles[offsets[v]] .. triangles[offsets[v + 1] - 1] */
+typedef struct {
+    int* offsets;
+    int* triangles;
+} adjacency_t;
+
+static int build_adjacency(adjacency_t* adj, const unsigned int* indices,
+                           int index_count, int vertex_count) {
+    adj->offsets = calloc((size_t)vertex_count + 1, sizeof(int));
+    adj->triangles = malloc((size_t)(index_count > 0 ? index_count : 1) * sizeof(int));
+    if (!adj->offsets || !adj->triangles) {
+        free(adj->offsets);
+        free(adj->triangles);
+        return -1;
+    }
+
+    for (int i = 0; i < index_count; i++) adj->offsets[indices[i] + 1]++;
+    for (int v = 0; v < vertex_count; v++) adj->offsets[v + 1] += adj->offsets[v];
+
+    /* Fill using offsets[v] as a cursor, then shift the cursors back */
+    for (int i = 0; i < index_count; i++) {
+        adj->triangles[adj->offsets[indices[i]]++] = i / 3;
+    }
+    for (int v = vertex_count; v > 0; v--) adj->offsets[v] = adj->offsets[v - 1];
+    adj->offsets[0] = 0;
+    return 0;
+}
+
+static void free_adjacency(adjacency_t* adj) {
+    free(adj->offsets);
+    free(adj->triangles);
+}
+
+/* Vertices that miss a FIFO cache of cache_size entries */
+static long count_misses(const unsigned int* indices, int count, int vertex_count,
+                         int cache_size) {
+    int* stamp = malloc((size_t)vertex_count * sizeof(int));
+    long misses = 0;
+    if (!stamp) return -1;
+
+    /* A vertex is cached if fewer than cache_size misses have happened
+     * since it was last loaded */
+    for (int v = 0; v < vertex_count; v++) stamp[v] = -cache_size - 1;
+    for (int i = 0; i < count; i++) {
+        unsigned int v = indices[i];
+        if (misses - stamp[v] > cache_size) {
+            stamp[v] = (int)misses;
+            misses++;
+        }
+    }
+    free(stamp);
+    return misses;
+}
+
+float mesh_acmr(const unsigned int* indices, int index_count, int vertex_count,
+                int cache_size) {
+    long misses = count_misses(indices, index_count, vertex_count,
+                               cache_size > 0 ? cache_size : MESH_CACHE_SIZE);
+    return index_count >= 3 && misses >= 0 ? (float)misses / (index_count / 3) : 0.0f;
+}
+
+float mesh_strip_acmr(const unsigned int* strip, int length, int vertex_count,
+                      int cache_size) {
+    long misses = count_misses(strip, length, vertex_count,
+                               cache_size > 0 ? cache_size : MESH_CACHE_SIZE);
+    long triangles = 0;
+
+    for (int i = 2; i < length; i++) {
+        if (strip[i] != strip[i-1] && strip[i] != strip[i-2] && strip[i-1] != strip[i-2]) {
+            triangles++;
+        }
+    }
+    return triangles > 0 && misses >= 0 ? (float)misses / triangles : 0.0f;
+}
+
+/*
+ * Tipsify: repeatedly emit every remaining triangle around a fanning
+ * vertex, then move to the vertex among those just emitted that will still
+ * be in the cache when its remaining triangles are drawn. Dead ends fall
+ * back to the most recently emitted vertices, then to input order.
+ */
+int mesh_optimize_vertex_cache(unsigned int* indices, int index_count,
+                               int vertex_count, int cache_size) {
+    int tri_count = index_count / 3;
+    adjacency_t adj;
+
+    if (tri_count == 0) return 0;
+    if (cache_size <= 0) cache_size = MESH_CACHE_SIZE;
+    if (build_adjacency(&adj, indices, tri_count * 3, vertex_count) != 0) return -1;
+
+    int* live = malloc((size_t)vertex_count * sizeof(int));
+    int* stamp = calloc((size_t)vertex_count, sizeof(int));
+    int* stack = malloc((size_t)tri_count * 3 * sizeof(int));
+    unsigned char* emitted = calloc((size_t)tri_count, 1);
+    unsigned int* out = malloc((size_t)tri_count * 3 * sizeof(unsigned int));
+    if (!live || !stamp || !stack || !emitted || !out) {
+        free(live); free(stamp); free(stack); free(emitted); free(out);
+        free_adjacency(&adj);
+        return -1;
+    }
+
+    for (int v = 0; v < vertex_count; v++) live[v] = adj.offsets[v + 1] - adj.offsets[v];
+
+    int fan = 0, cursor = 0, top = 0, out_count = 0;
+    int time = cache_size + 1;
+    while (fan >= 0) {
+        int candidates = top;
+
+        for (int a = adj.offsets[fan]; a < adj.offsets[fan + 1]; a++) {
+            int t = adj.triangles[a];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                out[out_count++] = v;
+                stack[top++] = (int)v;
+                live[v]--;
+                if (time - stamp[v] > cache_size) stamp[v] = time++;
+            }
+        }
+
+        /* Prefer a vertex emitted just now that will still be cached after
+         * its remaining triangles are drawn, the older the better */
+        int best = -1, best_priority = -1;
+        for (int i = candidates; i < top; i++) {
+            int v = stack[i];
+            if (live[v] <= 0) continue;
+            int priority = 0;
+            if (time - stamp[v] + 2 * live[v] <= cache_size) priority = time - stamp[v];
+            if (priority > best_priority) {
+                best_priority = priority;
+                best = v;
+            }
+        }
+        while (best < 0 && top > 0) {
+            int v = stack[--top];
+            if (live[v] > 0) best = v;
+        }
+        while (best < 0 && cursor < vertex_count) {
+            if (live[cursor] > 0) best = cursor;
+            cursor++;
+        }
+        fan = best;
+    }
+
+    memcpy(indices, out, (size_t)out_count * sizeof(unsigned int));
+    free(live); free(stamp); free(stack); free(emitted); free(out);
+    free_adjacency(&adj);
+    return 0;
+}
+
+/* An unvisited triangle containing the directed edge a->b, returning its
+ * third vertex in *third, or -1 */
+static int find_triangle(const adjacency_t* adj, const unsigned int* indices,
+                         const unsigned char* visited, unsigned int a, unsigned int b,
+                         unsigned int* third) {
+    for (int i = adj->offsets[a]; i < adj->offsets[a + 1]; i++) {
+        int t = adj->triangles[i];
+        const unsigned int* tri = &indices[t * 3];
+        if (visited[t]) continue;
+        for (int k = 0; k < 3; k++) {
+            if (tri[k] == a && tri[(k + 1) % 3] == b) {
+                *third = tri[(k + 2) % 3];
+                return t;
+            }
+        }
+    }
+    return -1;
+}
+
+int mesh_build_strip(const unsigned int* indices, int index_count, int vertex_count,
+                     unsigned int** out_strip) {
+    int tri_count = index_count / 3;
+    adjacency_t adj;
+
+    *out_strip = NULL;
+    if (build_adjacency(&adj, indices, tri_count * 3, vertex_count) != 0) return -1;
+
+    /* Worst case: every triangle alone, plus up to 3 joining indices */
+    unsigned int* strip = malloc((size_t)(tri_count * 6 + 1) * sizeof(unsigned int));
+    unsigned char* visited = calloc((size_t)tri_count + 1, 1);
+    if (!strip || !visited) {
+        free(strip);
+        free(visited);
+        free_adjacency(&adj);
+        return -1;
+    }
+
+    int length = 0;
+    for (int t = 0; t < tri_count; t++) {
+        const unsigned int* tri = &indices[t * 3];
+        unsigned int next;
+        int rot = 0;
+
+        if (visited[t]) continue;
+        visited[t] = 1;
+
+        /* Start on the rotation whose far edge leads somewhere. The second
+         * triangle of a strip is odd, so it must contain edge c->b. */
+        for (int r = 0; r < 3; r++) {
+            if (find_triangle(&adj, indices, visited, tri[(r + 2) % 3],
+                              tri[(r + 1) % 3], &next) >= 0) {
+                rot = r;
+                break;
+            }
+        }
+
+        /* Join to the previous strip with degenerate triangles, padding so
+         * the new strip starts on an even position and keeps its winding */
+        if (length > 0) {
+            unsigned int last = strip[length - 1];
+            strip[length++] = last;
+            strip[length++] = tri[rot];
+            if (length % 2) strip[length++] = tri[rot];
+        }
+
+        int start = length;
+        strip[length++] = tri[rot];
+        strip[length++] = tri[(rot + 1) % 3];
+        strip[length++] = tri[(rot + 2) % 3];
+
+        for (;;) {
+            unsigned int p = strip[length - 2], q = strip[length - 1];
+            int odd = (length - 2 - start) % 2;
+            int n = odd ? find_triangle(&adj, indices, visited, q, p, &next)
+                        : find_triangle(&adj, indices, visited, p, q, &next);
+            if (n < 0) break;
+            visited[n] = 1;
+            strip[length++] = next;
+        }
+    }
+
+    free(visited);
+    free_adjacency(&adj);
+    *out_strip = strip;
+    return length;
+}
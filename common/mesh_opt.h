@@ -0,0 +1,60 @@
+/*
+ * mesh_opt.h - Vertex cache optimisation for indexed triangle meshes
+ *
+ * After a vertex is transformed, the GPU keeps the result in a small
+ * post-transform cache, so a vertex that is reused soon afterwards is
+ * almost free. Row-by-row grid indices revisit each row only after a whole
+ * row has passed, by which time the cache has forgotten it. The reordering
+ * here (Tipsify, Sander et al. 2007) emits triangles in tight fans so
+ * shared vertices are reused while still cached.
+ *
+ * The cost is measured as ACMR, the average cache miss ratio: vertices
+ * transformed per triangle drawn. A regular grid can approach 0.5; a
+ * cache-oblivious order is close to 1.0.
+ */
+
+#ifndef MESH_OPT_H
+#define MESH_OPT_H
+
+#define MESH_CACHE_SIZE 16   /* FIFO entries assumed when none is given */
+
+/*
+ * mesh_acmr - Simulated ACMR of a triangle list on a FIFO cache
+ */
+float mesh_acmr(const unsigned int* indices, int index_count, int vertex_count,
+                int cache_size);
+
+/*
+ * mesh_strip_acmr - Simulated ACMR of a triangle strip
+ *
+ * Misses are divided by the strip's non-degenerate triangles.
+ */
+float mesh_strip_acmr(const unsigned int* strip, int length, int vertex_count,
+                      int cache_size);
+
+/*
+ * mesh_optimize_vertex_cache - Reorder a triangle list in place
+ *
+ * The triangles and their winding are unchanged, only their order.
+ * Runs in linear time. Returns 0, or -1 if memory ran out (the indices
+ * are then left as they were).
+ */
+int mesh_optimize_vertex_cache(unsigned int* indices, int index_count,
+                               int vertex_count, int cache_size);
+
+/*
+ * mesh_build_strip - Convert a triangle list into one triangle strip
+ *
+ * Triangles are chained greedily through shared edges, keeping their
+ * winding, and the separate strips are joined with degenerate triangles.
+ * A strip needs well under half the indices of the list, but it
+ * follows its own path across the mesh, so its ACMR stays close to 1.0
+ * whatever order the list was in.
+ *
+ * Returns the strip length and stores a malloc'd strip in *out_strip, or
+ * returns -1 if memory ran out.
+ */
+int mesh_build_strip(const unsigned int* indices, int index_count, int vertex_count,
+                     unsigned int** out_strip);
+
+#endif /* MESH_OPT_H */
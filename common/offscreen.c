@@ -0,0 +1,135 @@
+/*
+ * offscreen.c - OpenGL context without a visible window
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <GL/glut.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "offscreen.h"
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <string.h>
+
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLSurface egl_surface = EGL_NO_SURFACE;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+#endif
+
+static const char* backend = "none";
+static int glut_window = 0;
+
+#ifdef HAVE_EGL
+static EGLDisplay open_egl_display(void) {
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    /* Surfaceless needs no window system at all, which is what CI has */
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display) {
+            EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                      EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+                return display;
+            }
+        }
+    }
+#else
+    (void)extensions;
+#endif
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+static int create_egl(int width, int height) {
+    static const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLint surface_attribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLConfig config;
+    EGLint num_configs = 0;
+
+    egl_display = open_egl_display();
+    if (egl_display == EGL_NO_DISPLAY) return -1;
+
+    if (!eglChooseConfig(egl_display, config_attribs, &config, 1, &num_configs) ||
+        num_configs == 0 || !eglBindAPI(EGL_OPENGL_API)) {
+        offscreen_destroy();
+        return -1;
+    }
+
+    egl_surface = eglCreatePbufferSurface(egl_display, config, surface_attribs);
+    egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, NULL);
+    if (egl_surface == EGL_NO_SURFACE || egl_context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context)) {
+        offscreen_destroy();
+        return -1;
+    }
+
+    backend = "egl-pbuffer";
+    return 0;
+}
+#endif
+
+int offscreen_create(int* argc, char** argv, int width, int height, int software) {
+    if (software) {
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+        setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+    }
+
+#ifdef HAVE_EGL
+    if (create_egl(width, height) == 0) return 0;
+    fprintf(stderr, "EGL pbuffer unavailable, falling back to a GLUT window\n");
+#endif
+
+    /* glutInit exits if there is no display, so check first on X11 */
+#if !defined(_WIN32) && !defined(__APPLE__)
+    if (!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY")) {
+        fprintf(stderr, "No display available for an OpenGL context\n");
+        return -1;
+    }
+#endif
+
+    glutInit(argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+    glutInitWindowSize(width, height);
+    glut_window = glutCreateWindow("Benchmark");
+    backend = "glut-window";
+    return 0;
+}
+
+const char* offscreen_backend(void) {
+    return backend;
+}
+
+void offscreen_destroy(void) {
+#ifdef HAVE_EGL
+    if (egl_display != EGL_NO_DISPLAY) {
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (egl_context != EGL_NO_CONTEXT) eglDestroyContext(egl_display, egl_context);
+        if (egl_surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, egl_surface);
+        eglTerminate(egl_display);
+    }
+    egl_display = EGL_NO_DISPLAY;
+    egl_surface = EGL_NO_SURFACE;
+    egl_context = EGL_NO_CONTEXT;
+#endif
+    if (glut_window) {
+        glutDestroyWindow(glut_window);
+        glut_window = 0;
+    }
+    backend = "none";
+}
@@ -0,0 +1,30 @@
+/*
+ * offscreen.h - OpenGL context without a visible window
+ *
+ * Benchmarks need a context that does not depend on a desktop session or
+ * on window-manager compositing. Where EGL is available (built with
+ * HAVE_EGL) this creates a pbuffer context, preferring Mesa's surfaceless
+ * platform so it works with no X server at all. Otherwise it falls back
+ * to an ordinary GLUT window.
+ */
+
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+/*
+ * offscreen_create - Create a context and make it current
+ *
+ * @software: Ask Mesa for its software rasteriser (LIBGL_ALWAYS_SOFTWARE)
+ *
+ * Returns 0 on success, -1 if no context could be created.
+ */
+int offscreen_create(int* argc, char** argv, int width, int height, int software);
+
+/*
+ * offscreen_backend - Short name of the backend in use, e.g. "egl-pbuffer"
+ */
+const char* offscreen_backend(void);
+
+void offscreen_destroy(void);
+
+#endif /* OFFSCREEN_H */
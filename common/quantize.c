@@ -0,0 +1,57 @@
+/*
+ * quantize.c - Compact vertex formats for large meshes
+ */
+
+#include <math.h>
+#include "quantize.h"
+
+void quantize_positions(const float* in, int in_stride, int count,
+                        short* out, int out_stride, quantize_transform_t* xf) {
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = count > 0 ? in[axis] : 0.0f, hi = lo;
+        for (int i = 1; i < count; i++) {
+            float v = in[i * in_stride + axis];
+            if (v < lo) lo = v;
+            if (v > hi) hi = v;
+        }
+
+        /* A flat axis still needs a usable scale */
+        xf->offset[axis] = (lo + hi) * 0.5f;
+        xf->scale[axis] = hi > lo ? (hi - lo) / (2.0f * QUANTIZE_MAX) : 1.0f;
+        xf->max_error[axis] = 0.0f;
+
+        float inv = 1.0f / xf->scale[axis];
+        for (int i = 0; i < count; i++) {
+            float v = in[i * in_stride + axis];
+            long q = lroundf((v - xf->offset[axis]) * inv);
+            if (q > QUANTIZE_MAX) q = QUANTIZE_MAX;
+            if (q < -QUANTIZE_MAX) q = -QUANTIZE_MAX;
+            out[i * out_stride + axis] = (short)q;
+
+            float error = fabsf(q * xf->scale[axis] + xf->offset[axis] - v);
+            if (error > xf->max_error[axis]) xf->max_error[axis] = error;
+        }
+    }
+    if (out_stride > 3) {
+        for (int i = 0; i < count; i++) out[i * out_stride + 3] = 0;
+    }
+}
+
+void quantize_colors(const float* in, int in_stride, int count, unsigned char* out) {
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) {
+            float c = in[i * in_stride + k];
+            c = c < 0.0f ? 0.0f : c > 1.0f ? 1.0f : c;
+            out[i * 4 + k] = (unsigned char)(c * 255.0f + 0.5f);
+        }
+        out[i * 4 + 3] = 255;
+    }
+}
+
+int quantize_indices(const unsigned int* in, int count, unsigned short* out) {
+    for (int i = 0; i < count; i++) {
+        if (in[i] > 65535) return -1;
+        out[i] = (unsigned short)in[i];
+    }
+    return 0;
+}
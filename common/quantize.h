@@ -0,0 +1,55 @@
+/*
+ * quantize.h - Compact vertex formats for large meshes
+ *
+ * A float position and colour take 24 bytes per vertex. Stored as three
+ * shorts (padded to four) and four unsigned bytes they take 12, which
+ * halves both the memory and the data the GPU has to fetch. Shorts only
+ * hold -32767..32767, so each axis is mapped onto that range and the
+ * mapping is undone by the modelview matrix at draw time:
+ *
+ *   glTranslatef(xf.offset[0], xf.offset[1], xf.offset[2]);
+ *   glScalef(xf.scale[0], xf.scale[1], xf.scale[2]);
+ *   glVertexPointer(3, GL_SHORT, 4 * sizeof(GLshort), positions);
+ *
+ * Indices become GLushort, so a mesh has to be split into chunks of at
+ * most 65536 vertices.
+ */
+
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#define QUANTIZE_MAX 32767
+
+typedef struct {
+    float offset[3];             /* position = q * scale + offset */
+    float scale[3];
+    float max_error[3];          /* Largest decoding error found per axis */
+} quantize_transform_t;
+
+/*
+ * quantize_positions - Convert float positions to shorts
+ *
+ * @in_stride, @out_stride: Distance between vertices, in floats and shorts
+ *
+ * Each axis is fitted to its own bounding range, so the error is at most
+ * half a step, scale / 2. The error actually found is stored in
+ * xf->max_error.
+ */
+void quantize_positions(const float* in, int in_stride, int count,
+                        short* out, int out_stride, quantize_transform_t* xf);
+
+/*
+ * quantize_colors - Convert RGB floats (0..1) to RGBA bytes, alpha 255
+ *
+ * The error is at most 1/510 per channel.
+ */
+void quantize_colors(const float* in, int in_stride, int count, unsigned char* out);
+
+/*
+ * quantize_indices - Narrow 32-bit indices to 16 bits
+ *
+ * Returns 0, or -1 if an index does not fit (out is then incomplete).
+ */
+int quantize_indices(const unsigned int* in, int count, unsigned short* out);
+
+#endif /* QUANTIZE_H */
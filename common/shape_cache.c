@@ -0,0 +1,344 @@
+/*
+ * shape_cache.c - GLUT shapes compiled into display lists on first use
+ */
+
+#include <GL/glut.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shape_cache.h"
+
+#define VERTEX_BYTES  24         /* Position and normal, as floats */
+#define TEAPOT_VERTICES 12288    /* freeglut: 32 patches, 8x8 quads as triangles */
+
+typedef enum {
+    SHAPE_CUBE,
+    SHAPE_SPHERE,
+    SHAPE_CONE,
+    SHAPE_TORUS,
+    SHAPE_TEAPOT
+} shape_kind_t;
+
+typedef struct {
+    shape_kind_t kind;
+    int wire;
+    double a, b;                 /* Size, radius, base or inner radius; height or outer radius */
+    int slices, stacks;          /* Or sides and rings for the torus */
+} shape_key_t;
+
+typedef struct {
+    shape_key_t key;
+    GLuint list;
+    size_t bytes;
+    unsigned long last_used;
+} shape_entry_t;
+
+static struct {
+    shape_entry_t entries[SHAPE_CACHE_MAX_SHAPES];
+    int count;
+    size_t bytes;
+    size_t budget;
+    unsigned long clock;         /* Advances on every draw, for least recently used */
+    unsigned long hits, misses, evictions;
+} cache = {.budget = SHAPE_CACHE_DEFAULT_BUDGET};
+
+/* ------------------------------------------------------------------------
+ * Tessellation
+ *
+ * The sphere, cone and torus are surfaces of revolution about z: a
+ * profile of (radius, z) points with normals, swept round in 'slices'
+ * steps. Positions and normals match freeglut's, so a cached shape looks
+ * the same as GLUT's. Only the teapot is GLUT's own, which needs glutInit.
+ * ------------------------------------------------------------------------ */
+
+#define TWO_PI 6.28318530717958647692
+
+typedef struct {
+    GLfloat radius, z;           /* Distance from the axis, and height */
+    GLfloat nr, nz;              /* The normal, outward and up */
+} profile_t;
+
+typedef struct {
+    GLfloat c, s;
+} turn_t;
+
+static void vertex(const profile_t* p, const turn_t* t) {
+    glNormal3f(t->c * p->nr, t->s * p->nr, p->nz);
+    glVertex3f(t->c * p->radius, t->s * p->radius, p->z);
+}
+
+/* Strips from each profile point to the next, which must be lower on the outside */
+static void draw_revolution(const profile_t* profile, int points, int slices, int wire) {
+    turn_t* turn = malloc((size_t)(slices + 1) * sizeof(turn_t));
+
+    if (!turn) return;
+    for (int j = 0; j < slices; j++) {
+        double a = TWO_PI * j / slices;
+        turn[j].c = (GLfloat)cos(a);
+        turn[j].s = (GLfloat)sin(a);
+    }
+    turn[slices] = turn[0];
+
+    if (wire) {
+        for (int i = 0; i < points; i++) {
+            glBegin(GL_LINE_LOOP);
+            for (int j = 0; j < slices; j++) vertex(&profile[i], &turn[j]);
+            glEnd();
+        }
+        for (int j = 0; j < slices; j++) {
+            glBegin(GL_LINE_STRIP);
+            for (int i = 0; i < points; i++) vertex(&profile[i], &turn[j]);
+            glEnd();
+        }
+    } else {
+        for (int i = 0; i + 1 < points; i++) {
+            glBegin(GL_TRIANGLE_STRIP);
+            for (int j = 0; j <= slices; j++) {
+                vertex(&profile[i], &turn[j]);
+                vertex(&profile[i + 1], &turn[j]);
+            }
+            glEnd();
+        }
+    }
+    free(turn);
+}
+
+static void draw_cube(GLfloat size, int wire) {
+    static const GLfloat normals[6][3] = {
+        {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+    };
+    /* Corners of each face, counter-clockwise seen from outside, as +-1 */
+    static const signed char corners[6][4][3] = {
+        {{1, -1, 1}, {1, -1, -1}, {1, 1, -1}, {1, 1, 1}},
+        {{-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}},
+        {{-1, 1, 1}, {1, 1, 1}, {1, 1, -1}, {-1, 1, -1}},
+        {{-1, -1, -1}, {1, -1, -1}, {1, -1, 1}, {-1, -1, 1}},
+        {{-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}},
+        {{1, -1, -1}, {-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}},
+    };
+    GLfloat h = size * 0.5f;
+
+    if (!wire) glBegin(GL_QUADS);
+    for (int f = 0; f < 6; f++) {
+        if (wire) glBegin(GL_LINE_LOOP);
+        glNormal3fv(normals[f]);
+        for (int v = 0; v < 4; v++) {
+            glVertex3f(corners[f][v][0] * h, corners[f][v][1] * h, corners[f][v][2] * h);
+        }
+        if (wire) glEnd();
+    }
+    if (!wire) glEnd();
+}
+
+/* The shape, drawn with no list: what each call to GLUT costs */
+static void draw_immediate(const shape_key_t* k) {
+    int points = (k->kind == SHAPE_TORUS ? k->slices : k->stacks) + 1;
+    profile_t* profile;
+
+    if (k->kind == SHAPE_CUBE) {
+        draw_cube((GLfloat)k->a, k->wire);
+        return;
+    }
+    if (k->kind == SHAPE_TEAPOT) {
+        if (k->wire) glutWireTeapot(k->a);
+        else glutSolidTeapot(k->a);
+        return;
+    }
+    if (k->slices < 1 || k->stacks < 1 || !(profile = malloc((size_t)points * sizeof(profile_t)))) {
+        return;
+    }
+
+    for (int i = 0; i < points; i++) {
+        profile_t* p = &profile[i];
+        if (k->kind == SHAPE_SPHERE) {
+            /* Pole to pole */
+            double a = TWO_PI * 0.5 * i / k->stacks;
+            p->nr = (GLfloat)sin(a);
+            p->nz = (GLfloat)cos(a);
+            p->radius = (GLfloat)k->a * p->nr;
+            p->z = (GLfloat)k->a * p->nz;
+        } else if (k->kind == SHAPE_CONE) {
+            /* Apex to base */
+            double t = (double)i / k->stacks, slant = sqrt(k->a * k->a + k->b * k->b);
+            p->radius = (GLfloat)(k->a * t);
+            p->z = (GLfloat)(k->b * (1.0 - t));
+            p->nr = (GLfloat)(k->b / slant);
+            p->nz = (GLfloat)(k->a / slant);
+        } else {
+            /* Round the tube, downward on the outside; slices are its sides */
+            double a = -TWO_PI * i / k->slices;
+            p->nr = (GLfloat)cos(a);
+            p->nz = (GLfloat)sin(a);
+            p->radius = (GLfloat)(k->b + k->a * p->nr);
+            p->z = (GLfloat)k->a * p->nz;
+        }
+    }
+    if (k->kind == SHAPE_TORUS) draw_revolution(profile, points, k->stacks, k->wire);
+    else draw_revolution(profile, points, k->slices, k->wire);
+
+    if (k->kind == SHAPE_CONE && !k->wire) {
+        /* The base, facing down */
+        glBegin(GL_TRIANGLE_FAN);
+        glNormal3f(0.0f, 0.0f, -1.0f);
+        glVertex3f(0.0f, 0.0f, 0.0f);
+        for (int j = k->slices; j >= 0; j--) {
+            double a = TWO_PI * j / k->slices;
+            glVertex3f((GLfloat)(k->a * cos(a)), (GLfloat)(k->a * sin(a)), 0.0f);
+        }
+        glEnd();
+    }
+    free(profile);
+}
+
+/* ------------------------------------------------------------------------
+ * The cache
+ * ------------------------------------------------------------------------ */
+
+/*
+ * The driver does not say how much a list takes, so estimate it from the
+ * vertices sent: the strips above, four per face for the cube, and
+ * freeglut's count for the teapot.
+ */
+static size_t estimate_bytes(const shape_key_t* k) {
+    size_t strips = (size_t)(k->slices + 1) * 2 * (size_t)k->stacks;
+
+    switch (k->kind) {
+        case SHAPE_CUBE: return 24 * VERTEX_BYTES;
+        case SHAPE_SPHERE: return strips * VERTEX_BYTES;
+        case SHAPE_CONE: return (strips + (size_t)k->slices + 2) * VERTEX_BYTES;
+        case SHAPE_TORUS: return (size_t)(k->stacks + 1) * 2 * (size_t)k->slices * VERTEX_BYTES;
+        case SHAPE_TEAPOT: return (size_t)TEAPOT_VERTICES * (VERTEX_BYTES + 8);
+    }
+    return 0;
+}
+
+static int same_key(const shape_key_t* a, const shape_key_t* b) {
+    return a->kind == b->kind && a->wire == b->wire && a->a == b->a && a->b == b->b &&
+           a->slices == b->slices && a->stacks == b->stacks;
+}
+
+static void evict(int i) {
+    glDeleteLists(cache.entries[i].list, 1);
+    cache.bytes -= cache.entries[i].bytes;
+    cache.entries[i] = cache.entries[--cache.count];
+    cache.evictions++;
+}
+
+static void evict_oldest(void) {
+    int oldest = 0;
+
+    for (int i = 1; i < cache.count; i++) {
+        if (cache.entries[i].last_used < cache.entries[oldest].last_used) oldest = i;
+    }
+    evict(oldest);
+}
+
+static void draw(const shape_key_t* key) {
+    GLint compiling;
+
+    cache.clock++;
+    for (int i = 0; i < cache.count; i++) {
+        if (same_key(&cache.entries[i].key, key)) {
+            cache.entries[i].last_used = cache.clock;
+            cache.hits++;
+            glCallList(cache.entries[i].list);
+            return;
+        }
+    }
+
+    /* A miss: compile it, unless it cannot be kept or a list is being compiled */
+    cache.misses++;
+    size_t bytes = estimate_bytes(key);
+    glGetIntegerv(GL_LIST_INDEX, &compiling);
+    if (bytes > cache.budget || compiling != 0) {
+        draw_immediate(key);
+        return;
+    }
+    while (cache.count > 0 && (cache.count == SHAPE_CACHE_MAX_SHAPES ||
+                               cache.bytes + bytes > cache.budget)) {
+        evict_oldest();
+    }
+    GLuint list = glGenLists(1);
+    if (list == 0) {
+        draw_immediate(key);
+        return;
+    }
+    glNewList(list, GL_COMPILE);
+    draw_immediate(key);
+    glEndList();
+
+    shape_entry_t* entry = &cache.entries[cache.count++];
+    entry->key = *key;
+    entry->list = list;
+    entry->bytes = bytes;
+    entry->last_used = cache.clock;
+    cache.bytes += bytes;
+    glCallList(list);
+}
+
+static void draw_shape(shape_kind_t kind, int wire, double a, double b, int slices, int stacks) {
+    shape_key_t key;
+
+    memset(&key, 0, sizeof(key));
+    key.kind = kind;
+    key.wire = wire;
+    key.a = a;
+    key.b = b;
+    key.slices = slices;
+    key.stacks = stacks;
+    draw(&key);
+}
+
+void shape_cache_solid_cube(double size) { draw_shape(SHAPE_CUBE, 0, size, 0.0, 0, 0); }
+void shape_cache_wire_cube(double size) { draw_shape(SHAPE_CUBE, 1, size, 0.0, 0, 0); }
+
+void shape_cache_solid_sphere(double radius, int slices, int stacks) {
+    draw_shape(SHAPE_SPHERE, 0, radius, 0.0, slices, stacks);
+}
+
+void shape_cache_wire_sphere(double radius, int slices, int stacks) {
+    draw_shape(SHAPE_SPHERE, 1, radius, 0.0, slices, stacks);
+}
+
+void shape_cache_solid_cone(double base, double height, int slices, int stacks) {
+    draw_shape(SHAPE_CONE, 0, base, height, slices, stacks);
+}
+
+void shape_cache_wire_cone(double base, double height, int slices, int stacks) {
+    draw_shape(SHAPE_CONE, 1, base, height, slices, stacks);
+}
+
+void shape_cache_solid_torus(double inner_radius, double outer_radius, int sides, int rings) {
+    draw_shape(SHAPE_TORUS, 0, inner_radius, outer_radius, sides, rings);
+}
+
+void shape_cache_wire_torus(double inner_radius, double outer_radius, int sides, int rings) {
+    draw_shape(SHAPE_TORUS, 1, inner_radius, outer_radius, sides, rings);
+}
+
+void shape_cache_solid_teapot(double size) { draw_shape(SHAPE_TEAPOT, 0, size, 0.0, 0, 0); }
+void shape_cache_wire_teapot(double size) { draw_shape(SHAPE_TEAPOT, 1, size, 0.0, 0, 0); }
+
+void shape_cache_set_budget(size_t bytes) {
+    cache.budget = bytes;
+    while (cache.count > 0 && cache.bytes > cache.budget) evict_oldest();
+}
+
+void shape_cache_get_stats(shape_cache_stats_t* stats) {
+    stats->hits = cache.hits;
+    stats->misses = cache.misses;
+    stats->evictions = cache.evictions;
+    stats->lists = cache.count;
+    stats->bytes = cache.bytes;
+    stats->budget = cache.budget;
+}
+
+void shape_cache_reset_stats(void) {
+    cache.hits = cache.misses = cache.evictions = 0;
+}
+
+void shape_cache_clear(void) {
+    for (int i = 0; i < cache.count; i++) glDeleteLists(cache.entries[i].list, 1);
+    cache.count = 0;
+    cache.bytes = 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * shape_cache.h - GLUT shapes compiled into display lists on first use
+ *
+ * glutSolidSphere and friends compute every vertex and normal again on
+ * each call. This cache compiles each distinct shape (kind,
+ * size and tessellation) into a display list the first time it is
+ * drawn, and calls the list after that. The functions take the same
+ * arguments as their GLUT counterparts:
+ *
+ *   glutSolidSphere(0.5, 32, 32);        becomes
+ *   shape_cache_solid_sphere(0.5, 32, 32);
+ *
+ * The cube, sphere, cone and torus are tessellated here, with freeglut's
+ * positions and normals, so they need no glutInit and work in any
+ * context. The teapot is GLUT's own.
+ *
+ * Each list's size is estimated from its vertex count. When the lists
+ * would go over the budget, the least recently drawn ones are deleted
+ * with glDeleteLists. Display lists belong to the GL context, so call
+ * these with the same context current every time, and call
+ * shape_cache_clear() before destroying it.
+ *
+ * Inside a glNewList of the caller's own, shapes are drawn straight into
+ * that list: a reference to a cached list could be left dangling by a
+ * later eviction.
+ */
+
+#ifndef SHAPE_CACHE_H
+#define SHAPE_CACHE_H
+
+#include <stddef.h>
+
+#define SHAPE_CACHE_MAX_SHAPES 256
+#define SHAPE_CACHE_DEFAULT_BUDGET (8 * 1024 * 1024)
+
+typedef struct {
+    unsigned long hits;          /* Drawn from an existing list */
+    unsigned long misses;        /* Compiled, or drawn directly as too big to keep */
+    unsigned long evictions;     /* Lists deleted to make room */
+    int lists;                   /* Lists held now */
+    size_t bytes;                /* Their estimated size */
+    size_t budget;
+} shape_cache_stats_t;
+
+void shape_cache_solid_cube(double size);
+void shape_cache_wire_cube(double size);
+void shape_cache_solid_sphere(double radius, int slices, int stacks);
+void shape_cache_wire_sphere(double radius, int slices, int stacks);
+void shape_cache_solid_cone(double base, double height, int slices, int stacks);
+void shape_cache_wire_cone(double base, double height, int slices, int stacks);
+void shape_cache_solid_torus(double inner_radius, double outer_radius, int sides, int rings);
+void shape_cache_wire_torus(double inner_radius, double outer_radius, int sides, int rings);
+void shape_cache_solid_teapot(double size);
+void shape_cache_wire_teapot(double size);
+
+/*
+ * shape_cache_set_budget - Most bytes of lists to keep, deleting the
+ * least recently drawn lists now if they are over it
+ *
+ * A shape too big for the budget on its own is drawn without a list.
+ */
+void shape_cache_set_budget(size_t bytes);
+
+void shape_cache_get_stats(shape_cache_stats_t* stats);
+
+/*
+ * shape_cache_reset_stats - Zero the hit, miss and eviction counts
+ */
+void shape_cache_reset_stats(void);
+
+/*
+ * shape_cache_clear - Delete every list; the context must be current
+ */
+void shape_cache_clear(void);
+
+#endif /* SHAPE_CACHE_H */
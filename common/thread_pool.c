@@ -0,0 +1,150 @@
+/*
+ * thread_pool.c - Persistent worker threads for per-frame parallel loops
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+#define CHUNKS_PER_THREAD 4
+
+struct thread_pool {
+    pthread_t* workers;
+    int worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    unsigned generation;    /* Bumped for every loop */
+    int busy;               /* Workers still on the current loop */
+    int shutdown;
+
+    /* Current loop */
+    thread_pool_fn fn;
+    void* ctx;
+    int count;
+    int chunk;
+    int next;
+};
+
+static void run_chunks(thread_pool_t* pool) {
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int begin = pool->next;
+        pool->next += pool->chunk;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (begin >= pool->count) return;
+        int end = begin + pool->chunk;
+        pool->fn(pool->ctx, begin, end < pool->count ? end : pool->count);
+    }
+}
+
+static void* worker_main(void* arg) {
+    thread_pool_t* pool = arg;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_chunks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+thread_pool_t* thread_pool_create(int threads) {
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    if (!pool) return NULL;
+
+    if (threads <= 0) threads = thread_pool_cpu_count();
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    if (threads > 1) {
+        pool->workers = malloc((threads - 1) * sizeof(pthread_t));
+        if (!pool->workers) {
+            thread_pool_destroy(pool);
+            return NULL;
+        }
+        for (int i = 0; i < threads - 1; i++) {
+            if (pthread_create(&pool->workers[i], NULL, worker_main, pool) != 0) break;
+            pool->worker_count++;
+        }
+    }
+    return pool;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int thread_pool_size(const thread_pool_t* pool) {
+    return pool ? pool->worker_count + 1 : 1;
+}
+
+void thread_pool_parallel_for(thread_pool_t* pool, int count, int min_batch,
+                              thread_pool_fn fn, void* ctx) {
+    if (count <= 0) return;
+    if (min_batch < 1) min_batch = 1;
+
+    /* Not worth waking anyone: run it here */
+    if (!pool || pool->worker_count == 0 || count < 2 * min_batch) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    int threads = pool->worker_count + 1;
+    int chunk = count / (threads * CHUNKS_PER_THREAD);
+    if (chunk < min_batch) chunk = min_batch;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->count = count;
+    pool->chunk = chunk;
+    pool->next = 0;
+    pool->busy = pool->worker_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_chunks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int thread_pool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
@@ -0,0 +1,51 @@
+/*
+ * thread_pool.h - Persistent worker threads for per-frame parallel loops
+ *
+ * Starting threads every frame costs more than the work they would do, so
+ * the pool starts its workers once and hands them ranges of a loop on
+ * demand. The calling thread takes part in every loop, and a NULL pool
+ * simply runs the loop on the calling thread.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef struct thread_pool thread_pool_t;
+
+/* Processes items [begin, end) of a parallel loop */
+typedef void (*thread_pool_fn)(void* ctx, int begin, int end);
+
+/*
+ * thread_pool_create - Start a pool
+ *
+ * @threads: Threads working on each loop, including the caller, so 1 starts
+ *           no workers at all. 0 uses one per online CPU.
+ *
+ * Returns NULL if the pool could not be created.
+ */
+thread_pool_t* thread_pool_create(int threads);
+
+void thread_pool_destroy(thread_pool_t* pool);
+
+/*
+ * thread_pool_size - Threads working on each loop, 1 for a NULL pool
+ */
+int thread_pool_size(const thread_pool_t* pool);
+
+/*
+ * thread_pool_parallel_for - Run fn over [0, count) and wait for it to finish
+ *
+ * @min_batch: Smallest range worth handing to another thread
+ *
+ * Ranges are handed out in chunks as threads become free, so uneven
+ * per-item costs still balance. Not reentrant: call it from one thread.
+ */
+void thread_pool_parallel_for(thread_pool_t* pool, int count, int min_batch,
+                              thread_pool_fn fn, void* ctx);
+
+/*
+ * thread_pool_cpu_count - Number of online CPUs, at least 1
+ */
+int thread_pool_cpu_count(void);
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,149 @@
+/*
+ * timing.c - High-resolution monotonic clock helpers
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include "timing.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+uint64_t timing_now_ns(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000ull +
+           (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000ull / freq.QuadPart;
+}
+
+uint64_t timing_cpu_ns(void) {
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) * 100; /* FILETIME ticks are 100 ns */
+}
+
+void timing_sleep_until_ns(uint64_t deadline) {
+    uint64_t now = timing_now_ns();
+    if (deadline > now) Sleep((DWORD)((deadline - now) / 1000000));
+}
+
+#else
+#include <errno.h>
+#include <time.h>
+
+static uint64_t to_ns(const struct timespec* ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ull + (uint64_t)ts->tv_nsec;
+}
+
+uint64_t timing_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return to_ns(&ts);
+}
+
+uint64_t timing_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return to_ns(&ts);
+}
+
+void timing_sleep_until_ns(uint64_t deadline) {
+#ifdef __APPLE__
+    uint64_t now = timing_now_ns();
+    if (deadline > now) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)((deadline - now) / 1000000000ull);
+        ts.tv_nsec = (long)((deadline - now) % 1000000000ull);
+        nanosleep(&ts, NULL);
+    }
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline / 1000000000ull);
+    ts.tv_nsec = (long)(deadline % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        /* Interrupted by a signal; the deadline is absolute, so retry */
+    }
+#endif
+}
+#endif
+
+double timing_seconds(void) {
+    return timing_now_ns() / 1e9;
+}
+
+void frame_clock_init(frame_clock_t* clock, frame_clock_smoothing_t smoothing) {
+    memset(clock, 0, sizeof(*clock));
+    clock->last_ns = timing_now_ns();
+    clock->scale = 1.0;
+    clock->max_dt = 0.1;
+    clock->ema_alpha = 0.2;
+    clock->smoothing = smoothing;
+}
+
+static double median_of(const double* values, int count) {
+    double sorted[FRAME_CLOCK_MEDIAN_TAPS];
+    memcpy(sorted, values, count * sizeof(double));
+    for (int i = 1; i < count; i++) {
+        double v = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > v) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = v;
+    }
+    return (count & 1) ? sorted[count / 2]
+                       : 0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+}
+
+double frame_clock_tick(frame_clock_t* clock) {
+    uint64_t now = timing_now_ns();
+    clock->raw_ns = now - clock->last_ns;
+    clock->last_ns = now;
+
+    if (clock->paused) {
+        clock->dt = 0.0;
+        return 0.0;
+    }
+
+    double dt = clock->raw_ns / 1e9;
+    if (dt > clock->max_dt) dt = clock->max_dt;
+
+    switch (clock->smoothing) {
+        case FRAME_CLOCK_RAW:
+            break;
+        case FRAME_CLOCK_EMA:
+            if (clock->history_count == 0) {
+                clock->history[0] = dt;
+                clock->history_count = 1;
+            } else {
+                clock->history[0] += (dt - clock->history[0]) * clock->ema_alpha;
+            }
+            dt = clock->history[0];
+            break;
+        case FRAME_CLOCK_MEDIAN:
+            clock->history[clock->history_pos] = dt;
+            clock->history_pos = (clock->history_pos + 1) % FRAME_CLOCK_MEDIAN_TAPS;
+            if (clock->history_count < FRAME_CLOCK_MEDIAN_TAPS) clock->history_count++;
+            dt = median_of(clock->history, clock->history_count);
+            break;
+    }
+
+    dt *= clock->scale;
+    clock->dt = dt;
+    clock->time += dt;
+    return dt;
+}
+
+void frame_clock_set_paused(frame_clock_t* clock, int paused) {
+    clock->paused = paused;
+}
+
+void frame_clock_set_scale(frame_clock_t* clock, double scale) {
+    clock->scale = scale > 0.0 ? scale : 0.0;
+}
@@ -0,0 +1,83 @@
+/*
+ * timing.h - High-resolution monotonic clock helpers
+ *
+ * Use these instead of glutGet(GLUT_ELAPSED_TIME), which only has
+ * millisecond resolution, or gettimeofday(), which jumps when the system
+ * clock is adjusted.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+/*
+ * timing_now_ns - Monotonic wall-clock time in nanoseconds
+ *
+ * Unaffected by system clock changes; only differences are meaningful.
+ */
+uint64_t timing_now_ns(void);
+
+/*
+ * timing_cpu_ns - CPU time consumed by this process in nanoseconds
+ */
+uint64_t timing_cpu_ns(void);
+
+/*
+ * timing_sleep_until_ns - Sleep until a timing_now_ns() deadline
+ *
+ * May wake slightly late; callers needing precision spin the last part.
+ */
+void timing_sleep_until_ns(uint64_t deadline);
+
+/*
+ * timing_seconds - timing_now_ns() as seconds, for coarse measurements
+ */
+double timing_seconds(void);
+
+/* Frame clock: per-frame delta time with optional smoothing */
+
+typedef enum {
+    FRAME_CLOCK_RAW,     /* Exact measured delta */
+    FRAME_CLOCK_EMA,     /* Exponential moving average */
+    FRAME_CLOCK_MEDIAN   /* Median of the last few deltas; ignores spikes */
+} frame_clock_smoothing_t;
+
+#define FRAME_CLOCK_MEDIAN_TAPS 5
+
+typedef struct {
+    uint64_t last_ns;
+    uint64_t raw_ns;            /* Last unsmoothed, unscaled delta */
+    double dt;                  /* Last delta returned, in seconds */
+    double time;                /* Sum of returned deltas: scaled game time */
+    double scale;               /* Time multiplier, 1.0 = real time */
+    double max_dt;              /* Clamp for stalls, e.g. after a breakpoint */
+    double ema_alpha;           /* Weight of the newest sample for EMA */
+    int paused;
+    frame_clock_smoothing_t smoothing;
+    double history[FRAME_CLOCK_MEDIAN_TAPS];
+    int history_count;
+    int history_pos;
+} frame_clock_t;
+
+/*
+ * frame_clock_init - Start a frame clock at the current time
+ *
+ * Defaults: scale 1.0, max_dt 0.1 s, ema_alpha 0.2. The fields may be
+ * changed directly after init.
+ */
+void frame_clock_init(frame_clock_t* clock, frame_clock_smoothing_t smoothing);
+
+/*
+ * frame_clock_tick - Advance the clock; call once per frame
+ *
+ * Returns the smoothed, clamped and scaled delta in seconds, or 0 while
+ * paused. Smoothing trades exactness for stability: the sum of returned
+ * deltas can drift slightly from wall time.
+ */
+double frame_clock_tick(frame_clock_t* clock);
+
+void frame_clock_set_paused(frame_clock_t* clock, int paused);
+void frame_clock_set_scale(frame_clock_t* clock, double scale);
+
+#endif /* TIMING_H */